@@ -318,6 +318,16 @@ class Builder:
   def gather_avg(self, embedding, indices, name=None):
     return self.pooling_gather("GatherAvg", embedding, indices, name)
 
+  def quantize(self, x, scale, name=None):
+    result = self.op("Quantize", [x, scale], name)
+    result.type = DT_INT8
+    return result
+
+  def dequantize(self, x, scale, name=None):
+    result = self.op("Dequantize", [x, scale], name)
+    result.type = DT_FLOAT
+    return result
+
   def matmul(self, x, y, name=None):
     result = self.op("MatMul", [x, y], name)
     result.shape = x.shape[:-2] + [x.shape[-2], y.shape[-1]]
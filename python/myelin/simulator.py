@@ -61,7 +61,17 @@ def compute(flow, f, data):
     o = op.outputs
 
     if op.type == "MatMul":
-      v[o[0]] = np.matmul(v[i[0]], v[i[1]])
+      if o[0].type != i[0].type:
+        # Widen inputs to output type, e.g. int8 x int8 -> int32.
+        t = nptypes[o[0].type]
+        v[o[0]] = np.matmul(v[i[0]].astype(t), v[i[1]].astype(t))
+      else:
+        v[o[0]] = np.matmul(v[i[0]], v[i[1]])
+    elif op.type == "Quantize":
+      q = np.clip(np.rint(v[i[0]] * v[i[1]]), -127, 127)
+      v[o[0]] = q.astype(np.int8)
+    elif op.type == "Dequantize":
+      v[o[0]] = (v[i[0]] * v[i[1]]).astype(np.float32)
     elif op.type == "Exp":
       v[o[0]] = np.exp(v[i[0]])
     elif op.type == "Sigmoid":
@@ -228,7 +238,12 @@ def compute(flow, f, data):
       splits = np.split(v[i[0]], v[i[1]], v[i[2]])
       for k in range(len(splits)): v[o[k]] = splits[k]
     elif op.type == "Gather":
-      v[o[0]] = gather(v[i[0]], v[i[1]])
+      r = gather(v[i[0]], v[i[1]])
+      if len(i) == 3:
+        # Use oov vector for negative features.
+        r[v[i[1]] < 0] = v[i[2]]
+      if np.prod(o[0].shape) == r.size: r = r.reshape(o[0].shape)
+      v[o[0]] = r
     elif op.type == "GatherSum":
       v[o[0]] = np.sum(gather(v[i[0]], v[i[1]]), axis=1)
     elif op.type == "GatherMax":
@@ -48,6 +48,18 @@ flags.define("--lbzip2",
              default=False,
              action='store_true')
 
+flags.define("--bzip2_threads",
+             help="number of threads for parallel bzip2 decompression",
+             default=0,
+             type=int,
+             metavar="NUM")
+
+flags.define("--import_threads",
+             help="number of worker threads for importing wiki dumps",
+             default=5,
+             type=int,
+             metavar="NUM")
+
 class WikiWorkflow:
   def __init__(self, name=None, wf=None):
     if wf == None: wf = Workflow(name)
@@ -130,8 +142,10 @@ class WikiWorkflow:
                              name="wiki-decompress",
                              format="text/json")
       else:
-        input = self.wf.read(dump)
-      input = self.wf.parallel(input, threads=5)
+        input = self.wf.read(dump, params={
+          "decompression_threads": flags.arg.bzip2_threads,
+        })
+      input = self.wf.parallel(input, threads=flags.arg.import_threads)
       items, properties = self.wikidata_import(input)
       items_output = self.wikidata_items()
       self.wf.write(items, items_output, name="item-writer")
@@ -288,6 +302,8 @@ class WikiWorkflow:
     """Task for converting Wikipedia dump to SLING articles and redirects.
     Returns article, categories, and redirect channels."""
     task = self.wf.task("wikipedia-importer", name=name)
+    task.add_param("decompression_threads", flags.arg.bzip2_threads)
+    task.add_param("worker_threads", flags.arg.import_threads)
     task.attach_input("input", input)
     articles = self.wf.channel(task, name="articles", format="message/frame")
     categories = self.wf.channel(task, name="categories",
@@ -0,0 +1,286 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/http/http-client.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "sling/base/logging.h"
+#include "sling/string/numbers.h"
+
+namespace sling {
+
+namespace {
+
+// Return system error.
+Status Error(const char *context) {
+  return Status(errno, context, strerror(errno));
+}
+
+}  // namespace
+
+HTTPClient::HTTPClient(const string &host, int port)
+    : host_(host), port_(port) {}
+
+HTTPClient::~HTTPClient() {
+  Close();
+}
+
+Status HTTPClient::Connect() {
+  Close();
+
+  // Look up server address.
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *addr = nullptr;
+  string port = SimpleItoa(port_);
+  int rc = getaddrinfo(host_.c_str(), port.c_str(), &hints, &addr);
+  if (rc != 0) return Status(rc, "getaddrinfo", gai_strerror(rc));
+
+  // Connect to server.
+  sock_ = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+  if (sock_ < 0) {
+    freeaddrinfo(addr);
+    return Error("socket");
+  }
+  rc = connect(sock_, addr->ai_addr, addr->ai_addrlen);
+  freeaddrinfo(addr);
+  if (rc < 0) {
+    Status st = Error("connect");
+    Close();
+    return st;
+  }
+
+  // Send requests right away.
+  int on = 1;
+  setsockopt(sock_, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+  input_.reset(1 << 12);
+  return Status::OK;
+}
+
+void HTTPClient::Close() {
+  if (sock_ != -1) {
+    close(sock_);
+    sock_ = -1;
+  }
+  input_.clear();
+}
+
+Status HTTPClient::Request(const char *method, const char *path,
+                           Text body, const char *content_type,
+                           HTTPClientResponse *response) {
+  // Build request header.
+  string request;
+  request.append(method);
+  request.append(" ");
+  request.append(path);
+  request.append(" HTTP/1.1\r\n");
+  request.append("Host: ");
+  request.append(host_);
+  request.append(":");
+  request.append(SimpleItoa(port_));
+  request.append("\r\n");
+  if (content_type != nullptr) {
+    request.append("Content-Type: ");
+    request.append(content_type);
+    request.append("\r\n");
+  }
+  if (!body.empty() || strcmp(method, "POST") == 0) {
+    request.append("Content-Length: ");
+    request.append(SimpleItoa(body.size()));
+    request.append("\r\n");
+  }
+  request.append("\r\n");
+  request.append(body.data(), body.size());
+
+  // Send request. If the server has closed a kept-alive connection, we
+  // reconnect and try again.
+  bool reused = connected();
+  if (!reused) {
+    Status st = Connect();
+    if (!st.ok()) return st;
+  }
+  Status st = Send(request.data(), request.size());
+  if (st.ok()) st = ReceiveResponse(response);
+  if (!st.ok() && reused) {
+    st = Connect();
+    if (!st.ok()) return st;
+    st = Send(request.data(), request.size());
+    if (st.ok()) st = ReceiveResponse(response);
+  }
+  if (!st.ok() || !keep_) Close();
+  return st;
+}
+
+Status HTTPClient::Send(const char *data, int size) {
+  while (size > 0) {
+    int rc = send(sock_, data, size, MSG_NOSIGNAL);
+    if (rc < 0) {
+      if (errno == EINTR) continue;
+      return Error("send");
+    }
+    data += rc;
+    size -= rc;
+  }
+  return Status::OK;
+}
+
+Status HTTPClient::Receive(bool *eof) {
+  *eof = false;
+  input_.flush();
+  input_.ensure(1 << 12);
+  for (;;) {
+    int rc = recv(sock_, input_.end, input_.remaining(), 0);
+    if (rc < 0) {
+      if (errno == EINTR) continue;
+      return Error("recv");
+    }
+    if (rc == 0) *eof = true;
+    input_.end += rc;
+    return Status::OK;
+  }
+}
+
+Status HTTPClient::ReadLine(string *line) {
+  for (;;) {
+    // Find end of line in input buffer.
+    char *nl = static_cast<char *>(memchr(input_.start, '\n', input_.size()));
+    if (nl != nullptr) {
+      char *end = nl;
+      if (end > input_.start && end[-1] == '\r') end--;
+      line->assign(input_.start, end - input_.start);
+      input_.start = nl + 1;
+      return Status::OK;
+    }
+
+    // Receive more data.
+    bool eof;
+    Status st = Receive(&eof);
+    if (!st.ok()) return st;
+    if (eof) return Status(EPIPE, "Connection closed by server");
+  }
+}
+
+Status HTTPClient::ReadBytes(int size, string *data) {
+  while (size > 0) {
+    if (input_.empty()) {
+      bool eof;
+      Status st = Receive(&eof);
+      if (!st.ok()) return st;
+      if (eof) return Status(EPIPE, "Connection closed by server");
+    }
+    int n = input_.size();
+    if (n > size) n = size;
+    data->append(input_.start, n);
+    input_.start += n;
+    size -= n;
+  }
+  return Status::OK;
+}
+
+Status HTTPClient::ReceiveResponse(HTTPClientResponse *response) {
+  response->status = 0;
+  response->content_type.clear();
+  response->body.clear();
+
+  // Read status line.
+  string line;
+  Status st = ReadLine(&line);
+  if (!st.ok()) return st;
+  int sp = line.find(' ');
+  if (line.compare(0, 5, "HTTP/") != 0 || sp == -1) {
+    return Status(1, "Invalid HTTP response", line);
+  }
+  bool http11 = line.compare(0, sp, "HTTP/1.1") == 0;
+  response->status = atoi(line.c_str() + sp + 1);
+
+  // Read response headers.
+  int content_length = -1;
+  bool chunked = false;
+  keep_ = http11;
+  for (;;) {
+    st = ReadLine(&line);
+    if (!st.ok()) return st;
+    if (line.empty()) break;
+    int colon = line.find(':');
+    if (colon == -1) continue;
+    string name = line.substr(0, colon);
+    int start = colon + 1;
+    while (start < line.size() && line[start] == ' ') start++;
+    const char *value = line.c_str() + start;
+    if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+      content_length = atoi(value);
+    } else if (strcasecmp(name.c_str(), "Content-Type") == 0) {
+      response->content_type = value;
+    } else if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+      chunked = strcasecmp(value, "chunked") == 0;
+    } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+      if (strcasecmp(value, "close") == 0) keep_ = false;
+      if (strcasecmp(value, "keep-alive") == 0) keep_ = true;
+    }
+  }
+
+  // Read response body.
+  int status = response->status;
+  if (status == 204 || status == 304 || (status >= 100 && status < 200)) {
+    // No response body.
+  } else if (chunked) {
+    // Read chunks until the terminating zero-length chunk.
+    for (;;) {
+      st = ReadLine(&line);
+      if (!st.ok()) return st;
+      int size = strtol(line.c_str(), nullptr, 16);
+      if (size == 0) break;
+      st = ReadBytes(size, &response->body);
+      if (!st.ok()) return st;
+      st = ReadLine(&line);
+      if (!st.ok()) return st;
+    }
+
+    // Skip trailer.
+    do {
+      st = ReadLine(&line);
+      if (!st.ok()) return st;
+    } while (!line.empty());
+  } else if (content_length >= 0) {
+    st = ReadBytes(content_length, &response->body);
+    if (!st.ok()) return st;
+  } else {
+    // Read until the server closes the connection.
+    for (;;) {
+      response->body.append(input_.start, input_.size());
+      input_.start = input_.end;
+      bool eof;
+      st = Receive(&eof);
+      if (!st.ok()) return st;
+      if (eof) break;
+    }
+    keep_ = false;
+  }
+
+  return Status::OK;
+}
+
+}  // namespace sling
+
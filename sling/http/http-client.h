@@ -0,0 +1,101 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_HTTP_HTTP_CLIENT_H_
+#define SLING_HTTP_HTTP_CLIENT_H_
+
+#include <string>
+
+#include "sling/base/status.h"
+#include "sling/base/types.h"
+#include "sling/http/http-utils.h"
+#include "sling/string/text.h"
+
+namespace sling {
+
+// HTTP response received by client.
+struct HTTPClientResponse {
+  // HTTP status code.
+  int status = 0;
+
+  // Content type of response or empty if missing.
+  string content_type;
+
+  // Response body.
+  string body;
+};
+
+// Blocking HTTP/1.1 client connection. The connection to the server is kept
+// alive between requests if the server allows it, and is re-established
+// automatically if the server closes it.
+class HTTPClient {
+ public:
+  // Initialize client for connecting to server.
+  HTTPClient(const string &host, int port);
+  ~HTTPClient();
+
+  // Send HTTP request to server and receive the response.
+  Status Request(const char *method, const char *path,
+                 Text body, const char *content_type,
+                 HTTPClientResponse *response);
+
+  // Send GET request to server.
+  Status Get(const char *path, HTTPClientResponse *response) {
+    return Request("GET", path, Text(), nullptr, response);
+  }
+
+  // Connect to server.
+  Status Connect();
+
+  // Close connection to server.
+  void Close();
+
+  // Check if client is connected to server.
+  bool connected() const { return sock_ != -1; }
+
+ private:
+  // Send all data to server.
+  Status Send(const char *data, int size);
+
+  // Receive more data from server into input buffer. Returns false in eof if
+  // the connection has been closed by the server.
+  Status Receive(bool *eof);
+
+  // Read line terminated by CRLF from input.
+  Status ReadLine(string *line);
+
+  // Read number of bytes from input.
+  Status ReadBytes(int size, string *data);
+
+  // Receive response from server.
+  Status ReceiveResponse(HTTPClientResponse *response);
+
+  // Server address.
+  string host_;
+  int port_;
+
+  // Socket for connection.
+  int sock_ = -1;
+
+  // Input buffer.
+  HTTPBuffer input_;
+
+  // Whether the server keeps the connection open after current request.
+  bool keep_ = false;
+};
+
+}  // namespace sling
+
+#endif  // SLING_HTTP_HTTP_CLIENT_H_
+
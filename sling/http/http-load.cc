@@ -0,0 +1,400 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Load generator for benchmarking HTTP services like the knowledge server,
+// the document analyzer, and the corpus browser.
+//
+// In closed-loop mode, each connection sends a new request as soon as the
+// previous response has been received. In open-loop mode, requests arrive
+// at a fixed average rate (Poisson arrivals) independent of how fast the
+// server responds, and latency is measured from the scheduled arrival time so
+// queueing delays are not hidden.
+//
+// The request mix is read from a file with one request per line:
+//
+//   [<weight>] [<method>] <path> [<body file>]
+//
+// e.g. "10 /kb/item?id=Q76" or "1 POST /annotate doc.txt".
+
+#include <math.h>
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sling/base/clock.h"
+#include "sling/base/flags.h"
+#include "sling/base/init.h"
+#include "sling/base/logging.h"
+#include "sling/base/types.h"
+#include "sling/file/file.h"
+#include "sling/http/http-client.h"
+#include "sling/string/ctype.h"
+#include "sling/string/printf.h"
+#include "sling/util/random.h"
+#include "sling/util/thread.h"
+
+DEFINE_string(host, "localhost", "HTTP server host");
+DEFINE_int32(port, 8080, "HTTP server port");
+DEFINE_string(path, "/", "Request path if no request mix file is given");
+DEFINE_string(mix, "", "File with request mix");
+DEFINE_string(content_type, "application/json", "Content type for requests");
+DEFINE_string(mode, "closed", "Load mode (open or closed)");
+DEFINE_int32(connections, 8, "Number of keep-alive connections");
+DEFINE_double(rate, 100, "Request rate per second in open-loop mode");
+DEFINE_double(duration, 10, "Benchmark duration in seconds");
+DEFINE_double(warmup, 1, "Warm-up time in seconds before measuring");
+DEFINE_int32(max_backlog, 100000, "Maximum number of queued open-loop requests");
+DEFINE_bool(keepalive, true, "Reuse connections between requests");
+DEFINE_int32(seed, 0, "Seed for random request selection");
+
+using namespace sling;
+
+// Request in request mix.
+struct RequestSpec {
+  double weight = 1.0;
+  string method = "GET";
+  string path;
+  string body;
+
+  // Cumulative weight for sampling.
+  double cumulative = 0.0;
+};
+
+// Measurement for one request.
+struct Sample {
+  int request;      // index of request in mix
+  float latency;    // latency in microseconds
+};
+
+// Statistics collected by connection.
+struct ConnectionStats {
+  std::vector<Sample> samples;
+  int64 errors = 0;
+  int64 failures = 0;
+  int64 bytes = 0;
+};
+
+// Scheduled arrival for open-loop requests.
+struct Arrival {
+  int request;
+  Clock::Timestamp time;
+};
+
+class LoadGenerator {
+ public:
+  LoadGenerator() {
+    cycles_per_us_ = Clock::hz() / 1e6;
+  }
+
+  // Read request mix.
+  void ReadMix() {
+    if (FLAGS_mix.empty()) {
+      RequestSpec spec;
+      spec.path = FLAGS_path;
+      requests_.push_back(spec);
+    } else {
+      string contents;
+      CHECK(File::ReadContents(FLAGS_mix, &contents));
+      int pos = 0;
+      while (pos < contents.size()) {
+        int end = contents.find('\n', pos);
+        if (end == -1) end = contents.size();
+        string line = contents.substr(pos, end - pos);
+        pos = end + 1;
+
+        // Split line into fields.
+        std::vector<string> fields;
+        int start = 0;
+        while (start < line.size()) {
+          while (start < line.size() && ascii_isspace(line[start])) start++;
+          int stop = start;
+          while (stop < line.size() && !ascii_isspace(line[stop])) stop++;
+          if (stop > start) fields.push_back(line.substr(start, stop - start));
+          start = stop;
+        }
+        if (fields.empty() || fields[0][0] == '#') continue;
+
+        // Parse request specification.
+        RequestSpec spec;
+        int f = 0;
+        if (ascii_isdigit(fields[f][0])) spec.weight = atof(fields[f++].c_str());
+        if (f < fields.size() && ascii_isupper(fields[f][0])) {
+          spec.method = fields[f++];
+        }
+        CHECK_LT(f, fields.size()) << "Missing path in request: " << line;
+        spec.path = fields[f++];
+        if (f < fields.size()) {
+          CHECK(File::ReadContents(fields[f], &spec.body));
+        }
+        requests_.push_back(spec);
+      }
+    }
+    CHECK(!requests_.empty()) << "No requests";
+
+    // Compute cumulative weights for sampling requests.
+    double total = 0.0;
+    for (RequestSpec &spec : requests_) total += spec.weight;
+    double sum = 0.0;
+    for (RequestSpec &spec : requests_) {
+      sum += spec.weight / total;
+      spec.cumulative = sum;
+    }
+  }
+
+  // Run benchmark.
+  void Run() {
+    bool open = FLAGS_mode == "open";
+    CHECK(open || FLAGS_mode == "closed") << "Unknown mode: " << FLAGS_mode;
+    stats_.resize(FLAGS_connections);
+
+    // Compute start, measurement, and end times.
+    start_ = Clock::now();
+    measure_ = start_ + FLAGS_warmup * Clock::hz();
+    end_ = measure_ + FLAGS_duration * Clock::hz();
+
+    // Start connections.
+    WorkerPool workers;
+    workers.Start(FLAGS_connections, [this, open](int index) {
+      if (open) {
+        OpenLoopWorker(index);
+      } else {
+        ClosedLoopWorker(index);
+      }
+    });
+
+    // Generate arrivals in open-loop mode.
+    if (open) GenerateArrivals();
+
+    // Wait for all queued and in-flight requests to complete.
+    workers.Join();
+  }
+
+  // Output benchmark report.
+  void Report() {
+    // Merge statistics from all connections.
+    std::vector<Sample> samples;
+    int64 errors = 0;
+    int64 failures = 0;
+    int64 bytes = 0;
+    for (ConnectionStats &s : stats_) {
+      samples.insert(samples.end(), s.samples.begin(), s.samples.end());
+      errors += s.errors;
+      failures += s.failures;
+      bytes += s.bytes;
+    }
+
+    double secs = FLAGS_duration;
+    std::cout << "Mode:        " << FLAGS_mode << "-loop";
+    if (FLAGS_mode == "open") std::cout << " at " << FLAGS_rate << " req/s";
+    std::cout << ", " << FLAGS_connections << " connections\n";
+    std::cout << "Requests:    " << samples.size() << "\n";
+    std::cout << "Errors:      " << errors << " connection, "
+              << failures << " non-2xx";
+    if (dropped_ > 0) std::cout << ", " << dropped_ << " dropped";
+    std::cout << "\n";
+    std::cout << StringPrintf("Throughput:  %.1f req/s, %.2f MB/s\n",
+                              samples.size() / secs, bytes / secs / 1e6);
+
+    // Output latency percentiles for all requests.
+    std::cout << "Latency (ms):\n";
+    std::cout << StringPrintf("  %-40s %8s %8s %8s %8s %8s %8s %8s %8s\n",
+                              "request", "count", "mean", "p50", "p90", "p99",
+                              "p99.9", "max", "req/s");
+    ReportLatency("all", &samples, secs);
+
+    // Output latency percentiles per request type.
+    if (requests_.size() > 1) {
+      std::vector<std::vector<Sample>> per_request(requests_.size());
+      for (const Sample &s : samples) per_request[s.request].push_back(s);
+      for (int i = 0; i < requests_.size(); ++i) {
+        string name = requests_[i].method + " " + requests_[i].path;
+        ReportLatency(name, &per_request[i], secs);
+      }
+    }
+  }
+
+ private:
+  // Output latency distribution.
+  void ReportLatency(const string &name, std::vector<Sample> *samples,
+                     double secs) {
+    int n = samples->size();
+    if (n == 0) {
+      std::cout << StringPrintf("  %-40s %8d\n", name.c_str(), 0);
+      return;
+    }
+    std::vector<float> latencies;
+    latencies.reserve(n);
+    double sum = 0.0;
+    for (const Sample &s : *samples) {
+      latencies.push_back(s.latency);
+      sum += s.latency;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+      int index = std::min(n - 1, static_cast<int>(p * n));
+      return latencies[index] / 1000.0;
+    };
+    string label = name.size() > 40 ? name.substr(0, 37) + "..." : name;
+    std::cout << StringPrintf(
+        "  %-40s %8d %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.1f\n",
+        label.c_str(), n, sum / n / 1000.0,
+        percentile(0.5), percentile(0.9), percentile(0.99),
+        percentile(0.999), latencies.back() / 1000.0, n / secs);
+  }
+
+  // Select random request from mix.
+  int SelectRequest(Random *rnd) {
+    float p = rnd->UniformProb();
+    for (int i = 0; i < requests_.size(); ++i) {
+      if (p < requests_[i].cumulative) return i;
+    }
+    return requests_.size() - 1;
+  }
+
+  // Send request and record the latency measured from the start time.
+  void Execute(HTTPClient *client, int request, Clock::Timestamp start,
+               ConnectionStats *stats) {
+    const RequestSpec &spec = requests_[request];
+    HTTPClientResponse response;
+    const char *content_type =
+        spec.body.empty() ? nullptr : FLAGS_content_type.c_str();
+    Status st = client->Request(spec.method.c_str(), spec.path.c_str(),
+                                spec.body, content_type, &response);
+    Clock::Timestamp done = Clock::now();
+    if (!FLAGS_keepalive) client->Close();
+
+    // Only record requests started in the measurement window. Requests that
+    // complete after the end of the window are still recorded, since these
+    // are the slowest ones when the server is overloaded.
+    if (start < measure_ || start >= end_) return;
+    if (!st.ok()) {
+      VLOG(1) << "Request error: " << st;
+      stats->errors++;
+      return;
+    }
+    if (response.status < 200 || response.status >= 300) stats->failures++;
+    stats->bytes += response.body.size();
+    Sample sample;
+    sample.request = request;
+    sample.latency = (done - start) / cycles_per_us_;
+    stats->samples.push_back(sample);
+  }
+
+  // Closed-loop worker sending requests back-to-back on one connection.
+  void ClosedLoopWorker(int index) {
+    HTTPClient client(FLAGS_host, FLAGS_port);
+    Random rnd;
+    rnd.seed(FLAGS_seed * 1000 + index);
+    ConnectionStats *stats = &stats_[index];
+    while (Clock::now() < end_) {
+      int request = SelectRequest(&rnd);
+      Execute(&client, request, Clock::now(), stats);
+    }
+  }
+
+  // Open-loop worker executing scheduled requests on one connection.
+  void OpenLoopWorker(int index) {
+    HTTPClient client(FLAGS_host, FLAGS_port);
+    ConnectionStats *stats = &stats_[index];
+    for (;;) {
+      // Get next arrival.
+      Arrival arrival;
+      {
+        std::unique_lock<std::mutex> lock(mu_);
+        while (arrivals_.empty() && !done_) nonempty_.wait(lock);
+        if (arrivals_.empty()) break;
+        arrival = arrivals_.front();
+        arrivals_.pop_front();
+      }
+
+      // Latency is measured from the scheduled arrival time.
+      Execute(&client, arrival.request, arrival.time, stats);
+    }
+  }
+
+  // Generate Poisson arrivals at the requested rate.
+  void GenerateArrivals() {
+    Random rnd;
+    rnd.seed(FLAGS_seed);
+    double cycles_per_request = Clock::hz() / FLAGS_rate;
+    double next = start_;
+    while (next < end_) {
+      // Wait until next arrival.
+      Clock::Timestamp now = Clock::now();
+      if (next > now) {
+        int64 us = (next - now) / cycles_per_us_;
+        if (us > 0) usleep(us);
+      }
+
+      // Schedule request.
+      Arrival arrival;
+      arrival.request = SelectRequest(&rnd);
+      arrival.time = next;
+      {
+        std::unique_lock<std::mutex> lock(mu_);
+        if (arrivals_.size() < FLAGS_max_backlog) {
+          arrivals_.push_back(arrival);
+          nonempty_.notify_one();
+        } else {
+          dropped_++;
+        }
+      }
+
+      // Exponentially distributed time until next arrival.
+      double u = rnd.UniformProb();
+      next += -log(1.0 - u) * cycles_per_request;
+    }
+
+    // Signal workers that there are no more arrivals.
+    std::unique_lock<std::mutex> lock(mu_);
+    done_ = true;
+    nonempty_.notify_all();
+  }
+
+  // Request mix.
+  std::vector<RequestSpec> requests_;
+
+  // Statistics for each connection.
+  std::vector<ConnectionStats> stats_;
+
+  // Benchmark start time, start of measurement, and end time.
+  Clock::Timestamp start_;
+  Clock::Timestamp measure_;
+  Clock::Timestamp end_;
+  double cycles_per_us_;
+
+  // Queue of scheduled open-loop arrivals.
+  std::deque<Arrival> arrivals_;
+  bool done_ = false;
+  int64 dropped_ = 0;
+  std::mutex mu_;
+  std::condition_variable nonempty_;
+};
+
+int main(int argc, char *argv[]) {
+  InitProgram(&argc, &argv);
+
+  LoadGenerator generator;
+  generator.ReadMix();
+  generator.Run();
+  generator.Report();
+
+  return 0;
+}
+
@@ -17,6 +17,8 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/epoll.h>
@@ -304,6 +306,13 @@ void HTTPServer::AcceptConnection() {
   rc = fcntl(sock, F_SETFL, flags | O_NONBLOCK);
   if (rc < 0) LOG(WARNING) << Error("fcntl");
 
+  // Disable Nagle's algorithm. The header and body of a response are sent
+  // separately, and delaying the body until the header is acknowledged adds
+  // the client's delayed-ACK timeout to every small response.
+  int on = 1;
+  rc = setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  if (rc < 0) LOG(WARNING) << Error("setsockopt");
+
   // Create new connection.
   VLOG(3) << "New HTTP connection " << sock;
   HTTPConnection *conn = new HTTPConnection(this, sock);
@@ -717,6 +726,9 @@ void HTTPConnection::Dispatch() {
   // Allocate response object.
   delete response_;
   response_ = new HTTPResponse(this);
+  streaming_ = false;
+  chunked_ = false;
+  stream_status_ = Status::OK;
 
   // Find handler for request.
   HTTPServer::Handler handler = server_->FindHandler(request_);
@@ -724,18 +736,44 @@ void HTTPConnection::Dispatch() {
   // Dispatch request to handler.
   handler(request_, response_);
 
+  if (streaming_) {
+    // Send the rest of the streamed response. The response header has already
+    // been sent.
+    Status st = EndStreaming();
+    if (!st.ok()) {
+      VLOG(2) << "HTTP streaming error: " << st;
+      keep_ = false;
+    }
+    streaming_ = false;
+  } else {
+    // Set content length.
+    if (!response_body_.empty()) {
+      response_->SetContentLength(response_body_.size());
+    }
+
+    // Generate response header buffer.
+    PrepareResponseHeader();
+  }
+
+  // The request and response objects are no longer needed.
+  delete request_;
+  delete response_;
+  request_ = nullptr;
+  response_ = nullptr;
+}
+
+void HTTPConnection::PrepareResponseHeader() {
   // Add Date: and Server: headers.
   char datebuf[32];
   response_->Set("Server", server()->options().server_name.c_str(), false);
   response_->Set("Date", RFCTime(time(nullptr), datebuf), false);
 
-  // Set content length.
-  if (!response_body_.empty()) {
-    response_->SetContentLength(response_body_.size());
-  }
-
-  // Check for persistent connection.
-  if (request_->http11()) {
+  // Check for persistent connection. A streamed response without chunked
+  // encoding is terminated by closing the connection.
+  if (streaming_ && !chunked_) {
+    keep_ = false;
+    response_->Set("Connection", "close");
+  } else if (request_->http11()) {
     keep_ = true;
   } else if (request_->keep_alive()) {
     keep_ = true;
@@ -744,12 +782,97 @@ void HTTPConnection::Dispatch() {
 
   // Generate response header buffer.
   response_->WriteHeader(&response_header_);
+}
 
-  // The request and response objects are no longer needed.
-  delete request_;
-  delete response_;
-  request_ = nullptr;
-  response_ = nullptr;
+Status HTTPConnection::BeginStreaming() {
+  if (streaming_) return stream_status_;
+  streaming_ = true;
+
+  // Use chunked transfer encoding for HTTP/1.1 clients. Older clients get the
+  // raw response body and the connection is closed afterwards.
+  if (request_->http11()) {
+    chunked_ = true;
+    response_->Set("Transfer-Encoding", "chunked");
+  }
+
+  // Send response header.
+  PrepareResponseHeader();
+  stream_status_ = SendAll(response_header_.start, response_header_.size(),
+                           !response_body_.empty());
+  response_header_.clear();
+  if (!stream_status_.ok()) return stream_status_;
+
+  // Send any response data produced before streaming started.
+  return FlushResponse();
+}
+
+Status HTTPConnection::FlushResponse() {
+  if (!streaming_ || response_body_.empty()) return stream_status_;
+
+  // Discard the data if the client has gone away.
+  int size = response_body_.size();
+  if (stream_status_.ok()) {
+    if (chunked_) {
+      // Send chunk size, chunk data, and chunk terminator.
+      char header[16];
+      int len = snprintf(header, sizeof(header), "%x\r\n", size);
+      stream_status_ = SendAll(header, len, true);
+      if (stream_status_.ok()) {
+        stream_status_ = SendAll(response_body_.start, size, true);
+      }
+      if (stream_status_.ok()) {
+        stream_status_ = SendAll("\r\n", 2, false);
+      }
+    } else {
+      stream_status_ = SendAll(response_body_.start, size, false);
+    }
+  }
+
+  // Reuse the response buffer for the next chunk.
+  response_body_.start = response_body_.end = response_body_.floor;
+  return stream_status_;
+}
+
+Status HTTPConnection::EndStreaming() {
+  // Send remaining response data.
+  FlushResponse();
+  response_body_.clear();
+
+  // Send terminating zero-length chunk.
+  if (chunked_ && stream_status_.ok()) {
+    stream_status_ = SendAll("0\r\n\r\n", 5, false);
+  }
+  return stream_status_;
+}
+
+Status HTTPConnection::SendAll(const char *data, int size, bool more) {
+  int flags = MSG_NOSIGNAL;
+  if (more) flags |= MSG_MORE;
+  while (size > 0) {
+    int rc = send(sock_, data, size, flags);
+    if (rc < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN) return Error("send");
+
+      // Wait until client is ready to receive more data.
+      struct pollfd pfd;
+      pfd.fd = sock_;
+      pfd.events = POLLOUT;
+      pfd.revents = 0;
+      int timeout = server_->options().send_timeout * 1000;
+      rc = poll(&pfd, 1, timeout);
+      if (rc < 0 && errno != EINTR) return Error("poll");
+      if (rc == 0) return Status(ETIMEDOUT, "HTTP send timeout");
+      if (pfd.revents & (POLLERR | POLLHUP)) {
+        return Status(EPIPE, "HTTP connection closed");
+      }
+      continue;
+    }
+    VLOG(6) << "Send " << sock_ << ", " << rc << " bytes";
+    data += rc;
+    size -= rc;
+  }
+  return Status::OK;
 }
 
 bool HTTPConnection::ParseHeader() {
@@ -918,12 +1041,17 @@ bool HTTPConnection::ParseHeader() {
 }
 
 void HTTPConnection::AppendResponse(const char *data, int size) {
-  if (response_body_.empty()) {
+  if (response_body_.capacity() == 0) {
     int n = server_->options().initial_bufsiz;
     if (n < size) n = size;
     response_body_.reset(n);
   }
   response_body_.append(data, size);
+
+  // Send chunk when streaming and enough data has been buffered.
+  if (streaming_ && response_body_.size() >= server_->options().chunk_size) {
+    FlushResponse();
+  }
 }
 
 const char *HTTPConnection::State() const {
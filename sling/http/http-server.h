@@ -86,6 +86,14 @@ struct HTTPServerOptions {
   // File data buffer size.
   int file_bufsiz = 1 << 16;
 
+  // Amount of response data buffered before a chunk is sent to the client
+  // when streaming a response.
+  int chunk_size = 1 << 14;
+
+  // Maximum time (in seconds) to wait for a client to accept more data when
+  // streaming a response.
+  int send_timeout = 60;
+
   // HTTP server name reported in Server: header.
   string server_name = "HTTPServer/1.0";
 };
@@ -227,6 +235,17 @@ class HTTPConnection {
   // Set file for streaming response. This will take ownership of the file.
   void SendFile(File *file) { file_ = file; }
 
+  // Start streaming the response. The response header is sent right away and
+  // the response body is sent to the client while the request is being
+  // processed, using chunked transfer encoding for HTTP/1.1 requests.
+  Status BeginStreaming();
+
+  // Send buffered response data to the client when streaming.
+  Status FlushResponse();
+
+  // Check if response is being streamed.
+  bool streaming() const { return streaming_; }
+
   // Request and response body buffers.
   HTTPBuffer *request_buffer() { return &input_; }
   HTTPBuffer *response_buffer() { return &response_body_; }
@@ -243,6 +262,16 @@ class HTTPConnection {
   // be sent without blocking has been sent.
   Status Send(HTTPBuffer *buffer, bool *done);
 
+  // Send data, waiting for the socket to become writable if needed. This is
+  // used for streaming responses while the request is being processed.
+  Status SendAll(const char *data, int size, bool more);
+
+  // Send remaining response data and terminate streamed response.
+  Status EndStreaming();
+
+  // Add standard headers to response and generate response header buffer.
+  void PrepareResponseHeader();
+
   // Shut down connection.
   void Shutdown();
 
@@ -286,6 +315,15 @@ class HTTPConnection {
   // File for streaming response.
   File *file_ = nullptr;
 
+  // Response is streamed while the request is being processed.
+  bool streaming_ = false;
+
+  // Streamed response uses chunked transfer encoding.
+  bool chunked_ = false;
+
+  // Status of streamed response.
+  Status stream_status_;
+
   friend class HTTPServer;
 };
 
@@ -424,6 +462,17 @@ class HTTPResponse {
   // Set file for streaming response. This will take ownership of the file.
   void SendFile(File *file) { conn_->SendFile(file); }
 
+  // Start streaming the response body. The status and headers must be set
+  // before streaming begins, since the response header is sent immediately.
+  // Data appended to the response after this is sent to the client in chunks.
+  Status BeginStreaming() { return conn_->BeginStreaming(); }
+
+  // Send buffered response data to the client when streaming.
+  Status Flush() { return conn_->FlushResponse(); }
+
+  // Check if response is being streamed.
+  bool streaming() const { return conn_->streaming(); }
+
   // Return HTTP error message.
   void SendError(int status, const char *title, const char *msg);
 
@@ -436,6 +485,11 @@ class HTTPResponse {
   // HTTP response body buffer.
   HTTPBuffer *buffer() { return conn_->response_buffer(); }
 
+  // Configuration options for server.
+  const HTTPServerOptions &server_options() const {
+    return conn_->server()->options();
+  }
+
  private:
   // HTTP connect for request.
   HTTPConnection *conn_;
@@ -74,5 +74,45 @@ int64 HTTPOutputStream::ByteCount() const {
   return buffer_->size();
 }
 
+HTTPStreamingOutputStream::HTTPStreamingOutputStream(HTTPResponse *response,
+                                                     int block_size)
+    : response_(response),
+      buffer_(response->buffer()),
+      block_size_(block_size) {
+  chunk_size_ = response->server_options().chunk_size;
+  if (chunk_size_ < block_size_) chunk_size_ = block_size_;
+  response_->BeginStreaming();
+}
+
+HTTPStreamingOutputStream::~HTTPStreamingOutputStream() {
+  Flush();
+}
+
+bool HTTPStreamingOutputStream::Next(void **data, int *size) {
+  // Send buffered data when a full chunk is ready.
+  if (buffer_->size() >= chunk_size_) Flush();
+
+  if (buffer_->remaining() < block_size_) buffer_->ensure(block_size_);
+  int n = buffer_->remaining();
+  if (n > block_size_) n = block_size_;
+  *data = buffer_->end;
+  *size = n;
+  buffer_->end += n;
+  return true;
+}
+
+void HTTPStreamingOutputStream::BackUp(int count) {
+  buffer_->end -= count;
+}
+
+int64 HTTPStreamingOutputStream::ByteCount() const {
+  return sent_ + buffer_->size();
+}
+
+Status HTTPStreamingOutputStream::Flush() {
+  sent_ += buffer_->size();
+  return response_->Flush();
+}
+
 }  // namespace sling
 
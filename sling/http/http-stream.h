@@ -50,6 +50,32 @@ class HTTPOutputStream : public OutputStream {
   int block_size_;
 };
 
+// An OutputStream that streams the response body to the client while it is
+// being generated. The response header is sent when the stream is created and
+// the data is sent in chunks, so only one chunk is buffered in memory.
+class HTTPStreamingOutputStream : public OutputStream {
+ public:
+  HTTPStreamingOutputStream(HTTPResponse *response, int block_size = 8192);
+  ~HTTPStreamingOutputStream() override;
+
+  // OutputStream interface.
+  bool Next(void **data, int *size) override;
+  void BackUp(int count) override;
+  int64 ByteCount() const override;
+
+  // Send buffered data to the client.
+  Status Flush();
+
+ private:
+  HTTPResponse *response_;
+  HTTPBuffer *buffer_;
+  int block_size_;
+  int chunk_size_;
+
+  // Number of bytes sent to the client.
+  int64 sent_ = 0;
+};
+
 }  // namespace sling
 
 #endif  // SLING_HTTP_HTTP_STREAM_H_
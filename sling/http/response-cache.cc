@@ -0,0 +1,208 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/http/response-cache.h"
+
+#include <functional>
+#include <string>
+
+#include "sling/base/logging.h"
+#include "sling/http/http-server.h"
+#include "sling/string/numbers.h"
+
+namespace sling {
+
+ResponseCache::ResponseCache(int64 capacity, int num_shards) {
+  CHECK_GT(num_shards, 0);
+  for (int i = 0; i < num_shards; ++i) shards_.push_back(new Shard());
+  set_capacity(capacity);
+}
+
+ResponseCache::~ResponseCache() {
+  Clear();
+  for (Shard *shard : shards_) delete shard;
+}
+
+void ResponseCache::set_capacity(int64 capacity) {
+  shard_capacity_ = capacity / shards_.size();
+}
+
+bool ResponseCache::Serve(const string &key, HTTPResponse *response) {
+  Shard *shard = GetShard(key);
+  MutexLock lock(&shard->mu);
+  Entry *e = Find(shard, key);
+  if (e == nullptr) return false;
+
+  // Output cached response.
+  response->SetContentType(e->content_type.c_str());
+  response->Append(e->body);
+  return true;
+}
+
+bool ResponseCache::Lookup(const string &key, string *body) {
+  Shard *shard = GetShard(key);
+  MutexLock lock(&shard->mu);
+  Entry *e = Find(shard, key);
+  if (e == nullptr) return false;
+  body->assign(e->body);
+  return true;
+}
+
+void ResponseCache::Insert(const string &key, HTTPResponse *response) {
+  // Only cache successful responses that have not been streamed.
+  if (response->status() != 200 || response->streaming()) return;
+  const char *content_type = response->ContentType();
+  if (content_type == nullptr) return;
+  HTTPBuffer *buffer = response->buffer();
+  Insert(key, content_type, Text(buffer->start, buffer->size()));
+}
+
+void ResponseCache::Insert(const string &key,
+                           const char *content_type,
+                           Text body) {
+  // Create new cache entry.
+  Entry *e = new Entry();
+  e->key = key;
+  e->content_type = content_type;
+  e->body.assign(body.data(), body.size());
+  int64 bytes = e->bytes();
+  if (bytes > shard_capacity_) {
+    delete e;
+    return;
+  }
+
+  Shard *shard = GetShard(key);
+  MutexLock lock(&shard->mu);
+
+  // Replace existing entry for key.
+  auto f = shard->map.find(key);
+  if (f != shard->map.end()) {
+    Entry *old = f->second;
+    shard->Unlink(old);
+    shard->size -= old->bytes();
+    delete old;
+    f->second = e;
+  } else {
+    shard->map[key] = e;
+  }
+  shard->PushFront(e);
+  shard->size += bytes;
+
+  // Evict least recently used entries until the shard is within capacity.
+  while (shard->size > shard_capacity_ && shard->tail != nullptr) {
+    Entry *lru = shard->tail;
+    shard->Unlink(lru);
+    shard->map.erase(lru->key);
+    shard->size -= lru->bytes();
+    delete lru;
+    evictions_++;
+  }
+}
+
+ResponseCache::Entry *ResponseCache::Find(Shard *shard, const string &key) {
+  auto f = shard->map.find(key);
+  if (f == shard->map.end()) {
+    misses_++;
+    return nullptr;
+  }
+
+  // Move entry to the front of the LRU list.
+  Entry *e = f->second;
+  shard->Unlink(e);
+  shard->PushFront(e);
+  hits_++;
+  return e;
+}
+
+void ResponseCache::Clear() {
+  for (Shard *shard : shards_) {
+    MutexLock lock(&shard->mu);
+    Entry *e = shard->head;
+    while (e != nullptr) {
+      Entry *next = e->next;
+      delete e;
+      e = next;
+    }
+    shard->map.clear();
+    shard->head = shard->tail = nullptr;
+    shard->size = 0;
+  }
+}
+
+int64 ResponseCache::size() const {
+  int64 total = 0;
+  for (Shard *shard : shards_) {
+    MutexLock lock(&shard->mu);
+    total += shard->size;
+  }
+  return total;
+}
+
+int64 ResponseCache::entries() const {
+  int64 total = 0;
+  for (Shard *shard : shards_) {
+    MutexLock lock(&shard->mu);
+    total += shard->map.size();
+  }
+  return total;
+}
+
+void ResponseCache::Report(HTTPResponse *response) const {
+  int64 lookups = hits_ + misses_;
+  double hit_rate = lookups == 0 ? 0.0 : 100.0 * hits_ / lookups;
+  char rate[32];
+  snprintf(rate, sizeof(rate), "%.1f%%", hit_rate);
+
+  response->Append("<table border=\"1\">\n");
+  response->Append("<tr><td>Entries</td><td>" +
+                   SimpleItoa(entries()) + "</td></tr>\n");
+  response->Append("<tr><td>Size</td><td>" +
+                   SimpleItoa(size()) + "</td></tr>\n");
+  response->Append("<tr><td>Capacity</td><td>" +
+                   SimpleItoa(shard_capacity_ * shards_.size()) +
+                   "</td></tr>\n");
+  response->Append("<tr><td>Hits</td><td>" +
+                   SimpleItoa(hits_) + "</td></tr>\n");
+  response->Append("<tr><td>Misses</td><td>" +
+                   SimpleItoa(misses_) + "</td></tr>\n");
+  response->Append("<tr><td>Hit rate</td><td>" +
+                   string(rate) + "</td></tr>\n");
+  response->Append("<tr><td>Evictions</td><td>" +
+                   SimpleItoa(evictions_) + "</td></tr>\n");
+  response->Append("</table>\n");
+}
+
+ResponseCache::Shard *ResponseCache::GetShard(const string &key) const {
+  size_t hash = std::hash<string>()(key);
+  return shards_[hash % shards_.size()];
+}
+
+void ResponseCache::Shard::Unlink(Entry *e) {
+  if (e->prev != nullptr) e->prev->next = e->next;
+  if (e->next != nullptr) e->next->prev = e->prev;
+  if (e == head) head = e->next;
+  if (e == tail) tail = e->prev;
+  e->next = e->prev = nullptr;
+}
+
+void ResponseCache::Shard::PushFront(Entry *e) {
+  e->prev = nullptr;
+  e->next = head;
+  if (head != nullptr) head->prev = e;
+  head = e;
+  if (tail == nullptr) tail = e;
+}
+
+}  // namespace sling
+
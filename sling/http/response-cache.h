@@ -0,0 +1,126 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_HTTP_RESPONSE_CACHE_H_
+#define SLING_HTTP_RESPONSE_CACHE_H_
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sling/base/types.h"
+#include "sling/http/http-server.h"
+#include "sling/string/text.h"
+#include "sling/util/mutex.h"
+
+namespace sling {
+
+// Bounded LRU cache of rendered HTTP responses. The cache is split into a
+// number of shards, each with its own lock and LRU list, so it can be used
+// concurrently from the HTTP worker threads.
+class ResponseCache {
+ public:
+  // Initialize cache with a maximum size in bytes.
+  ResponseCache(int64 capacity = 64 << 20, int num_shards = 16);
+  ~ResponseCache();
+
+  // Set maximum size of cache in bytes. A capacity of zero disables caching.
+  void set_capacity(int64 capacity);
+
+  // Serve response from cache. Returns false if the key is not in the cache.
+  bool Serve(const string &key, HTTPResponse *response);
+
+  // Add rendered response body and content type to cache.
+  void Insert(const string &key, HTTPResponse *response);
+
+  // Look up cached response body. Returns false if key is not in the cache.
+  bool Lookup(const string &key, string *body);
+
+  // Add response body with content type to cache.
+  void Insert(const string &key, const char *content_type, Text body);
+
+  // Remove all responses from the cache.
+  void Clear();
+
+  // Output cache statistics as HTML.
+  void Report(HTTPResponse *response) const;
+
+  // Cache statistics.
+  int64 hits() const { return hits_; }
+  int64 misses() const { return misses_; }
+  int64 evictions() const { return evictions_; }
+  int64 size() const;
+  int64 entries() const;
+
+ private:
+  // Cached response in doubly-linked LRU list.
+  struct Entry {
+    string key;
+    string content_type;
+    string body;
+    Entry *prev = nullptr;
+    Entry *next = nullptr;
+
+    // Memory used by entry.
+    int64 bytes() const {
+      return sizeof(Entry) + key.size() + content_type.size() + body.size();
+    }
+  };
+
+  // Cache shard.
+  struct Shard {
+    // Unlink entry from LRU list.
+    void Unlink(Entry *e);
+
+    // Insert entry at the front of LRU list.
+    void PushFront(Entry *e);
+
+    // Mapping from key to cache entry.
+    std::unordered_map<string, Entry *> map;
+
+    // LRU list with the most recently used entry first.
+    Entry *head = nullptr;
+    Entry *tail = nullptr;
+
+    // Number of bytes used by entries in shard.
+    int64 size = 0;
+
+    // Mutex for serializing access to shard.
+    mutable Mutex mu;
+  };
+
+  // Get shard for key.
+  Shard *GetShard(const string &key) const;
+
+  // Find entry in shard and mark it as most recently used. The shard must be
+  // locked by the caller.
+  Entry *Find(Shard *shard, const string &key);
+
+  // Cache shards.
+  std::vector<Shard *> shards_;
+
+  // Maximum size of each shard in bytes.
+  std::atomic<int64> shard_capacity_;
+
+  // Cache statistics.
+  std::atomic<int64> hits_{0};
+  std::atomic<int64> misses_{0};
+  std::atomic<int64> evictions_{0};
+};
+
+}  // namespace sling
+
+#endif  // SLING_HTTP_RESPONSE_CACHE_H_
+
@@ -14,6 +14,7 @@
 
 #include "sling/http/web-service.h"
 
+#include "sling/base/logging.h"
 #include "sling/stream/stream.h"
 #include "sling/frame/decoder.h"
 #include "sling/frame/encoder.h"
@@ -137,36 +138,56 @@ WebService::WebService(Store *commons,
   }
 }
 
-WebService::~WebService() {
-  // Do not generate a response if output is empty or if there is an error.
-  if (output_.invalid()) return;
-  if (response_->status() != 200) return;
+// Serializer for streaming output objects to the client.
+struct WebService::Streamer {
+  Streamer(WebService *ws)
+      : stream(ws->response()),
+        out(&stream),
+        printer(&ws->store_, &out),
+        json(&ws->store_, &out) {
+    // The encoder outputs the binary marker when it is created, so it is only
+    // created for encoded output.
+    if (ws->output_format_ == ENCODED) {
+      encoder = new Encoder(&ws->store_, &out);
+    }
+    printer.set_byref(ws->byref_);
+    json.set_byref(ws->byref_);
+    if (ws->output_format_ == TEXT) printer.set_indent(2);
+    if (ws->output_format_ == JSON) json.set_indent(2);
+  }
+  ~Streamer() { delete encoder; }
 
-  // Use input format to determine output format if it has not been set.
-  if (output_format_ == EMPTY) output_format_ = input_format_;
+  HTTPStreamingOutputStream stream;
+  Output out;
+  Encoder *encoder = nullptr;
+  Printer printer;
+  JSONWriter json;
 
-  // Change output format based on fmt parameter.
-  Text fmt = Get("fmt");
-  if (!fmt.empty()) {
-    if (fmt == "enc") {
-      output_format_ = ENCODED;
-    } else if (fmt == "txt") {
-      output_format_ = TEXT;
-    } else if (fmt == "lex") {
-      output_format_ = LEX;
-    } else if (fmt == "compact") {
-      output_format_ = COMPACT;
-    } else if (fmt == "json") {
-      output_format_ = JSON;
-    } else if (fmt == "cjson") {
-      output_format_ = CJSON;
+  // Number of objects streamed.
+  int count = 0;
+
+  // Output streamed JSON objects as array.
+  bool array = true;
+};
+
+WebService::~WebService() {
+  // Terminate streamed output.
+  if (streamer_ != nullptr) {
+    bool json = output_format_ == JSON || output_format_ == CJSON;
+    if (json && streamer_->array) {
+      if (streamer_->count == 0) streamer_->out.WriteChar('[');
+      streamer_->out.WriteChar(']');
     }
+    delete streamer_;
+    return;
   }
 
-  // Fall back to binary encoded SLING format.
-  if (output_format_ == EMPTY || output_format_ == UNKNOWN) {
-    output_format_ = ENCODED;
-  }
+  // Do not generate a response if output is empty or if there is an error.
+  if (output_.invalid()) return;
+  if (response_->status() != 200) return;
+
+  // Determine output format.
+  ResolveOutputFormat();
 
   // Output response.
   HTTPOutputStream stream(response_->buffer());
@@ -174,7 +195,7 @@ WebService::~WebService() {
   switch (output_format_) {
     case ENCODED: {
       // Output as encoded SLING frames.
-      response_->SetContentType("application/sling");
+      SetContentType();
       Encoder encoder(&store_, &out);
       encoder.Encode(output_);
       break;
@@ -182,7 +203,7 @@ WebService::~WebService() {
 
     case TEXT: {
       // Output as human-readable SLING frames.
-      response_->SetContentType("text/sling; charset=utf-8");
+      SetContentType();
       Printer printer(&store_, &out);
       printer.set_indent(2);
       printer.set_byref(byref_);
@@ -192,7 +213,7 @@ WebService::~WebService() {
 
     case COMPACT: {
       // Output compact SLING text.
-      response_->SetContentType("text/sling; charset=utf-8");
+      SetContentType();
       Printer printer(&store_, &out);
       printer.set_byref(byref_);
       printer.Print(output_);
@@ -201,7 +222,7 @@ WebService::~WebService() {
 
     case JSON: {
       // Output in JSON format.
-      response_->SetContentType("text/json; charset=utf-8");
+      SetContentType();
       JSONWriter writer(&store_, &out);
       writer.set_indent(2);
       writer.set_byref(byref_);
@@ -211,7 +232,7 @@ WebService::~WebService() {
 
     case CJSON: {
       // Output in compact JSON format.
-      response_->SetContentType("application/json; charset=utf-8");
+      SetContentType();
       JSONWriter writer(&store_, &out);
       writer.set_byref(byref_);
       writer.Write(output_);
@@ -223,7 +244,7 @@ WebService::~WebService() {
       if (!output_.IsString()) {
         response_->SendError(500, "Internal Server Error", "no lex output");
       } else {
-        response_->SetContentType("text/lex");
+        SetContentType();
         out.Write(output_.AsString().text());
       }
       break;
@@ -234,7 +255,7 @@ WebService::~WebService() {
       if (!output_.IsString()) {
         response_->SendError(500, "Internal Server Error", "no output");
       } else {
-        response_->SetContentType("text/plain");
+        SetContentType();
         out.Write(output_.AsString().text());
       }
       break;
@@ -247,6 +268,122 @@ WebService::~WebService() {
   }
 }
 
+void WebService::ResolveOutputFormat() {
+  // Use input format to determine output format if it has not been set.
+  if (output_format_ == EMPTY) output_format_ = input_format_;
+
+  // Change output format based on fmt parameter.
+  Text fmt = Get("fmt");
+  if (!fmt.empty()) {
+    if (fmt == "enc") {
+      output_format_ = ENCODED;
+    } else if (fmt == "txt") {
+      output_format_ = TEXT;
+    } else if (fmt == "lex") {
+      output_format_ = LEX;
+    } else if (fmt == "compact") {
+      output_format_ = COMPACT;
+    } else if (fmt == "json") {
+      output_format_ = JSON;
+    } else if (fmt == "cjson") {
+      output_format_ = CJSON;
+    }
+  }
+
+  // Fall back to binary encoded SLING format.
+  if (output_format_ == EMPTY || output_format_ == UNKNOWN) {
+    output_format_ = ENCODED;
+  }
+}
+
+void WebService::SetContentType() {
+  switch (output_format_) {
+    case ENCODED:
+      response_->SetContentType("application/sling");
+      break;
+    case TEXT:
+    case COMPACT:
+      response_->SetContentType("text/sling; charset=utf-8");
+      break;
+    case JSON:
+      response_->SetContentType("text/json; charset=utf-8");
+      break;
+    case CJSON:
+      response_->SetContentType("application/json; charset=utf-8");
+      break;
+    case LEX:
+      response_->SetContentType("text/lex");
+      break;
+    case PLAIN:
+      response_->SetContentType("text/plain");
+      break;
+    case EMPTY:
+    case UNKNOWN:
+      break;
+  }
+}
+
+void WebService::StartStreaming(bool array) {
+  ResolveOutputFormat();
+  SetContentType();
+  streamer_ = new Streamer(this);
+  streamer_->array = array;
+}
+
+void WebService::Stream(const Object &object) {
+  // Start streaming on first output object.
+  if (streamer_ == nullptr) StartStreaming(true);
+  CHECK(streamer_->array || streamer_->count == 0);
+
+  switch (output_format_) {
+    case ENCODED:
+      // Encoded objects are just output one after another.
+      streamer_->encoder->Encode(object);
+      break;
+
+    case TEXT:
+    case COMPACT:
+      // Output SLING text objects separated by newlines.
+      streamer_->printer.Print(object);
+      if (streamer_->array) streamer_->out.WriteChar('\n');
+      break;
+
+    case JSON:
+    case CJSON:
+      // Output JSON objects as array elements.
+      if (streamer_->array) {
+        streamer_->out.WriteChar(streamer_->count == 0 ? '[' : ',');
+      }
+      streamer_->json.Write(object);
+      break;
+
+    case LEX:
+    case PLAIN:
+      // Output text strings.
+      if (object.IsString()) {
+        streamer_->out.Write(object.AsString().text());
+      }
+      break;
+
+    case EMPTY:
+    case UNKNOWN:
+      break;
+  }
+  streamer_->count++;
+}
+
+void WebService::StreamOutput(const Object &object) {
+  CHECK(streamer_ == nullptr);
+  StartStreaming(false);
+  Stream(object);
+}
+
+void WebService::Flush() {
+  if (streamer_ == nullptr) return;
+  streamer_->out.Flush();
+  streamer_->stream.Flush();
+}
+
 Text WebService::Get(Text name) const {
   for (auto &p : parameters_) {
     if (p.name == name) return p.value;
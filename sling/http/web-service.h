@@ -73,7 +73,43 @@ class WebService {
   bool byref() const { return byref_; }
   void set_byref(bool byref) { byref_ = byref; }
 
+  // Determine output format from the request and the fmt parameter. This is
+  // done automatically when the response is generated, but can be called
+  // before to find out the format that will be used for the output.
+  void ResolveOutputFormat();
+
+  // Stream object to the client. Instead of building the complete output
+  // object and serializing it when the service is done, objects can be
+  // serialized and sent to the client incrementally as they are produced.
+  // The response status and headers are sent on the first call. Streamed JSON
+  // output is returned as a JSON array of the streamed objects. The output
+  // object is ignored once streaming has started.
+  void Stream(const Object &object);
+
+  // Stream a single output object to the client. This is an alternative to
+  // set_output() for large outputs, where the object is serialized directly
+  // to the client in chunks instead of being buffered in the response. JSON
+  // output is not wrapped in an array, so the response is the same as for
+  // set_output(). No other objects can be streamed after this.
+  void StreamOutput(const Object &object);
+
+  // Send streamed output buffered so far to the client.
+  void Flush();
+
+  // Check if output is being streamed.
+  bool streaming() const { return streamer_ != nullptr; }
+
  private:
+  struct Streamer;
+
+  // Set content type for output format.
+  void SetContentType();
+
+  // Send response header and start streaming output. If array is true,
+  // multiple objects can be streamed, and JSON objects are output as a JSON
+  // array.
+  void StartStreaming(bool array);
+
   // URL query parameter.
   struct Parameter {
     Parameter(const string &n, const string &v) : name(n), value(v) {}
@@ -101,6 +137,9 @@ class WebService {
 
   // Allow references.
   bool byref_ = false;
+
+  // Serializer for streamed output.
+  Streamer *streamer_ = nullptr;
 };
 
 }  // namespace sling
@@ -0,0 +1,262 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/myelin/autotune.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <unordered_map>
+
+#include "sling/base/clock.h"
+#include "sling/base/logging.h"
+#include "sling/file/file.h"
+#include "sling/string/printf.h"
+#include "third_party/jit/cpu.h"
+
+namespace sling {
+namespace myelin {
+
+// Loop unrollings tried for tunable kernels.
+static const int kUnrolls[] = {1, 2, 4};
+
+Autotuner::Autotuner(const Library &library, const Options &options)
+    : library_(library), options_(options) {
+  // Benchmark networks are compiled without instrumentation.
+  options_.profiling = false;
+  options_.external_profiler = false;
+  options_.global_profiler = false;
+  options_.hardware_counters = false;
+  options_.debug = false;
+  options_.flops_address = nullptr;
+  cpu_ = HostCPU();
+}
+
+string Autotuner::HostCPU() {
+  // Tuning decisions depend on the CPU model and the features enabled for
+  // code generation.
+  jit::ProcessorInformation info;
+  return StringPrintf("%s/%02x/%02x/%02x/%x",
+                      info.vendor(), info.family(), info.model(),
+                      info.stepping(), jit::CPU::SupportedFeatures());
+}
+
+int Autotuner::Tune(Flow *flow) {
+  int tuned = 0;
+  for (Flow::Operation *op : flow->ops()) {
+    // Skip operations that have already been tuned.
+    if (op->HasAttr("kernel")) continue;
+    if (!Benchmarkable(op)) continue;
+
+    // Use previous decision for operations with the same key.
+    string key = Key(op);
+    auto f = choices_.find(key);
+    if (f == choices_.end()) {
+      // Operations without a choice of kernels are recorded with an empty
+      // kernel name.
+      Choice choice;
+      if (!Select(op, &choice)) choice = Choice();
+      f = choices_.emplace(key, choice).first;
+    }
+    const Choice &choice = f->second;
+    if (choice.kernel.empty()) continue;
+
+    // Record decision in operation.
+    op->SetAttr("kernel", choice.kernel);
+    if (choice.unroll > 0) op->SetAttr("unroll", choice.unroll);
+    VLOG(3) << "Autotune " << op->name << ": " << choice.kernel
+            << (choice.unroll > 0 ? " unroll " : "")
+            << (choice.unroll > 0 ? std::to_string(choice.unroll) : "");
+    tuned++;
+  }
+  return tuned;
+}
+
+bool Autotuner::Benchmarkable(Flow::Operation *op) {
+  // Steps in tasks and steps that need to be linked to other cells cannot be
+  // benchmarked in isolation.
+  if (op->task != 0) return false;
+  if (op->indegree() == 0 || op->outdegree() == 0) return false;
+  for (Flow::Variable *var : op->inputs) {
+    if (var->ref() || !var->shape.defined()) return false;
+  }
+  for (Flow::Variable *var : op->outputs) {
+    if (var->ref() || !var->shape.defined()) return false;
+  }
+  return true;
+}
+
+string Autotuner::Key(Flow::Operation *op) {
+  string key = op->type;
+  key.push_back('(');
+  for (int i = 0; i < op->indegree(); ++i) {
+    Flow::Variable *var = op->inputs[i];
+    if (i > 0) key.push_back(',');
+    key.append(var->TypeString());
+    if (var->constant()) key.push_back('#');
+  }
+  key.append(")->(");
+  for (int i = 0; i < op->outdegree(); ++i) {
+    if (i > 0) key.push_back(',');
+    key.append(op->outputs[i]->TypeString());
+  }
+  key.push_back(')');
+  for (const Attribute &attr : *op) {
+    if (attr.name == "kernel" || attr.name == "unroll") continue;
+    key.push_back(' ');
+    key.append(attr.name);
+    key.push_back('=');
+    key.append(attr.value);
+  }
+  return key;
+}
+
+bool Autotuner::Select(Flow::Operation *op, Choice *choice) {
+  // Benchmark all host kernels for the operation in priority order.
+  const Library::Kernels &kernels = library_.Lookup(op->type);
+  double best = -1;
+  int candidates = 0;
+  for (int k = kernels.size() - 1; k >= 0; --k) {
+    Kernel *kernel = kernels[k];
+    if (kernel->Location() != HOST) continue;
+    std::vector<int> unrolls;
+    if (kernel->Tunable()) {
+      unrolls.assign(std::begin(kUnrolls), std::end(kUnrolls));
+    } else {
+      unrolls.push_back(0);
+    }
+    for (int unroll : unrolls) {
+      int64 complexity = -1;
+      double cycles = Benchmark(op, kernel->Name(), unroll, &complexity);
+      if (cycles < 0) break;
+
+      // Do not tune cheap steps.
+      if (complexity >= 0 && complexity < min_complexity_) return false;
+
+      VLOG(5) << "Autotune " << op->name << " with " << kernel->Name()
+              << " unroll " << unroll << ": " << cycles << " cycles";
+      if (best < 0 || cycles < best) {
+        best = cycles;
+        choice->kernel = kernel->Name();
+        choice->unroll = unroll;
+      }
+      candidates++;
+    }
+  }
+
+  return candidates > 1;
+}
+
+double Autotuner::Benchmark(Flow::Operation *op, const string &kernel,
+                            int unroll, int64 *complexity) {
+  // Build flow with a single operation. Constants share the data with the
+  // original flow.
+  Flow flow;
+  Flow::Function *func = flow.AddFunction("autotune");
+  std::unordered_map<Flow::Variable *, Flow::Variable *> mapping;
+  auto map = [&](Flow::Variable *var) {
+    Flow::Variable *&v = mapping[var];
+    if (v == nullptr) {
+      v = flow.AddVariable(var->name, var->type, var->shape);
+      if (var->constant()) {
+        v->data = var->data;
+        v->size = var->size;
+      }
+    }
+    return v;
+  };
+  std::vector<Flow::Variable *> inputs;
+  std::vector<Flow::Variable *> outputs;
+  for (Flow::Variable *var : op->inputs) {
+    Flow::Variable *v = map(var);
+    if (!v->constant()) v->set_in();
+    inputs.push_back(v);
+  }
+  for (Flow::Variable *var : op->outputs) {
+    outputs.push_back(map(var)->set_out());
+  }
+  Flow::Operation *bop =
+      flow.AddOperation(func, op->name, op->type, inputs, outputs);
+  bop->CopyAttrsFrom(*op);
+  bop->SetAttr("kernel", kernel);
+  if (unroll > 0) bop->SetAttr("unroll", unroll);
+
+  // Compile network and check that the kernel was selected.
+  Network net;
+  net.options() = options_;
+  if (!net.Compile(flow, library_)) return -1;
+  Cell *cell = net.GetCell(func->name);
+  Step *step = cell->LookupStep(op->name);
+  if (step == nullptr || step->kernel()->Name() != kernel) return -1;
+  *complexity = step->complexity();
+
+  // Run the step and return the average cycles for the fastest run.
+  Instance data(cell);
+  data.Clear();
+  data.Compute();
+  double best = -1;
+  for (int run = 0; run < runs_; ++run) {
+    Clock clock;
+    clock.start();
+    for (int i = 0; i < iterations_; ++i) data.Compute();
+    clock.stop();
+    double cycles = static_cast<double>(clock.cycles()) / iterations_;
+    if (best < 0 || cycles < best) best = cycles;
+  }
+  return best;
+}
+
+bool Autotuner::Load(const string &filename) {
+  string contents;
+  if (!File::ReadContents(filename, &contents).ok()) return false;
+
+  // Each line has a CPU identity, a key, a kernel name, and an unrolling
+  // separated by tabs.
+  size_t pos = 0;
+  while (pos < contents.size()) {
+    size_t end = contents.find('\n', pos);
+    if (end == string::npos) end = contents.size();
+    string line = contents.substr(pos, end - pos);
+    pos = end + 1;
+    size_t tab0 = line.find('\t');
+    if (tab0 == string::npos) continue;
+    size_t tab2 = line.rfind('\t');
+    if (tab2 == tab0) continue;
+    size_t tab1 = line.rfind('\t', tab2 - 1);
+    if (tab1 == tab0) continue;
+    if (line.compare(0, tab0, cpu_) != 0) {
+      foreign_.push_back(line + "\n");
+      continue;
+    }
+    Choice &choice = choices_[line.substr(tab0 + 1, tab1 - tab0 - 1)];
+    choice.kernel = line.substr(tab1 + 1, tab2 - tab1 - 1);
+    choice.unroll = atoi(line.c_str() + tab2 + 1);
+  }
+  return true;
+}
+
+bool Autotuner::Save(const string &filename) const {
+  // Output decisions sorted by key.
+  std::vector<string> lines(foreign_);
+  for (auto &it : choices_) {
+    lines.push_back(cpu_ + "\t" + it.first + "\t" + it.second.kernel + "\t" +
+                    std::to_string(it.second.unroll) + "\n");
+  }
+  std::sort(lines.begin(), lines.end());
+  string contents;
+  for (const string &line : lines) contents.append(line);
+  return File::WriteContents(filename, contents).ok();
+}
+
+}  // namespace myelin
+}  // namespace sling
@@ -0,0 +1,129 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_MYELIN_AUTOTUNE_H_
+#define SLING_MYELIN_AUTOTUNE_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sling/base/types.h"
+#include "sling/myelin/compute.h"
+#include "sling/myelin/flow.h"
+
+namespace sling {
+namespace myelin {
+
+// The autotuner selects kernels for the operations in an analyzed flow by
+// micro-benchmarking the candidate kernels on the host CPU. Each operation is
+// compiled into a separate single-step network for each kernel that supports
+// it, and for kernels that support tuning, for each loop unrolling. The
+// fastest choice is recorded in the "kernel" and "unroll" attributes of the
+// operation, which are used by the network compiler when selecting kernels.
+// The decisions are saved with the flow, and can also be saved to a tuning
+// file that is shared between flows. Operations with the same type, shapes
+// and attributes are only benchmarked once. Entries in the tuning file are
+// tagged with the CPU model and features, so decisions made on one machine
+// type are not used on another.
+//
+// Usage:
+//   flow.Analyze(library);
+//   Autotuner tuner(library, net.options());
+//   tuner.Load(filename);
+//   tuner.Tune(&flow);
+//   tuner.Save(filename);
+//   net.Compile(flow, library);
+class Autotuner {
+ public:
+  // Kernel selection for operation.
+  struct Choice {
+    string kernel;   // name of fastest kernel
+    int unroll = 0;  // maximum loop unrolling for kernel, 0 for default
+  };
+
+  // Initialize autotuner for compiling networks with options.
+  Autotuner(const Library &library, const Options &options);
+
+  // Select kernels for all operations in analyzed flow. Operations that
+  // already have a kernel attribute are not tuned. Returns the number of
+  // operations for which a kernel was selected.
+  int Tune(Flow *flow);
+
+  // Load tuning decisions from file. Only decisions for the host CPU are
+  // used. Returns false if the file cannot be read.
+  bool Load(const string &filename);
+
+  // Save tuning decisions to file. Decisions for other CPUs that were read by
+  // Load() are kept.
+  bool Save(const string &filename) const;
+
+  // Return identity of the host CPU model and features used for tagging
+  // tuning decisions.
+  static string HostCPU();
+
+  // Number of iterations per benchmark run.
+  void set_iterations(int iterations) { iterations_ = iterations; }
+
+  // Number of benchmark runs. The fastest run is used for each candidate.
+  void set_runs(int runs) { runs_ = runs; }
+
+  // Minimum number of operations for tuning step.
+  void set_min_complexity(int64 min_complexity) {
+    min_complexity_ = min_complexity;
+  }
+
+ private:
+  // Check if operation can be benchmarked in isolation.
+  static bool Benchmarkable(Flow::Operation *op);
+
+  // Compute key for operation type, shapes, and attributes.
+  static string Key(Flow::Operation *op);
+
+  // Select the fastest kernel for operation. Returns false if there is no
+  // choice to make.
+  bool Select(Flow::Operation *op, Choice *choice);
+
+  // Compile operation with kernel and unrolling and measure the execution
+  // time in cycles. Returns -1 if the kernel was not selected for the
+  // operation. The number of operations for the step is returned in
+  // complexity.
+  double Benchmark(Flow::Operation *op, const string &kernel, int unroll,
+                   int64 *complexity);
+
+  // Kernel library.
+  const Library &library_;
+
+  // Compiler options for benchmark networks.
+  Options options_;
+
+  // Host CPU model and enabled features.
+  string cpu_;
+
+  // Tuning decisions for host CPU keyed by operation key.
+  std::unordered_map<string, Choice> choices_;
+
+  // Lines from tuning file with decisions for other CPUs.
+  std::vector<string> foreign_;
+
+  // Benchmark parameters.
+  int iterations_ = 100;
+  int runs_ = 5;
+  int64 min_complexity_ = 1024;
+};
+
+}  // namespace myelin
+}  // namespace sling
+
+#endif  // SLING_MYELIN_AUTOTUNE_H_
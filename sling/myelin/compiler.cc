@@ -22,11 +22,14 @@
 #include "sling/base/logging.h"
 #include "sling/base/perf.h"
 #include "sling/file/file.h"
+#include "sling/myelin/autotune.h"
 #include "sling/myelin/compute.h"
 #include "sling/myelin/elf-linker.h"
 #include "sling/myelin/flow.h"
 #include "sling/myelin/graph.h"
+#include "sling/myelin/jit-cache.h"
 #include "sling/myelin/profile.h"
+#include "sling/myelin/quantization.h"
 #include "sling/myelin/cuda/cuda-runtime.h"
 #include "sling/myelin/kernel/cuda.h"
 #include "sling/myelin/kernel/dragnn.h"
@@ -36,6 +39,7 @@
 DEFINE_string(cpu, "", "Enable/disable CPU features");
 DEFINE_bool(gpu, false, "Run kernels on GPU");
 DEFINE_bool(profile, false, "Profile neural network computations");
+DEFINE_bool(profile_counters, false, "Profile hardware performance counters");
 DEFINE_string(input_flow, "", "File for saving raw input flow");
 DEFINE_string(final_flow, "", "File for saving final analyzed flow");
 DEFINE_string(input_dot, "", "File for saving raw input flow as DOT file");
@@ -43,6 +47,7 @@ DEFINE_string(input_graph, "", "File for saving raw input flow as SVG file");
 DEFINE_string(final_graph, "", "File for saving analyzed flow as SVG file");
 DEFINE_string(final_dot, "", "File for saving analyzed flow as DOT file");
 DEFINE_string(jit_code, "", "File for saving JIT generated code");
+DEFINE_string(jit_cache, "", "Directory for caching JIT generated code");
 DEFINE_bool(dump_input_flow, false, "Dump raw input flow to log");
 DEFINE_bool(dump_final_flow, false, "Dump final analyzed flow to log");
 DEFINE_bool(dump_cells, false, "Dump cells after compilation");
@@ -61,7 +66,13 @@ DEFINE_bool(jit_debug, false, "Debug break in jit code");
 DEFINE_int32(cuda_device, -1, "CUDA device number");
 DEFINE_int32(cuda_context_flags, 0, "CUDA context flags");
 DEFINE_int32(sparse_threshold, 64, "Minimum dimension size for sparse update");
+DEFINE_int64(parallel_threshold, 1 << 20,
+             "Minimum number of operations per parallel step partition");
 DEFINE_bool(compile_only, false, "Stop after compilation");
+DEFINE_bool(autotune, false, "Select kernels by benchmarking on host CPU");
+DEFINE_string(autotune_file, "", "File for saving kernel tuning decisions");
+DEFINE_string(half_precision, "",
+              "Store constant matrices as 16-bit floats (half or bfloat16)");
 
 namespace sling {
 namespace myelin {
@@ -106,6 +117,46 @@ Compiler::~Compiler() {
 }
 
 void Compiler::Compile(Flow *flow, Network *net) {
+  // Register runtime.
+  if (runtime_ != nullptr) net->set_runtime(runtime_);
+
+  // Set FLOPs counter for measuring performance.
+  if (perf_flopctr_ && net->options().flops_address == nullptr) {
+    net->options().flops_address = Perf::flopptr();
+  }
+
+  // Optionally enable profiling.
+  if (FLAGS_profile) {
+    net->options().profiling = true;
+    net->options().global_profiler = true;
+    if (FLAGS_profile_counters) net->options().hardware_counters = true;
+  }
+
+  // Set compiler options.
+  if (FLAGS_dynamic_instance_allocation) {
+    net->options().dynamic_allocation = true;
+  }
+  if (FLAGS_sync_steps) net->options().sync_steps = true;
+  if (FLAGS_jit_debug) net->options().debug = true;
+  if (FLAGS_fast_math) net->options().fast_math = true;
+  net->options().sparse_threshold = FLAGS_sparse_threshold;
+  net->options().parallel_threshold = FLAGS_parallel_threshold;
+
+  // Look up analyzed flow in JIT cache. The JIT cache is not used for GPU
+  // code and when the generated code is output.
+  bool dump = !FLAGS_jit_code.empty() || FLAGS_dump_code;
+  bool use_cache = !FLAGS_jit_cache.empty() && !FLAGS_gpu && !dump &&
+                   JITCache::Supported(*net);
+  JITCache cache(FLAGS_jit_cache);
+  Flow cached;
+  bool hit = false;
+  if (use_cache) {
+    string settings = "half_precision=" + FLAGS_half_precision;
+    if (FLAGS_autotune) settings.append(" autotune=" + Autotuner::HostCPU());
+    cache.Initialize(*flow, *library_, *net, settings);
+    hit = cache.Load(&cached);
+  }
+
   // Optionally dump input flow.
   if (FLAGS_dump_input_flow) {
     LOG(INFO) << "Input flow:\n" << flow->ToString();
@@ -119,55 +170,71 @@ void Compiler::Compile(Flow *flow, Network *net) {
   // Optionally output DOT file for input.
   WriteGraph(*flow, FLAGS_input_dot, FLAGS_input_graph);
 
-  // Analyze flow.
-  flow->Analyze(*library_);
+  // Analyze flow. The analyzed flow from the JIT cache is used on a cache hit.
+  if (!hit) flow->Analyze(*library_);
+  const Flow &final = hit ? cached : *flow;
+
+  // Optionally store constant matrices as 16-bit floating point numbers. This
+  // is done on the analyzed flow, so matrices used by fused matrix
+  // multiplications are also converted.
+  if (!FLAGS_half_precision.empty() && !hit && !FLAGS_gpu) {
+    Type type = DT_HALF;
+    if (FLAGS_half_precision == "bfloat16") {
+      type = DT_BFLOAT16;
+    } else {
+      CHECK_EQ(FLAGS_half_precision, "half");
+    }
+    int converted = ConvertToHalfPrecision(flow, type);
+    VLOG(1) << "Converted " << converted << " matrices to "
+            << FLAGS_half_precision;
+  }
+
+  // Optionally select kernels by benchmarking them on the host CPU. The
+  // decisions are stored in the analyzed flow, so they are also saved in the
+  // JIT cache.
+  if (FLAGS_autotune && !hit && !FLAGS_gpu) {
+    Autotuner tuner(*library_, net->options());
+    if (!FLAGS_autotune_file.empty()) tuner.Load(FLAGS_autotune_file);
+    int tuned = tuner.Tune(flow);
+    VLOG(1) << "Autotuned " << tuned << " steps";
+    if (!FLAGS_autotune_file.empty()) {
+      if (!tuner.Save(FLAGS_autotune_file)) {
+        LOG(WARNING) << "Error saving tuning decisions to "
+                     << FLAGS_autotune_file;
+      }
+    }
+  }
 
   // Optionally dump final flow.
   if (FLAGS_dump_final_flow) {
-    LOG(INFO) << "Final flow:\n" << flow->ToString();
+    LOG(INFO) << "Final flow:\n" << final.ToString();
   }
 
   // Optionally save final flow.
   if (!FLAGS_final_flow.empty()) {
-    flow->Save(FLAGS_final_flow);
+    final.Save(FLAGS_final_flow);
   }
 
   // Optionally output graph for final flow.
-  WriteGraph(*flow, FLAGS_final_dot, FLAGS_final_graph);
+  WriteGraph(final, FLAGS_final_dot, FLAGS_final_graph);
 
   // Optionally check flow consistency.
   if (FLAGS_check_flow_consistency) {
-    CHECK(flow->IsConsistent());
-  }
-
-  // Register runtime.
-  if (runtime_ != nullptr) net->set_runtime(runtime_);
-
-  // Set FLOPs counter for measuring performance.
-  if (perf_flopctr_ && net->options().flops_address == nullptr) {
-    net->options().flops_address = Perf::flopptr();
-  }
-
-  // Optionally enable profiling.
-  if (FLAGS_profile) {
-    net->options().profiling = true;
-    net->options().global_profiler = true;
+    CHECK(final.IsConsistent());
   }
 
   // Compile flow to network.
   ElfLinker linker;
-  if (!FLAGS_jit_code.empty() || FLAGS_dump_code) {
+  if (dump) {
     net->set_linker(&linker);
+  } else if (use_cache) {
+    net->set_linker(&cache);
   }
-  if (FLAGS_dynamic_instance_allocation) {
-    net->options().dynamic_allocation = true;
-  }
-  if (FLAGS_sync_steps) net->options().sync_steps = true;
-  if (FLAGS_jit_debug) net->options().debug = true;
-  if (FLAGS_fast_math) net->options().fast_math = true;
-  net->options().sparse_threshold = FLAGS_sparse_threshold;
 
-  CHECK(net->Compile(*flow, *library_));
+  CHECK(net->Compile(final, *library_));
+
+  // Save analyzed flow and generated code in JIT cache.
+  if (use_cache && !hit) cache.Save(*flow);
 
   // Bind flow artifacts to network tensors, cells, and steps.
   net->Bind(flow);
@@ -28,7 +28,10 @@ class Compiler {
   Compiler();
   ~Compiler();
 
-  // Compile flow to network.
+  // Compile flow to network. If a JIT cache directory is set with the
+  // --jit_cache flag and the flow is found in the cache, the flow is not
+  // analyzed and the network is compiled from the cached analyzed flow and
+  // code instead.
   void Compile(Flow *flow, Network *net);
 
   // Library with transformations and kernels for compilation.
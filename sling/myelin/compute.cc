@@ -25,6 +25,7 @@
 #include "sling/base/types.h"
 #include "sling/file/file.h"
 #include "sling/myelin/macro-assembler.h"
+#include "sling/myelin/perf-counters.h"
 #include "sling/string/printf.h"
 
 namespace sling {
@@ -1482,7 +1483,23 @@ bool Network::Compile(const Flow &flow, const Library &library) {
   // Find kernels for implementing each step.
   for (Step *step : steps_) {
     auto &kernels = library.Lookup(step->type());
-    for (int k = kernels.size() - 1; k >= 0; --k) {
+
+    // Use the kernel selected by the autotuner if it supports the step.
+    const string &selected = step->GetAttr("kernel");
+    if (!selected.empty() && step->task_index_ == -1) {
+      for (Kernel *kernel : kernels) {
+        if (kernel->Name() == selected && kernel->Supports(step, options_)) {
+          step->kernel_ = kernel;
+          break;
+        }
+      }
+      if (step->kernel_ == nullptr) {
+        VLOG(3) << "Selected kernel " << selected << " does not support "
+                << step->name();
+      }
+    }
+
+    for (int k = kernels.size() - 1; k >= 0 && !step->kernel_; --k) {
       Kernel *kernel = kernels[k];
       if (kernel->Supports(step, options_)) {
         // Check that kernel location is compatible with task placement.
@@ -1536,8 +1553,12 @@ bool Network::Compile(const Flow &flow, const Library &library) {
       //     int64 overhead;
       //     int64 steptime[#steps];
       //     TaskTiming tasktime[#tasks];
+      //     int64 counters[#steps][#counters];  // if hardware_counters
       //   };
       size_t size = 2 + cell->steps_.size() + 2 * cell->tasks_.size();
+      if (options_.hardware_counters) {
+        size += cell->steps_.size() * PerfCounters::NUM_COUNTERS;
+      }
       Tensor *profile = new Tensor();
       profile->name_ = "timing/" + cell->name_;
       profile->cell_ = cell;
@@ -1823,6 +1844,9 @@ bool Network::Compile(const Flow &flow, const Library &library) {
     // Start code generation for cell.
     linker_->BeginCell(cell);
 
+    // Use previously generated code for cell if the linker has it.
+    if (linker_->LoadCell(cell, &cell->code_)) continue;
+
     // Create macro assembler for code generation.
     MacroAssembler masm(nullptr, 0, options_);
     masm.set_runtime(runtime_);
@@ -1887,6 +1911,7 @@ bool Network::Compile(const Flow &flow, const Library &library) {
     if (options_.profiling) {
       int timing = cell->profile()->offset();
       masm.TimeStep(timing, 1 * sizeof(int64));
+      if (options_.hardware_counters) masm.SampleCounters(timing, -1);
     }
 
     // Let kernels generate code for each step.
@@ -1967,6 +1992,11 @@ bool Network::Compile(const Flow &flow, const Library &library) {
         if (options_.profiling && !step->noop_) {
           int timing = cell->profile()->offset();
           masm.TimeStep(timing, (stepnum + 2) * sizeof(int64));
+          if (options_.hardware_counters) {
+            int slot = 2 + cell->steps_.size() + 2 * cell->tasks_.size() +
+                       stepnum * PerfCounters::NUM_COUNTERS;
+            masm.SampleCounters(timing, slot * sizeof(int64));
+          }
         }
       } else {
         // Parallel step.
@@ -96,6 +96,10 @@ class Kernel {
 
   // Number of numeric operations kernel performs for step.
   virtual int64 Complexity(const Step *step) { return -1; }
+
+  // Check if the loop unrolling of the generated code can be selected with the
+  // "unroll" step attribute.
+  virtual bool Tunable() { return false; }
 };
 
 // Library of kernels for implementing operations.
@@ -131,6 +135,11 @@ class Library : public Transformations {
   // Find kernels implementing operation.
   const Kernels &Lookup(const string &op) const;
 
+  // Map from op name to kernels implementing the op.
+  const std::unordered_map<string, Kernels> &kernels() const {
+    return kernels_;
+  }
+
  private:
   // Register custom kernel.
   CustomKernel &RegisterCustomKernel(const string &op, const string &name,
@@ -160,6 +169,18 @@ struct Task {
   int32 index;
 };
 
+// A parallel task splits the computation of a step into a number of partitions
+// that can be computed in parallel. The partition function is called with the
+// instance data and the partition number for each partition.
+struct ParallelTask {
+  // Function for computing partition.
+  void (*func)(void *arg, int64 partition);
+  void *arg;
+
+  // Number of partitions.
+  int64 partitions;
+};
+
 // Data transfer between host and device.
 struct Transfer {
   Transfer(Tensor *tensor, int taskidx) : tensor(tensor), taskidx(taskidx) {}
@@ -189,6 +210,7 @@ class Runtime {
  public:
   typedef void (*TaskFunc)(Task *);
   typedef void (*InstanceFunc)(void *);
+  typedef void (*ParallelFunc)(ParallelTask *);
 
   virtual ~Runtime() = default;
 
@@ -238,6 +260,15 @@ class Runtime {
   // can return null if no synchronization is needed.
   virtual InstanceFunc SyncMainFunc() { return nullptr; }
 
+  // Return the number of threads that can compute partitions of a step in
+  // parallel.
+  virtual int ParallelThreads() { return 1; }
+
+  // Return runtime function for computing all partitions of a parallel task.
+  // The function returns when all partitions have been computed. This can
+  // return null if the runtime does not support intra-step parallelism.
+  virtual ParallelFunc ParallelForFunc() { return nullptr; }
+
   // Return the size of extra instance data needed by runtime. This extra data
   // will be allocated at the beginning of the instance block at offset 0.
   virtual int ExtraInstanceData(Cell *cell) { return 0; }
@@ -292,6 +323,10 @@ class Linker {
   // Start code generation for cell.
   virtual void BeginCell(Cell *cell) {}
 
+  // Load previously generated code for cell. If this returns true, no code is
+  // generated for the cell.
+  virtual bool LoadCell(Cell *cell, jit::Code *code) { return false; }
+
   // Compilation of cell completed.
   virtual void EndCell(Cell *cell,
                        jit::CodeGenerator *generator,
@@ -1337,6 +1372,7 @@ struct Options {
   Order parameter_element_order = ROW_MAJOR; // element order for parameters
   bool debug = false;                        // insert breakpoint in cell
   bool profiling = false;                    // enable profiling
+  bool hardware_counters = false;            // profile hardware counters
   bool external_profiler = false;            // external profiling buffer
   bool global_profiler = false;              // global profiling buffer
   bool dynamic_allocation = false;           // dynamic instance allocation
@@ -1345,6 +1381,7 @@ struct Options {
   bool aot = false;                          // ahead-of-time compilation
   bool pic = false;                          // position-independent code
   int sparse_threshold = 64;                 // threshold for sparse update
+  int64 parallel_threshold = 1 << 20;        // minimum ops per step partition
   int64 *flops_address = nullptr;            // address of FLOPs counter
 
   bool ref_profiler() const { return external_profiler || global_profiler; }
@@ -155,8 +155,9 @@ bool ElementwiseIndexGenerator::EnableSparse(Tensor *sparse) {
       // Only one simple iterator allowed for sparse iteration.
       if (inner != nullptr) return false;
       inner = it;
-    } else if (it->type != SCALAR) {
-      // Only simple and scalar iterators can be combined with sparse iteration.
+    } else if (it->type != SCALAR && it->type != CONST) {
+      // Only simple, scalar, and constant iterators can be combined with
+      // sparse iteration.
       return false;
     }
   }
@@ -0,0 +1,657 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/myelin/jit-cache.h"
+
+#include <link.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "sling/base/logging.h"
+#include "sling/file/file.h"
+#include "sling/string/printf.h"
+#include "sling/util/fingerprint.h"
+#include "third_party/jit/cpu.h"
+
+namespace sling {
+namespace myelin {
+
+// Magic number and format version for cache entries. The version must be
+// incremented whenever the format of the cache entries changes.
+static const uint32 kCacheMagic = 0x4a4c594d;
+static const uint32 kCacheVersion = 1;
+
+namespace {
+
+// Incremental fingerprint computation.
+class Fingerprinter {
+ public:
+  void Add(const void *data, size_t size) {
+    fp_ = FingerprintCat(fp_, Fingerprint(static_cast<const char *>(data),
+                                          size));
+  }
+  void Add(const string &str) { Add(str.data(), str.size()); }
+  void Add(int64 n) { Add(&n, sizeof(int64)); }
+
+  void Add(const Shape &shape) {
+    Add(shape.rank());
+    for (int d = 0; d < shape.rank(); ++d) Add(shape.dim(d));
+  }
+
+  void Add(const Attributes &attrs) {
+    Add(attrs.size());
+    for (const auto &attr : attrs) {
+      Add(attr.name);
+      Add(attr.value);
+    }
+  }
+
+  uint64 fp() const { return fp_; }
+
+ private:
+  uint64 fp_ = 0;
+};
+
+// Writer for serializing cache entry.
+class Writer {
+ public:
+  void Write(const void *data, size_t size) {
+    buffer_.append(static_cast<const char *>(data), size);
+  }
+  void WriteInt(int32 n) { Write(&n, sizeof(int32)); }
+  void WriteInt64(int64 n) { Write(&n, sizeof(int64)); }
+  void WriteString(const string &str) {
+    WriteInt(str.size());
+    Write(str.data(), str.size());
+  }
+
+  const string &buffer() const { return buffer_; }
+
+ private:
+  string buffer_;
+};
+
+// Reader for deserializing cache entry. Reading past the end of the data
+// marks the reader as failed.
+class Reader {
+ public:
+  explicit Reader(const string &data)
+      : ptr_(data.data()), end_(data.data() + data.size()) {}
+
+  bool Read(void *data, size_t size) {
+    if (end_ - ptr_ < size) {
+      ok_ = false;
+      return false;
+    }
+    memcpy(data, ptr_, size);
+    ptr_ += size;
+    return true;
+  }
+
+  int32 ReadInt() {
+    int32 n = 0;
+    Read(&n, sizeof(int32));
+    return n;
+  }
+
+  int64 ReadInt64() {
+    int64 n = 0;
+    Read(&n, sizeof(int64));
+    return n;
+  }
+
+  string ReadString() {
+    int size = ReadInt();
+    if (size < 0 || end_ - ptr_ < size) {
+      ok_ = false;
+      return "";
+    }
+    string str(ptr_, size);
+    ptr_ += size;
+    return str;
+  }
+
+  bool ok() const { return ok_; }
+
+ private:
+  const char *ptr_;
+  const char *end_;
+  bool ok_ = true;
+};
+
+// Module search for dl_iterate_phdr().
+struct ModuleSearch {
+  const char *address;             // address to search for
+  const char *name = nullptr;      // name of module containing address
+  char *base = nullptr;            // base address of module
+};
+
+int FindModuleCallback(struct dl_phdr_info *info, size_t size, void *data) {
+  ModuleSearch *search = static_cast<ModuleSearch *>(data);
+  for (int i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+    if (phdr.p_type != PT_LOAD) continue;
+    const char *start =
+        reinterpret_cast<const char *>(info->dlpi_addr + phdr.p_vaddr);
+    const char *end = start + phdr.p_memsz;
+    if (search->address >= start && search->address < end) {
+      search->name = info->dlpi_name;
+      search->base = reinterpret_cast<char *>(info->dlpi_addr);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Module base search for dl_iterate_phdr().
+struct BaseSearch {
+  const char *name;                // module name
+  char *base = nullptr;            // base address of module
+  bool found = false;              // module found
+};
+
+int FindBaseCallback(struct dl_phdr_info *info, size_t size, void *data) {
+  BaseSearch *search = static_cast<BaseSearch *>(data);
+  if (strcmp(info->dlpi_name, search->name) != 0) return 0;
+  search->base = reinterpret_cast<char *>(info->dlpi_addr);
+  search->found = true;
+  return 1;
+}
+
+}  // namespace
+
+void JITCache::Initialize(const Flow &flow,
+                          const Library &library,
+                          const Network &network,
+                          const string &settings) {
+  const Options &options = network.options();
+  Fingerprinter fp;
+  fp.Add(kCacheVersion);
+
+  // Add the binary containing the compiler to the key, so the cache is
+  // invalidated when the kernels change.
+  ModuleSearch search;
+  search.address = reinterpret_cast<const char *>(&FindModuleCallback);
+  dl_iterate_phdr(FindModuleCallback, &search);
+  Module binary;
+  if (search.name != nullptr && GetModuleInfo(search.name, &binary)) {
+    fp.Add(binary.name);
+    fp.Add(binary.size);
+    fp.Add(binary.mtime);
+  } else {
+    LOG(WARNING) << "Unable to locate binary for JIT cache";
+    uncacheable_ = true;
+  }
+
+  // Add CPU features and cache sizes, which are used for selecting kernels
+  // and tensor layouts.
+  fp.Add(jit::CPU::SupportedFeatures());
+  fp.Add(jit::CPU::CacheLineSize());
+  fp.Add(jit::CPU::L1CacheSize());
+  fp.Add(jit::CPU::L2CacheSize());
+  fp.Add(jit::CPU::L3CacheSize());
+
+  // Add compiler options.
+  fp.Add(options.parameter_element_order);
+  fp.Add(options.debug);
+  fp.Add(options.dynamic_allocation);
+  fp.Add(options.sync_steps);
+  fp.Add(options.fast_math);
+  fp.Add(options.sparse_threshold);
+  fp.Add(options.flops_address != nullptr);
+  fp.Add(options.parallel_threshold);
+  fp.Add(settings);
+
+  // Add runtime, since the generated code calls into the runtime and steps
+  // are split into partitions based on the number of runtime threads.
+  Runtime *runtime = network.runtime();
+  fp.Add(runtime->Description());
+  fp.Add(runtime->SupportsAsync());
+  fp.Add(runtime->ParallelThreads());
+
+  // Add transformations and kernels in library.
+  for (Transformer *transformer : library.transformers()) {
+    fp.Add(transformer->Name());
+  }
+  for (Typer *typer : library.typers()) {
+    fp.Add(typer->Name());
+  }
+  std::vector<string> ops;
+  for (auto &it : library.kernels()) ops.push_back(it.first);
+  std::sort(ops.begin(), ops.end());
+  for (const string &op : ops) {
+    fp.Add(op);
+    for (Kernel *kernel : library.Lookup(op)) fp.Add(kernel->Name());
+  }
+
+  // Add input flow.
+  for (const Flow::Variable *var : flow.vars()) {
+    fp.Add(var->name);
+    fp.Add(var->flags);
+    fp.Add(var->type);
+    fp.Add(var->shape);
+    fp.Add(var->init);
+    for (const string &alias : var->aliases) fp.Add(alias);
+    fp.Add(*var);
+    if (var->data != nullptr) fp.Add(var->data, var->size);
+  }
+  for (const Flow::Operation *op : flow.ops()) {
+    fp.Add(op->name);
+    fp.Add(op->flags);
+    fp.Add(op->type);
+    fp.Add(op->task);
+    fp.Add(op->priority);
+    for (const Flow::Variable *input : op->inputs) fp.Add(input->name);
+    fp.Add(-1);
+    for (const Flow::Variable *output : op->outputs) fp.Add(output->name);
+    fp.Add(*op);
+  }
+  for (const Flow::Function *func : flow.funcs()) {
+    fp.Add(func->name);
+    fp.Add(func->flags);
+    for (const Flow::Operation *op : func->ops) fp.Add(op->name);
+  }
+  for (const Flow::Connector *cnx : flow.cnxs()) {
+    fp.Add(cnx->name);
+    fp.Add(cnx->flags);
+    for (const Flow::Variable *link : cnx->links) fp.Add(link->name);
+  }
+  for (const Flow::Blob *blob : flow.blobs()) {
+    fp.Add(blob->name);
+    fp.Add(blob->type);
+    fp.Add(*blob);
+    if (blob->data != nullptr) fp.Add(blob->data, blob->size);
+  }
+
+  key_ = fp.fp();
+  VLOG(3) << "JIT cache key "
+          << StringPrintf("%016llx", static_cast<unsigned long long>(key_));
+}
+
+bool JITCache::Load(Flow *flow) {
+  // Read cache entry.
+  string jitfile = FileName(".jit");
+  string flowfile = FileName(".flow");
+  if (!File::Exists(jitfile) || !File::Exists(flowfile)) return false;
+  string data;
+  if (!File::ReadContents(jitfile, &data).ok()) return false;
+  Reader reader(data);
+  if (reader.ReadInt() != kCacheMagic) return false;
+  if (reader.ReadInt() != kCacheVersion) return false;
+  if (reader.ReadInt64() != key_) return false;
+
+  // Read modules referenced by code and check that they have not changed.
+  int num_modules = reader.ReadInt();
+  for (int i = 0; i < num_modules && reader.ok(); ++i) {
+    Module module;
+    module.name = reader.ReadString();
+    module.size = reader.ReadInt64();
+    module.mtime = reader.ReadInt64();
+    if (ModuleBase(module) == nullptr) {
+      LOG(WARNING) << "Module " << module.name << " changed; "
+                   << "ignoring JIT cache entry " << jitfile;
+      return false;
+    }
+    modules_.push_back(module);
+  }
+
+  // Read flow information which is not stored in the flow file.
+  int num_tasks = reader.ReadInt();
+  for (int i = 0; i < num_tasks && reader.ok(); ++i) {
+    string op = reader.ReadString();
+    int task = reader.ReadInt();
+    tasks_.emplace_back(op, task);
+  }
+  int num_inits = reader.ReadInt();
+  for (int i = 0; i < num_inits && reader.ok(); ++i) {
+    string var = reader.ReadString();
+    int init = reader.ReadInt();
+    inits_.emplace_back(var, init);
+  }
+  int num_unused = reader.ReadInt();
+  for (int i = 0; i < num_unused && reader.ok(); ++i) {
+    string func = reader.ReadString();
+    string var = reader.ReadString();
+    unused_.emplace_back(func, var);
+  }
+
+  // Read tensor layout.
+  layout_ = reader.ReadString();
+
+  // Read code for cells.
+  int num_cells = reader.ReadInt();
+  for (int i = 0; i < num_cells && reader.ok(); ++i) {
+    cells_.emplace_back();
+    CellCode &cell = cells_.back();
+    cell.name = reader.ReadString();
+    cell.code = reader.ReadString();
+    int num_relocs = reader.ReadInt();
+    for (int j = 0; j < num_relocs && reader.ok(); ++j) {
+      cell.relocs.emplace_back();
+      Relocation &reloc = cell.relocs.back();
+      reloc.kind = static_cast<Relocation::Kind>(reader.ReadInt());
+      reloc.symbol = reader.ReadString();
+      reloc.module = reader.ReadInt();
+      reloc.offset = reader.ReadInt64();
+      int num_refs = reader.ReadInt();
+      for (int k = 0; k < num_refs && reader.ok(); ++k) {
+        int ref = reader.ReadInt();
+        if (ref < 0 || ref + sizeof(uint64) > cell.code.size()) {
+          LOG(WARNING) << "Invalid relocation in JIT cache entry " << jitfile;
+          return false;
+        }
+        reloc.refs.push_back(ref);
+      }
+      if (reloc.kind == Relocation::MODULE &&
+          (reloc.module < 0 || reloc.module >= modules_.size())) {
+        LOG(WARNING) << "Invalid module in JIT cache entry " << jitfile;
+        return false;
+      }
+    }
+  }
+  if (!reader.ok()) {
+    LOG(WARNING) << "Truncated JIT cache entry " << jitfile;
+    return false;
+  }
+
+  // Load analyzed flow.
+  if (!flow->Load(flowfile).ok()) {
+    LOG(WARNING) << "Error loading cached flow " << flowfile;
+    return false;
+  }
+  for (auto &t : tasks_) {
+    Flow::Operation *op = flow->Op(t.first);
+    if (op != nullptr) op->task = t.second;
+  }
+  for (auto &i : inits_) {
+    Flow::Variable *var = flow->Var(i.first);
+    if (var != nullptr) {
+      var->init = static_cast<Flow::Variable::Initialization>(i.second);
+    }
+  }
+  for (auto &u : unused_) {
+    Flow::Function *func = flow->Func(u.first);
+    Flow::Variable *var = flow->Var(u.second);
+    if (func != nullptr && var != nullptr) func->unused.push_back(var);
+  }
+
+  VLOG(1) << "Loaded network from JIT cache " << jitfile;
+  hit_ = true;
+  return true;
+}
+
+bool JITCache::Save(const Flow &flow) {
+  if (hit_ || uncacheable_ || network_ == nullptr) return false;
+
+  // Make sure cache directory exists.
+  if (!File::Exists(dir_)) File::Mkdir(dir_);
+
+  // Write cache entry header and the modules referenced by the code.
+  Writer writer;
+  writer.WriteInt(kCacheMagic);
+  writer.WriteInt(kCacheVersion);
+  writer.WriteInt64(key_);
+  writer.WriteInt(modules_.size());
+  for (const Module &module : modules_) {
+    writer.WriteString(module.name);
+    writer.WriteInt64(module.size);
+    writer.WriteInt64(module.mtime);
+  }
+
+  // Write flow information which is not stored in the flow file.
+  std::vector<std::pair<string, int>> tasks;
+  for (const Flow::Operation *op : flow.ops()) {
+    if (op->task != 0) tasks.emplace_back(op->name, op->task);
+  }
+  writer.WriteInt(tasks.size());
+  for (auto &t : tasks) {
+    writer.WriteString(t.first);
+    writer.WriteInt(t.second);
+  }
+  std::vector<std::pair<string, int>> inits;
+  for (const Flow::Variable *var : flow.vars()) {
+    if (var->init != Flow::Variable::INIT_ZERO) {
+      inits.emplace_back(var->name, var->init);
+    }
+  }
+  writer.WriteInt(inits.size());
+  for (auto &i : inits) {
+    writer.WriteString(i.first);
+    writer.WriteInt(i.second);
+  }
+  std::vector<std::pair<string, string>> unused;
+  for (const Flow::Function *func : flow.funcs()) {
+    for (const Flow::Variable *var : func->unused) {
+      unused.emplace_back(func->name, var->name);
+    }
+  }
+  writer.WriteInt(unused.size());
+  for (auto &u : unused) {
+    writer.WriteString(u.first);
+    writer.WriteString(u.second);
+  }
+
+  // Write tensor layout.
+  writer.WriteString(Layout(network_));
+
+  // Write code for cells.
+  writer.WriteInt(cells_.size());
+  for (const CellCode &cell : cells_) {
+    writer.WriteString(cell.name);
+    writer.WriteString(cell.code);
+    writer.WriteInt(cell.relocs.size());
+    for (const Relocation &reloc : cell.relocs) {
+      writer.WriteInt(reloc.kind);
+      writer.WriteString(reloc.symbol);
+      writer.WriteInt(reloc.module);
+      writer.WriteInt64(reloc.offset);
+      writer.WriteInt(reloc.refs.size());
+      for (int ref : reloc.refs) writer.WriteInt(ref);
+    }
+  }
+
+  // Write flow and code to temporary files and rename them, so concurrent
+  // processes never see partially written cache entries.
+  string suffix = StringPrintf(".%d", getpid());
+  string flowfile = FileName(".flow");
+  string jitfile = FileName(".jit");
+  flow.Save(flowfile + suffix);
+  if (!File::WriteContents(jitfile + suffix, writer.buffer()).ok() ||
+      !File::Rename(flowfile + suffix, flowfile).ok() ||
+      !File::Rename(jitfile + suffix, jitfile).ok()) {
+    LOG(WARNING) << "Error writing JIT cache entry " << jitfile;
+    File::Delete(flowfile + suffix);
+    File::Delete(jitfile + suffix);
+    return false;
+  }
+
+  VLOG(1) << "Saved network to JIT cache " << jitfile;
+  return true;
+}
+
+void JITCache::BeginNetwork(Network *network) {
+  network_ = network;
+}
+
+bool JITCache::LoadCell(Cell *cell, jit::Code *code) {
+  if (!hit_) return false;
+
+  // Check that the tensor layout matches the cached layout.
+  if (!layout_checked_) {
+    layout_matches_ = Layout(network_) == layout_;
+    if (!layout_matches_) {
+      LOG(WARNING) << "Tensor layout mismatch for JIT cache entry "
+                   << FileName(".jit") << "; regenerating code";
+    }
+    layout_checked_ = true;
+  }
+  if (!layout_matches_) return false;
+
+  // Find cached code for cell.
+  const CellCode *cached = nullptr;
+  for (const CellCode &c : cells_) {
+    if (c.name == cell->name()) cached = &c;
+  }
+  if (cached == nullptr) return false;
+
+  // Relocate references to tensor data and functions.
+  string buffer = cached->code;
+  for (const Relocation &reloc : cached->relocs) {
+    char *address;
+    if (reloc.kind == Relocation::TENSOR) {
+      Tensor *tensor = network_->LookupParameter(reloc.symbol);
+      if (tensor == nullptr || !tensor->IsGlobal()) return false;
+      address = tensor->data();
+    } else {
+      char *base = ModuleBase(modules_[reloc.module]);
+      if (base == nullptr) return false;
+      address = base + reloc.offset;
+    }
+    for (int ref : reloc.refs) {
+      memcpy(&buffer[ref], &address, sizeof(char *));
+    }
+  }
+
+  // Allocate executable code object in memory.
+  code->Allocate(&buffer[0], buffer.size());
+  return true;
+}
+
+void JITCache::EndCell(Cell *cell,
+                       jit::CodeGenerator *generator,
+                       jit::Code *code,
+                       int data_size) {
+  // Allocate executable code object in memory.
+  code->Allocate(generator);
+  if (uncacheable_) return;
+
+  // Record code and relocations for external references.
+  cells_.emplace_back();
+  CellCode &cached = cells_.back();
+  cached.name = cell->name();
+  cached.code.assign(reinterpret_cast<char *>(generator->begin()),
+                     generator->size());
+  for (auto &e : generator->externs()) {
+    Relocation reloc;
+    Tensor *tensor = network_->LookupParameter(e.symbol);
+    if (tensor != nullptr && tensor->IsGlobal() &&
+        tensor->data() == reinterpret_cast<char *>(e.address)) {
+      reloc.kind = Relocation::TENSOR;
+      reloc.symbol = e.symbol;
+      reloc.module = -1;
+      reloc.offset = 0;
+    } else {
+      reloc.kind = Relocation::MODULE;
+      reloc.module = FindModule(e.address, &reloc.offset);
+      if (reloc.module == -1) {
+        VLOG(1) << "Cannot cache code for " << cell->name()
+                << " with reference to " << e.symbol;
+        uncacheable_ = true;
+        return;
+      }
+    }
+    for (auto &ref : e.refs) {
+      if (ref.relative) {
+        VLOG(1) << "Cannot cache code for " << cell->name()
+                << " with relative reference to " << e.symbol;
+        uncacheable_ = true;
+        return;
+      }
+      reloc.refs.push_back(ref.offset);
+    }
+    cached.relocs.push_back(reloc);
+  }
+}
+
+bool JITCache::Supported(const Network &network) {
+  const Options &options = network.options();
+  return !options.profiling && !options.aot && !options.pic;
+}
+
+string JITCache::FileName(const char *ext) const {
+  return StringPrintf("%s/%016llx%s", dir_.c_str(),
+                      static_cast<unsigned long long>(key_), ext);
+}
+
+string JITCache::Layout(Network *network) {
+  string layout;
+  for (Cell *cell : network->cells()) {
+    StringAppendF(&layout, "cell %s %lu %d\n",
+                  cell->name().c_str(),
+                  cell->instance_size(),
+                  cell->instance_alignment());
+  }
+  auto add = [&layout](Tensor *t) {
+    StringAppendF(&layout, "%s %s %s %lu %lu %lu %d %d %s %s %d %d\n",
+                  t->name().c_str(),
+                  t->cell() == nullptr ? "-" : t->cell()->name().c_str(),
+                  t->TypeString().c_str(),
+                  t->offset(), t->size(), t->space(),
+                  t->byte_alignment(), t->order(),
+                  t->aligned().ToString().c_str(),
+                  t->stride().ToString().c_str(),
+                  t->ref(), t->placement());
+  };
+  for (Tensor *t : network->globals()) add(t);
+  for (Tensor *t : network->parameters()) add(t);
+  return layout;
+}
+
+int JITCache::FindModule(const void *address, uint64 *offset) {
+  // Find module containing address.
+  ModuleSearch search;
+  search.address = static_cast<const char *>(address);
+  if (dl_iterate_phdr(FindModuleCallback, &search) == 0) return -1;
+  *offset = search.address - search.base;
+
+  // Return index of existing module.
+  for (int i = 0; i < modules_.size(); ++i) {
+    if (modules_[i].name == search.name) return i;
+  }
+
+  // Add new module.
+  Module module;
+  if (!GetModuleInfo(search.name, &module)) return -1;
+  modules_.push_back(module);
+  return modules_.size() - 1;
+}
+
+char *JITCache::ModuleBase(const Module &module) {
+  // Check that module has not changed.
+  Module current;
+  if (!GetModuleInfo(module.name, &current)) return nullptr;
+  if (current.size != module.size) return nullptr;
+  if (current.mtime != module.mtime) return nullptr;
+
+  // Find base address for module.
+  BaseSearch search;
+  search.name = module.name.c_str();
+  dl_iterate_phdr(FindBaseCallback, &search);
+  return search.found ? search.base : nullptr;
+}
+
+bool JITCache::GetModuleInfo(const string &name, Module *module) {
+  // The main program does not have a name.
+  string filename = name.empty() ? "/proc/self/exe" : name;
+  FileStat stat;
+  if (!File::Stat(filename, &stat).ok()) return false;
+  module->name = name;
+  module->size = stat.size;
+  module->mtime = stat.mtime;
+  return true;
+}
+
+}  // namespace myelin
+}  // namespace sling
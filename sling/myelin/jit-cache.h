@@ -0,0 +1,171 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_MYELIN_JIT_CACHE_H_
+#define SLING_MYELIN_JIT_CACHE_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sling/base/types.h"
+#include "sling/myelin/compute.h"
+#include "sling/myelin/flow.h"
+
+namespace sling {
+namespace myelin {
+
+// Persistent on-disk cache for compiled networks. The cache is keyed by a
+// fingerprint of the input flow, the CPU features, the compiler options, the
+// runtime, the kernel library, and the binary containing the compiler. A cache entry
+// consists of two files in the cache directory:
+//
+//   <key>.flow  the analyzed flow after all transformations
+//   <key>.jit   the generated code for each cell with relocations for
+//               external references, and the tensor layouts
+//
+// On a cache hit, the analyzed flow is compiled instead of the input flow, so
+// the flow analysis and transformations are skipped. The cache acts as linker
+// for the network, so the code for the cells is loaded from the cache instead
+// of being generated. The tensor layouts are recomputed from the analyzed flow
+// and checked against the cached layouts before the cached code is used.
+//
+// Usage:
+//   JITCache cache(dir);
+//   cache.Initialize(flow, library, net);
+//   Flow cached;
+//   bool hit = cache.Load(&cached);
+//   if (!hit) flow.Analyze(library);
+//   net.set_linker(&cache);
+//   net.Compile(hit ? cached : flow, library);
+//   if (!hit) cache.Save(flow);
+class JITCache : public Linker {
+ public:
+  // Initialize cache in directory.
+  explicit JITCache(const string &dir) : dir_(dir) {}
+
+  // Compute the cache key for compiling the input flow into the network. This
+  // must be called before the flow is analyzed and after the runtime and
+  // options have been set for the network. The settings are compiler settings
+  // that change the analyzed flow but are not part of the network options.
+  void Initialize(const Flow &flow,
+                  const Library &library,
+                  const Network &network,
+                  const string &settings = "");
+
+  // Load cached analyzed flow. Returns false if the flow is not in the cache.
+  bool Load(Flow *flow);
+
+  // Save analyzed flow and the code generated for the network to the cache.
+  // Returns false if the code cannot be cached, e.g. because it has
+  // references to data that cannot be relocated.
+  bool Save(const Flow &flow);
+
+  // Linker interface.
+  void BeginNetwork(Network *network) override;
+  bool LoadCell(Cell *cell, jit::Code *code) override;
+  void EndCell(Cell *cell,
+               jit::CodeGenerator *generator,
+               jit::Code *code,
+               int data_size) override;
+
+  // Cache key.
+  uint64 key() const { return key_; }
+
+  // Check if code was loaded from the cache.
+  bool hit() const { return hit_; }
+
+  // Check if network can be compiled with the JIT cache.
+  static bool Supported(const Network &network);
+
+ private:
+  // Reference to code or data outside the code block.
+  struct Relocation {
+    enum Kind {TENSOR, MODULE};
+    Kind kind;                     // kind of reference
+    string symbol;                 // tensor name for tensor references
+    int module;                    // module index for module references
+    uint64 offset;                 // offset in module for module references
+    std::vector<int> refs;         // offsets of absolute references in code
+  };
+
+  // Generated code for cell.
+  struct CellCode {
+    string name;                   // cell name
+    string code;                   // code and static data for cell
+    std::vector<Relocation> relocs;  // relocations for code
+  };
+
+  // Loaded shared object or executable that code refers to.
+  struct Module {
+    string name;                   // module name (empty for main program)
+    uint64 size = 0;               // file size of module
+    int64 mtime = 0;               // modification time of module
+  };
+
+  // Return file name for cache entry with extension.
+  string FileName(const char *ext) const;
+
+  // Return layout signature for all tensors in network.
+  static string Layout(Network *network);
+
+  // Find module containing address. Returns the module index, or -1 if the
+  // address is not in any loaded module.
+  int FindModule(const void *address, uint64 *offset);
+
+  // Find base address for module. Returns null if the module is not loaded or
+  // has changed since the cache entry was saved.
+  static char *ModuleBase(const Module &module);
+
+  // Get file information for module.
+  static bool GetModuleInfo(const string &name, Module *module);
+
+  // Cache directory.
+  string dir_;
+
+  // Cache key for flow.
+  uint64 key_ = 0;
+
+  // Network being compiled.
+  Network *network_ = nullptr;
+
+  // Set if code has been loaded from cache.
+  bool hit_ = false;
+
+  // Set if the code cannot be cached.
+  bool uncacheable_ = false;
+
+  // Tensor layout for cached network, and a flag set when the layout of the
+  // network being compiled has been checked against it.
+  string layout_;
+  bool layout_checked_ = false;
+  bool layout_matches_ = false;
+
+  // Code for cells.
+  std::vector<CellCode> cells_;
+
+  // Modules referenced by code.
+  std::vector<Module> modules_;
+
+  // Task assignments, initialization, and unused variables which are not
+  // stored in the flow file.
+  std::vector<std::pair<string, int>> tasks_;
+  std::vector<std::pair<string, int>> inits_;
+  std::vector<std::pair<string, string>> unused_;
+};
+
+}  // namespace myelin
+}  // namespace sling
+
+#endif  // SLING_MYELIN_JIT_CACHE_H_
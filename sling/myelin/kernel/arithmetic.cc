@@ -245,8 +245,11 @@ struct Expression {
     // singular broadcasts are not used for computing the maximum size since
     // these can be broadcast to the vector size. Also, the expression is
     // eligible for sparse computation if there is only one sparse non-trivial
-    // input.
+    // input. Lazy assignments only update the elements selected by the
+    // sparsity bitmap, so these can also have dense inputs and do not need to
+    // be zero-preserving.
     bool assignment = step->outdegree() == 0;
+    bool lazy = step->type() == "Assign" && step->GetAttr("lazy", false);
     int elements = prototype->elements();
     bool single_bcast = false;
     bool sparse = false;
@@ -275,8 +278,8 @@ struct Expression {
       if (common < elements) elements = common;
     }
 
-    // Sparse and dense inputs cannot be mixed.
-    if (dense) sparse = false;
+    // Sparse and dense inputs cannot be mixed, except for lazy assignments.
+    if (dense && !lazy) sparse = false;
 
     // Compile expression to be computed.
     InitExpression(step, &expr);
@@ -295,7 +298,7 @@ struct Expression {
           var->unhoistable = true;
         }
       }
-    } else if (sparse) {
+    } else if (sparse && !lazy) {
       // Check if expression supports sparse assignment/computation.
       if (assignment) {
         if (!expr.SparseAssignCompatible()) sparse = false;
@@ -313,7 +316,7 @@ struct Expression {
     generator->Initialize(expr, type, spare_regs, &index);
 
     // Enable sparse iterators in index generator.
-    if (sparse) index.EnableSparse(bitmap);
+    if (sparse && index.EnableSparse(bitmap)) sparsity = bitmap;
   }
 
   ~Expression() { delete generator; }
@@ -377,6 +380,9 @@ struct Expression {
   // Representative output (or input) from expression.
   Tensor *prototype;
 
+  // Sparsity bitmap for sparse iteration, or null for dense iteration.
+  Tensor *sparsity = nullptr;
+
   // Expression to be compiled.
   Express expr;
 
@@ -1063,6 +1069,13 @@ class Calculate : public Kernel {
       // Link output reference to assignment target.
       if (step->outdegree() == 1) {
         step->input(0)->Link(step->output(0));
+
+        // The output of a lazy sparse assignment is only up to date for the
+        // elements in the sparsity bitmap, so consumers should use the same
+        // bitmap.
+        if (expression.sparsity != nullptr && step->GetAttr("lazy", false)) {
+          step->output(0)->set_sparse(expression.sparsity);
+        }
       }
     } else {
       // Enable sharing of inputs and outputs.
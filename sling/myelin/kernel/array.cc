@@ -800,6 +800,24 @@ class MultiGather : public Kernel {
     Register input = masm->rr().alloc();
     Register embeddings = masm->rr().alloc();
 
+    // Split large gathers into partitions over the feature indices which are
+    // copied in parallel. The cost is estimated by the number of bytes copied.
+    int n = f->elements();
+    int64 bytes = static_cast<int64>(M->stride(0)) * n;
+    int partitions = masm->Partitions(bytes, n);
+    int chunk = (n + partitions - 1) / partitions;
+    Register end = no_reg;
+    Label entry, done;
+    if (partitions > 1) {
+      partitions = (n + chunk - 1) / chunk;
+      step->set_variant("|" + std::to_string(partitions));
+      end = masm->rr().alloc();
+      __ ParallelFor(partitions, &entry);
+      __ jmp(&done);
+      __ bind(&entry);
+      __ BeginPartition(index);
+    }
+
     // Load tensor locations.
     __ LoadTensorAddress(embeddings, M);
     __ LoadTensorAddress(input, f);
@@ -807,7 +825,18 @@ class MultiGather : public Kernel {
 
     // Loop over all feature indices.
     Label l;
-    __ xorq(index, index);
+    if (partitions > 1) {
+      // Compute range of feature indices for partition.
+      __ imulq(index, index, Immediate(chunk));
+      __ imulq(acc, index, Immediate(M->stride(0)));
+      __ addq(dst, acc);
+      __ leaq(end, Operand(index, chunk));
+      __ movq(acc, Immediate(n));
+      __ cmpq(end, acc);
+      __ cmovq(greater, end, acc);
+    } else {
+      __ xorq(index, index);
+    }
     __ bind(&l);
 
     // Get feature index.
@@ -840,8 +869,18 @@ class MultiGather : public Kernel {
 
     // Next feature index.
     __ incq(index);
-    __ cmpq(index, Immediate(f->elements()));
+    if (partitions > 1) {
+      __ cmpq(index, end);
+    } else {
+      __ cmpq(index, Immediate(f->elements()));
+    }
     __ j(less, &l);
+
+    // End of partition function.
+    if (partitions > 1) {
+      __ EndPartition();
+      __ bind(&done);
+    }
   }
 
   int64 Complexity(const Step *step) override {
@@ -0,0 +1,619 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "sling/myelin/compute.h"
+#include "sling/myelin/macro-assembler.h"
+
+#define __ masm->
+
+namespace sling {
+namespace myelin {
+
+using namespace jit;
+
+// Kernels for matrices stored as 16-bit floating point numbers. Both IEEE
+// half precision (float16) and bfloat16 are supported. The matrix elements are
+// converted to float when they are loaded, and all arithmetic is done in float,
+// so only the memory bandwidth for the matrix is reduced. Half precision
+// numbers are converted with the F16C instructions, and bfloat16 numbers,
+// which are the upper 16 bits of a float, are converted by zero extension and
+// shifting.
+
+// Number of floats in an AVX register.
+static const int kVecSize = 8;
+
+// Check if CPU supports conversion of 16-bit floating point type to float.
+static bool SupportsHalf(Type type) {
+  switch (type) {
+    case DT_HALF: return CPU::Enabled(AVX) && CPU::Enabled(F16C);
+    case DT_BFLOAT16: return CPU::Enabled(AVX2);
+    default: return false;
+  }
+}
+
+// Kernel name prefix for 16-bit floating point type.
+static string HalfName(Type type) {
+  return type == DT_HALF ? "AVXHalf" : "AVXBf16";
+}
+
+// Load eight 16-bit floating point numbers and convert them to float.
+static void LoadHalf(MacroAssembler *masm, Type type,
+                     YMMRegister dst, const Operand &src) {
+  if (type == DT_HALF) {
+    __ vcvtph2ps(dst, src);
+  } else {
+    __ vpmovzxwd(dst, src);
+    __ vpslld(dst, dst, 16);
+  }
+}
+
+// Load one 16-bit floating point number and convert it to float.
+static void LoadHalfScalar(MacroAssembler *masm, Type type,
+                           XMMRegister dst, Register tmp,
+                           const Operand &src) {
+  __ movzxwl(tmp, src);
+  if (type == DT_HALF) {
+    __ vmovd(dst, tmp);
+    __ vcvtph2ps(dst, dst);
+  } else {
+    __ shll(tmp, Immediate(16));
+    __ vmovd(dst, tmp);
+  }
+}
+
+// Vector-matrix multiplication with 16-bit floating point matrix, y=x*W with
+// optional bias and relu.
+class AVXHalfVecMatMul : public Kernel {
+ public:
+  // Maximum number of column blocks computed in parallel.
+  static const int kMaxUnrolls = 4;
+
+  AVXHalfVecMatMul(Type type, bool bias, bool relu)
+      : type_(type), bias_(bias), relu_(relu) {}
+
+  string Name() override { return HalfName(type_) + "VecMatMul" + Suffix(); }
+  string Operation() override { return "MatMul" + Suffix(); }
+
+  bool Supports(Step *step) override {
+    // Requires CPU with conversion instructions.
+    if (!SupportsHalf(type_)) return false;
+
+    // Two or three 2D tensor inputs and one 2D tensor output.
+    if (step->indegree() != (bias_ ? 3 : 2)) return false;
+    if (step->outdegree() != 1) return false;
+    Tensor *x = step->input(0);
+    Tensor *W = step->input(1);
+    Tensor *y = step->output(0);
+    if (x->rank() != 2 || x->type() != DT_FLOAT) return false;
+    if (W->rank() != 2 || W->type() != type_) return false;
+    if (y->rank() != 2 || y->type() != DT_FLOAT) return false;
+
+    // Check shape. First input must be a row vector.
+    if (x->dim(0) != 1 || x->dim(1) != W->dim(0)) return false;
+    if (y->dim(0) != 1 || y->dim(1) != W->dim(1)) return false;
+
+    // The matrix must be row-major.
+    if (!W->SupportsOrder(ROW_MAJOR)) return false;
+
+    // Transpose not supported.
+    if (step->GetAttr("transpose_a", false)) return false;
+    if (step->GetAttr("transpose_b", false)) return false;
+    if (step->GetAttr("transpose_c", false)) return false;
+
+    // Check bias vector.
+    if (bias_) {
+      Tensor *b = step->input(2);
+      if (b->type() != DT_FLOAT) return false;
+      if (b->elements() != y->dim(1)) return false;
+      if (b->rank() == 2 && b->dim(0) != 1) return false;
+      if (b->rank() > 2) return false;
+    }
+
+    return true;
+  }
+
+  void Adjust(Step *step) override {
+    step->input(1)->RequireOrder(ROW_MAJOR);
+  }
+
+  void Generate(Step *step, MacroAssembler *masm) override {
+    Registers &rr = masm->rr();
+    SIMDRegisters &mm = masm->mm();
+    Label l1, l2, l3, l4;
+
+    // Get input and output tensors.
+    Tensor *x = step->input(0);
+    Tensor *W = step->input(1);
+    Tensor *b = bias_ ? step->input(2) : nullptr;
+    Tensor *y = step->output(0);
+    bool fma = masm->Enabled(FMA3);
+
+    // Get matrix dimensions.
+    int rows = W->dim(0);
+    int cols = W->dim(1);
+    int main_cols = (cols / kVecSize) * kVecSize;
+    int remaining_cols = cols - main_cols;
+    int dsize = sizeof(uint16);
+
+    // Compute the number of unrolls.
+    int unrolls = 0;
+    for (int i = 1; i <= kMaxUnrolls; ++i) {
+      int batch_size = i * kVecSize;
+      if (main_cols >= batch_size && main_cols % batch_size == 0) unrolls = i;
+    }
+    string variant = "U" + std::to_string(unrolls);
+    if (remaining_cols > 0) variant += "R" + std::to_string(remaining_cols);
+    step->set_variant(variant);
+
+    // Allocate general registers.
+    Register rowofs = rr.alloc();
+    Register colofs = rr.alloc();
+    Register m = rr.alloc();
+    Register matrix = rr.alloc();
+    Register input = rr.alloc();
+    Register output = rr.alloc();
+    Register vector = bias_ ? rr.alloc() : no_reg;
+    Register tmp = rr.alloc();
+
+    // Allocate SIMD registers.
+    std::vector<YMMRegister> sum;
+    std::vector<YMMRegister> w;
+    for (int i = 0; i < std::max(unrolls, 1); ++i) {
+      sum.push_back(mm.allocy());
+      w.push_back(mm.allocy());
+    }
+    YMMRegister elem = mm.allocy();
+    YMMRegister zero = relu_ ? mm.allocy() : no_ymm_reg;
+
+    // Load tensor locations.
+    __ LoadTensorAddress(input, x);
+    __ LoadTensorAddress(matrix, W);
+    if (bias_) __ LoadTensorAddress(vector, b);
+    __ LoadTensorAddress(output, y);
+    if (relu_) __ vxorps(zero, zero, zero);
+
+    // Compute main columns.
+    if (unrolls > 0) {
+      // Outer loop over matrix column blocks.
+      __ xorq(colofs, colofs);
+      __ LoopStart(&l1);
+      for (int i = 0; i < unrolls; ++i) {
+        __ vxorps(sum[i], sum[i], sum[i]);
+      }
+      __ movq(m, matrix);
+      __ xorq(rowofs, rowofs);
+
+      // Inner loop over rows.
+      __ LoopStart(&l2);
+      __ vbroadcastss(elem, Operand(input, rowofs));
+      for (int i = 0; i < unrolls; ++i) {
+        LoadHalf(masm, type_, w[i], Operand(m, i * kVecSize * dsize));
+        if (fma) {
+          __ vfmadd231ps(sum[i], elem, w[i]);
+        } else {
+          __ vmulps(w[i], w[i], elem);
+          __ vaddps(sum[i], sum[i], w[i]);
+        }
+      }
+      __ addq(m, Immediate(W->stride(0)));
+      __ addq(rowofs, Immediate(sizeof(float)));
+      __ cmpq(rowofs, Immediate(rows * sizeof(float)));
+      __ j(less, &l2);
+
+      // Save to y[col:col+n].
+      for (int i = 0; i < unrolls; ++i) {
+        int disp = i * kVecSize * sizeof(float);
+        if (bias_) {
+          __ vaddps(sum[i], sum[i], Operand(vector, colofs, times_1, disp));
+        }
+        if (relu_) {
+          __ vmaxps(sum[i], sum[i], zero);
+        }
+        __ vmovups(Operand(output, colofs, times_1, disp), sum[i]);
+      }
+
+      // Next matrix column block.
+      __ addq(matrix, Immediate(unrolls * kVecSize * dsize));
+      __ addq(colofs, Immediate(unrolls * kVecSize * sizeof(float)));
+      __ cmpq(colofs, Immediate(main_cols * sizeof(float)));
+      __ j(less, &l1);
+    }
+
+    // Compute remaining columns one at a time.
+    if (remaining_cols > 0) {
+      XMMRegister acc = sum[0].xmm();
+      XMMRegister val = w[0].xmm();
+      __ movq(colofs, Immediate(main_cols * sizeof(float)));
+      __ LoopStart(&l3);
+      __ vxorps(acc, acc, acc);
+      __ movq(m, matrix);
+      __ xorq(rowofs, rowofs);
+
+      // Inner loop over rows.
+      __ LoopStart(&l4);
+      LoadHalfScalar(masm, type_, val, tmp, Operand(m));
+      if (fma) {
+        __ vfmadd231ss(acc, val, Operand(input, rowofs));
+      } else {
+        __ vmulss(val, val, Operand(input, rowofs));
+        __ vaddss(acc, acc, val);
+      }
+      __ addq(m, Immediate(W->stride(0)));
+      __ addq(rowofs, Immediate(sizeof(float)));
+      __ cmpq(rowofs, Immediate(rows * sizeof(float)));
+      __ j(less, &l4);
+
+      // Save to y[col].
+      if (bias_) __ vaddss(acc, acc, Operand(vector, colofs));
+      if (relu_) __ vmaxss(acc, acc, zero.xmm());
+      __ vmovss(Operand(output, colofs), acc);
+
+      // Next column.
+      __ addq(matrix, Immediate(dsize));
+      __ addq(colofs, Immediate(sizeof(float)));
+      __ cmpq(colofs, Immediate(cols * sizeof(float)));
+      __ j(less, &l3);
+    }
+  }
+
+  int64 Complexity(const Step *step) override {
+    int64 ops = step->input(1)->elements() * 2;
+    if (bias_) ops += step->output(0)->elements();
+    if (relu_) ops += step->output(0)->elements();
+    return ops;
+  }
+
+ private:
+  // Kernel name and operation suffix.
+  string Suffix() const {
+    string suffix;
+    if (bias_) suffix += "Add";
+    if (relu_) suffix += "Relu";
+    return suffix;
+  }
+
+  Type type_;    // matrix element type
+  bool bias_;    // add bias vector to result, y=Wx+b
+  bool relu_;    // apply rectified linear unit, y=max(0,Wx+b)
+};
+
+// Look up features in 16-bit floating point embedding matrix and output the
+// embedding vectors, or the sum or average of the embedding vectors, as floats.
+// Like the float kernels, the feature list is terminated by the first negative
+// feature after the first non-negative feature.
+class AVXHalfGather : public Kernel {
+ public:
+  // Pooling operations.
+  enum Pooling {NONE, SUM, AVG};
+
+  // Maximum number of column blocks computed in parallel.
+  static const int kMaxUnrolls = 4;
+
+  AVXHalfGather(Type type, Pooling pooling) : type_(type), pooling_(pooling) {}
+
+  string Name() override { return HalfName(type_) + Operation(); }
+  string Operation() override {
+    switch (pooling_) {
+      case NONE: return "Gather";
+      case SUM: return "GatherSum";
+      case AVG: return "GatherAvg";
+      default: return "???";
+    }
+  }
+
+  bool Supports(Step *step) override {
+    // Requires CPU with conversion instructions.
+    if (!SupportsHalf(type_)) return false;
+
+    // Check inputs and outputs.
+    if (step->indegree() != 2 || step->outdegree() != 1) return false;
+    Tensor *M = step->input(0);
+    Tensor *f = step->input(1);
+    Tensor *v = step->output(0);
+    if (M->type() != type_ || M->rank() != 2) return false;
+    if (f->type() != DT_INT32) return false;
+    if (v->type() != DT_FLOAT) return false;
+    if (pooling_ == NONE) {
+      int r = v->rank() - 1;
+      if (r < 0) return false;
+      if (v->shape().outer(r) != f->elements()) return false;
+      if (v->shape().inner(r) != M->dim(1)) return false;
+    } else {
+      if (f->rank() != 2) return false;
+      if (v->elements() != M->dim(1)) return false;
+    }
+
+    return true;
+  }
+
+  void Adjust(Step *step) override {
+    // Embedding matrix must be row-major and output must be dense.
+    step->input(0)->RequireOrder(ROW_MAJOR);
+    step->output(0)->RequireDense();
+    step->output(0)->RequireStandardOrder();
+  }
+
+  void Generate(Step *step, MacroAssembler *masm) override {
+    Registers &rr = masm->rr();
+    SIMDRegisters &mm = masm->mm();
+
+    // Get inputs and outputs.
+    Tensor *M = step->input(0);
+    Tensor *f = step->input(1);
+    Tensor *v = step->output(0);
+    int dims = M->dim(1);
+    int main_cols = (dims / kVecSize) * kVecSize;
+    int remaining_cols = dims - main_cols;
+    int chunk = kMaxUnrolls * kVecSize;
+    int chunks = main_cols / chunk;
+    int tail = (main_cols % chunk) / kVecSize;
+    step->set_variant("C" + std::to_string(chunks) +
+                      "T" + std::to_string(tail) +
+                      "R" + std::to_string(remaining_cols));
+
+    // Allocate registers.
+    Register acc = rr.alloc();
+    Register col = rr.alloc();
+    Register fidx = rr.alloc();
+    Register fcnt = rr.alloc();
+    Register embeddings = rr.alloc();
+    Register input = rr.alloc();
+    Register output = rr.alloc();
+    Register tmp = rr.alloc();
+    std::vector<YMMRegister> sum;
+    for (int i = 0; i < kMaxUnrolls + remaining_cols; ++i) {
+      sum.push_back(mm.allocy());
+    }
+    YMMRegister elem = mm.allocy();
+    YMMRegister scale = mm.allocy();
+
+    // Load tensor locations.
+    __ LoadTensorAddress(embeddings, M);
+    __ LoadTensorAddress(input, f);
+    __ LoadTensorAddress(output, v);
+
+    if (pooling_ == NONE) {
+      // Loop over features.
+      Label l1, l2, l3;
+      __ xorq(fidx, fidx);
+      __ LoopStart(&l1);
+      __ movsxlq(acc, Operand(input, fidx, times_4));
+      __ testq(acc, acc);
+      __ j(negative, &l2);
+
+      // Convert embedding vector for feature.
+      __ Multiply(acc, M->stride(0));
+      __ addq(acc, embeddings);
+      GenerateColumns(masm, acc, col, tmp, sum, elem, chunks, tail,
+                      remaining_cols, [&](int i, int disp, bool scalar) {
+        if (scalar) {
+          __ vmovss(Operand(output, col, times_4, disp), sum[i].xmm());
+        } else {
+          __ vmovups(Operand(output, col, times_4, disp), sum[i]);
+        }
+      });
+      __ jmp(&l3);
+
+      // Output zero vector for negative features.
+      __ bind(&l2);
+      __ vxorps(elem, elem, elem);
+      for (int i = 0; i < main_cols / kVecSize; ++i) {
+        __ vmovups(Operand(output, i * kVecSize * sizeof(float)), elem);
+      }
+      for (int i = 0; i < remaining_cols; ++i) {
+        __ vmovss(Operand(output, (main_cols + i) * sizeof(float)), elem.xmm());
+      }
+
+      // Next feature.
+      __ bind(&l3);
+      __ addq(output, Immediate(dims * sizeof(float)));
+      __ incq(fidx);
+      __ cmpq(fidx, Immediate(f->elements()));
+      __ j(less, &l1);
+    } else {
+      // Loop over column chunks, and for each chunk loop over the features.
+      auto store = [&](int i, int disp, bool scalar) {
+        if (scalar) {
+          if (pooling_ == AVG) {
+            __ vdivss(sum[i].xmm(), sum[i].xmm(), scale.xmm());
+          }
+          __ vmovss(Operand(output, col, times_4, disp), sum[i].xmm());
+        } else {
+          if (pooling_ == AVG) __ vdivps(sum[i], sum[i], scale);
+          __ vmovups(Operand(output, col, times_4, disp), sum[i]);
+        }
+      };
+
+      // Full chunks.
+      if (chunks > 0) {
+        Label l1;
+        __ xorq(col, col);
+        __ LoopStart(&l1);
+        GeneratePooling(masm, kMaxUnrolls, 0, acc, col, fidx, fcnt, tmp,
+                        embeddings, input, f->elements(), sum, elem, scale,
+                        M->stride(0), store);
+        __ addq(col, Immediate(chunk));
+        __ cmpq(col, Immediate(chunks * chunk));
+        __ j(less, &l1);
+      }
+
+      // Tail chunk with the remaining blocks and columns.
+      if (tail > 0 || remaining_cols > 0) {
+        __ movq(col, Immediate(chunks * chunk));
+        GeneratePooling(masm, tail, remaining_cols, acc, col, fidx, fcnt, tmp,
+                        embeddings, input, f->elements(), sum, elem, scale,
+                        M->stride(0), store);
+      }
+    }
+  }
+
+  int64 Complexity(const Step *step) override {
+    return step->input(0)->dim(1) * step->input(1)->elements();
+  }
+
+ private:
+  // Callback for emitting code for a converted block or column. The first
+  // argument is the sum register index, the second is the displacement of the
+  // output relative to the current column, and the third argument is true for
+  // single columns.
+  typedef std::function<void(int, int, bool)> Emitter;
+
+  // Convert the columns of the embedding vector at src to float, and call the
+  // emitter for each block and remaining column. The chunks are processed in a
+  // loop and the tail blocks and remaining columns are unrolled.
+  void GenerateColumns(MacroAssembler *masm, Register src, Register col,
+                       Register tmp, const std::vector<YMMRegister> &sum,
+                       YMMRegister elem, int chunks, int tail, int remaining,
+                       const Emitter &emit) {
+    int chunk = kMaxUnrolls * kVecSize;
+    if (chunks > 0) {
+      Label l1;
+      __ xorq(col, col);
+      __ LoopStart(&l1);
+      for (int i = 0; i < kMaxUnrolls; ++i) {
+        int ofs = i * kVecSize;
+        LoadHalf(masm, type_, sum[i],
+                 Operand(src, col, times_2, ofs * sizeof(uint16)));
+        emit(i, ofs * sizeof(float), false);
+      }
+      __ addq(col, Immediate(chunk));
+      __ cmpq(col, Immediate(chunks * chunk));
+      __ j(less, &l1);
+    }
+    __ movq(col, Immediate(chunks * chunk));
+    for (int i = 0; i < tail; ++i) {
+      int ofs = i * kVecSize;
+      LoadHalf(masm, type_, sum[i],
+               Operand(src, col, times_2, ofs * sizeof(uint16)));
+      emit(i, ofs * sizeof(float), false);
+    }
+    for (int i = 0; i < remaining; ++i) {
+      int ofs = tail * kVecSize + i;
+      LoadHalfScalar(masm, type_, sum[i].xmm(), tmp,
+                     Operand(src, col, times_2, ofs * sizeof(uint16)));
+      emit(i, ofs * sizeof(float), true);
+    }
+  }
+
+  // Sum the embedding vectors for the features for a chunk of blocks and
+  // single columns starting at the current column.
+  void GeneratePooling(MacroAssembler *masm, int blocks, int singles,
+                       Register acc, Register col, Register fidx,
+                       Register fcnt, Register tmp, Register embeddings,
+                       Register input, int num_features,
+                       const std::vector<YMMRegister> &sum,
+                       YMMRegister elem, YMMRegister scale, int row_size,
+                       const Emitter &store) {
+    // Clear sums. The single columns use the registers after the blocks.
+    for (int i = 0; i < blocks + singles; ++i) {
+      __ vxorps(sum[i], sum[i], sum[i]);
+    }
+    __ xorq(fidx, fidx);
+    __ xorq(fcnt, fcnt);
+
+    // Loop over features.
+    Label l1, l2, l3, done;
+    __ LoopStart(&l1);
+    __ movsxlq(acc, Operand(input, fidx, times_4));
+    __ testq(acc, acc);
+    __ j(positive, &l2);
+
+    // Skip leading negative features and stop at the first negative feature
+    // after that.
+    __ testq(fcnt, fcnt);
+    __ j(not_zero, &done);
+    __ jmp(&l3);
+
+    // Add embedding vector for feature to sums.
+    __ bind(&l2);
+    __ incq(fcnt);
+    __ Multiply(acc, row_size);
+    __ addq(acc, embeddings);
+    for (int i = 0; i < blocks; ++i) {
+      int ofs = i * kVecSize;
+      LoadHalf(masm, type_, elem,
+               Operand(acc, col, times_2, ofs * sizeof(uint16)));
+      __ vaddps(sum[i], sum[i], elem);
+    }
+    for (int i = 0; i < singles; ++i) {
+      int ofs = blocks * kVecSize + i;
+      LoadHalfScalar(masm, type_, elem.xmm(), tmp,
+                     Operand(acc, col, times_2, ofs * sizeof(uint16)));
+      __ vaddss(sum[blocks + i].xmm(), sum[blocks + i].xmm(), elem.xmm());
+    }
+
+    // Next feature.
+    __ bind(&l3);
+    __ incq(fidx);
+    __ cmpq(fidx, Immediate(num_features));
+    __ j(less, &l1);
+    __ bind(&done);
+
+    // Compute divisor for average. The output is zero if there are no
+    // features.
+    if (pooling_ == AVG) {
+      Label l4;
+      __ testq(fcnt, fcnt);
+      __ j(not_zero, &l4);
+      __ incq(fcnt);
+      __ bind(&l4);
+      __ vcvtqsi2ss(scale.xmm(), scale.xmm(), fcnt);
+      __ vbroadcastss(scale, scale);
+    }
+
+    // Store sums.
+    for (int i = 0; i < blocks; ++i) {
+      store(i, i * kVecSize * sizeof(float), false);
+    }
+    for (int i = 0; i < singles; ++i) {
+      store(blocks + i, (blocks * kVecSize + i) * sizeof(float), true);
+    }
+  }
+
+  Type type_;         // embedding element type
+  Pooling pooling_;   // pooling operation for combining vectors
+};
+
+void RegisterAVXHalf(Library *library) {
+  for (Type type : {DT_HALF, DT_BFLOAT16}) {
+    // Computes  : y = x * W (+ b) (relu)
+    // Input     : x: float32[1,n]
+    //             W: float16/bfloat16[n,m] row-major
+    //             b: float32[1,m]
+    // Output    : y: float32[1,m]
+    // Requires  : AVX, F16C (float16) or AVX2 (bfloat16)
+    // Supports  : FMA3
+    library->Register(new AVXHalfVecMatMul(type, false, false));
+    library->Register(new AVXHalfVecMatMul(type, true, false));
+    library->Register(new AVXHalfVecMatMul(type, false, true));
+    library->Register(new AVXHalfVecMatMul(type, true, true));
+
+    // Computes  : v = M[f] or v = sum/avg(M[f])
+    // Input     : M: float16/bfloat16[k,n] row-major
+    //             f: int32[1,m]
+    // Output    : v: float32[m,n] or float32[n]
+    // Requires  : AVX, F16C (float16) or AVX2 (bfloat16)
+    library->Register(new AVXHalfGather(type, AVXHalfGather::NONE));
+    library->Register(new AVXHalfGather(type, AVXHalfGather::SUM));
+    library->Register(new AVXHalfGather(type, AVXHalfGather::AVG));
+  }
+}
+
+}  // namespace myelin
+}  // namespace sling
+
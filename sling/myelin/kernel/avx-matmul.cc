@@ -1430,6 +1430,144 @@ class AVXIntVecMatMulAddReluH : public AVXIntVecMatMulHBase {
   string Operation() override { return "MatMulAddRelu"; }
 };
 
+// Integer vector-matrix multiplication with 32-bit accumulation for CPUs with
+// AVX2. This is used for quantized matrix multiplication where the elements of
+// the input and the matrix are in the range [-127,127]. The sign of the input
+// is moved over to the matrix so the products can be computed with unsigned by
+// signed byte multiplication without saturating the 16-bit pair sums.
+class AVXIntVecMatMulI32 : public AVXVecMatMulBase {
+ public:
+  AVXIntVecMatMulI32()
+      : AVXVecMatMulBase(false, false, COLUMN_MAJOR, DT_INT8, DT_INT32) {}
+
+  string Name() override { return "AVXIntVecMatMulI32"; }
+  string Operation() override { return "MatMul"; }
+
+  bool Supports(Step *step) override {
+    // Requires CPU with AVX2 support.
+    if (!CPU::Enabled(AVX2)) return false;
+    return AVXVecMatMulBase::Supports(step);
+  }
+
+  void Adjust(Step *step) override {
+    // Get input and output tensors.
+    Tensor *x = step->input(0);
+    Tensor *W = step->input(1);
+
+    // Align to one ymm register (256 bits, 32 bytes).
+    int byte_alignment = 256 / 8;
+    x->SetMiniumAlignment(byte_alignment);
+    W->SetMiniumAlignment(byte_alignment);
+
+    W->RequireOrder(COLUMN_MAJOR);
+    x->MinAlign({1, 32});
+    W->MinAlign({32, 1});
+  }
+
+  void Generate(Step *step, MacroAssembler *masm) override {
+    Registers &rr = masm->rr();
+    SIMDRegisters &mm = masm->mm();
+    Label l1, l2;
+
+    // Get input and output tensors.
+    Tensor *x = step->input(0);
+    Tensor *W = step->input(1);
+    Tensor *y = step->output(0);
+
+    // Get matrix dimensions.
+    int rows = W->dim(0);
+    int cols = W->dim(1);
+    int row_size = W->stride(1);
+    bool unroll = W->aligned(0) % 64 == 0;
+
+    // Allocate general registers.
+    Register acc = rr.alloc();
+    Register row = rr.alloc();
+    Register col = rr.alloc();
+    Register matrix = rr.alloc();
+    Register input = rr.alloc();
+    Register output = rr.alloc();
+
+    // Allocate SIMD registers.
+    YMMRegister ones = mm.allocy();
+    YMMRegister xval0 = mm.allocy();
+    YMMRegister wval0 = mm.allocy();
+    YMMRegister sum0 = mm.allocy();
+    YMMRegister xval1 = mm.allocy();
+    YMMRegister wval1 = mm.allocy();
+    YMMRegister sum1 = mm.allocy();
+
+    // Load tensor locations.
+    __ LoadTensorAddress(input, x);
+    __ LoadTensorAddress(matrix, W);
+    __ LoadTensorAddress(output, y);
+    __ vmovdqa(ones, masm->GetConstant<int16>(1, 16)->address());
+    __ xorq(col, col);
+
+    // Outer loop over columns.
+    __ LoopStart(&l1);
+    __ xorq(row, row);
+    __ vpxor(sum0, sum0, sum0);
+    if (unroll) {
+      __ vpxor(sum1, sum1, sum1);
+    }
+
+    // Inner loop over rows.
+    __ LoopStart(&l2);
+
+    // Load next 32 or 64 elements from x and W, and compute sign(x)*W and |x|.
+    __ vmovdqa(xval0, Operand(input, row));
+    __ vmovdqa(wval0, Operand(matrix, row));
+    __ vpsignb(wval0, wval0, xval0);
+    __ vpsignb(xval0, xval0, xval0);
+    if (unroll) {
+      __ vmovdqa(xval1, Operand(input, row, times_1, 32));
+      __ vmovdqa(wval1, Operand(matrix, row, times_1, 32));
+      __ vpsignb(wval1, wval1, xval1);
+      __ vpsignb(xval1, xval1, xval1);
+      __ addq(row, Immediate(64));
+    } else {
+      __ addq(row, Immediate(32));
+    }
+
+    // Multiply and add pairs into 16-bit integers and then add these pairwise
+    // into the 32-bit sums.
+    __ vpmaddubsw(xval0, xval0, wval0);
+    __ vpmaddwd(xval0, xval0, ones);
+    __ vpaddd(sum0, sum0, xval0);
+    if (unroll) {
+      __ vpmaddubsw(xval1, xval1, wval1);
+      __ vpmaddwd(xval1, xval1, ones);
+      __ vpaddd(sum1, sum1, xval1);
+    }
+
+    // Move to next row.
+    __ cmpq(row, Immediate(rows));
+    __ j(less, &l2);
+
+    // Add elements horizontally.
+    YMMRegister sum = sum0;
+    YMMRegister hi = wval0;
+    if (unroll) {
+      __ vpaddd(sum, sum0, sum1);
+    }
+    __ vperm2i128(hi, sum, sum, 1);
+    __ vpaddd(sum, sum, hi);
+    __ vphaddd(sum, sum, sum);
+    __ vphaddd(sum, sum, sum);
+
+    // Save to y[col].
+    __ movq(acc, sum.xmm());
+    __ movl(Operand(output, col, times_4), acc);
+
+    // Move to next column.
+    __ addq(col, Immediate(1));
+    __ addq(matrix, Immediate(row_size));
+    __ cmpq(col, Immediate(cols));
+    __ j(less, &l1);
+  }
+};
+
 void RegisterAVXMatMul(Library *library) {
   // Computes  : y = x * W
   // Input     : x: float32[1,n]
@@ -1495,6 +1633,13 @@ void RegisterAVXMatMul(Library *library) {
   // Requires  : AVX2
   library->Register(new AVXIntVecMatMulAddReluH());
 
+  // Computes  : y = x * W
+  // Input     : x: int8[1,n] in range [-127,127]
+  //             W: int8[n,m] column-major in range [-127,127]
+  // Output    : y: int32[1,m]
+  // Requires  : AVX2
+  library->Register(new AVXIntVecMatMulI32());
+
   // Computes  : c = a * c
   // Input     : a: float32[1,n]
   //             b: float32[n,1]
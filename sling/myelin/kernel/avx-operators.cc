@@ -301,6 +301,233 @@ class AVXIntSub : public AVXIntBinaryOperator {
   string Operation() override { return "Sub"; }
 };
 
+// Quantize float vector to 8-bit integers using AVX2, i.e. q = round(x * s)
+// clipped to the range [-127,127], where s is a scalar scaling factor. The
+// output is padded to 32 bytes, but the input is left dense, so the remaining
+// elements are loaded with a mask.
+class AVXQuantize : public Kernel {
+ public:
+  string Name() override { return "AVXQuantize"; }
+  string Operation() override { return "Quantize"; }
+
+  bool Supports(Step *step) override {
+    // Requires CPU with AVX2 support.
+    if (!CPU::Enabled(AVX2)) return false;
+
+    // Check inputs and outputs.
+    if (step->inputs().size() != 2) return false;
+    if (step->outputs().size() != 1) return false;
+    Tensor *x = step->input(0);
+    Tensor *s = step->input(1);
+    Tensor *q = step->output(0);
+
+    // Check types.
+    if (x->type() != DT_FLOAT) return false;
+    if (s->type() != DT_FLOAT || s->elements() != 1) return false;
+    if (q->type() != DT_INT8) return false;
+
+    // Only vectors are supported.
+    if (x->rank() < 1 || q->rank() != x->rank()) return false;
+    int n = x->dim(x->rank() - 1);
+    if (x->elements() != n || q->elements() != n) return false;
+
+    return true;
+  }
+
+  void Adjust(Step *step) override {
+    Tensor *x = step->input(0);
+    Tensor *q = step->output(0);
+
+    x->SetMiniumAlignment(sizeof(float));
+    q->MinAlignLast(32);
+    q->SetMiniumAlignment(32);
+  }
+
+  void Generate(Step *step, MacroAssembler *masm) override {
+    Registers &rr = masm->rr();
+    SIMDRegisters &mm = masm->mm();
+
+    Tensor *x = step->input(0);
+    Tensor *s = step->input(1);
+    Tensor *q = step->output(0);
+    int n = x->elements();
+    int blocks = n / 32;
+    int remaining = n % 32;
+
+    Register ofs = rr.alloc();
+    Register input = rr.alloc();
+    Register output = rr.alloc();
+    Register factor = rr.alloc();
+    YMMRegister scale = mm.allocy();
+    YMMRegister perm = mm.allocy();
+    YMMRegister lower = mm.allocy();
+    YMMRegister v[4];
+    for (int i = 0; i < 4; ++i) v[i] = mm.allocy();
+
+    // Load tensor locations and constants.
+    static const int32 permutation[8] = {0, 4, 1, 5, 2, 6, 3, 7};
+    __ LoadTensorAddress(input, x);
+    __ LoadTensorAddress(output, q);
+    __ LoadTensorAddress(factor, s);
+    __ vbroadcastss(scale, Operand(factor));
+    __ vmovdqa(perm, masm->GetData(permutation, sizeof(permutation))->address());
+    __ vmovdqa(lower, masm->GetConstant<int8>(-127, 32)->address());
+    __ xorq(ofs, ofs);
+
+    // Quantize 32 elements at a time.
+    if (blocks > 0) {
+      Label l;
+      __ LoopStart(&l);
+      for (int i = 0; i < 4; ++i) {
+        __ vmulps(v[i], scale, Operand(input, i * 32));
+      }
+      Pack(masm, v, scale, perm, lower, Operand(output, ofs));
+      __ addq(input, Immediate(32 * sizeof(float)));
+      __ addq(ofs, Immediate(32));
+      __ cmpq(ofs, Immediate(blocks * 32));
+      __ j(less, &l);
+    }
+
+    // Load the remaining elements with masks. The masked-out lanes are zero,
+    // and the output padding is overwritten with zeros.
+    if (remaining > 0) {
+      int32 mask[32];
+      for (int i = 0; i < 32; ++i) mask[i] = i < remaining ? -1 : 0;
+      Register masks = factor;
+      __ leaq(masks, masm->GetData(mask, sizeof(mask))->address());
+      for (int i = 0; i < 4; ++i) {
+        if (i * 8 < remaining) {
+          __ vmovdqa(v[i], Operand(masks, i * 32));
+          __ vmaskmovps(v[i], v[i], Operand(input, i * 32));
+          __ vmulps(v[i], v[i], scale);
+        } else {
+          __ vxorps(v[i], v[i], v[i]);
+        }
+      }
+      Pack(masm, v, scale, perm, lower, Operand(output, ofs));
+    }
+  }
+
+  // Round and convert four registers with scaled floats to 32 bytes and store
+  // them in the output.
+  static void Pack(MacroAssembler *masm, YMMRegister *v, YMMRegister tmp,
+                   YMMRegister perm, YMMRegister lower, const Operand &dst) {
+    for (int i = 0; i < 4; ++i) {
+      __ vroundps(v[i], v[i], round_nearest);
+      __ vcvttps2dq(v[i], v[i]);
+    }
+
+    // Pack integers into bytes with saturation. The packing is done within
+    // each 128-bit lane, so the 32-bit groups are permuted into order
+    // afterwards.
+    __ vpackssdw(v[0], v[0], v[1]);
+    __ vpackssdw(v[2], v[2], v[3]);
+    __ vpacksswb(v[0], v[0], v[2]);
+    __ vpermd(v[0], perm, v[0]);
+    __ vpmaxsb(v[0], v[0], lower);
+    __ vmovdqa(dst, v[0]);
+  }
+
+  int64 Complexity(const Step *step) override {
+    return step->input(0)->elements() * 2;
+  }
+};
+
+// Dequantize 32-bit integer vector using AVX, i.e. y = x * s element-wise,
+// where s is a float vector with scaling factors. The tensors are not padded,
+// so the remaining elements are loaded and stored with a mask.
+class AVXDequantize : public Kernel {
+ public:
+  string Name() override { return "AVXDequantize"; }
+  string Operation() override { return "Dequantize"; }
+
+  bool Supports(Step *step) override {
+    // Requires CPU with AVX support.
+    if (!CPU::Enabled(AVX)) return false;
+
+    // Check inputs and outputs.
+    if (step->inputs().size() != 2) return false;
+    if (step->outputs().size() != 1) return false;
+    Tensor *x = step->input(0);
+    Tensor *s = step->input(1);
+    Tensor *y = step->output(0);
+
+    // Check types.
+    if (x->type() != DT_INT32) return false;
+    if (s->type() != DT_FLOAT) return false;
+    if (y->type() != DT_FLOAT) return false;
+
+    // Only vectors are supported.
+    if (y->rank() < 1) return false;
+    int n = y->dim(y->rank() - 1);
+    if (y->elements() != n) return false;
+    if (x->elements() != n || x->dim(x->rank() - 1) != n) return false;
+    if (s->elements() != n || s->dim(s->rank() - 1) != n) return false;
+
+    return true;
+  }
+
+  void Adjust(Step *step) override {
+    step->input(0)->SetMiniumAlignment(sizeof(int32));
+    step->input(1)->SetMiniumAlignment(sizeof(float));
+    step->output(0)->SetMiniumAlignment(sizeof(float));
+  }
+
+  void Generate(Step *step, MacroAssembler *masm) override {
+    Registers &rr = masm->rr();
+    SIMDRegisters &mm = masm->mm();
+
+    Tensor *x = step->input(0);
+    Tensor *s = step->input(1);
+    Tensor *y = step->output(0);
+    int n = y->elements();
+    int blocks = n / 8;
+    int remaining = n % 8;
+
+    Register ofs = rr.alloc();
+    Register input = rr.alloc();
+    Register scale = rr.alloc();
+    Register output = rr.alloc();
+    YMMRegister elem = mm.allocy();
+    YMMRegister mask = mm.allocy();
+    YMMRegister factor = mm.allocy();
+
+    // Load tensor locations.
+    __ LoadTensorAddress(input, x);
+    __ LoadTensorAddress(scale, s);
+    __ LoadTensorAddress(output, y);
+    __ xorq(ofs, ofs);
+
+    // Compute y = float(x) * s for eight elements at a time.
+    if (blocks > 0) {
+      Label l;
+      __ LoopStart(&l);
+      __ vcvtdq2ps(elem, Operand(input, ofs));
+      __ vmulps(elem, elem, Operand(scale, ofs));
+      __ vmovups(Operand(output, ofs), elem);
+      __ addq(ofs, Immediate(8 * sizeof(float)));
+      __ cmpq(ofs, Immediate(blocks * 8 * sizeof(float)));
+      __ j(less, &l);
+    }
+
+    // Compute the remaining elements using masked loads and stores.
+    if (remaining > 0) {
+      int32 bits[8];
+      for (int i = 0; i < 8; ++i) bits[i] = i < remaining ? -1 : 0;
+      __ vmovdqa(mask, masm->GetData(bits, sizeof(bits))->address());
+      __ vmaskmovps(elem, mask, Operand(input, ofs));
+      __ vmaskmovps(factor, mask, Operand(scale, ofs));
+      __ vcvtdq2ps(elem, elem);
+      __ vmulps(elem, elem, factor);
+      __ vmaskmovps(Operand(output, ofs), mask, elem);
+    }
+  }
+
+  int64 Complexity(const Step *step) override {
+    return step->input(0)->elements() * 2;
+  }
+};
+
 void RegisterAVXOperators(Library *library) {
   // Computes  : c = a + b element-wise
   // Input     : a: float32[d1,...,dn]
@@ -336,6 +563,20 @@ void RegisterAVXOperators(Library *library) {
   // Output    : c: int8/16/32/64[d1,...,dn]
   // Requires  : AVX
   library->Register(new AVXIntSub());
+
+  // Computes  : q = min(max(round(x * s), -127), 127) element-wise
+  // Input     : x: float32[d1,...,dn]
+  //             s: float32 scalar
+  // Output    : q: int8[d1,...,dn]
+  // Requires  : AVX2
+  library->Register(new AVXQuantize());
+
+  // Computes  : y = x * s element-wise
+  // Input     : x: int32[d1,...,dn]
+  //             s: float32[d1,...,dn]
+  // Output    : y: float32[d1,...,dn]
+  // Requires  : AVX
+  library->Register(new AVXDequantize());
 }
 
 }  // namespace myelin
@@ -19,6 +19,9 @@
 namespace sling {
 namespace myelin {
 
+// avx-half.cc
+void RegisterAVXHalf(Library *library);
+
 // avx-math.cc
 void RegisterAVXMath(Library *library);
 
@@ -37,6 +40,7 @@ void RegisterAVXLibrary(Library *library) {
   RegisterSIMDMatMulLibrary(library);
   RegisterAVXMatMul(library);
   RegisterAVXOperators(library);
+  RegisterAVXHalf(library);
 }
 
 }  // namespace myelin
@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <functional>
 #include <string>
 #include <utility>
 
@@ -253,6 +254,8 @@ class SIMDMatMul : public Kernel {
     return true;
   }
 
+  bool Tunable() override { return true; }
+
   void Adjust(Step *step) override {
     // Set required order for output.
     MatMulArgs args(step);
@@ -303,6 +306,12 @@ class SIMDMatMul : public Kernel {
     }
   }
 
+  // Maximum number of unrolls for the column blocks. This can be overridden by
+  // the autotuner with the unroll attribute.
+  static int MaxUnrolls(Step *step) {
+    return step->GetAttr("unroll", SIMDStrategy::kMaxUnrolls);
+  }
+
   // Compute dot products between rows/columns in A and column blocks in B using
   // vertical summing. The vectors in A can either be traverse from top to
   // bottom (strided) or from left ro right (consecutive).
@@ -322,8 +331,7 @@ class SIMDMatMul : public Kernel {
     }
 
     // Compute vector processing strategy.
-    SIMDStrategy strategy(&sasm, args.b().width());
-    strategy.PreloadMasks();
+    SIMDStrategy strategy(&sasm, args.b().width(), MaxUnrolls(step));
 
     // Allocate registers.
     Register a = masm->rr().alloc();
@@ -335,6 +343,25 @@ class SIMDMatMul : public Kernel {
     auto sum = sasm.alloc(strategy.MaxUnrolls());
     int elem = sasm.alloc();
 
+    // Split large multiplications into partitions over the rows in A which
+    // are computed in parallel.
+    int rows = args.a().height();
+    int partitions = 1;
+    if (!strided && batchsize == 1) {
+      partitions = masm->Partitions(Complexity(step), rows);
+    }
+    int chunk = (rows + partitions - 1) / partitions;
+    Label entry, done;
+    if (partitions > 1) {
+      partitions = (rows + chunk - 1) / chunk;
+      step->set_variant(step->variant() + "|" + std::to_string(partitions));
+      __ ParallelFor(partitions, &entry);
+      __ jmp(&done);
+      __ bind(&entry);
+      __ BeginPartition(col_ofs);
+    }
+    strategy.PreloadMasks();
+
     // Load tensor addresses.
     __ LoadTensorAddress(a, args.a().tensor);
     __ LoadTensorAddress(b, args.b().tensor);
@@ -370,7 +397,18 @@ class SIMDMatMul : public Kernel {
     // Loop over rows/columns in A.
     Register a_end = masm->rr().alloc();
     Label l1;
-    if (!outer_single) {
+    if (partitions > 1) {
+      // Compute range of rows in A for partition.
+      __ leaq(a_end, Operand(a, outer_limit));
+      __ imulq(a_ofs, col_ofs, Immediate(chunk * outer_step));
+      __ addq(a, a_ofs);
+      __ imulq(a_ofs, col_ofs, Immediate(chunk * args.c().stride()));
+      __ addq(c, a_ofs);
+      __ leaq(b_ptr, Operand(a, chunk * outer_step));
+      __ cmpq(b_ptr, a_end);
+      __ cmovq(less, a_end, b_ptr);
+      __ bind(&l1);
+    } else if (!outer_single) {
       __ leaq(a_end, Operand(a, outer_limit));
       __ bind(&l1);
     }
@@ -547,6 +585,12 @@ class SIMDMatMul : public Kernel {
       __ cmpq(batch, Immediate(batchsize));
       __ j(less, &lb);
     }
+
+    // End of partition function.
+    if (partitions > 1) {
+      __ EndPartition();
+      __ bind(&done);
+    }
   }
 
   // Compute dot products between row blocks in A and row blocks in B using
@@ -563,8 +607,7 @@ class SIMDMatMul : public Kernel {
     CHECK_EQ(args.a().batch_size(), 1);
 
     // Compute vector processing strategy.
-    SIMDStrategy strategy(&sasm, args.b().width());
-    strategy.PreloadMasks();
+    SIMDStrategy strategy(&sasm, args.b().width(), MaxUnrolls(step));
 
     // Allocate registers.
     Register a = masm->rr().alloc();
@@ -576,6 +619,22 @@ class SIMDMatMul : public Kernel {
     auto sum = sasm.alloc(strategy.MaxUnrolls());
     auto elem = sasm.alloc(strategy.MaxUnrolls());
 
+    // Split large multiplications into partitions over the rows in A which
+    // are computed in parallel.
+    int rows = args.a().height();
+    int partitions = masm->Partitions(Complexity(step), rows);
+    int chunk = (rows + partitions - 1) / partitions;
+    Label entry, done;
+    if (partitions > 1) {
+      partitions = (rows + chunk - 1) / chunk;
+      step->set_variant(step->variant() + "|" + std::to_string(partitions));
+      __ ParallelFor(partitions, &entry);
+      __ jmp(&done);
+      __ bind(&entry);
+      __ BeginPartition(ofs);
+    }
+    strategy.PreloadMasks();
+
     // Load tensor addresses.
     __ LoadTensorAddress(a, args.a().tensor);
     __ LoadTensorAddress(b, args.b().tensor);
@@ -587,7 +646,18 @@ class SIMDMatMul : public Kernel {
     }
     Register a_end = masm->rr().alloc();
     Label l1;
-    if (args.a().height() > 1) {
+    if (partitions > 1) {
+      // Compute range of rows in A for partition.
+      __ leaq(a_end, Operand(a, args.a().size()));
+      __ imulq(b_ptr, ofs, Immediate(chunk * args.a().stride()));
+      __ addq(a, b_ptr);
+      __ imulq(b_ptr, ofs, Immediate(chunk * args.c().stride()));
+      __ addq(c, b_ptr);
+      __ leaq(ofs, Operand(a, chunk * args.a().stride()));
+      __ cmpq(ofs, a_end);
+      __ cmovq(less, a_end, ofs);
+      __ bind(&l1);
+    } else if (args.a().height() > 1) {
       __ leaq(a_end, Operand(a, args.a().size()));
       __ bind(&l1);
     }
@@ -695,6 +765,12 @@ class SIMDMatMul : public Kernel {
       __ cmpq(a, a_end);
       __ j(less, &l1);
     }
+
+    // End of partition function.
+    if (partitions > 1) {
+      __ EndPartition();
+      __ bind(&done);
+    }
   }
 
   // Compute dot products between columns in A and rows in B.
@@ -811,9 +887,607 @@ class SIMDMatMul : public Kernel {
   bool accumulate_;  // matmul with assignment
 };
 
+// Maximum embedding dimension for fused gather and matmul. The pooled
+// embedding vector is kept on the stack.
+static const int kMaxGatherMatMulDims = 4096;
+
+// Fused embedding lookup with pooling and vector-matrix multiplication with
+// optional bias and relu, i.e. y = relu(pool(M[f]) * W + b). The pooled
+// embedding vector is accumulated in a scratch area on the stack, so there is
+// no intermediate tensor in the instance and no separate step for the gather,
+// add, and relu. If the oov attribute is set, the oov vector follows the
+// feature input and is used instead of the pooled vector when there are no
+// features.
+class SIMDGatherMatMul : public Kernel {
+ public:
+  string Name() override { return "SIMDGatherMatMul"; }
+  string Operation() override { return "GatherMatMul"; }
+
+  bool Supports(Step *step) override {
+    // Check inputs and outputs.
+    int w = WeightIndex(step);
+    if (step->indegree() != w + 1 && step->indegree() != w + 2) return false;
+    if (step->outdegree() != 1) return false;
+    Tensor *M = step->input(0);
+    Tensor *f = step->input(1);
+    Tensor *W = step->input(w);
+    Tensor *y = step->output(0);
+    Type type = y->type();
+    if (!SIMDAssembler::Supports(type)) return false;
+    if (M->type() != type || M->rank() != 2) return false;
+    if (f->type() != DT_INT32 || f->rank() != 2) return false;
+    if (W->type() != type || W->rank() != 2) return false;
+    if (W->dim(0) != M->dim(1)) return false;
+    if (W->dim(0) > kMaxGatherMatMulDims) return false;
+    if (y->elements() != W->dim(1)) return false;
+    if (step->indegree() == w + 2) {
+      Tensor *b = step->input(w + 1);
+      if (b->type() != type || b->elements() != W->dim(1)) return false;
+    }
+    if (w == 3) {
+      Tensor *oov = step->input(2);
+      if (oov->type() != type || oov->elements() != W->dim(0)) return false;
+    }
+
+    // Check pooling.
+    const string &pooling = step->GetAttr("pooling");
+    if (pooling == "avg") {
+      if (type != DT_FLOAT && type != DT_DOUBLE) return false;
+      if (!CPU::Enabled(SSE2)) return false;
+    } else if (pooling != "sum") {
+      return false;
+    }
+
+    // Embedding and weight matrices must be row-major.
+    if (!M->SupportsOrder(ROW_MAJOR)) return false;
+    if (!W->SupportsOrder(ROW_MAJOR)) return false;
+
+    return true;
+  }
+
+  void Adjust(Step *step) override {
+    int w = WeightIndex(step);
+    Tensor *M = step->input(0);
+    Tensor *W = step->input(w);
+    Tensor *y = step->output(0);
+    M->RequireOrder(ROW_MAJOR);
+    W->RequireOrder(ROW_MAJOR);
+
+    // Align to one vector register.
+    int vecbytes = SIMDAssembler::VectorBytes(y->type());
+    M->SetMiniumAlignment(vecbytes);
+    W->SetMiniumAlignment(vecbytes);
+    y->SetMiniumAlignment(vecbytes);
+    if (w == 3) step->input(2)->SetMiniumAlignment(vecbytes);
+    bool bias = step->indegree() == w + 2;
+    if (bias) step->input(w + 1)->SetMiniumAlignment(vecbytes);
+
+    // Reserve registers. The bias needs an extra register.
+    int regs = SIMDAssembler::RegisterUsage(y->type()) + (bias ? 10 : 9);
+    step->SetRegisterUsage(regs);
+  }
+
+  void Generate(Step *step, MacroAssembler *masm) override {
+    // Get inputs and outputs.
+    int w = WeightIndex(step);
+    Tensor *M = step->input(0);
+    Tensor *f = step->input(1);
+    Tensor *oov = w == 3 ? step->input(2) : nullptr;
+    Tensor *W = step->input(w);
+    Tensor *b = step->indegree() == w + 2 ? step->input(w + 1) : nullptr;
+    Tensor *y = step->output(0);
+    bool avg = step->GetAttr("pooling") == "avg";
+    bool relu = step->GetAttr("relu", false);
+    int dims = W->dim(0);
+
+    // Create SIMD code generators.
+    Type type = y->type();
+    int dsize = TypeTraits::of(type).size();
+    int vecbytes = SIMDAssembler::VectorBytes(type);
+    bool aligned = M->stride(0) % vecbytes == 0 &&
+                   W->stride(0) % vecbytes == 0;
+    SIMDAssembler sasm(masm, type, aligned);
+    step->set_variant(sasm.name());
+
+    // Compute vector processing strategies for the embedding vector and the
+    // output vector.
+    SIMDStrategy pooling(&sasm, dims);
+    SIMDStrategy matmul(&sasm, y->elements());
+
+    // Allocate registers.
+    Register embeddings = masm->rr().alloc();
+    Register input = masm->rr().alloc();
+    Register weights = masm->rr().alloc();
+    Register bias = b != nullptr ? masm->rr().alloc() : no_reg;
+    Register output = masm->rr().alloc();
+    Register fidx = masm->rr().alloc();
+    Register fcnt = masm->rr().alloc();
+    Register acc = masm->rr().alloc();
+    Register ofs = masm->rr().alloc();
+    Register row = fidx;
+    auto sum = sasm.alloc(std::max(pooling.MaxUnrolls(), matmul.MaxUnrolls()));
+    int elem = sasm.alloc();
+    int zeroes = relu ? sasm.alloc() : -1;
+
+    // Load tensor locations.
+    __ LoadTensorAddress(embeddings, M);
+    __ LoadTensorAddress(input, f);
+    __ LoadTensorAddress(weights, W);
+    if (b != nullptr) __ LoadTensorAddress(bias, b);
+    __ LoadTensorAddress(output, y);
+
+    // Reserve aligned scratch area on the stack for the pooled embedding
+    // vector. The original stack pointer is saved after the scratch area.
+    int frame = (dims * dsize + 63) & ~63;
+    __ movq(acc, rsp);
+    __ andq(rsp, Immediate(-64));
+    __ subq(rsp, Immediate(frame + 64));
+    __ movq(Operand(rsp, frame), acc);
+
+    // Clear pooled embedding vector.
+    pooling.PreloadMasks();
+    GenerateBlocks(masm, pooling, dsize, ofs,
+                   [&](const SIMDStrategy::Phase &phase) {
+      auto *gen = phase.generator;
+      gen->Zero(elem);
+      if (phase.masked) {
+        gen->MaskedStore(Operand(rsp, ofs), elem);
+      } else {
+        for (int i = 0; i < phase.unrolls; ++i) {
+          int disp = i * gen->VectorSize() * dsize;
+          gen->Store(Operand(rsp, ofs, times_1, disp), elem);
+        }
+      }
+    });
+
+    // Loop over features. Leading negative features are skipped and the
+    // feature list is terminated by the first negative feature after that.
+    Label l1, l2, l3, done;
+    __ xorq(fidx, fidx);
+    __ xorq(fcnt, fcnt);
+    __ bind(&l1);
+    __ movsxlq(acc, Operand(input, fidx, times_4));
+    __ testq(acc, acc);
+    __ j(positive, &l2);
+    __ testq(fcnt, fcnt);
+    __ j(not_zero, &done);
+    __ jmp(&l3);
+
+    // Add embedding vector for feature to pooled vector.
+    __ bind(&l2);
+    __ incq(fcnt);
+    __ Multiply(acc, M->stride(0));
+    __ addq(acc, embeddings);
+    GenerateBlocks(masm, pooling, dsize, ofs,
+                   [&](const SIMDStrategy::Phase &phase) {
+      auto *gen = phase.generator;
+      if (phase.masked) {
+        gen->MaskedLoad(sum[0], Operand(acc, ofs));
+        gen->MaskedAdd(sum[0], sum[0], Operand(rsp, ofs));
+        gen->MaskedStore(Operand(rsp, ofs), sum[0]);
+      } else {
+        for (int i = 0; i < phase.unrolls; ++i) {
+          int disp = i * gen->VectorSize() * dsize;
+          gen->Load(sum[i], Operand(acc, ofs, times_1, disp));
+          gen->Add(sum[i], sum[i], Operand(rsp, ofs, times_1, disp));
+          gen->Store(Operand(rsp, ofs, times_1, disp), sum[i]);
+        }
+      }
+    });
+
+    // Next feature.
+    __ bind(&l3);
+    __ incq(fidx);
+    __ cmpq(fidx, Immediate(f->elements()));
+    __ j(less, &l1);
+    __ bind(&done);
+
+    // Use oov vector if there are no features.
+    if (oov != nullptr) {
+      Label l4;
+      __ testq(fcnt, fcnt);
+      __ j(not_zero, &l4);
+      __ LoadTensorAddress(acc, oov);
+      GenerateBlocks(masm, pooling, dsize, ofs,
+                     [&](const SIMDStrategy::Phase &phase) {
+        auto *gen = phase.generator;
+        if (phase.masked) {
+          gen->MaskedLoad(sum[0], Operand(acc, ofs));
+          gen->MaskedStore(Operand(rsp, ofs), sum[0]);
+        } else {
+          for (int i = 0; i < phase.unrolls; ++i) {
+            int disp = i * gen->VectorSize() * dsize;
+            gen->Load(sum[i], Operand(acc, ofs, times_1, disp));
+            gen->Store(Operand(rsp, ofs, times_1, disp), sum[i]);
+          }
+        }
+      });
+      __ bind(&l4);
+    }
+
+    // Compute average by multiplying the pooled vector with 1/fcnt. The
+    // reciprocal is computed with an exact division.
+    if (avg) {
+      Label l4;
+      __ testq(fcnt, fcnt);
+      __ j(zero, &l4);
+      XMMRegister sr = jit::XMMRegister::from_code(elem);
+      XMMRegister cr = jit::XMMRegister::from_code(sum[0]);
+      if (type == DT_DOUBLE) {
+        auto *one = masm->GetConstant<double>(1.0);
+        if (masm->Enabled(AVX)) {
+          __ vcvtqsi2sd(cr, cr, fcnt);
+          __ vmovsd(sr, one->address());
+          __ vdivsd(sr, sr, cr);
+        } else {
+          CHECK(masm->Enabled(SSE2));
+          __ cvtqsi2sd(cr, fcnt);
+          __ movsd(sr, one->address());
+          __ divsd(sr, cr);
+        }
+      } else {
+        auto *one = masm->GetConstant<float>(1.0f);
+        if (masm->Enabled(AVX)) {
+          __ vcvtqsi2ss(cr, cr, fcnt);
+          __ vmovss(sr, one->address());
+          __ vdivss(sr, sr, cr);
+        } else {
+          __ cvtqsi2ss(cr, fcnt);
+          __ movss(sr, one->address());
+          __ divss(sr, cr);
+        }
+      }
+      sasm.main()->Broadcast(elem, elem);
+      GenerateBlocks(masm, pooling, dsize, ofs,
+                     [&](const SIMDStrategy::Phase &phase) {
+        auto *gen = phase.generator;
+        if (phase.masked) {
+          gen->MaskedMul(sum[0], elem, Operand(rsp, ofs));
+          gen->MaskedStore(Operand(rsp, ofs), sum[0]);
+        } else {
+          for (int i = 0; i < phase.unrolls; ++i) {
+            int disp = i * gen->VectorSize() * dsize;
+            gen->Mul(sum[i], elem, Operand(rsp, ofs, times_1, disp));
+            gen->Store(Operand(rsp, ofs, times_1, disp), sum[i]);
+          }
+        }
+      });
+      __ bind(&l4);
+    }
+
+    // Multiply pooled vector with weight matrix using vertical summation over
+    // the column blocks of the output.
+    matmul.PreloadMasks();
+    if (relu) sasm.main()->Zero(zeroes);
+    GenerateBlocks(masm, matmul, dsize, ofs,
+                   [&](const SIMDStrategy::Phase &phase) {
+      auto *gen = phase.generator;
+      int unrolls = phase.masked ? 1 : phase.unrolls;
+      int vecsize = gen->VectorSize();
+      for (int i = 0; i < unrolls; ++i) gen->Zero(sum[i]);
+
+      // Loop over rows in W.
+      Label lr;
+      __ movq(acc, weights);
+      __ xorq(row, row);
+      __ bind(&lr);
+      gen->Broadcast(elem, Operand(rsp, row));
+      if (phase.masked) {
+        gen->MaskedMulAdd(sum[0], elem, Operand(acc, ofs));
+      } else {
+        for (int i = 0; i < unrolls; ++i) {
+          int disp = i * vecsize * dsize;
+          bool retain = i != unrolls - 1;
+          gen->MulAdd(sum[i], elem, Operand(acc, ofs, times_1, disp), retain);
+        }
+      }
+      __ addq(acc, Immediate(W->stride(0)));
+      __ addq(row, Immediate(dsize));
+      __ cmpq(row, Immediate(dims * dsize));
+      __ j(less, &lr);
+
+      // Add bias, apply relu, and save result.
+      for (int i = 0; i < unrolls; ++i) {
+        int disp = i * vecsize * dsize;
+        if (b != nullptr) {
+          if (phase.masked) {
+            gen->MaskedAdd(sum[i], sum[i], Operand(bias, ofs));
+          } else {
+            gen->Add(sum[i], sum[i], Operand(bias, ofs, times_1, disp));
+          }
+        }
+        if (relu) gen->Accumulate(REDUCE_MAX, sum[i], zeroes);
+        if (phase.masked) {
+          gen->MaskedStore(Operand(output, ofs), sum[i]);
+        } else {
+          gen->Store(Operand(output, ofs, times_1, disp), sum[i]);
+        }
+      }
+    });
+
+    // Restore stack pointer.
+    __ movq(rsp, Operand(rsp, frame));
+  }
+
+  int64 Complexity(const Step *step) override {
+    int w = WeightIndex(step);
+    Tensor *W = step->input(w);
+    int64 ops = W->elements() * 2;
+    ops += W->dim(0) * step->input(1)->elements();
+    if (step->indegree() == w + 2) ops += W->dim(1);
+    if (step->GetAttr("relu", false)) ops += W->dim(1);
+    return ops;
+  }
+
+ private:
+  // Index of the weight matrix input. The inputs are M, f, [oov], W, [b].
+  static int WeightIndex(const Step *step) {
+    return step->GetAttr("oov", false) ? 3 : 2;
+  }
+
+  // Generate code for each block of a vector processed with a strategy. The
+  // offset register holds the byte offset of the current block.
+  typedef std::function<void(const SIMDStrategy::Phase &)> Body;
+  static void GenerateBlocks(MacroAssembler *masm,
+                             const SIMDStrategy &strategy, int dsize,
+                             Register ofs, const Body &body) {
+    for (auto &phase : strategy.phases()) {
+      int vecsize = phase.generator->VectorSize();
+      int blkstart = phase.offset * dsize;
+      int blksize = phase.unrolls * vecsize * dsize;
+      if (blkstart == 0) {
+        __ xorq(ofs, ofs);
+      } else {
+        __ movq(ofs, Immediate(blkstart));
+      }
+      Label l;
+      __ bind(&l);
+      body(phase);
+      if (phase.repeat > 1) {
+        __ addq(ofs, Immediate(blksize));
+        __ cmpq(ofs, Immediate(blkstart + phase.repeat * blksize));
+        __ j(less, &l);
+      }
+    }
+  }
+};
+
+// Fuse embedding pooling into the following vector-matrix multiplication, and
+// fuse bias and relu into the fused op. A vector-matrix multiplication of a
+// concatenation of pooled embeddings is first split into a chain of
+// multiplications with the row blocks of the weight matrix, so each embedding
+// can be fused with its block.
+class GatherMatMulTransformer : public Transformer {
+ public:
+  string Name() override { return "GatherMatMulTransformer"; }
+
+  bool Transform(Flow *flow) override {
+    int combines = 0;
+    while (SplitConcat(flow) || FuseGather(flow) ||
+           FuseBias(flow) || FuseRelu(flow)) {
+      combines++;
+    }
+    return combines > 0;
+  }
+
+ private:
+  // Check if variable is only used as an intermediate result by a single op.
+  static bool Intermediate(Flow::Variable *var, Flow::Operation *producer) {
+    if (var->usages() != 1 || var->out()) return false;
+    if (var->consumers[0]->task != producer->task) return false;
+    return var->shape.defined();
+  }
+
+  // Check if the consumer of a variable is a vector-matrix multiplication with
+  // the variable as the vector and return the matrix multiplication op.
+  static Flow::Operation *VecMatMul(Flow::Variable *x) {
+    Flow::Operation *matmul = x->consumers[0];
+    bool bias = matmul->type == "MatMulAdd" ||
+                matmul->type == "MatMulAddRelu";
+    bool relu = matmul->type == "MatMulRelu" ||
+                matmul->type == "MatMulAddRelu";
+    if (matmul->type != "MatMul" && !bias && !relu) return nullptr;
+    if (matmul->indegree() != (bias ? 3 : 2)) return nullptr;
+    if (matmul->outdegree() != 1) return nullptr;
+    if (matmul->inputs[0] != x) return nullptr;
+    if (matmul->GetAttr("transpose_a", false)) return nullptr;
+    if (matmul->GetAttr("transpose_b", false)) return nullptr;
+    if (matmul->GetAttr("transpose_c", false)) return nullptr;
+    Flow::Variable *W = matmul->inputs[1];
+    if (W->type != x->type || W->rank() != 2) return nullptr;
+    if (W->dim(0) != x->elements()) return nullptr;
+    if (x->rank() == 2 && x->dim(0) != 1) return nullptr;
+    return matmul;
+  }
+
+  // Check if variable is the output of an embedding lookup that can be fused
+  // with a vector-matrix multiplication and return the lookup op. This is
+  // either GatherSum/GatherAvg or a Gather of a single feature.
+  static Flow::Operation *Pooling(Flow::Variable *v) {
+    Flow::Operation *op = v->producer;
+    if (op == nullptr || op->outdegree() != 1) return nullptr;
+    if (!Intermediate(v, op)) return nullptr;
+    if (!SIMDAssembler::Supports(v->type)) return nullptr;
+    Flow::Variable *M = op->inputs[0];
+    if (M->rank() != 2 || M->dim(1) > kMaxGatherMatMulDims) return nullptr;
+    if (op->type == "GatherSum") {
+      if (op->indegree() != 2) return nullptr;
+    } else if (op->type == "GatherAvg") {
+      if (op->indegree() != 2) return nullptr;
+      if (v->type != DT_FLOAT && v->type != DT_DOUBLE) return nullptr;
+    } else if (op->type == "Gather") {
+      if (op->indegree() != 2 && op->indegree() != 3) return nullptr;
+      if (op->inputs[1]->elements() != 1) return nullptr;
+      if (v->elements() != M->dim(1)) return nullptr;
+      if (op->indegree() == 3) {
+        Flow::Variable *oov = op->inputs[2];
+        if (oov->type != v->type || oov->elements() != M->dim(1)) {
+          return nullptr;
+        }
+      }
+    } else {
+      return nullptr;
+    }
+    return op;
+  }
+
+  // Fuse GatherSum/GatherAvg/Gather with MatMul into GatherMatMul.
+  bool FuseGather(Flow *flow) {
+    for (Flow::Operation *op : flow->ops()) {
+      if (op->outdegree() != 1 || Pooling(op->outputs[0]) != op) continue;
+      Flow::Operation *matmul = VecMatMul(op->outputs[0]);
+      if (matmul == nullptr) continue;
+      bool avg = op->type == "GatherAvg";
+      bool oov = op->type == "Gather" && op->indegree() == 3;
+      bool relu = matmul->type == "MatMulRelu" ||
+                  matmul->type == "MatMulAddRelu";
+
+      Flow::Operation *fused = flow->Fuse(op, matmul, "GatherMatMul");
+      fused->SetAttr("pooling", avg ? "avg" : "sum");
+      if (oov) fused->SetAttr("oov", true);
+      if (relu) fused->SetAttr("relu", true);
+      return true;
+    }
+    return false;
+  }
+
+  // Split vector-matrix multiplication of concatenated embeddings into a chain
+  // of vector-matrix multiplications with row blocks of the constant weight
+  // matrix, i.e. concat(v1,...,vn) * W + b = vn * Wn + (... (v1 * W1 + b)).
+  bool SplitConcat(Flow *flow) {
+    for (Flow::Operation *concat : flow->ops()) {
+      if (concat->type != "Concat" || concat->outdegree() != 1) continue;
+      int n = concat->GetAttr("N", 0);
+      if (n < 2 || concat->indegree() != n + 1) continue;
+      int axis;
+      if (!concat->inputs[n]->GetData(&axis) || axis != 1) continue;
+      Flow::Variable *fv = concat->outputs[0];
+      if (!Intermediate(fv, concat)) continue;
+      if (fv->rank() != 2 || fv->dim(0) != 1) continue;
+
+      // All the concatenated vectors must be fusable embedding lookups.
+      bool fusable = true;
+      for (int i = 0; i < n; ++i) {
+        Flow::Variable *v = concat->inputs[i];
+        if (v->type != fv->type || v->rank() != 2 || v->dim(0) != 1 ||
+            Pooling(v) == nullptr) {
+          fusable = false;
+        }
+      }
+      if (!fusable) continue;
+
+      // The weight matrix must be a constant so it can be split.
+      Flow::Operation *matmul = VecMatMul(fv);
+      if (matmul == nullptr) continue;
+      Flow::Variable *W = matmul->inputs[1];
+      if (!W->constant()) continue;
+      bool bias = matmul->type == "MatMulAdd" ||
+                  matmul->type == "MatMulAddRelu";
+      bool relu = matmul->type == "MatMulRelu" ||
+                  matmul->type == "MatMulAddRelu";
+      Flow::Variable *b = bias ? matmul->inputs[2] : nullptr;
+      Flow::Variable *y = matmul->outputs[0];
+      Flow::Function *func = matmul->func;
+      string opname = matmul->name;
+      int task = matmul->task;
+      std::vector<Flow::Variable *> parts(concat->inputs.begin(),
+                                          concat->inputs.begin() + n);
+
+      // Remove concatenation and matrix multiplication.
+      flow->RemoveOperation(matmul);
+      flow->RemoveOperation(concat);
+      flow->DeleteVariable(fv);
+
+      // Add a vector-matrix multiplication for each row block of the weight
+      // matrix which adds the result for the previous blocks as the bias.
+      int width = y->dim(1);
+      size_t rowsize = width * TypeTraits::of(W->type).size();
+      const char *data = W->data;
+      Flow::Variable *acc = b;
+      for (int i = 0; i < n; ++i) {
+        Flow::Variable *v = parts[i];
+        int rows = v->dim(1);
+        string name = flow->VarName(W->name + "/block");
+        Flow::Variable *Wi = flow->AddVariable(name, W->type, {rows, width});
+        Wi->size = rows * rowsize;
+        Wi->data = flow->AllocateMemory(data, Wi->size);
+        data += Wi->size;
+
+        bool last = i == n - 1;
+        Flow::Variable *out = y;
+        if (!last) {
+          out = flow->AddVariable(flow->VarName(y->name + "/partial"),
+                                  y->type, y->shape);
+        }
+        string type = acc != nullptr ? "MatMulAdd" : "MatMul";
+        if (last && relu) type.append("Relu");
+        std::vector<Flow::Variable *> inputs = {v, Wi};
+        if (acc != nullptr) inputs.push_back(acc);
+        Flow::Operation *op =
+            flow->AddOperation(func, flow->OpName(opname), type,
+                               inputs, {out});
+        op->task = task;
+        acc = out;
+      }
+      if (W->detached()) flow->DeleteVariable(W);
+      return true;
+    }
+    return false;
+  }
+
+  // Fuse bias addition into GatherMatMul.
+  bool FuseBias(Flow *flow) {
+    for (Flow::Operation *op : flow->ops()) {
+      if (op->type != "GatherMatMul") continue;
+      int inputs = op->GetAttr("oov", false) ? 4 : 3;
+      if (op->indegree() != inputs || op->GetAttr("relu", false)) continue;
+      Flow::Variable *y = op->outputs[0];
+      if (!Intermediate(y, op)) continue;
+      Flow::Operation *add = y->consumers[0];
+      if (add->type != "Add" || add->indegree() != 2) continue;
+      Flow::Variable *b = add->inputs[0] == y ? add->inputs[1] : add->inputs[0];
+      if (b == y || b->type != y->type) continue;
+      if (b->elements() != y->elements()) continue;
+      if (!add->outputs[0]->shape.defined()) continue;
+      if (add->outputs[0]->elements() != y->elements()) continue;
+
+      flow->Fuse(op, add, "GatherMatMul");
+      return true;
+    }
+    return false;
+  }
+
+  // Fuse relu into GatherMatMul.
+  bool FuseRelu(Flow *flow) {
+    for (Flow::Operation *op : flow->ops()) {
+      if (op->type != "GatherMatMul") continue;
+      if (op->GetAttr("relu", false)) continue;
+      Flow::Variable *y = op->outputs[0];
+      if (!Intermediate(y, op)) continue;
+      Flow::Operation *relu = y->consumers[0];
+      if (relu->type != "Relu" || relu->indegree() != 1) continue;
+
+      flow->Fuse(op, relu, "GatherMatMul");
+      op->SetAttr("relu", true);
+      return true;
+    }
+    return false;
+  }
+};
+
 void RegisterSIMDMatMulLibrary(Library *library) {
   library->Register(new SIMDMatMul(true));
   library->Register(new SIMDMatMul(false));
+
+  // Computes  : y = relu(pool(M[f]) * W + b)
+  // Input     : M: float32[k,n] row-major
+  //             f: int32[1,m]
+  //             oov: float32[1,n] (optional)
+  //             W: float32[n,h] row-major
+  //             b: float32[1,h] (optional)
+  // Output    : y: float32[1,h]
+  library->RegisterTransformer(new GatherMatMulTransformer());
+  library->Register(new SIMDGatherMatMul());
 }
 
 }  // namespace myelin
@@ -14,6 +14,8 @@
 
 #include "sling/myelin/learning.h"
 
+#include <algorithm>
+
 #include "sling/base/logging.h"
 #include "sling/myelin/builder.h"
 
@@ -77,106 +79,243 @@ float CrossEntropyLoss::Compute(float *logits, int target,
   return *data.Get<float>(loss_);
 }
 
+Optimizer::~Optimizer() {
+  for (Instance *data : instances_) delete data;
+  for (Shard *shard : shards_) delete shard;
+}
+
 void Optimizer::Build(Flow *flow) {
-  // Build mapping from learnable variable to gradient for variable.
-  FlowBuilder tf(flow, name_);
-  GradientMap gradmap;
+  // Find learnable variables.
+  std::vector<Flow::Variable *> vars;
   for (Flow::Variable *var : flow->vars()) {
-    if (!var->learnable()) continue;
-
-    // Get gradient variable for learnable variable.
-    Flow::Variable *dvar = flow->GradientVar(var);
-    CHECK(dvar != nullptr) << "No gradient found for " << var->name;
-
-    // Find function for gradient variable.
-    Flow::Operation *producer = nullptr;
-    if (dvar->producer != nullptr) {
-      producer = dvar->producer;
-    } else if (!dvar->consumers.empty()) {
-      producer = dvar->consumers[0];
-    }
-    CHECK(producer != nullptr) << "No producer for gradient " << dvar->name;
-    Flow::Function *func = producer->func;
-    CHECK(func != nullptr) << "No producer function for gradient "
-                           << dvar->name;
-
-    // Add instance variables for producer functions.
-    if (instance_[func] == nullptr) instance_[func] = tf.Instance(func);
+    if (var->learnable()) vars.push_back(var);
+  }
 
-    // Add reference to gradient in update function.
-    gradmap[var] = tf.Ref(instance_[func], dvar);
+  // Partition learnable variables into shards with approximately the same
+  // number of parameters by assigning the largest remaining variable to the
+  // smallest shard.
+  int num_shards = std::max(std::min<int>(num_shards_, vars.size()), 1);
+  std::sort(vars.begin(), vars.end(),
+            [](Flow::Variable *a, Flow::Variable *b) {
+    if (a->elements() != b->elements()) return a->elements() > b->elements();
+    return a->name < b->name;
+  });
+  std::vector<std::vector<Flow::Variable *>> partition(num_shards);
+  std::vector<int64> sizes(num_shards);
+  for (Flow::Variable *var : vars) {
+    int smallest = 0;
+    for (int i = 1; i < num_shards; ++i) {
+      if (sizes[i] < sizes[smallest]) smallest = i;
+    }
+    partition[smallest].push_back(var);
+    sizes[smallest] += var->elements();
   }
 
-  // Optionally add gradient clipping.
-  if (clipping_threshold_ != 0.0 && !gradmap.empty()) {
-    auto *threshold = tf.Name(tf.Const(clipping_threshold_), "threshold");
-    if (local_clipping_) {
-      // Clip each weight tensor separately.
-      for (auto &it : gradmap) {
-        auto &dv = it.second;
-        auto *norm = tf.Norm(dv);
-        auto *clip = tf.Div(threshold, tf.Maximum(norm, threshold));
-        dv = tf.Mul(dv, clip);
+  // Build update function for each shard.
+  for (int i = 0; i < num_shards; ++i) {
+    Shard *shard = new Shard();
+    shard->name = name_;
+    if (num_shards > 1) shard->name += "/" + std::to_string(i);
+    shards_.push_back(shard);
+
+    // Build mapping from learnable variable to gradient for variable.
+    FlowBuilder tf(flow, shard->name);
+    GradientMap gradmap;
+    for (Flow::Variable *var : partition[i]) {
+      // Get gradient variable for learnable variable.
+      Flow::Variable *dvar = flow->GradientVar(var);
+      CHECK(dvar != nullptr) << "No gradient found for " << var->name;
+
+      // Find function for gradient variable.
+      Flow::Operation *producer = nullptr;
+      if (dvar->producer != nullptr) {
+        producer = dvar->producer;
+      } else if (!dvar->consumers.empty()) {
+        producer = dvar->consumers[0];
       }
-    } else {
-      // Compute global norm over all gradient tensors.
-      Flow::Variable *sum = nullptr;
-      for (auto &it : gradmap) {
-        auto &dv = it.second;
-        auto *squared_sum = tf.Sum(tf.Square(dv));
-        if (sum == nullptr) {
-          sum = squared_sum;
-        } else {
-          sum = tf.Add(sum, squared_sum);
+      CHECK(producer != nullptr) << "No producer for gradient " << dvar->name;
+      Flow::Function *func = producer->func;
+      CHECK(func != nullptr) << "No producer function for gradient "
+                             << dvar->name;
+
+      // Add instance variables for producer functions.
+      auto &instance = shard->instance[func];
+      if (instance == nullptr) instance = tf.Instance(func);
+
+      // Add reference to gradient in update function.
+      gradmap[var] = tf.Ref(instance, dvar);
+    }
+
+    // Optionally add gradient clipping. The clipping factors are applied to
+    // the gradients by Clip().
+    clipping_.clear();
+    if (clipping_threshold_ != 0.0 && !gradmap.empty()) {
+      auto *threshold = tf.Name(tf.Const(clipping_threshold_), "threshold");
+      if (local_clipping_) {
+        // Clip each weight tensor separately.
+        for (auto &it : gradmap) {
+          auto *norm = tf.Norm(it.second);
+          clipping_[it.first] = tf.Div(threshold, tf.Maximum(norm, threshold));
         }
-      }
-      auto *norm = tf.Sqrt(sum);
+      } else {
+        // Compute global norm over all gradient tensors.
+        Flow::Variable *sum = nullptr;
+        for (auto &it : gradmap) {
+          auto &dv = it.second;
+          auto *squared_sum = tf.Sum(tf.Square(dv));
+          if (sum == nullptr) {
+            sum = squared_sum;
+          } else {
+            sum = tf.Add(sum, squared_sum);
+          }
+        }
+        auto *norm = tf.Sqrt(sum);
 
-      // Clip gradients by global norm.
-      auto *clip = tf.Div(threshold, tf.Maximum(norm, threshold));
-      for (auto &it : gradmap) {
-        auto &dv = it.second;
-        dv = tf.Mul(dv, clip);
+        // Clip gradients by global norm.
+        auto *clip = tf.Div(threshold, tf.Maximum(norm, threshold));
+        for (auto &it : gradmap) clipping_[it.first] = clip;
       }
     }
-  }
 
-  // Build optimizer.
-  BuildOptimizer(gradmap, &tf);
+    // Build optimizer.
+    BuildOptimizer(gradmap, &tf);
+    clipping_.clear();
 
-  // Optimizer is only needed at training-time.
-  tf.func()->set_training();
+    // Optimizer is only needed at training-time.
+    tf.func()->set_training();
+  }
 }
 
 void Optimizer::Initialize(const Network &network) {
-  // Get cell for update.
-  Cell *cell = network.GetCell(name_);
-
-  // Create data instance for update.
-  data_ = new Instance(cell);
-
-  // Create mapping from gradient computation cell to instance variable in
-  // update cell.
-  for (auto it : instance_) {
-    Cell *gradient_cell = network.GetCell(it.first->name);
-    Tensor *gradient_instance = cell->GetParameter(it.second->name);
-    refs_[gradient_cell] = gradient_instance;
-  }
+  for (Shard *shard : shards_) {
+    // Get cell for update.
+    shard->cell = network.GetCell(shard->name);
+
+    // Create mapping from gradient computation cell to instance variable in
+    // update cell.
+    for (auto it : shard->instance) {
+      Cell *gradient_cell = network.GetCell(it.first->name);
+      Tensor *gradient_instance = shard->cell->GetParameter(it.second->name);
+      shard->refs[gradient_cell] = gradient_instance;
+    }
 
-  // Initialize optimizer.
-  InitializeOptimizer();
+    // Create data instance for update.
+    shard->data = new Instance(shard->cell);
+    InitializeInstance(shard->data);
+    instances_.push_back(shard->data);
+    if (hogwild_) shard->idle.push_back(shard->data);
+  }
 }
 
-void Optimizer::Apply(const std::vector<Instance *> &gradients) {
+void Optimizer::Update(Shard *shard, Instance *data,
+                       const std::vector<Instance *> &gradients) {
   // Set instance references to gradients in update.
   for (Instance *g : gradients) {
-    auto f = refs_.find(g->cell());
-    CHECK(f != refs_.end()) << g->cell()->name();
-    data_->Set(f->second, g);
+    auto f = shard->refs.find(g->cell());
+    if (f != shard->refs.end()) data->Set(f->second, g);
   }
 
   // Apply gradient update to learnable parameters.
-  data_->Compute();
+  data->Compute();
+}
+
+void Optimizer::Apply(const std::vector<Instance *> &gradients) {
+  // Check that all gradients have updates.
+  for (Instance *g : gradients) {
+    bool found = false;
+    for (Shard *shard : shards_) {
+      if (shard->refs.count(g->cell()) > 0) found = true;
+    }
+    CHECK(found) << g->cell()->name();
+  }
+
+  if (hogwild_) {
+    // Apply gradients using idle update instances without locking the
+    // parameters.
+    for (Shard *shard : shards_) {
+      Instance *data = Acquire(shard);
+      Update(shard, data, gradients);
+      Release(shard, data);
+    }
+  } else if (shards_.size() > 1) {
+    // Update the shards that are not locked by other workers first, and then
+    // wait for the remaining shards.
+    int n = shards_.size();
+    std::vector<bool> done(n);
+    for (int i = 0; i < n; ++i) {
+      Shard *shard = shards_[i];
+      if (!shard->mu.TryLock()) continue;
+      Update(shard, shard->data, gradients);
+      shard->mu.Unlock();
+      done[i] = true;
+    }
+    for (int i = 0; i < n; ++i) {
+      if (done[i]) continue;
+      Shard *shard = shards_[i];
+      MutexLock lock(&shard->mu);
+      Update(shard, shard->data, gradients);
+    }
+  } else {
+    // Caller serializes updates.
+    Shard *shard = shards_[0];
+    Update(shard, shard->data, gradients);
+  }
+}
+
+void Optimizer::Apply(const std::vector<Instance *> &gradients, Mutex *mu) {
+  if (concurrent()) {
+    Apply(gradients);
+  } else {
+    MutexLock lock(mu);
+    Apply(gradients);
+  }
+}
+
+Instance *Optimizer::Acquire(Shard *shard) {
+  MutexLock lock(&mu_);
+  if (!shard->idle.empty()) {
+    Instance *data = shard->idle.back();
+    shard->idle.pop_back();
+    return data;
+  }
+
+  // Create new update instance if all instances are in use.
+  Instance *data = new Instance(shard->cell);
+  InitializeInstance(data);
+  instances_.push_back(data);
+  return data;
+}
+
+void Optimizer::Release(Shard *shard, Instance *data) {
+  MutexLock lock(&mu_);
+  shard->idle.push_back(data);
+}
+
+void Optimizer::SetParameter(const string &name, float value) {
+  MutexLock lock(&mu_);
+  for (Instance *data : instances_) {
+    *data->Get<float>(GetParameter(data, name)) = value;
+  }
+}
+
+Flow::Variable *Optimizer::Clip(FlowBuilder *tf, Flow::Variable *var,
+                                Flow::Variable *dv) {
+  auto f = clipping_.find(var);
+  if (f == clipping_.end()) return dv;
+  return tf->Mul(dv, f->second);
+}
+
+void Optimizer::Assign(FlowBuilder *tf, Flow::Variable *var,
+                       Flow::Variable *value) {
+  auto *assign = tf->Assign(var, value);
+  if (lazy_) assign->SetAttr("lazy", true);
+}
+
+Flow::Variable *Optimizer::Accumulate(FlowBuilder *tf, Flow::Variable *var,
+                                      Flow::Variable *value) {
+  auto *result = tf->Accumulate(var, value);
+  if (lazy_) result->producer->SetAttr("lazy", true);
+  return result;
 }
 
 void GradientDescentOptimizer::BuildOptimizer(const GradientMap &gradmap,
@@ -189,29 +328,28 @@ void GradientDescentOptimizer::BuildOptimizer(const GradientMap &gradmap,
   // Update learnable variables from gradients.
   for (auto it : gradmap) {
     auto *v = it.first;
-    auto *dv = it.second;
+    auto *dv = Clip(&tf, v, it.second);
 
     // Add scaled gradient to parameters.
     float lambda = v->GetAttr("l2reg", lambda_);
     if (lambda != 0.0) {
-      tf.Assign(v, tf.Add(tf.Mul(tf.Sub(tf.One(), tf.Const(lambda)), v),
-                          tf.Mul(dv, multiplier)));
+      Assign(&tf, v, tf.Add(tf.Mul(tf.Sub(tf.One(), tf.Const(lambda)), v),
+                            tf.Mul(dv, multiplier)));
     } else {
-      tf.AssignAdd(v, tf.Mul(dv, multiplier));
+      Assign(&tf, v, tf.Add(v, tf.Mul(dv, multiplier)));
     }
   }
 }
 
-void GradientDescentOptimizer::InitializeOptimizer() {
-  // Set initial learning rate.
-  alpha_ = GetParameter(name_ + "/alpha");
-  *data_->Get<float>(alpha_) = lr_;
+void GradientDescentOptimizer::InitializeInstance(Instance *data) {
+  // Set current learning rate.
+  *data->Get<float>(GetParameter(data, "alpha")) = lr_;
 }
 
 float GradientDescentOptimizer::DecayLearningRate() {
-  float &lr = *data_->Get<float>(alpha_);
-  lr *= decay_;
-  return lr;
+  lr_ *= decay_;
+  SetParameter("alpha", lr_);
+  return lr_;
 }
 
 void MomentumOptimizer::BuildOptimizer(const GradientMap &gradmap,
@@ -232,48 +370,30 @@ void MomentumOptimizer::BuildOptimizer(const GradientMap &gradmap,
   int i = 0;
   for (auto it : gradmap) {
     auto *var = it.first;
-    auto *dv = it.second;
-
-    // Reference to previous update.
-    auto *v_in = tf.Var("vin" + std::to_string(i), DT_FLOAT, var->shape);
-    v_in->set_in()->set_ref();
+    auto *dv = Clip(&tf, var, it.second);
 
-    // Blend current and new update.
-    auto *v_out = tf.Add(tf.Mul(gamma, v_in), tf.Mul(alpha, dv));
-    v_out->set_out();
-    tf.Name(v_out, "vout" + std::to_string(i));
+    // Blend previous and new update. The momentum is a global variable, so it
+    // is shared by all update instances.
+    auto *v_var = tf.Var("v" + std::to_string(i), dv->type, dv->shape);
+    v_var->set_learnable();
+    auto *v = Accumulate(&tf, v_var, tf.Add(tf.Mul(gamma, v_var),
+                                            tf.Mul(alpha, dv)));
 
     // Update parameters.
-    tf.Assign(var, tf.Sub(var, v_out));
+    Assign(&tf, var, tf.Sub(var, v));
     i++;
-
-    // Link input to output.
-    tf.flow()->Connect({v_in, v_out});
-  }
-  num_linked_ = i;
-}
-
-void MomentumOptimizer::InitializeOptimizer() {
-  // Set initial learning rate.
-  alpha_ = GetParameter(name_ + "/alpha");
-  *data_->Get<float>(alpha_) = lr_;
-
-  // Link input and output.
-  for (int i = 0; i < num_linked_; ++i) {
-    Tensor *vin = GetParameter(name_ + "/vin" + std::to_string(i));
-    Tensor *vout = GetParameter(name_ + "/vout" + std::to_string(i));
-    data_->SetReference(vin, data_->GetAddress(vout));
   }
 }
 
-void MomentumOptimizer::Apply(const std::vector<Instance *> &gradients) {
-  Optimizer::Apply(gradients);
+void MomentumOptimizer::InitializeInstance(Instance *data) {
+  // Set current learning rate.
+  *data->Get<float>(GetParameter(data, "alpha")) = lr_;
 }
 
 float MomentumOptimizer::DecayLearningRate() {
-  float &lr = *data_->Get<float>(alpha_);
-  lr *= decay_;
-  return lr;
+  lr_ *= decay_;
+  SetParameter("alpha", lr_);
+  return lr_;
 }
 
 void AdamOptimizer::BuildOptimizer(const GradientMap &gradmap,
@@ -313,44 +433,44 @@ void AdamOptimizer::BuildOptimizer(const GradientMap &gradmap,
     auto *var = it.first;
     auto *dv = it.second;
 
-    // Aggregate mean and variance.
-    auto *m_var = tf.Var("m" + std::to_string(i), dv->type, dv->shape);
-    auto *mw = one_minus_beta1;
-    auto *m = tf.Accumulate(m_var, tf.Add(tf.Mul(m_var, beta1),
-                                          tf.Mul(dv, mw)));
-
+    // Aggregate variance and mean. The moment estimates are global variables,
+    // so they are shared by all update instances. The variance is updated
+    // before the mean, so concurrent hogwild updates never see a new mean
+    // with an old variance, which could give huge steps for new features.
     auto *v_var = tf.Var("v" + std::to_string(i), dv->type, dv->shape);
+    v_var->set_learnable();
     auto *vw = one_minus_beta2;
-    auto *v = tf.Accumulate(v_var, tf.Add(tf.Mul(v_var, beta2),
-                                          tf.Square(tf.Mul(dv, vw))));
+    auto *v = Accumulate(&tf, v_var,
+                         tf.Add(tf.Mul(v_var, beta2),
+                                tf.Square(tf.Mul(Clip(&tf, var, dv), vw))));
+
+    auto *m_var = tf.Var("m" + std::to_string(i), dv->type, dv->shape);
+    m_var->set_learnable();
+    auto *mw = one_minus_beta1;
+    auto *m = Accumulate(&tf, m_var,
+                         tf.Add(tf.Mul(m_var, beta1),
+                                tf.Mul(Clip(&tf, var, dv), mw)));
 
     // Update parameters.
     auto *delta = tf.Div(tf.Mul(m, lr), tf.Add(tf.Sqrt(v), epsilon));
-    tf.Assign(var, tf.Sub(var, delta));
+    Assign(&tf, var, tf.Sub(var, delta));
     i++;
   }
 }
 
-void AdamOptimizer::InitializeOptimizer() {
-  // Set initial learning rate.
-  alpha_ = GetParameter(name_ + "/alpha");
-  *data_->Get<float>(alpha_) = lr_;
+void AdamOptimizer::InitializeInstance(Instance *data) {
+  // Set current learning rate.
+  *data->Get<float>(GetParameter(data, "alpha")) = lr_;
 
   // Initialize bias correction parameters.
-  auto *beta1_t = GetParameter(name_ + "/beta1_t");
-  auto *beta2_t = GetParameter(name_ + "/beta2_t");
-  *data_->Get<float>(beta1_t) = 1.0;
-  *data_->Get<float>(beta2_t) = 1.0;
-}
-
-void AdamOptimizer::Apply(const std::vector<Instance *> &gradients) {
-  Optimizer::Apply(gradients);
+  *data->Get<float>(GetParameter(data, "beta1_t")) = 1.0;
+  *data->Get<float>(GetParameter(data, "beta2_t")) = 1.0;
 }
 
 float AdamOptimizer::DecayLearningRate() {
-  float &lr = *data_->Get<float>(alpha_);
-  lr *= decay_;
-  return lr;
+  lr_ *= decay_;
+  SetParameter("alpha", lr_);
+  return lr_;
 }
 
 }  // namespace myelin
@@ -17,10 +17,12 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 #include "sling/myelin/builder.h"
 #include "sling/myelin/compute.h"
 #include "sling/myelin/flow.h"
+#include "sling/util/mutex.h"
 
 namespace sling {
 namespace myelin {
@@ -55,13 +57,37 @@ class CrossEntropyLoss {
 
 // A parameter optimizer applies updates to the learnable parameters of a model
 // based on the (accumulated) gradients from backpropagation.
+//
+// By default, the optimizer has a single update function for all learnable
+// parameters and the caller must serialize calls to Apply(). For training with
+// many workers, the optimizer can be made safe for concurrent updates:
+//
+//   sharded  The learnable parameters are partitioned into shards with separate
+//            update functions and locks, so workers can update different
+//            shards at the same time.
+//   hogwild  Gradients are applied without locking. Each concurrent update
+//            uses its own update instance. Optimizer state tensors like the
+//            momentum and moment estimates are shared globals, while scalar
+//            state like the Adam bias correction is kept per instance.
+//            Concurrent writes to the same parameter can overwrite each other.
+//
+// Shards are made up of whole variables, so a single large variable like an
+// embedding matrix is always updated under one lock in sharded mode. Use
+// hogwild updates to avoid contention on large variables.
+//
+// With lazy updates, the optimizer only updates the rows of the parameters and
+// the optimizer state that have gradients, i.e. the rows selected by the
+// sparsity bitmap of the gradient. This is used for large embedding matrices,
+// where the gradient only covers the features in the batch (see the
+// sparse_threshold compiler option). Optimizer state for the other rows is
+// not decayed until the row is updated again.
 class Optimizer {
  public:
   // Mapping from learnable variables to their gradients.
   typedef std::map<Flow::Variable *, Flow::Variable *> GradientMap;
 
   Optimizer(const string &name = "optimizer") : name_(name) {}
-  virtual ~Optimizer() { delete data_; }
+  virtual ~Optimizer();
 
   // Build update function for applying gradients.
   void Build(Flow *flow);
@@ -69,48 +95,131 @@ class Optimizer {
   // Initialize gradient update for model.
   void Initialize(const Network &network);
 
-  // Apply gradients to update learnable parameters.
+  // Apply gradients to update learnable parameters. This can be called
+  // concurrently from multiple threads if concurrent() is true.
   virtual void Apply(const std::vector<Instance *> &gradients);
 
+  // Apply gradients to update learnable parameters from multiple threads.
+  // The update is serialized by the mutex unless the optimizer is concurrent.
+  void Apply(const std::vector<Instance *> &gradients, Mutex *mu);
+
   // Decay learning rate. Returns new learning rate.
   virtual float DecayLearningRate() { return 0.0; }
 
-  // Data instance for optimizer.
-  Instance *data() const { return data_; }
+  // Data instance for optimizer (first shard).
+  Instance *data() const {
+    return shards_.empty() ? nullptr : shards_[0]->data;
+  }
 
   // Norm clipping threshold.
   float clipping_threshold() const { return clipping_threshold_; }
   void set_clipping_threshold(float t) { clipping_threshold_ = t; }
 
-  // Local or global norm clipping.
+  // Local or global norm clipping. For sharded optimizers, the global norm is
+  // computed over the gradients in each shard.
   bool local_clipping() const { return local_clipping_; }
   void set_local_clipping(bool b) { local_clipping_ = b; }
 
+  // Number of shards for the learnable parameters. This must be set before
+  // the update function is built.
+  int num_shards() const { return num_shards_; }
+  void set_num_shards(int n) { num_shards_ = n; }
+
+  // Apply gradients without locking.
+  bool hogwild() const { return hogwild_; }
+  void set_hogwild(bool b) { hogwild_ = b; }
+
+  // Check if gradients can be applied concurrently.
+  bool concurrent() const { return num_shards_ > 1 || hogwild_; }
+
+  // Only update rows with gradients for sparse gradients. This must be set
+  // before the update function is built.
+  bool lazy() const { return lazy_; }
+  void set_lazy(bool b) { lazy_ = b; }
+
  protected:
   // Let subclass build the parameter update using the gradient map.
   virtual void BuildOptimizer(const GradientMap &gradmap,
                               FlowBuilder *update) = 0;
 
-  // Let subclass initialize update function for optimizer.
-  virtual void InitializeOptimizer() = 0;
+  // Let subclass initialize new instance of update function.
+  virtual void InitializeInstance(Instance *data) = 0;
 
-  // Get parameter from network.
-  Tensor *GetParameter(const string &name) {
-    return data_->cell()->GetParameter(name);
+  // Get parameter in update function for instance.
+  static Tensor *GetParameter(Instance *data, const string &name) {
+    const Cell *cell = data->cell();
+    return cell->GetParameter(cell->name() + "/" + name);
   }
 
+  // Set scalar parameter in all update instances.
+  void SetParameter(const string &name, float value);
+
+  // Return gradient for variable scaled by the clipping factor. The scaling is
+  // done separately for each use of the gradient, so it can be fused into the
+  // update expressions.
+  Flow::Variable *Clip(FlowBuilder *tf, Flow::Variable *var,
+                       Flow::Variable *dv);
+
+  // Assign new value to learnable variable.
+  void Assign(FlowBuilder *tf, Flow::Variable *var, Flow::Variable *value);
+
+  // Assign new value to optimizer state variable and return reference to the
+  // updated state.
+  Flow::Variable *Accumulate(FlowBuilder *tf, Flow::Variable *var,
+                             Flow::Variable *value);
+
   // Name of optimizer.
   string name_;
 
-  // Mapping from gradient computation cell to instance variable in update.
-  std::map<Flow::Function *, Flow::Variable *> instance_;
-  std::map<const Cell *, Tensor *> refs_;
+ private:
+  // Update function for a shard of the learnable parameters.
+  struct Shard {
+    // Name of update function.
+    string name;
+
+    // Mapping from gradient computation function to instance variable in
+    // update function.
+    std::map<Flow::Function *, Flow::Variable *> instance;
+    std::map<const Cell *, Tensor *> refs;
+
+    // Update cell.
+    Cell *cell = nullptr;
+
+    // Data instance for updating the learnable parameters from the gradients.
+    Instance *data = nullptr;
+
+    // Idle update instances for hogwild updates.
+    std::vector<Instance *> idle;
+
+    // Lock for updating shard.
+    Mutex mu;
+  };
+
+  // Apply gradients to shard using update instance.
+  static void Update(Shard *shard, Instance *data,
+                     const std::vector<Instance *> &gradients);
 
-  // Data instance for updating the learnable parameters from the gradients.
-  Instance *data_ = nullptr;
+  // Get idle update instance for shard, or create a new one.
+  Instance *Acquire(Shard *shard);
+
+  // Return update instance for shard to the idle pool.
+  void Release(Shard *shard, Instance *data);
+
+  // Update functions for shards.
+  std::vector<Shard *> shards_;
+
+  // Clipping factors for the gradients of the shard being built.
+  std::map<Flow::Variable *, Flow::Variable *> clipping_;
+
+  // All update instances, and a lock for the instances and the idle pools.
+  std::vector<Instance *> instances_;
+  Mutex mu_;
 
   float clipping_threshold_ = 0.0;  // norm clipping threshold (0=no clipping)
   bool local_clipping_ = false;     // compute norm per tensor
+  int num_shards_ = 1;              // number of parameter shards
+  bool hogwild_ = false;            // lock-free updates
+  bool lazy_ = false;               // only update rows with gradients
 };
 
 // Stochastic gradient descent optimizer.
@@ -119,7 +228,7 @@ class GradientDescentOptimizer : public Optimizer {
   // Decay learning rate.
   float DecayLearningRate() override;
 
-  // Initial learning rate.
+  // Learning rate.
   float learning_rate() const { return lr_; }
   void set_learning_rate(float lr) { lr_ = lr; }
 
@@ -133,10 +242,9 @@ class GradientDescentOptimizer : public Optimizer {
 
  protected:
   void BuildOptimizer(const GradientMap &gradmap, FlowBuilder *update) override;
-  void InitializeOptimizer() override;
+  void InitializeInstance(Instance *data) override;
 
-  Tensor *alpha_ = nullptr;         // current learning rate
-  float lr_ = 0.01;                 // initial learning rate
+  float lr_ = 0.01;                 // current learning rate
   float decay_  = 1.0;              // learning rate decay
   float lambda_ = 0.0;              // regularization parameter (0=none)
 };
@@ -146,9 +254,6 @@ class MomentumOptimizer : public Optimizer {
  public:
   MomentumOptimizer(const string &name = "optimizer") : Optimizer(name) {}
 
-  // Apply gradients to update learnable parameters.
-  void Apply(const std::vector<Instance *> &gradients) override;
-
   // Decay learning rate.
   float DecayLearningRate() override;
 
@@ -166,13 +271,11 @@ class MomentumOptimizer : public Optimizer {
 
  protected:
   void BuildOptimizer(const GradientMap &gradmap, FlowBuilder *update) override;
-  void InitializeOptimizer() override;
+  void InitializeInstance(Instance *data) override;
 
-  Tensor *alpha_ = nullptr;         // current learning rate
-  float lr_ = 0.01;                 // initial learning rate
+  float lr_ = 0.01;                 // current learning rate
   float decay_  = 1.0;              // learning rate decay
   float momentum_ = 0.9;            // blending ratio for previous update
-  int num_linked_ = 0;              // number of linked updates
 };
 
 // Adam optimizer.
@@ -180,9 +283,6 @@ class AdamOptimizer : public Optimizer {
  public:
   AdamOptimizer(const string &name = "optimizer") : Optimizer(name) {}
 
-  // Apply gradients to update learnable parameters.
-  void Apply(const std::vector<Instance *> &gradients) override;
-
   // Decay learning rate.
   float DecayLearningRate() override;
 
@@ -208,10 +308,9 @@ class AdamOptimizer : public Optimizer {
 
  protected:
   void BuildOptimizer(const GradientMap &gradmap, FlowBuilder *update) override;
-  void InitializeOptimizer() override;
+  void InitializeInstance(Instance *data) override;
 
-  Tensor *alpha_ = nullptr;         // current learning rate
-  float lr_ = 0.01;                 // initial learning rate
+  float lr_ = 0.01;                 // current learning rate
   float decay_  = 1.0;              // learning rate decay
 
   float beta1_ = 0.9;               // mean decay rate
@@ -19,6 +19,7 @@
 #include "sling/base/logging.h"
 #include "sling/base/macros.h"
 #include "sling/myelin/compute.h"
+#include "sling/myelin/perf-counters.h"
 
 namespace sling {
 namespace myelin {
@@ -1582,7 +1583,7 @@ void MacroAssembler::Reduce(Reduction op, Type type,
 
 void MacroAssembler::UpdateCounter(int64 *counter, int64 value) {
   CHECK(!rr_.used(rdi));
-  movp(rdi, counter);
+  load_extern(rdi, counter, "myelin_flops");
   lock();
   addq(Operand(rdi), Immediate(value));
 }
@@ -1628,6 +1629,84 @@ void MacroAssembler::WaitForMainTask() {
   CallInstanceFunction(runtime_->SyncMainFunc(), "myelin_sync_main");
 }
 
+int MacroAssembler::Partitions(int64 complexity, int64 units) {
+  // Check that runtime supports parallel execution of partitions.
+  int threads = runtime_->ParallelThreads();
+  if (threads <= 1 || options_.parallel_threshold <= 0) return 1;
+  if (runtime_->ParallelForFunc() == nullptr) return 1;
+
+  // Each partition must have enough work to amortize the cost of dispatching
+  // it to another thread.
+  int64 partitions = complexity / options_.parallel_threshold;
+  if (partitions > threads) partitions = threads;
+  if (partitions > units) partitions = units;
+  return partitions > 1 ? partitions : 1;
+}
+
+void MacroAssembler::ParallelFor(int partitions, jit::Label *entry) {
+  Runtime::ParallelFunc func = runtime_->ParallelForFunc();
+  CHECK(func != nullptr) << "Runtime does not support parallel steps";
+
+  // Build parallel task structure on the stack. The stack is aligned for the
+  // call to the runtime and the original stack pointer is saved after the
+  // task structure.
+  const int saved_rsp = sizeof(ParallelTask);
+  movq(rax, rsp);
+  andq(rsp, Immediate(-16));
+  subq(rsp, Immediate((sizeof(ParallelTask) + sizeof(void *) + 15) & ~15));
+  movq(Operand(rsp, saved_rsp), rax);
+  leaq(rax, Operand(entry));
+  movq(Operand(rsp, offsetof(ParallelTask, func)), rax);
+  movq(Operand(rsp, offsetof(ParallelTask, arg)), datareg);
+  movq(Operand(rsp, offsetof(ParallelTask, partitions)),
+       Immediate(partitions));
+
+  // Call runtime to compute partitions.
+  movq(arg_reg_1, rsp);
+  call_extern(reinterpret_cast<void *>(func), "myelin_parallel_for");
+
+  // Restore stack pointer.
+  movq(rsp, Operand(rsp, saved_rsp));
+}
+
+void MacroAssembler::BeginPartition(Register index) {
+  // Zero upper part of YMM register if CPU needs it to avoid AVX-SSE transition
+  // penalties.
+  if (CPU::VZeroNeeded() && Enabled(AVX)) {
+    vzeroupper();
+  }
+
+  // Save preserved registers on stack.
+  if (rr_.saved(rbp)) pushq(rbp);
+  if (rr_.saved(rbx)) pushq(rbx);
+  if (rr_.saved(r12)) pushq(r12);
+  if (rr_.saved(r13)) pushq(r13);
+  if (rr_.saved(r14)) pushq(r14);
+  if (rr_.saved(r15)) pushq(r15);
+
+  // Get arguments.
+  if (!datareg.is(arg_reg_1)) movq(datareg, arg_reg_1);
+  if (!index.is(arg_reg_2)) movq(index, arg_reg_2);
+}
+
+void MacroAssembler::EndPartition() {
+  // Restore preserved registers from stack.
+  if (rr_.saved(r15)) popq(r15);
+  if (rr_.saved(r14)) popq(r14);
+  if (rr_.saved(r13)) popq(r13);
+  if (rr_.saved(r12)) popq(r12);
+  if (rr_.saved(rbx)) popq(rbx);
+  if (rr_.saved(rbp)) popq(rbp);
+
+  // Zero upper part of YMM register if CPU needs it to avoid AVX-SSE transition
+  // penalties.
+  if (CPU::VZeroNeeded() && Enabled(AVX)) {
+    vzeroupper();
+  }
+
+  ret(0);
+}
+
 void MacroAssembler::CallInstanceFunction(void (*func)(void *),
                                           const string &symbol) {
   if (func != nullptr) {
@@ -1647,6 +1726,29 @@ void MacroAssembler::IncrementInvocations(int offset) {
   }
 }
 
+void MacroAssembler::SampleCounters(int offset, int disp) {
+  // Timing instrumentation must be active.
+  CHECK(options_.profiling);
+
+  // Call counter sampler with the address of the step counters.
+  if (disp < 0) {
+    xorq(arg_reg_1, arg_reg_1);
+  } else if (options_.ref_profiler()) {
+    movq(arg_reg_1, Operand(datareg, offset));
+    addq(arg_reg_1, Immediate(disp));
+  } else {
+    leaq(arg_reg_1, Operand(datareg, offset + disp));
+  }
+  void *target = reinterpret_cast<void *>(PerfCounters::Sample);
+  call_extern(target, "myelin_sample_counters");
+
+  // Restart step timer.
+  rdtsc();
+  shlq(rdx, Immediate(32));
+  orq(rax, rdx);
+  movq(tsreg, rax);
+}
+
 void MacroAssembler::TimeStep(int offset, int disp) {
   // Timing instrumentation must be active.
   CHECK(options_.profiling);
@@ -441,6 +441,12 @@ class MacroAssembler : public jit::Assembler {
   // Generate timing for step and update instance block.
   void TimeStep(int offset, int disp);
 
+  // Add hardware counter increments since last sample to the counters at disp
+  // in the instance block. If disp is negative, the counters are only sampled
+  // for the next step. All caller-saved registers are clobbered, and the step
+  // timer is restarted so the sampling is not included in the step timing.
+  void SampleCounters(int offset, int disp);
+
   // Start task.
   void StartTask(int offset, int32 id, int32 index, Label *entry);
 
@@ -450,6 +456,23 @@ class MacroAssembler : public jit::Assembler {
   // Wait for main task to complete.
   void WaitForMainTask();
 
+  // Return the number of partitions for computing a step with the given
+  // complexity in parallel, where the computation can be split into at most
+  // the given number of units. Returns 1 if the step should not be split.
+  int Partitions(int64 complexity, int64 units);
+
+  // Call runtime to compute all partitions of a step in parallel with the
+  // partition function at the entry label. All caller-saved registers are
+  // clobbered by the call.
+  void ParallelFor(int partitions, Label *entry);
+
+  // Generate prologue for partition function. The partition number is loaded
+  // into the index register.
+  void BeginPartition(Register index);
+
+  // Generate epilogue for partition function.
+  void EndPartition();
+
   // Reset register usage.
   void ResetRegisterUsage();
 
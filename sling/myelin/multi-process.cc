@@ -114,6 +114,117 @@ class Worker {
   std::thread thread_;
 };
 
+// Thread pool for computing the partitions of parallel tasks. The calling
+// thread computes partitions together with the pool threads. If the pool is
+// already busy with another parallel task, the partitions are computed by the
+// calling thread alone.
+class ParallelPool {
+ public:
+  // Start additional pool threads until the pool has at least the requested
+  // number of threads.
+  void Reserve(int size) {
+    std::lock_guard<std::mutex> busy(busy_);
+    while (static_cast<int>(threads_.size()) < size) {
+      threads_.emplace_back(&ParallelPool::Run, this);
+    }
+  }
+
+  // Stop pool threads.
+  ~ParallelPool() {
+    mu_.lock();
+    stop_ = true;
+    mu_.unlock();
+    ready_.notify_all();
+    for (auto &t : threads_) t.join();
+  }
+
+  // Compute all partitions of parallel task.
+  void Compute(ParallelTask *task) {
+    // Compute partitions sequentially if the pool is busy.
+    std::unique_lock<std::mutex> busy(busy_, std::try_to_lock);
+    if (!busy.owns_lock() || threads_.empty()) {
+      for (int64 i = 0; i < task->partitions; ++i) task->func(task->arg, i);
+      return;
+    }
+
+    // Publish task to pool threads.
+    std::unique_lock<std::mutex> lock(mu_);
+    task_ = task;
+    next_ = 0;
+    remaining_ = task->partitions;
+    lock.unlock();
+    ready_.notify_all();
+
+    // Compute partitions in calling thread.
+    lock.lock();
+    while (next_ < task->partitions) {
+      int64 partition = next_++;
+      lock.unlock();
+      task->func(task->arg, partition);
+      lock.lock();
+      remaining_--;
+    }
+
+    // Wait until all partitions have been computed.
+    while (remaining_ > 0) done_.wait(lock);
+    task_ = nullptr;
+  }
+
+  // Return the shared thread pool.
+  static ParallelPool *Shared() {
+    static ParallelPool *pool = new ParallelPool();
+    return pool;
+  }
+
+  // Runtime function for computing partitions with the shared pool.
+  static void ParallelFor(ParallelTask *task) {
+    Shared()->Compute(task);
+  }
+
+ private:
+  // Pool thread.
+  void Run() {
+    std::unique_lock<std::mutex> lock(mu_);
+    for (;;) {
+      // Wait for partition to compute.
+      while (task_ == nullptr || next_ >= task_->partitions) {
+        if (stop_) return;
+        ready_.wait(lock);
+      }
+
+      // Compute next partition.
+      ParallelTask *task = task_;
+      int64 partition = next_++;
+      lock.unlock();
+      task->func(task->arg, partition);
+      lock.lock();
+
+      // Signal completion of the last partition.
+      if (--remaining_ == 0) done_.notify_one();
+    }
+  }
+
+  // Lock held by the thread currently using the pool.
+  std::mutex busy_;
+
+  // Mutex and signals for task distribution.
+  std::mutex mu_;
+  std::condition_variable ready_;
+  std::condition_variable done_;
+
+  // Current parallel task, next partition to compute, and the number of
+  // partitions not yet completed.
+  ParallelTask *task_ = nullptr;
+  int64 next_ = 0;
+  int64 remaining_ = 0;
+
+  // Flag for stopping pool threads.
+  bool stop_ = false;
+
+  // Pool threads.
+  std::vector<std::thread> threads_;
+};
+
 MultiProcessorRuntime::~MultiProcessorRuntime() {
   // Stop all workers.
   for (auto *w : workers_) delete w;
@@ -194,6 +305,12 @@ Runtime::TaskFunc MultiProcessorRuntime::WaitTaskFunc() {
   return Worker::Wait;
 }
 
+Runtime::ParallelFunc MultiProcessorRuntime::ParallelForFunc() {
+  // The calling thread computes partitions together with the pool threads.
+  ParallelPool::Shared()->Reserve(parallel_threads_ - 1);
+  return ParallelPool::ParallelFor;
+}
+
 }  // namespace myelin
 }  // namespace sling
 
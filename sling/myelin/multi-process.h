@@ -20,6 +20,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 namespace sling {
 namespace myelin {
@@ -53,12 +54,23 @@ class MultiProcessorRuntime : public Runtime {
   TaskFunc StartTaskFunc() override;
   TaskFunc WaitTaskFunc() override;
 
+  // Intra-step parallelism using a thread pool shared by all runtimes.
+  int ParallelThreads() override { return parallel_threads_; }
+  ParallelFunc ParallelForFunc() override;
+
+  // Set the maximum number of threads for computing partitions of a step. If
+  // this is set to one, steps are not split into partitions.
+  void set_parallel_threads(int threads) { parallel_threads_ = threads; }
+
  private:
   // Mutex for synchronizing access to worker pool.
   std::mutex mu_;
 
   // Worker pool.
   std::vector<Worker *> workers_;
+
+  // Maximum number of threads for computing partitions of a step.
+  int parallel_threads_ = std::thread::hardware_concurrency();
 };
 
 }  // namespace myelin
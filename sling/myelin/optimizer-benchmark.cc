@@ -0,0 +1,272 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark for multi-threaded training with the different optimizer update
+// modes. A synthetic classification model with a large embedding matrix and a
+// feed-forward layer is trained with a fixed number of parameter updates
+// distributed over a number of worker threads. For each update mode and
+// thread count, the update throughput and the loss on held-out examples are
+// reported:
+//
+//   locked   all updates are serialized by a global lock
+//   sharded  parameters are split into shards with separate locks
+//   hogwild  updates are applied without locking
+
+#include <math.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "sling/base/clock.h"
+#include "sling/base/flags.h"
+#include "sling/base/init.h"
+#include "sling/base/logging.h"
+#include "sling/base/types.h"
+#include "sling/myelin/builder.h"
+#include "sling/myelin/compiler.h"
+#include "sling/myelin/compute.h"
+#include "sling/myelin/flow.h"
+#include "sling/myelin/gradient.h"
+#include "sling/myelin/learning.h"
+#include "sling/string/numbers.h"
+#include "sling/util/mutex.h"
+#include "sling/util/random.h"
+#include "sling/util/thread.h"
+
+DEFINE_string(modes, "locked,sharded,hogwild", "Update modes to benchmark");
+DEFINE_string(threads, "1,2,4,8", "Thread counts to benchmark");
+DEFINE_string(optimizer, "adam", "Optimizer (sgd, momentum, adam)");
+DEFINE_bool(lazy, false, "Only update embedding rows with gradients");
+DEFINE_int32(shards, 4, "Number of parameter shards in sharded mode");
+DEFINE_int32(updates, 2000, "Number of parameter updates per run");
+DEFINE_int32(batch_size, 16, "Number of examples per update");
+DEFINE_int32(vocabulary, 100000, "Number of feature embeddings");
+DEFINE_int32(dims, 64, "Embedding dimension");
+DEFINE_int32(hidden, 128, "Hidden layer size");
+DEFINE_int32(classes, 16, "Number of output classes");
+DEFINE_int32(features, 8, "Number of features per example");
+DEFINE_int32(eval_examples, 2000, "Number of held-out evaluation examples");
+DEFINE_double(learning_rate, 0.001, "Learning rate");
+
+using namespace sling;
+using namespace sling::myelin;
+
+// Synthetic classification task. Each feature belongs to a class, and an
+// example for a class has mostly features from that class mixed with random
+// features.
+class SyntheticTask {
+ public:
+  SyntheticTask() {
+    Random rnd;
+    rnd.seed(1);
+    by_class_.resize(FLAGS_classes);
+    for (int f = 0; f < FLAGS_vocabulary; ++f) {
+      by_class_[rnd.UniformInt(FLAGS_classes)].push_back(f);
+    }
+  }
+
+  // Generate random example. Returns the class for the example.
+  int Sample(Random *rnd, int *features) const {
+    int label = rnd->UniformInt(FLAGS_classes);
+    const std::vector<int> &members = by_class_[label];
+    for (int i = 0; i < FLAGS_features; ++i) {
+      if (rnd->UniformProb() < 0.7) {
+        features[i] = members[rnd->UniformInt(members.size())];
+      } else {
+        features[i] = rnd->UniformInt(FLAGS_vocabulary);
+      }
+    }
+    return label;
+  }
+
+ private:
+  // Features for each class.
+  std::vector<std::vector<int>> by_class_;
+};
+
+// Model trained with one update mode.
+class Model {
+ public:
+  Model(const string &mode) {
+    // Build classifier.
+    Flow::Function *func = flow_.AddFunction("classifier");
+    FlowBuilder f(&flow_, func);
+    auto *embeddings = f.RandomNormal(
+        f.Parameter("embeddings", DT_FLOAT, {FLAGS_vocabulary, FLAGS_dims}));
+    features_ = f.Placeholder("features", DT_INT32, {1, FLAGS_features});
+    auto *encoding = f.GatherSum(embeddings, features_);
+    logits_ = f.Name(f.FFLayers(encoding, {FLAGS_hidden, FLAGS_classes},
+                                -1, true, "Relu"), "logits");
+
+    // Build gradient and loss.
+    Flow::Function *gfunc = Gradient(&flow_, func);
+    Flow::Variable *dlogits = flow_.GradientVar(logits_);
+    Flow::Variable *primal = flow_.PrimalVar(func);
+    loss_.Build(&flow_, logits_, dlogits);
+
+    // Build optimizer.
+    if (FLAGS_optimizer == "momentum") {
+      auto *momentum = new MomentumOptimizer();
+      momentum->set_learning_rate(FLAGS_learning_rate);
+      optimizer_ = momentum;
+    } else if (FLAGS_optimizer == "adam") {
+      auto *adam = new AdamOptimizer();
+      adam->set_learning_rate(FLAGS_learning_rate);
+      optimizer_ = adam;
+    } else {
+      auto *sgd = new GradientDescentOptimizer();
+      sgd->set_learning_rate(FLAGS_learning_rate);
+      optimizer_ = sgd;
+    }
+    if (mode == "sharded") optimizer_->set_num_shards(FLAGS_shards);
+    if (mode == "hogwild") optimizer_->set_hogwild(true);
+    optimizer_->set_lazy(FLAGS_lazy);
+    optimizer_->Build(&flow_);
+
+    // Compile model.
+    compiler_.Compile(&flow_, &net_);
+    classifier_ = net_.GetCell(func->name);
+    gclassifier_ = net_.GetCell(gfunc->name);
+    features_tensor_ = net_.GetParameter(features_->name);
+    logits_tensor_ = net_.GetParameter(logits_->name);
+    dlogits_tensor_ = net_.GetParameter(dlogits->name);
+    primal_tensor_ = net_.GetParameter(primal->name);
+    loss_.Initialize(net_);
+    optimizer_->Initialize(net_);
+    net_.InitModelParameters(1);
+  }
+
+  ~Model() { delete optimizer_; }
+
+  // Train model with worker thread until the number of updates is reached.
+  void Train(const SyntheticTask &task, int index, std::atomic<int> *updates) {
+    Random rnd;
+    rnd.seed(index + 100);
+    Instance data(classifier_);
+    Instance gdata(gclassifier_);
+    std::vector<Instance *> gradients{&gdata};
+    int *features = data.Get<int>(features_tensor_);
+    float *logits = data.Get<float>(logits_tensor_);
+    float *dlogits = gdata.Get<float>(dlogits_tensor_);
+
+    while (updates->fetch_add(1) < FLAGS_updates) {
+      // Compute gradients for batch.
+      gdata.Clear();
+      gdata.Set(primal_tensor_, &data);
+      for (int b = 0; b < FLAGS_batch_size; ++b) {
+        int label = task.Sample(&rnd, features);
+        data.Compute();
+        loss_.Compute(logits, label, dlogits);
+        gdata.Compute();
+      }
+
+      // Apply gradients.
+      optimizer_->Apply(gradients, &update_mu_);
+    }
+  }
+
+  // Compute average loss on held-out examples.
+  float Evaluate(const SyntheticTask &task) {
+    Random rnd;
+    rnd.seed(7);
+    Instance data(classifier_);
+    Instance gdata(gclassifier_);
+    int *features = data.Get<int>(features_tensor_);
+    float *logits = data.Get<float>(logits_tensor_);
+    float *dlogits = gdata.Get<float>(dlogits_tensor_);
+    float loss = 0.0;
+    for (int i = 0; i < FLAGS_eval_examples; ++i) {
+      int label = task.Sample(&rnd, features);
+      data.Compute();
+      loss += loss_.Compute(logits, label, dlogits);
+    }
+    return loss / FLAGS_eval_examples;
+  }
+
+ private:
+  // Model flow and input/output variables.
+  Flow flow_;
+  Flow::Variable *features_;
+  Flow::Variable *logits_;
+
+  // Loss function and optimizer.
+  CrossEntropyLoss loss_;
+  Optimizer *optimizer_ = nullptr;
+
+  // Compiled model.
+  Compiler compiler_;
+  Network net_;
+  Cell *classifier_;
+  Cell *gclassifier_;
+  Tensor *features_tensor_;
+  Tensor *logits_tensor_;
+  Tensor *dlogits_tensor_;
+  Tensor *primal_tensor_;
+
+  // Lock for serializing updates in locked mode.
+  Mutex update_mu_;
+};
+
+// Split comma-separated list.
+static std::vector<string> SplitList(const string &list) {
+  std::vector<string> items;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(',', start);
+    if (end == string::npos) end = list.size();
+    if (end > start) items.push_back(list.substr(start, end - start));
+    start = end + 1;
+  }
+  return items;
+}
+
+int main(int argc, char *argv[]) {
+  InitProgram(&argc, &argv);
+
+  SyntheticTask task;
+  std::vector<string> modes = SplitList(FLAGS_modes);
+  std::vector<int> thread_counts;
+  for (const string &t : SplitList(FLAGS_threads)) {
+    int n;
+    CHECK(safe_strto32(t, &n)) << t;
+    thread_counts.push_back(n);
+  }
+
+  printf("%-8s %8s %12s %12s %10s\n",
+         "mode", "threads", "updates/s", "examples/s", "loss");
+  for (const string &mode : modes) {
+    for (int threads : thread_counts) {
+      Model model(mode);
+      std::atomic<int> updates{0};
+      Clock clock;
+      clock.start();
+      WorkerPool pool;
+      pool.Start(threads, [&](int index) {
+        model.Train(task, index, &updates);
+      });
+      pool.Join();
+      clock.stop();
+
+      double secs = clock.secs();
+      printf("%-8s %8d %12.1f %12.1f %10.4f\n",
+             mode.c_str(), threads,
+             FLAGS_updates / secs,
+             FLAGS_updates * FLAGS_batch_size / secs,
+             model.Evaluate(task));
+      fflush(stdout);
+    }
+  }
+
+  return 0;
+}
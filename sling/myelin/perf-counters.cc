@@ -0,0 +1,135 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/myelin/perf-counters.h"
+
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "sling/base/logging.h"
+
+namespace sling {
+namespace myelin {
+
+// Hardware event for each counter.
+static const uint64 kEvents[PerfCounters::NUM_COUNTERS] = {
+  PERF_COUNT_HW_INSTRUCTIONS,
+  PERF_COUNT_HW_CACHE_MISSES,
+  PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+// Counter group for thread.
+struct CounterGroup {
+  bool initialized;                        // counters have been opened
+  int fds[PerfCounters::NUM_COUNTERS];     // counters; the first is the leader
+  int64 last[PerfCounters::NUM_COUNTERS];  // counter values at last sample
+};
+
+static thread_local CounterGroup group;
+
+// Open counter for event. The first counter is the group leader.
+static int OpenCounter(uint64 event, int leader) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = event;
+  attr.disabled = leader == -1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+// Close counters in group.
+static void CloseGroup(int *fds) {
+  for (int i = 0; i < PerfCounters::NUM_COUNTERS; ++i) {
+    if (fds[i] != -1) close(fds[i]);
+    fds[i] = -1;
+  }
+}
+
+// Open counter group for current thread. Returns false if the counters are
+// not available.
+static bool OpenGroup(int *fds) {
+  for (int i = 0; i < PerfCounters::NUM_COUNTERS; ++i) fds[i] = -1;
+  for (int i = 0; i < PerfCounters::NUM_COUNTERS; ++i) {
+    fds[i] = OpenCounter(kEvents[i], fds[0]);
+    if (fds[i] == -1) {
+      CloseGroup(fds);
+      return false;
+    }
+  }
+  ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+}
+
+// Read counter values for group.
+static bool ReadGroup(int fd, int64 *values) {
+  // The group is read as the number of counters followed by the values.
+  uint64 data[PerfCounters::NUM_COUNTERS + 1];
+  if (read(fd, data, sizeof(data)) != sizeof(data)) return false;
+  for (int i = 0; i < PerfCounters::NUM_COUNTERS; ++i) {
+    values[i] = data[i + 1];
+  }
+  return true;
+}
+
+void PerfCounters::Sample(int64 *counters) {
+  CounterGroup &g = group;
+  if (!g.initialized) {
+    g.initialized = true;
+    if (!OpenGroup(g.fds)) {
+      static bool warned = false;
+      if (!warned) {
+        LOG(WARNING) << "Hardware performance counters not available";
+        warned = true;
+      }
+    } else if (!ReadGroup(g.fds[0], g.last)) {
+      CloseGroup(g.fds);
+    }
+  }
+  if (g.fds[0] == -1) return;
+
+  int64 values[NUM_COUNTERS];
+  if (!ReadGroup(g.fds[0], values)) return;
+  if (counters != nullptr) {
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+      counters[i] += values[i] - g.last[i];
+    }
+  }
+  for (int i = 0; i < NUM_COUNTERS; ++i) g.last[i] = values[i];
+}
+
+bool PerfCounters::Supported() {
+  int fds[NUM_COUNTERS];
+  if (!OpenGroup(fds)) return false;
+  CloseGroup(fds);
+  return true;
+}
+
+const char *PerfCounters::Name(int counter) {
+  switch (counter) {
+    case INSTRUCTIONS: return "instructions";
+    case CACHE_MISSES: return "cache misses";
+    case BRANCH_MISSES: return "branch misses";
+    default: return "???";
+  }
+}
+
+}  // namespace myelin
+}  // namespace sling
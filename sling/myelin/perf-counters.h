@@ -0,0 +1,52 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_MYELIN_PERF_COUNTERS_H_
+#define SLING_MYELIN_PERF_COUNTERS_H_
+
+#include "sling/base/types.h"
+
+namespace sling {
+namespace myelin {
+
+// Hardware performance counters for profiling steps in cell computations. The
+// counters are read with perf_event_open(2) and only count user-space events
+// for the calling thread. The counters for a thread are opened on first use.
+// If the counters are not available, e.g. because of the perf_event_paranoid
+// setting, the counters are reported as zero.
+class PerfCounters {
+ public:
+  // Hardware counters sampled for each step.
+  enum Counter {
+    INSTRUCTIONS,     // retired instructions
+    CACHE_MISSES,     // last level cache misses
+    BRANCH_MISSES,    // mispredicted branches
+    NUM_COUNTERS,
+  };
+
+  // Add the counter increments since the last sample on the current thread to
+  // the counters. If counters is null, only the last sample is updated.
+  static void Sample(int64 *counters);
+
+  // Check if hardware counters can be read on this machine.
+  static bool Supported();
+
+  // Return name of counter.
+  static const char *Name(int counter);
+};
+
+}  // namespace myelin
+}  // namespace sling
+
+#endif  // SLING_MYELIN_PERF_COUNTERS_H_
@@ -19,10 +19,15 @@
 
 #include "sling/myelin/profile.h"
 
+#include "sling/base/flags.h"
 #include "sling/base/types.h"
+#include "sling/file/file.h"
 #include "sling/string/printf.h"
 #include "third_party/jit/cpu.h"
 
+DEFINE_string(profile_svg, "",
+              "File name prefix for data profile diagrams with step timing");
+
 namespace sling {
 namespace myelin {
 
@@ -34,6 +39,12 @@ static const char *header = "| percent |  accum% |      time    |   gflops |"
                             " kernel"
                             "                        | t | step\n";
 
+static const char *counter_divider = "+--------------+-------+------------"
+                                     "+-------------";
+
+static const char *counter_header = "| instructions |   IPC | cache miss "
+                                    "| branch miss ";
+
 static float max_giga_flops = 100000;
 
 static string TimeStr(float us) {
@@ -64,6 +75,9 @@ void Profile::Initialize(int64 *data, Order order) {
   total_ = overhead_;
   total_complexity_ = 0;
   tasks_ = reinterpret_cast<TaskTiming *>(timing_ + steps());
+  if (cell()->network()->options().hardware_counters) {
+    counters_ = reinterpret_cast<int64 *>(tasks_ + tasks());
+  }
 
   steps_.resize(cell()->steps().size());
   for (int i = 0; i < steps(); ++i) {
@@ -96,10 +110,31 @@ void Profile::Initialize(int64 *data, Order order) {
 
     total_ += timing_[i];
     total_complexity_ += complexity(i);
+    if (has_counters()) {
+      int64 *counters = counters_ + i * PerfCounters::NUM_COUNTERS;
+      for (int c = 0; c < PerfCounters::NUM_COUNTERS; ++c) {
+        total_counters_[c] += counters[c];
+      }
+    }
   }
   sort(steps_.begin(), steps_.end());
 }
 
+int Profile::position(const Step *step) const {
+  for (int i = 0; i < steps(); ++i) {
+    if (steps_[i].step == step) return i;
+  }
+  return -1;
+}
+
+// Divider or header line split at the kernel column where the hardware
+// counter columns are inserted.
+static string ReportLine(const char *line, const char *counters) {
+  string str(line);
+  if (counters != nullptr) str.insert(46, counters);
+  return str;
+}
+
 string Profile::ASCIIReport() const {
   // Check if profiling has been enabled.
   if (!enabled()) return "No profile";
@@ -155,9 +190,12 @@ string Profile::ASCIIReport() const {
   report.append("\n");
 
   // Output header.
-  report.append(divider);
-  report.append(header);
-  report.append(divider);
+  const char *cdiv = has_counters() ? counter_divider : nullptr;
+  const char *chdr = has_counters() ? counter_header : nullptr;
+  string div = ReportLine(divider, cdiv);
+  report.append(div);
+  report.append(ReportLine(header, chdr));
+  report.append(div);
 
   // Output profile for each step.
   float accum = 0;
@@ -177,8 +215,17 @@ string Profile::ASCIIReport() const {
     if (gflops >= max_giga_flops) gflops = 0;
     accum += percent(i);
     StringAppendF(&report,
-                  "| %6.2f%% | %6.2f%% |%s |%9.3f | %-30s|%-2s | %s",
-                  percent(i), accum, TimeStr(time(i)).c_str(), gflops,
+                  "| %6.2f%% | %6.2f%% |%s |%9.3f ",
+                  percent(i), accum, TimeStr(time(i)).c_str(), gflops);
+    if (has_counters()) {
+      StringAppendF(&report,
+                    "| %12" PRId64 " | %5.2f | %10" PRId64 " | %11" PRId64 " ",
+                    counter(i, PerfCounters::INSTRUCTIONS), ipc(i),
+                    counter(i, PerfCounters::CACHE_MISSES),
+                    counter(i, PerfCounters::BRANCH_MISSES));
+    }
+    StringAppendF(&report,
+                  "| %-30s|%-2s | %s",
                   name.c_str(),
                   tid.c_str(),
                   step(i)->name().c_str());
@@ -193,22 +240,33 @@ string Profile::ASCIIReport() const {
   // Output overhead.
   if (overhead_ > 0) {
     StringAppendF(&report,
-                  "| %6.2f%% | %6.2f%% |%s |%9.3f | %-30s|%-2s | %s\n",
+                  "| %6.2f%% | %6.2f%% |%s |%9.3f ",
                   overhead_percent(),
                   100.0,
-                  TimeStr(overhead_time()).c_str(), 0.0, "", "",
-                  "Entry & Exit");
+                  TimeStr(overhead_time()).c_str(), 0.0);
+    if (has_counters()) {
+      StringAppendF(&report, "| %12s | %5s | %10s | %11s ", "", "", "", "");
+    }
+    StringAppendF(&report, "| %-30s|%-2s | %s\n", "", "", "Entry & Exit");
   }
 
   // Output totals.
   float gflops = gigaflops();
   if (gflops >= max_giga_flops) gflops = 0;
 
-  report.append(divider);
+  report.append(div);
   StringAppendF(&report,
-                "| 100.00%% | 100.00%% |%s |%9.3f | %-30s|   |\n",
-                TimeStr(time()).c_str(), gflops, "TOTAL");
-  report.append(divider);
+                "| 100.00%% | 100.00%% |%s |%9.3f ",
+                TimeStr(time()).c_str(), gflops);
+  if (has_counters()) {
+    StringAppendF(&report,
+                  "| %12" PRId64 " | %5.2f | %10" PRId64 " | %11" PRId64 " ",
+                  counter(PerfCounters::INSTRUCTIONS), ipc(),
+                  counter(PerfCounters::CACHE_MISSES),
+                  counter(PerfCounters::BRANCH_MISSES));
+  }
+  StringAppendF(&report, "| %-30s|   |\n", "TOTAL");
+  report.append(div);
 
   // Output task timing.
   if (tasks() > 0) {
@@ -386,10 +444,24 @@ string DataProfile::AsSVG() {
   for (int i = 0; i < cell_->steps().size(); ++i) {
     Step *step = cell_->steps()[i];
     stepmap[step] = i;
+    string label = step->name() + " (" + step->type() + ")";
+    int idx = profile_ != nullptr ? profile_->position(step) : -1;
+    if (idx != -1 && !step->noop()) {
+      StringAppendF(&label, " %.3f μs", profile_->time(idx));
+      if (profile_->has_counters()) {
+        StringAppendF(&label,
+            ", %" PRId64 " instr, %.2f IPC, %" PRId64 " cache miss, "
+            "%" PRId64 " branch miss",
+            profile_->counter(idx, PerfCounters::INSTRUCTIONS),
+            profile_->ipc(idx),
+            profile_->counter(idx, PerfCounters::CACHE_MISSES),
+            profile_->counter(idx, PerfCounters::BRANCH_MISSES));
+      }
+    }
     StringAppendF(&svg,
-        "<text x=\"%0.f\" y=\"%0.f\">%s (%s)</text>\n",
+        "<text x=\"%0.f\" y=\"%0.f\">%s</text>\n",
         data_width + label_dx, i * step_height + label_dy,
-        step->name().c_str(), step->type().c_str());
+        Escape(label).c_str());
     if (i > 0) {
       StringAppendF(&svg,
           "<line x1=\"%0.f\" y1=\"%0.f\" x2=\"%0.f\" y2=\"%0.f\" "
@@ -475,6 +547,16 @@ string DataProfile::AsSVG() {
 void LogProfile(const Network &net) {
   if (net.options().global_profiler) {
     LOG(INFO) << "Profiling report:\n" << ProfileReport(net);
+
+    // Optionally output data layout diagrams with step timing.
+    if (!FLAGS_profile_svg.empty()) {
+      for (Cell *cell : net.cells()) {
+        Profile profile(cell->profile_summary());
+        DataProfile data_profile(cell, &profile);
+        string filename = FLAGS_profile_svg + cell->name() + ".svg";
+        File::WriteContents(filename, data_profile.AsSVG());
+      }
+    }
   }
 }
 
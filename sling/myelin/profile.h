@@ -21,6 +21,7 @@
 #include "sling/base/clock.h"
 #include "sling/base/types.h"
 #include "sling/myelin/compute.h"
+#include "sling/myelin/perf-counters.h"
 
 namespace sling {
 namespace myelin {
@@ -133,6 +134,38 @@ class Profile {
     return tasks_[tidx].wait / (Clock::mhz() * invocations_);
   }
 
+  // Check if hardware counters have been sampled for steps.
+  bool has_counters() const { return counters_ != nullptr; }
+
+  // Hardware counter value per invocation for step.
+  int64 counter(int idx, int c) const {
+    if (invocations_ == 0) return 0;
+    int index = steps_[idx].index;
+    return counters_[index * PerfCounters::NUM_COUNTERS + c] / invocations_;
+  }
+
+  // Hardware counter value per invocation for all steps.
+  int64 counter(int c) const {
+    return invocations_ > 0 ? total_counters_[c] / invocations_ : 0;
+  }
+
+  // Instructions per CPU cycle for step.
+  double ipc(int idx) const {
+    int64 c = cycles(idx);
+    return c == 0 ? 0 : counter(idx, PerfCounters::INSTRUCTIONS) /
+                        static_cast<double>(c);
+  }
+
+  // Instructions per CPU cycle for computation.
+  double ipc() const {
+    int64 c = cycles();
+    return c == 0 ? 0 : counter(PerfCounters::INSTRUCTIONS) /
+                        static_cast<double>(c);
+  }
+
+  // Position of step in profile order.
+  int position(const Step *step) const;
+
   // Timing profile report in ASCII format.
   string ASCIIReport() const;
 
@@ -188,6 +221,13 @@ class Profile {
   // Array of clock cycle counts for each task.
   TaskTiming *tasks_ = nullptr;
 
+  // Array of hardware counters for each step or null if hardware counters are
+  // not enabled.
+  int64 *counters_ = nullptr;
+
+  // Hardware counter totals for computation.
+  int64 total_counters_[PerfCounters::NUM_COUNTERS] = {};
+
   // Sorted step information.
   std::vector<StepInfo> steps_;
 };
@@ -220,15 +260,18 @@ class ProfileOverview {
   double total_time_ = 0.0;      // total execution time in microseconds
 };
 
-// Data profile for cell instance tensor allocation.
+// Data profile for cell instance tensor allocation. If a profile is provided,
+// the step labels include the step timing and hardware counters.
 class DataProfile {
  public:
-  DataProfile(Cell *cell) : cell_(cell) {}
+  DataProfile(Cell *cell, const Profile *profile = nullptr)
+      : cell_(cell), profile_(profile) {}
 
   string AsSVG();
 
  private:
   Cell *cell_;
+  const Profile *profile_;
 };
 
 // Log profile report if profiling enabled.
@@ -0,0 +1,384 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/myelin/quantization.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "sling/base/logging.h"
+#include "sling/string/printf.h"
+#include "third_party/jit/cpu.h"
+
+namespace sling {
+namespace myelin {
+
+// Largest quantized value. The range is kept symmetric around zero.
+static const int kMaxQuantized = 127;
+
+// Round and clip value to quantized range.
+static int8 QuantizeValue(float value) {
+  float q = nearbyintf(value);
+  if (q > kMaxQuantized) q = kMaxQuantized;
+  if (q < -kMaxQuantized) q = -kMaxQuantized;
+  return static_cast<int8>(q);
+}
+
+// Convert float to IEEE half precision with rounding to nearest even.
+static uint16 FloatToHalf(float value) {
+  uint32 x;
+  memcpy(&x, &value, sizeof(float));
+  uint32 sign = (x >> 16) & 0x8000;
+  uint32 abs = x & 0x7fffffff;
+
+  // Infinity and NaN.
+  if (abs >= 0x7f800000) {
+    return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+  }
+
+  // Overflow to infinity.
+  if (abs >= 0x477ff000) return sign | 0x7c00;
+
+  // Denormals and underflow to zero.
+  if (abs < 0x38800000) {
+    int shift = 126 - (abs >> 23);
+    if (shift > 24) return sign;
+    uint32 mantissa = (abs & 0x7fffff) | 0x800000;
+    uint32 half = mantissa >> shift;
+    uint32 rest = mantissa & ((1 << shift) - 1);
+    uint32 midpoint = 1 << (shift - 1);
+    if (rest > midpoint || (rest == midpoint && (half & 1))) half++;
+    return sign | half;
+  }
+
+  // Normal numbers. Rounding may carry into the exponent.
+  uint32 half = ((abs - 0x38000000) >> 13);
+  uint32 rest = abs & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+  return sign | half;
+}
+
+// Convert float to bfloat16 with rounding to nearest even.
+static uint16 FloatToBfloat16(float value) {
+  uint32 x;
+  memcpy(&x, &value, sizeof(float));
+  if ((x & 0x7fffffff) > 0x7f800000) return (x >> 16) | 0x40;
+  return (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+}
+
+// Check if op can use a 16-bit floating point matrix for input.
+static bool SupportsHalfMatrix(Flow::Operation *op, Flow::Variable *W) {
+  if (op->outdegree() != 1 || op->outputs[0]->type != DT_FLOAT) return false;
+  if (op->type == "MatMul" || op->type == "MatMulRelu" ||
+      op->type == "MatMulAdd" || op->type == "MatMulAddRelu") {
+    // Vector-matrix multiplication, optionally fused with bias and relu.
+    bool bias = op->type == "MatMulAdd" || op->type == "MatMulAddRelu";
+    if (op->indegree() != (bias ? 3 : 2) || op->inputs[1] != W) return false;
+    if (bias && op->inputs[2]->type != DT_FLOAT) return false;
+    if (op->GetAttr("transpose_a", false)) return false;
+    if (op->GetAttr("transpose_b", false)) return false;
+    if (op->GetAttr("transpose_c", false)) return false;
+    Flow::Variable *x = op->inputs[0];
+    return x->type == DT_FLOAT && x->rank() == 2 && x->dim(0) == 1;
+  } else if (op->type == "Gather" ||
+             op->type == "GatherSum" ||
+             op->type == "GatherAvg") {
+    // Embedding lookup.
+    if (op->indegree() != 2 || op->inputs[0] != W) return false;
+    return op->inputs[1]->type == DT_INT32;
+  }
+  return false;
+}
+
+int ConvertToHalfPrecision(Flow *flow, Type type, int min_elements) {
+  CHECK(type == DT_HALF || type == DT_BFLOAT16);
+  bool supported = type == DT_HALF
+      ? jit::CPU::Enabled(jit::AVX) && jit::CPU::Enabled(jit::F16C)
+      : jit::CPU::Enabled(jit::AVX2);
+  if (!supported) {
+    LOG(WARNING) << "CPU does not support " << TypeTraits::of(type).name()
+                 << " kernels; keeping float matrices";
+    return 0;
+  }
+
+  // Find constant float matrices only used by ops with 16-bit kernels.
+  std::vector<Flow::Variable *> matrices;
+  for (Flow::Variable *var : flow->vars()) {
+    if (var->type != DT_FLOAT || var->rank() != 2) continue;
+    if (!var->constant() || var->elements() < min_elements) continue;
+    if (var->in() || var->out() || var->usages() == 0) continue;
+    bool eligible = true;
+    for (Flow::Operation *op : var->consumers) {
+      if (!SupportsHalfMatrix(op, var)) eligible = false;
+    }
+    if (eligible) matrices.push_back(var);
+  }
+
+  // Convert matrices.
+  const char *suffix = type == DT_HALF ? "/half" : "/bfloat16";
+  for (Flow::Variable *W : matrices) {
+    size_t elements = W->elements();
+    const float *src = reinterpret_cast<const float *>(W->data);
+    Flow::Variable *Wh = flow->AddVariable(W->name + suffix, type, W->shape);
+    Wh->size = elements * sizeof(uint16);
+    Wh->data = flow->AllocateMemory(Wh->size);
+    uint16 *dst = reinterpret_cast<uint16 *>(Wh->data);
+    for (size_t i = 0; i < elements; ++i) {
+      dst[i] = type == DT_HALF ? FloatToHalf(src[i]) : FloatToBfloat16(src[i]);
+    }
+
+    // Replace float matrix with the converted matrix.
+    std::vector<Flow::Operation *> consumers = W->consumers;
+    for (Flow::Operation *op : consumers) op->ReplaceInput(W, Wh);
+    if (W->detached()) flow->DeleteVariable(W);
+  }
+
+  return matrices.size();
+}
+
+Quantizer::~Quantizer() {
+  for (Layer *layer : layers_) delete layer;
+}
+
+int Quantizer::Prepare(Flow *flow) {
+  for (Flow::Operation *op : flow->ops()) {
+    // Only vector-matrix multiplications with constant float matrices are
+    // quantized.
+    if (op->type != "MatMul") continue;
+    if (op->indegree() != 2 || op->outdegree() != 1) continue;
+    if (op->GetAttr("transpose_a", false)) continue;
+    if (op->GetAttr("transpose_b", false)) continue;
+    if (op->GetAttr("transpose_c", false)) continue;
+    Flow::Variable *x = op->inputs[0];
+    Flow::Variable *W = op->inputs[1];
+    Flow::Variable *y = op->outputs[0];
+    if (x->type != DT_FLOAT || x->rank() != 2 || x->dim(0) != 1) continue;
+    if (W->type != DT_FLOAT || W->rank() != 2 || !W->constant()) continue;
+    if (y->type != DT_FLOAT) continue;
+    if (W->elements() < min_elements_) continue;
+
+    // Keep input available for calibration.
+    x->set_out();
+
+    Layer *layer = new Layer();
+    layer->op = op->name;
+    layer->input = x->name;
+    layer->rows = W->dim(0);
+    layer->columns = W->dim(1);
+    layers_.push_back(layer);
+  }
+
+  return layers_.size();
+}
+
+void Quantizer::Initialize(const Network &network) {
+  for (Layer *layer : layers_) {
+    layer->tensor = network.LookupParameter(layer->input);
+    if (layer->tensor == nullptr) {
+      LOG(WARNING) << "Input " << layer->input << " for " << layer->op
+                   << " not found in calibration network";
+    }
+  }
+}
+
+void Quantizer::Observe(Instance *data) {
+  for (Layer *layer : layers_) {
+    Tensor *t = layer->tensor;
+    if (t == nullptr || t->cell() != data->cell()) continue;
+
+    // Get input values.
+    char *base = data->GetAddress(t);
+    if (t->ref()) base = *reinterpret_cast<char **>(base);
+    if (base == nullptr) continue;
+
+    // Update input range.
+    int n = layer->rows;
+    std::vector<float> values(n);
+    for (int i = 0; i < n; ++i) {
+      float v = *reinterpret_cast<float *>(base + t->offset(0, i));
+      values[i] = v;
+      float a = fabsf(v);
+      if (a > layer->range) layer->range = a;
+    }
+    layer->observations++;
+
+    // Keep sample for measuring quantization error.
+    if (layer->samples.size() < max_samples_) {
+      layer->samples.push_back(std::move(values));
+    }
+  }
+}
+
+int Quantizer::Quantize(Flow *flow) {
+  if (!jit::CPU::Enabled(jit::AVX2)) {
+    LOG(WARNING) << "Quantized kernels require AVX2; keeping float flow";
+    return 0;
+  }
+
+  int quantized = 0;
+  for (Layer *layer : layers_) {
+    if (layer->observations == 0 || layer->range == 0.0) {
+      LOG(WARNING) << "No calibration data for " << layer->op;
+      continue;
+    }
+    if (QuantizeLayer(flow, layer)) quantized++;
+  }
+  return quantized;
+}
+
+bool Quantizer::QuantizeLayer(Flow *flow, Layer *layer) {
+  // Find op in flow and check that it matches the calibrated op.
+  Flow::Operation *op = flow->Op(layer->op);
+  if (op == nullptr || op->type != "MatMul") return false;
+  if (op->indegree() != 2 || op->outdegree() != 1) return false;
+  Flow::Variable *x = op->inputs[0];
+  Flow::Variable *W = op->inputs[1];
+  Flow::Variable *y = op->outputs[0];
+  if (x->type != DT_FLOAT || !W->constant() || W->type != DT_FLOAT) {
+    return false;
+  }
+  if (W->dim(0) != layer->rows || W->dim(1) != layer->columns) return false;
+  int rows = layer->rows;
+  int cols = layer->columns;
+
+  // Compute symmetric scale for each column of the matrix.
+  const float *weights = reinterpret_cast<const float *>(W->data);
+  std::vector<float> wscale(cols, 0.0);
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) {
+      float a = fabsf(weights[r * cols + c]);
+      if (a > wscale[c]) wscale[c] = a;
+    }
+  }
+  for (int c = 0; c < cols; ++c) {
+    wscale[c] = wscale[c] == 0.0 ? 1.0 : wscale[c] / kMaxQuantized;
+  }
+
+  // Quantize matrix. Matrices shared between several ops are only quantized
+  // once.
+  string wqname = W->name + "/quantized";
+  Flow::Variable *Wq = flow->Var(wqname);
+  if (Wq == nullptr) {
+    Wq = flow->AddVariable(wqname, DT_INT8, W->shape);
+    Wq->size = rows * cols;
+    Wq->data = flow->AllocateMemory(Wq->size);
+    int8 *q = reinterpret_cast<int8 *>(Wq->data);
+    for (int r = 0; r < rows; ++r) {
+      for (int c = 0; c < cols; ++c) {
+        q[r * cols + c] = QuantizeValue(weights[r * cols + c] / wscale[c]);
+      }
+    }
+  }
+  const int8 *wq = reinterpret_cast<const int8 *>(Wq->data);
+
+  // Input scaling factor and combined output scales.
+  float xscale = layer->range / kMaxQuantized;
+  float factor = 1.0 / xscale;
+  std::vector<float> scale(cols);
+  for (int c = 0; c < cols; ++c) scale[c] = xscale * wscale[c];
+
+  // Measure the quantization error on the sampled inputs.
+  double error = 0.0;
+  int measured = 0;
+  layer->max_error = 0.0;
+  std::vector<int> xq(rows);
+  for (const std::vector<float> &sample : layer->samples) {
+    for (int r = 0; r < rows; ++r) xq[r] = QuantizeValue(sample[r] * factor);
+    double diff = 0.0;
+    double norm = 0.0;
+    for (int c = 0; c < cols; ++c) {
+      double expected = 0.0;
+      int64 acc = 0;
+      for (int r = 0; r < rows; ++r) {
+        expected += sample[r] * weights[r * cols + c];
+        acc += xq[r] * wq[r * cols + c];
+      }
+      double actual = acc * scale[c];
+      double delta = fabs(actual - expected);
+      if (delta > layer->max_error) layer->max_error = delta;
+      diff += delta * delta;
+      norm += expected * expected;
+    }
+    if (norm > 0.0) {
+      error += sqrt(diff / norm);
+      measured++;
+    }
+  }
+  layer->error = measured > 0 ? error / measured : 0.0;
+
+  // Add constants for scaling factors.
+  Flow::Variable *s = flow->AddVariable(op->name + "/input_scale",
+                                        DT_FLOAT, {});
+  s->data = flow->AllocateMemory(&factor, sizeof(float));
+  s->size = sizeof(float);
+  Flow::Variable *sw = flow->AddVariable(op->name + "/output_scale",
+                                         DT_FLOAT, {1, cols});
+  sw->data = flow->AllocateMemory(scale.data(), cols * sizeof(float));
+  sw->size = cols * sizeof(float);
+
+  // Rewrite op to quantize the input, multiply with the quantized matrix, and
+  // dequantize the result.
+  Flow::Function *func = op->func;
+  Flow::Variable *qx = flow->AddVariable(op->name + "/quantized_input",
+                                         DT_INT8, x->shape);
+  Flow::Variable *qy = flow->AddVariable(op->name + "/quantized_output",
+                                         DT_INT32, y->shape);
+  flow->AddOperation(func, op->name + "/Quantize", "Quantize", {x, s}, {qx});
+  op->ReplaceInput(x, qx);
+  op->ReplaceInput(W, Wq);
+  op->ReplaceOutput(y, qy);
+  flow->AddOperation(func, op->name + "/Dequantize", "Dequantize",
+                     {qy, sw}, {y});
+
+  // Remove float matrix if it is no longer used.
+  if (W->detached()) flow->DeleteVariable(W);
+
+  layer->quantized = true;
+  return true;
+}
+
+string Quantizer::Report() const {
+  string report;
+  StringAppendF(&report, "%-40s %12s %10s %10s %12s %12s\n",
+                "op", "shape", "float KB", "int8 KB", "rel error", "max error");
+  int64 float_bytes = 0;
+  int64 quantized_bytes = 0;
+  double error = 0.0;
+  int layers = 0;
+  for (const Layer *layer : layers_) {
+    if (!layer->quantized) continue;
+    int64 fsize = layer->rows * layer->columns * sizeof(float);
+    int64 qsize = layer->rows * layer->columns + layer->columns * sizeof(float);
+    string shape = StringPrintf("%dx%d", layer->rows, layer->columns);
+    StringAppendF(&report, "%-40s %12s %10.1f %10.1f %11.4f%% %12.6f\n",
+                  layer->op.c_str(), shape.c_str(),
+                  fsize / 1024.0, qsize / 1024.0,
+                  layer->error * 100.0, layer->max_error);
+    float_bytes += fsize;
+    quantized_bytes += qsize;
+    error += layer->error;
+    layers++;
+  }
+  if (layers > 0) {
+    StringAppendF(&report, "%-40s %12s %10.1f %10.1f %11.4f%%\n",
+                  "total", "", float_bytes / 1024.0, quantized_bytes / 1024.0,
+                  error / layers * 100.0);
+  }
+  return report;
+}
+
+}  // namespace myelin
+}  // namespace sling
+
@@ -0,0 +1,135 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_MYELIN_QUANTIZATION_H_
+#define SLING_MYELIN_QUANTIZATION_H_
+
+#include <string>
+#include <vector>
+
+#include "sling/base/types.h"
+#include "sling/myelin/compute.h"
+#include "sling/myelin/flow.h"
+
+namespace sling {
+namespace myelin {
+
+// Post-training quantization of vector-matrix multiplications with constant
+// float matrices to 8-bit integer arithmetic:
+//
+//   y = MatMul(x, W)  =>  xq = Quantize(x, 1/sx)
+//                         yq = MatMul(xq, Wq)
+//                         y  = Dequantize(yq, sx * sw)
+//
+// The matrix is quantized with a symmetric scale sw for each output column. The
+// scale sx for the input is calibrated by running the float network on sample
+// inputs and recording the range of the input values. The quantized flow uses
+// the AVX2 integer kernels, so the float flow remains the reference on CPUs
+// without AVX2. Usage:
+//
+//   Flow flow;                         // float flow used for calibration
+//   flow.Load(model);
+//   Quantizer quantizer;
+//   quantizer.Prepare(&flow);
+//   Network network;
+//   compiler.Compile(&flow, &network);
+//   quantizer.Initialize(network);
+//   for each sample:
+//     compute sample in instance
+//     quantizer.Observe(&instance);
+//
+//   Flow quantized;                    // fresh copy of the float flow
+//   quantized.Load(model);
+//   quantizer.Quantize(&quantized);
+//   LOG(INFO) << quantizer.Report();
+class Quantizer {
+ public:
+  ~Quantizer();
+
+  // Select the vector-matrix multiplications in the flow that can be quantized
+  // and mark their inputs as outputs so the input values can be observed
+  // during calibration. Returns the number of selected ops.
+  int Prepare(Flow *flow);
+
+  // Look up the inputs for the selected ops in the calibration network.
+  void Initialize(const Network &network);
+
+  // Record the input ranges for the selected ops in the cell computed by the
+  // instance.
+  void Observe(Instance *data);
+
+  // Rewrite the calibrated ops in the flow to quantized integer ops. The flow
+  // must be a copy of the flow used for calibration that has not been
+  // analyzed. The quantization error is measured on the sampled inputs.
+  // Returns the number of quantized ops.
+  int Quantize(Flow *flow);
+
+  // Return table with the quantization error and the weight size for each
+  // quantized op.
+  string Report() const;
+
+  // Minimum number of matrix elements for quantizing an op.
+  int min_elements() const { return min_elements_; }
+  void set_min_elements(int min_elements) { min_elements_ = min_elements; }
+
+  // Maximum number of input samples kept for each op for measuring the
+  // quantization error.
+  int max_samples() const { return max_samples_; }
+  void set_max_samples(int max_samples) { max_samples_ = max_samples; }
+
+ private:
+  // Calibration and quantization statistics for matrix multiplication.
+  struct Layer {
+    string op;                    // name of matrix multiplication op
+    string input;                 // name of input variable
+    Tensor *tensor = nullptr;     // input tensor in calibration network
+    float range = 0.0;            // maximum absolute input value
+    int64 observations = 0;       // number of observed inputs
+    std::vector<std::vector<float>> samples;  // sampled inputs
+
+    bool quantized = false;       // op has been quantized
+    int rows = 0;                 // number of matrix rows
+    int columns = 0;              // number of matrix columns
+    double error = 0.0;           // mean relative error on samples
+    double max_error = 0.0;       // maximum absolute error on samples
+  };
+
+  // Quantize matrix multiplication for layer. Returns false if the op could
+  // not be quantized.
+  bool QuantizeLayer(Flow *flow, Layer *layer);
+
+  // Ops selected for quantization.
+  std::vector<Layer *> layers_;
+
+  // Minimum number of matrix elements for quantizing an op.
+  int min_elements_ = 1024;
+
+  // Maximum number of input samples per op.
+  int max_samples_ = 100;
+};
+
+// Convert constant float matrices used by vector-matrix multiplications and
+// embedding lookups to 16-bit floating point numbers, i.e. DT_HALF or
+// DT_BFLOAT16. This halves the memory bandwidth for the matrices, while the
+// kernels still compute in float precision. A matrix is only converted if it
+// has at least min_elements elements and all the ops using it can be computed
+// with the 16-bit kernels. Returns the number of converted matrices, which is
+// zero if the CPU does not support the conversion instructions.
+int ConvertToHalfPrecision(Flow *flow, Type type, int min_elements = 1024);
+
+}  // namespace myelin
+}  // namespace sling
+
+#endif  // SLING_MYELIN_QUANTIZATION_H_
+
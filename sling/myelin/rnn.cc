@@ -14,8 +14,14 @@
 
 #include "sling/myelin/rnn.h"
 
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+
 #include "sling/myelin/builder.h"
 #include "sling/myelin/gradient.h"
+#include "sling/util/mutex.h"
+#include "sling/util/threadpool.h"
 
 namespace sling {
 namespace myelin {
@@ -372,6 +378,90 @@ void RNN::Initialize(const Network &net) {
     mask = net.GetParameter(name + "/mask");
     nodropout = net.GetParameter(name + "/nodropout");
   }
+
+  // Initialize input projection.
+  xproj = net.LookupParameter(name + "/xproj");
+  if (xproj != nullptr) {
+    pcell = net.GetCell(name + "/project");
+    pinput = net.GetParameter(name + "/project/input");
+    poutput = net.GetParameter(name + "/project/output");
+    CHECK_EQ(pinput->order(), ROW_MAJOR);
+    CHECK_EQ(poutput->order(), ROW_MAJOR);
+  }
+}
+
+bool RNN::BuildProjection(Flow *flow, int block) {
+  // Input projections cannot be moved out of RNN cells for learning.
+  Flow::Function *func = flow->Func(name);
+  Flow::Variable *x = flow->Var(name + "/input");
+  if (func == nullptr || x == nullptr) return false;
+  if (flow->GradientFunc(func) != nullptr) return false;
+  if (x->rank() != 2 || x->dim(0) != 1) return false;
+
+  // Find matrix multiplications of the input with constant matrices.
+  std::vector<Flow::Operation *> projections;
+  int input_dim = x->dim(1);
+  int total = 0;
+  for (Flow::Operation *op : x->consumers) {
+    if (op->type != "MatMul") continue;
+    if (op->indegree() != 2 || op->outdegree() != 1) continue;
+    if (op->inputs[0] != x) continue;
+    if (op->GetAttr("transpose_a", false)) continue;
+    if (op->GetAttr("transpose_b", false)) continue;
+    Flow::Variable *w = op->inputs[1];
+    if (!w->constant() || w->type != x->type || w->rank() != 2) continue;
+    if (w->dim(0) != input_dim) continue;
+    if (w->size != w->elements() * TypeTraits::of(w->type).size()) continue;
+    projections.push_back(op);
+    total += w->dim(1);
+  }
+  if (projections.empty()) return false;
+
+  // Build projection cell with all the projection matrices concatenated.
+  auto dt = x->type;
+  int dsize = TypeTraits::of(dt).size();
+  FlowBuilder p(flow, name + "/project");
+  auto *w = p.Name(p.Const(nullptr, dt, {input_dim, total}), "W");
+  int column = 0;
+  for (Flow::Operation *op : projections) {
+    Flow::Variable *m = op->inputs[1];
+    int width = m->dim(1) * dsize;
+    for (int r = 0; r < input_dim; ++r) {
+      memcpy(w->data + (r * total + column) * dsize, m->data + r * width,
+             width);
+    }
+    column += m->dim(1);
+  }
+  auto *input = p.Placeholder("input", dt, {block, input_dim});
+  input->set(Flow::Variable::ROW);
+  auto *output = p.Name(p.MatMul(input, w), "output");
+  output->set(Flow::Variable::ROW)->set_out();
+
+  // Replace the input projections in the RNN cell with slices of the
+  // precomputed projection.
+  FlowBuilder f(flow, func);
+  auto *xproj = f.Placeholder("xproj", dt, {1, total}, true);
+  int offset = 0;
+  for (int i = 0; i < projections.size(); ++i) {
+    Flow::Operation *op = projections[i];
+    Flow::Variable *result = op->outputs[0];
+    int width = op->inputs[1]->dim(1);
+    string opname = op->name;
+    flow->RemoveOperation(op);
+
+    string suffix = std::to_string(i);
+    auto *begin = f.Name(f.Const(std::vector<int>{0, offset}),
+                         "xproj/begin" + suffix);
+    auto *size = f.Name(f.Const(std::vector<int>{1, width}),
+                        "xproj/size" + suffix);
+    flow->AddOperation(func, opname, "Slice", {xproj, begin, size}, {result});
+    offset += width;
+  }
+
+  // Keep the input in the RNN cell even if it is no longer used.
+  if (x->consumers.empty()) func->unused.push_back(x);
+
+  return true;
 }
 
 RNNMerger::Variables RNNMerger::Build(Flow *flow,
@@ -463,33 +553,72 @@ void RNNLayer::Initialize(const Network &net) {
   }
 }
 
-RNNInstance::RNNInstance(const RNNLayer *rnn)
+void RNNLayer::BuildProjections(Flow *flow, int block) {
+  lr_.BuildProjection(flow, block);
+  if (bidir_) rl_.BuildProjection(flow, block);
+}
+
+RNNInstance::RNNInstance(const RNNLayer *rnn, ThreadPool *pool)
     : rnn_(rnn),
+      pool_(pool),
       lr_(rnn->lr_.cell),
       lr_hidden_(rnn->lr_.h_out),
       lr_control_(rnn->lr_.c_out),
+      lr_projector_(rnn->lr_.pcell),
+      lr_xproj_(rnn->lr_.xproj),
       rl_(rnn->rl_.cell),
       rl_hidden_(rnn->rl_.h_out),
       rl_control_(rnn->rl_.c_out),
+      rl_projector_(rnn->rl_.pcell),
+      rl_xproj_(rnn->rl_.xproj),
       merger_(rnn->merger_.cell),
       merged_(rnn->merger_.merged) {}
 
-Channel *RNNInstance::Compute(Channel *input) {
+void RNNInstance::Project(const RNN &rnn, Channel *input,
+                          Instance *projector, Channel *xproj) {
+  // Compute input projections for blocks of inputs.
+  int length = input->size();
+  int block = rnn.pinput->dim(0);
+  size_t input_size = rnn.pinput->dim(1) * rnn.pinput->element_size();
+  size_t output_size = rnn.poutput->dim(1) * rnn.poutput->element_size();
+  char *inputs = projector->GetAddress(rnn.pinput);
+  char *outputs = projector->GetAddress(rnn.poutput);
+  xproj->resize(length);
+  for (int start = 0; start < length; start += block) {
+    int end = std::min(start + block, length);
+    for (int i = start; i < end; ++i) {
+      char *row = inputs + (i - start) * rnn.pinput->stride(0);
+      memcpy(row, input->at(i), input_size);
+    }
+    projector->Compute();
+    for (int i = start; i < end; ++i) {
+      char *row = outputs + (i - start) * rnn.poutput->stride(0);
+      memcpy(xproj->at(i), row, output_size);
+    }
+  }
+}
+
+void RNNInstance::ComputeLeftToRight(Channel *input) {
   // Get sequence length.
   int length = input->size();
   bool ctrl = rnn_->lr_.has_control();
+  bool proj = rnn_->lr_.has_projection();
 
   // Set pass-through dropout mask.
   if (rnn_->lr_.has_mask()) {
     lr_.SetReference(rnn_->lr_.mask, rnn_->lr_.nodropout->data());
   }
 
+  // Precompute input projections for the whole sequence.
+  if (proj) Project(rnn_->lr_, input, &lr_projector_, &lr_xproj_);
+
   // Compute left-to-right RNN.
   lr_hidden_.resize(length);
   if (ctrl) lr_control_.resize(length);
 
   if (length > 0) {
     lr_.Set(rnn_->lr_.input, input, 0);
+    if (proj) lr_.Set(rnn_->lr_.xproj, &lr_xproj_, 0);
     lr_.SetReference(rnn_->lr_.h_in, rnn_->lr_.zero->data());
     lr_.Set(rnn_->lr_.h_out, &lr_hidden_, 0);
     if (ctrl) {
@@ -501,6 +630,7 @@ Channel *RNNInstance::Compute(Channel *input) {
 
   for (int i = 1; i < length; ++i) {
     lr_.Set(rnn_->lr_.input, input, i);
+    if (proj) lr_.Set(rnn_->lr_.xproj, &lr_xproj_, i);
     lr_.Set(rnn_->lr_.h_in, &lr_hidden_, i - 1);
     lr_.Set(rnn_->lr_.h_out, &lr_hidden_, i);
     if (ctrl) {
@@ -509,21 +639,29 @@ Channel *RNNInstance::Compute(Channel *input) {
     }
     lr_.Compute();
   }
+}
 
-  // Return left-to-right hidden channel for unidirectional RNN.
-  if (!rnn_->bidir_) return &lr_hidden_;
+void RNNInstance::ComputeRightToLeft(Channel *input) {
+  // Get sequence length.
+  int length = input->size();
+  bool ctrl = rnn_->rl_.has_control();
+  bool proj = rnn_->rl_.has_projection();
 
   // Set pass-through dropout mask.
   if (rnn_->rl_.has_mask()) {
     rl_.SetReference(rnn_->rl_.mask, rnn_->rl_.nodropout->data());
   }
 
+  // Precompute input projections for the whole sequence.
+  if (proj) Project(rnn_->rl_, input, &rl_projector_, &rl_xproj_);
+
   // Compute right-to-left RNN.
   rl_hidden_.resize(length);
   if (ctrl) rl_control_.resize(length);
 
   if (length > 0) {
     rl_.Set(rnn_->rl_.input, input, length - 1);
+    if (proj) rl_.Set(rnn_->rl_.xproj, &rl_xproj_, length - 1);
     rl_.SetReference(rnn_->rl_.h_in, rnn_->rl_.zero->data());
     rl_.Set(rnn_->rl_.h_out, &rl_hidden_, length - 1);
     if (ctrl) {
@@ -535,6 +673,7 @@ Channel *RNNInstance::Compute(Channel *input) {
 
   for (int i = length - 2; i >= 0; --i) {
     rl_.Set(rnn_->rl_.input, input, i);
+    if (proj) rl_.Set(rnn_->rl_.xproj, &rl_xproj_, i);
     rl_.Set(rnn_->rl_.h_in, &rl_hidden_, i + 1);
     rl_.Set(rnn_->rl_.h_out, &rl_hidden_, i);
     if (ctrl) {
@@ -543,8 +682,37 @@ Channel *RNNInstance::Compute(Channel *input) {
     }
     rl_.Compute();
   }
+}
+
+Channel *RNNInstance::Compute(Channel *input) {
+  // Return left-to-right hidden channel for unidirectional RNN.
+  if (!rnn_->bidir_) {
+    ComputeLeftToRight(input);
+    return &lr_hidden_;
+  }
+
+  if (pool_ != nullptr) {
+    // Compute right-to-left RNN in worker thread while computing the
+    // left-to-right RNN in this thread.
+    Mutex mu;
+    std::condition_variable finished;
+    bool done = false;
+    pool_->Schedule([&]() {
+      ComputeRightToLeft(input);
+      MutexLock lock(&mu);
+      done = true;
+      finished.notify_one();
+    });
+    ComputeLeftToRight(input);
+    std::unique_lock<std::mutex> lock(mu);
+    while (!done) finished.wait(lock);
+  } else {
+    ComputeLeftToRight(input);
+    ComputeRightToLeft(input);
+  }
 
   // Merge outputs.
+  int length = input->size();
   merged_.resize(length);
   merger_.SetChannel(rnn_->merger_.left, &lr_hidden_);
   merger_.SetChannel(rnn_->merger_.right, &rl_hidden_);
@@ -809,10 +977,16 @@ void RNNStack::Initialize(const Network &net) {
   }
 }
 
+void RNNStack::BuildProjections(Flow *flow, int block) {
+  for (RNNLayer &l : layers_) {
+    l.BuildProjections(flow, block);
+  }
+}
+
 RNNStackInstance::RNNStackInstance(const RNNStack &stack) {
   layers_.reserve(stack.layers().size());
   for (const RNNLayer &l : stack.layers()) {
-    layers_.emplace_back(&l);
+    layers_.emplace_back(&l, stack.pool());
   }
 }
 
@@ -23,6 +23,9 @@
 #include "sling/myelin/flow.h"
 
 namespace sling {
+
+class ThreadPool;
+
 namespace myelin {
 
 class RNNInstance;
@@ -77,12 +80,23 @@ struct RNN {
   // Initialize RNN.
   void Initialize(const Network &net);
 
+  // Move the input-to-hidden matrix multiplications out of the RNN cell and
+  // into a separate projection cell. The projection cell computes the input
+  // projections for a block of inputs with one matrix-matrix product, and the
+  // RNN cell takes the precomputed projections as input. This is only
+  // supported for inference. Returns false if the RNN cell has no input
+  // projections that can be precomputed.
+  bool BuildProjection(Flow *flow, int block);
+
   // Control channel is optional for RNN.
   bool has_control() const { return c_in != nullptr; }
 
   // Dropout is only needed during training.
   bool has_mask() const { return mask != nullptr; }
 
+  // Input projections are optionally precomputed for the whole sequence.
+  bool has_projection() const { return xproj != nullptr; }
+
   string name;                     // RNN cell name
   Spec spec;                       // RNN specification
 
@@ -97,6 +111,11 @@ struct RNN {
 
   Tensor *nodropout = nullptr;     // dropout mask with no dropout
 
+  Cell *pcell = nullptr;           // input projection cell
+  Tensor *pinput = nullptr;        // block of inputs for projection
+  Tensor *poutput = nullptr;       // block of input projections
+  Tensor *xproj = nullptr;         // precomputed input projection for RNN
+
   Cell *gcell = nullptr;           // RNN gradient cell
   Tensor *dinput = nullptr;        // input gradient
   Tensor *primal = nullptr;        // link to primal RNN cell
@@ -162,6 +181,9 @@ class RNNLayer {
   // Initialize RNN.
   void Initialize(const Network &net);
 
+  // Precompute input projections for blocks of inputs.
+  void BuildProjections(Flow *flow, int block);
+
  private:
   string name_;       // cell name prefix
   bool bidir_;        // bidirectional RNN
@@ -175,27 +197,46 @@ class RNNLayer {
   friend class RNNLearner;
 };
 
-// Instance of RNN layer for inference.
+// Instance of RNN layer for inference. If a thread pool is provided, the
+// left-to-right and right-to-left RNNs of a bidirectional layer are computed
+// concurrently.
 class RNNInstance {
  public:
-  RNNInstance(const RNNLayer *rnn);
+  RNNInstance(const RNNLayer *rnn, ThreadPool *pool = nullptr);
 
   // Compute RNN over input sequence and return output sequence.
   Channel *Compute(Channel *input);
 
  private:
+  // Compute left-to-right RNN over input sequence.
+  void ComputeLeftToRight(Channel *input);
+
+  // Compute right-to-left RNN over input sequence.
+  void ComputeRightToLeft(Channel *input);
+
+  // Compute input projections for the whole input sequence.
+  static void Project(const RNN &rnn, Channel *input,
+                      Instance *projector, Channel *xproj);
+
   // Descriptor for RNN layer.
   const RNNLayer *rnn_;
 
+  // Worker pool for computing the directions concurrently.
+  ThreadPool *pool_;
+
   // Left-to-right RNN.
   Instance lr_;
   Channel lr_hidden_;
   Channel lr_control_;
+  Instance lr_projector_;
+  Channel lr_xproj_;
 
   // Right-to-left RNN for bidirectional RNN.
   Instance rl_;
   Channel rl_hidden_;
   Channel rl_control_;
+  Instance rl_projector_;
+  Channel rl_xproj_;
 
   // RNN channel merger for bidirectional RNN.
   Instance merger_;
@@ -283,15 +324,27 @@ class RNNStack {
   // Initialize RNN stack.
   void Initialize(const Network &net);
 
+  // Rewrite inference flow for the RNN stack so input projections are
+  // computed for blocks of inputs before running the recurrences. This must
+  // be done before the flow is compiled.
+  void BuildProjections(Flow *flow, int block = 16);
+
   // Layers in RNN stack.
   const std::vector<RNNLayer> &layers() const { return layers_; }
 
+  // Worker pool for computing bidirectional layers in parallel.
+  ThreadPool *pool() const { return pool_; }
+  void set_pool(ThreadPool *pool) { pool_ = pool; }
+
  private:
   // Name prefix for RNN cells.
   string name_;
 
   // RNN layers.
   std::vector<RNNLayer> layers_;
+
+  // Optional worker pool for prediction.
+  ThreadPool *pool_ = nullptr;
 };
 
 // Multi-layer RNN instance for prediction.
@@ -2954,7 +2954,7 @@ void SIMDAssembler::Reduce(Reduction op, const std::vector<int> &regs) {
   }
 }
 
-SIMDStrategy::SIMDStrategy(SIMDAssembler *sasm, int size) {
+SIMDStrategy::SIMDStrategy(SIMDAssembler *sasm, int size, int max_unrolls) {
   // Use scalar generator for singletons.
   if (size == 1) {
     phases_.emplace_back(sasm->scalar());
@@ -2964,8 +2964,8 @@ SIMDStrategy::SIMDStrategy(SIMDAssembler *sasm, int size) {
   // Add bulk phase.
   int vecsize = sasm->main()->VectorSize();
   int main = (size / vecsize) * vecsize;
-  int max_unrolls = sasm->main()->SupportsUnroll() ? kMaxUnrolls : 1;
-  int unrolls = std::min(main / vecsize, max_unrolls);
+  if (!sasm->main()->SupportsUnroll()) max_unrolls = 1;
+  int unrolls = std::min(main / vecsize, std::max(max_unrolls, 1));
   int remaining = size;
   int offset = 0;
   if (unrolls > 0) {
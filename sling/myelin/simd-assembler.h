@@ -179,8 +179,9 @@ class SIMDStrategy {
     SIMDGenerator *generator;   // code generator for phase
   };
 
-  // Compute a strategy for processing a vector of a certain size.
-  SIMDStrategy(SIMDAssembler *sasm, int size);
+  // Compute a strategy for processing a vector of a certain size. The bulk of
+  // the vector is processed with at most max_unrolls unrolls.
+  SIMDStrategy(SIMDAssembler *sasm, int size, int max_unrolls = kMaxUnrolls);
 
   // Maximum number of unrolls.
   int MaxUnrolls();
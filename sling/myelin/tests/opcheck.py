@@ -20,6 +20,7 @@ import sling.flags as flags
 import sling.myelin as myelin
 import sling.myelin.simulator as simulator
 import numpy as np
+import re
 import sys
 import struct
 
@@ -50,13 +51,33 @@ class Test:
 
 tests = {}
 
+# CPU features supported by the host, adjusted by the --cpu flag.
+cpu_features = set()
+with open("/proc/cpuinfo") as cpuinfo:
+  for line in cpuinfo:
+    if line.startswith("flags"):
+      cpu_features.update(line.split(":")[1].split())
+      break
+if flags.arg.cpu and flags.arg.cpu[0] not in "+-":
+  # Only the listed vector extensions are enabled.
+  cpu_features -= {"avx", "avx2", "avx512f", "fma"}
+for sign, feature in re.findall(r"([+-]?)([\w.]+)", flags.arg.cpu):
+  if sign == "-":
+    cpu_features.discard(feature)
+  else:
+    cpu_features.add(feature)
+
+def cpu_enabled(feature):
+  return feature in cpu_features
+
 # Initialize myelin compiler.
 compiler = myelin.Compiler()
 
 # Compare flow functions against numpy.
-def check(flow, variant, lo=-10.0, hi=10.0, rtol=1e-5, atol=1e-8, check=None):
+def check(flow, variant, lo=-10.0, hi=10.0, rtol=1e-5, atol=1e-8, check=None,
+          baseline=None):
   # Ensure that inputs are not overwritten.
-  for i in flow.inputs(): i.output = True
+  for i in flow.inputs(const=False): i.output = True
 
   if flags.arg.v >= 2:
     for f in flow.funcs.values():
@@ -85,8 +106,11 @@ def check(flow, variant, lo=-10.0, hi=10.0, rtol=1e-5, atol=1e-8, check=None):
         r = np.random.ranf(a.shape) * (hi - lo) + lo
       np.copyto(a, r, casting="unsafe")
 
-    # Compute function using numpy.
-    baseline = simulator.compute(flow, f, data)
+    # Compute function using numpy unless a reference function is given.
+    if baseline is None:
+      expected = simulator.compute(flow, f, data)
+    else:
+      expected = baseline(data)
 
     # Compute cell.
     for n in range(flags.arg.repeat):
@@ -103,7 +127,7 @@ def check(flow, variant, lo=-10.0, hi=10.0, rtol=1e-5, atol=1e-8, check=None):
     for o in check:
       test.runs += 1
       t = data.tensor(o)
-      b = baseline[o]
+      b = expected[o]
 
       if b.dtype == bool: t = np.array(t, dtype=bool)
       if not np.allclose(t, b, rtol=rtol, atol=atol):
@@ -129,6 +153,8 @@ def check(flow, variant, lo=-10.0, hi=10.0, rtol=1e-5, atol=1e-8, check=None):
   if flags.arg.profile:
     print(net.profile())
 
+  return net
+
 # Tests
 
 def matmul_test(m, k, n):
@@ -787,6 +813,68 @@ def gather_avg_test(n, d, s):
   v = f.gather_avg(emb, ind)
   check(flow, (n, d, s), 0, n, rtol=1e-3)
 
+# Check that embedding lookups have been fused with the matmul.
+def check_fused(net, name, variant, lookups):
+  test = tests[name]
+  cell = net.cell(name)
+  for v in lookups:
+    test.runs += 1
+    if v.name in cell:
+      test.errors += 1
+      print("ERROR: %s not fused in %s %s" % (v.name, name, str(variant)))
+
+def gather_matmul_test(n, d, s, m, pooling, bias=False, relu=False):
+  flow = myelin.Flow()
+  f = flow.define("gather_" + pooling + "_matmul")
+  nptype = simulator.nptypes[dt]
+  emb = f.array("emb", np.random.ranf((n, d)).astype(nptype))
+  ind = f.var("ind", myelin.DT_INT32, [1, s])
+  if pooling == "sum":
+    v = f.gather_sum(emb, ind)
+  else:
+    v = f.gather_avg(emb, ind)
+  W = f.array("W", (np.random.ranf((d, m)) * 2 - 1).astype(nptype))
+  y = f.matmul(v, W)
+  if bias: y = f.add(y, f.array("b", np.random.ranf((1, m)).astype(nptype)))
+  if relu: y = f.relu(y)
+  variant = (n, d, s, m, bias, relu)
+  net = check(flow, variant, 0, n, rtol=1e-3, atol=1e-5)
+  check_fused(net, f.func.name, variant, [v])
+
+def gather_oov_matmul_test(n, d, m):
+  flow = myelin.Flow()
+  f = flow.define("gather_oov_matmul")
+  nptype = simulator.nptypes[dt]
+  emb = f.array("emb", np.random.ranf((n, d)).astype(nptype))
+  oov = f.array("oov", np.random.ranf((1, d)).astype(nptype))
+  ind = f.var("ind", myelin.DT_INT32, [1, 1])
+  v = f.gather(emb, ind, oov)
+  W = f.array("W", (np.random.ranf((d, m)) * 2 - 1).astype(nptype))
+  y = f.matmul(v, W)
+  net = check(flow, (n, d, m), -n, n, rtol=1e-3, atol=1e-5)
+  check_fused(net, f.func.name, (n, d, m), [v])
+
+def gather_concat_matmul_test(n, d, s, m, bias=False, relu=False):
+  flow = myelin.Flow()
+  f = flow.define("gather_concat_matmul")
+  nptype = simulator.nptypes[dt]
+  emb1 = f.array("emb1", np.random.ranf((n, d)).astype(nptype))
+  emb2 = f.array("emb2", np.random.ranf((n, d + 3)).astype(nptype))
+  ind1 = f.var("ind1", myelin.DT_INT32, [1, s])
+  ind2 = f.var("ind2", myelin.DT_INT32, [1, s])
+  ind3 = f.var("ind3", myelin.DT_INT32, [1, 1])
+  v1 = f.gather_sum(emb1, ind1)
+  v2 = f.gather_avg(emb2, ind2)
+  v3 = f.gather(emb1, ind3)
+  fv = f.concat([v1, v2, v3])
+  W = f.array("W", (np.random.ranf((3 * d + 3, m)) * 2 - 1).astype(nptype))
+  y = f.matmul(fv, W)
+  if bias: y = f.add(y, f.array("b", np.random.ranf((1, m)).astype(nptype)))
+  if relu: y = f.relu(y)
+  variant = (n, d, s, m, bias, relu)
+  net = check(flow, variant, 0, n, rtol=1e-3, atol=1e-5)
+  check_fused(net, f.func.name, variant, [v1, v2, v3, fv])
+
 def scatter_add_test(n, d, s):
   flow = myelin.Flow()
   f = flow.define("scatter_add")
@@ -822,6 +910,100 @@ def acc_matmul_test(m, k, n):
   f.assign(c, f.add(c, f.matmul(a, b)))
   check(flow, (m, k, n), 0, 10, check=[c])
 
+def quantized_matmul_test(k, n):
+  # Quantize weights column-wise to 8 bits.
+  W = np.random.ranf((k, n)).astype(np.float32) * 2 - 1
+  wscale = np.max(np.abs(W), axis=0) / 127
+  wscale[wscale == 0] = 1
+  Wq = np.rint(W / wscale).astype(np.int8)
+
+  # The input is in [-1,1), so it is quantized with a fixed scale.
+  xscale = np.float32(1.0 / 127)
+
+  flow = myelin.Flow()
+  f = flow.define("quantized_matmul")
+  x = f.var("x", myelin.DT_FLOAT, [1, k])
+  xq = f.quantize(x, f.const(1.0 / xscale))
+  yq = f.matmul(xq, f.array("Wq", Wq))
+  yq.type = myelin.DT_INT32
+  scale = (xscale * wscale).astype(np.float32).reshape(1, n)
+  y = f.dequantize(yq, f.array("scale", scale))
+
+  # Compare with the exact result of the quantized computation.
+  check(flow, (k, n), -1.0, 1.0, check=[y])
+
+  # Compare with the float computation. Each product is off by at most half a
+  # quantization step for both the input and the weight.
+  wabs = np.sum(np.abs(W), axis=0)
+  error = k * wscale / 2 + (wabs + k * wscale / 2) * xscale / 2
+  def reference(data):
+    return {y: np.matmul(np.asarray(data.tensor(x)), W)}
+  check(flow, (k, n), -1.0, 1.0, rtol=0, atol=error * 1.001 + 1e-5,
+        check=[y], baseline=reference)
+
+# Round float32 array to 16-bit floating point and back.
+def round_half(a, precision):
+  if precision == "half":
+    return a.astype(np.float16).astype(np.float32)
+  bits = a.astype(np.float32).view(np.uint32).astype(np.uint64)
+  bits = (bits + 0x7fff + ((bits >> 16) & 1)) >> 16 << 16
+  return bits.astype(np.uint32).view(np.float32)
+
+# Compile flow with constant matrices converted to 16-bit floating point and
+# compare with numpy using the rounded matrix.
+def check_half(flow, variant, precision, matrix, reference, lo, hi, **kwargs):
+  sling.api.set_flag("half_precision", precision)
+  try:
+    net = check(flow, variant, lo, hi, baseline=reference, **kwargs)
+  finally:
+    sling.api.set_flag("half_precision", "")
+
+  # Check that the matrix has been converted.
+  net.tensor(matrix.name + "/" + precision)
+
+def half_matmul_test(k, n, precision, bias=False, relu=False):
+  flow = myelin.Flow()
+  f = flow.define(precision + "_matmul")
+  x = f.var("x", myelin.DT_FLOAT, [1, k])
+  W = np.random.ranf((k, n)).astype(np.float32) * 2 - 1
+  Wv = f.array("W", W)
+  y = f.matmul(x, Wv)
+  if bias:
+    b = np.random.ranf((1, n)).astype(np.float32) - 0.5
+    y = f.add(y, f.array("b", b))
+  if relu: y = f.relu(y)
+
+  Wr = round_half(W, precision)
+  def reference(data):
+    r = np.matmul(np.asarray(data.tensor(x)), Wr)
+    if bias: r += b
+    if relu: r = np.maximum(r, 0)
+    return {y: r}
+  check_half(flow, (k, n, bias, relu), precision, Wv, reference, -1.0, 1.0,
+             rtol=1e-4, atol=1e-5, check=[y])
+
+def half_gather_test(n, d, s, precision, pooling=None):
+  flow = myelin.Flow()
+  f = flow.define(precision + "_gather" + ("_" + pooling if pooling else ""))
+  emb = np.random.ranf((n, d)).astype(np.float32)
+  M = f.array("emb", emb)
+  ind = f.var("ind", myelin.DT_INT32, [1, s])
+  if pooling == "sum":
+    v = f.gather_sum(M, ind)
+  elif pooling == "avg":
+    v = f.gather_avg(M, ind)
+  else:
+    v = f.gather(M, ind)
+
+  embr = round_half(emb, precision)
+  def reference(data):
+    r = np.take(embr, np.asarray(data.tensor(ind))[0], axis=0)
+    if pooling == "sum": r = np.sum(r, axis=0, keepdims=True)
+    if pooling == "avg": r = np.mean(r, axis=0, keepdims=True)
+    return {v: r}
+  check_half(flow, (n, d, s), precision, M, reference, 0, n,
+             rtol=1e-4, atol=1e-5, check=[v])
+
 # Check for specific test to run.
 if flags.arg.test:
   print("Running test", flags.arg.test)
@@ -948,6 +1130,39 @@ for i in sizes:
           sum_axis_test(i, j, k, axis)
           max_axis_test(i, j, k, axis)
 
+if dt == myelin.DT_FLOAT or dt == myelin.DT_DOUBLE:
+  for d in [1, 7, 8, 9, 33, 64]:
+    for m in [1, 5, 16, 33]:
+      gather_oov_matmul_test(32, d, m)
+      for s in [1, 3]:
+        for bias, relu in [(False, False), (True, False), (False, True),
+                           (True, True)]:
+          gather_matmul_test(32, d, s, m, "sum", bias, relu)
+          gather_matmul_test(32, d, s, m, "avg", bias, relu)
+          gather_concat_matmul_test(32, d, s, m, bias, relu)
+
+if dt == myelin.DT_FLOAT and cpu_enabled("avx2"):
+  for k in [1, 3, 7, 31, 32, 33, 67, 256]:
+    for n in [1, 5, 9, 32, 33, 65]:
+      quantized_matmul_test(k, n)
+
+if dt == myelin.DT_FLOAT:
+  # Matrices must have at least 1024 elements to be converted.
+  precisions = []
+  if cpu_enabled("avx") and cpu_enabled("f16c"): precisions.append("half")
+  if cpu_enabled("avx2"): precisions.append("bfloat16")
+  for precision in precisions:
+    for k in [128, 131, 257]:
+      for n in [9, 17, 33, 64, 100]:
+        half_matmul_test(k, n, precision)
+        half_matmul_test(k, n, precision, bias=True)
+        half_matmul_test(k, n, precision, bias=True, relu=True)
+    for d in [9, 17, 33, 64, 100]:
+      for s in [1, 3, 8]:
+        half_gather_test(160, d, s, precision)
+        half_gather_test(160, d, s, precision, "sum")
+        half_gather_test(160, d, s, precision, "avg")
+
 if flags.arg.thorough:
   matmul_test(1024, 1024, 1024)
 
@@ -0,0 +1,122 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Test for the pipelined annotator executor. Documents are run through a
+// two-stage annotation pipeline, and each document must pass through the
+// stages in order and be delivered exactly once before Stop() returns.
+
+#include <vector>
+
+#include "sling/base/init.h"
+#include "sling/base/logging.h"
+#include "sling/base/types.h"
+#include "sling/frame/store.h"
+#include "sling/nlp/document/annotator.h"
+#include "sling/nlp/document/document.h"
+#include "sling/task/environment.h"
+#include "sling/task/task.h"
+#include "sling/util/mutex.h"
+
+using namespace sling;
+using namespace sling::nlp;
+
+// First stage adds a token to the document.
+class FirstStage : public Annotator {
+ public:
+  void Annotate(Document *document) override {
+    CHECK_EQ(document->num_tokens(), 0);
+    document->AddToken("first");
+  }
+};
+
+REGISTER_ANNOTATOR("test-first-stage", FirstStage);
+
+// Second stage checks that the first stage has run and adds another token.
+class SecondStage : public Annotator {
+ public:
+  void Annotate(Document *document) override {
+    CHECK_EQ(document->num_tokens(), 1);
+    CHECK_EQ(document->token(0).word(), "first");
+    document->AddToken("second");
+  }
+};
+
+REGISTER_ANNOTATOR("test-second-stage", SecondStage);
+
+// Task environment for initializing the pipeline.
+class TestEnvironment : public task::Environment {
+ public:
+  task::Counter *GetCounter(const string &name) override { return &dummy_; }
+  void ChannelCompleted(task::Channel *channel) override {}
+  void TaskCompleted(task::Task *task) override {}
+
+ private:
+  task::Counter dummy_;
+};
+
+// Run documents through the pipeline and check that each document is
+// delivered exactly once after being annotated by all stages.
+void TestPipelineExecutor(const Pipeline &pipeline,
+                          Store *commons, const DocumentNames *names,
+                          int num_documents, int queue_size,
+                          int output_threads) {
+  PipelineExecutor executor(&pipeline, queue_size, output_threads);
+  executor.Start();
+
+  Mutex mu;
+  std::vector<int> delivered(num_documents);
+  for (int i = 0; i < num_documents; ++i) {
+    Store *store = new Store(commons);
+    Document *document = new Document(store, names);
+    executor.Submit(document, [&, i, store](Document *document) {
+      CHECK_EQ(document->num_tokens(), 2);
+      CHECK_EQ(document->token(1).word(), "second");
+      delete document;
+      delete store;
+      MutexLock lock(&mu);
+      delivered[i]++;
+    });
+  }
+  executor.Stop();
+
+  for (int i = 0; i < num_documents; ++i) {
+    CHECK_EQ(delivered[i], 1) << "document " << i;
+  }
+  LOG(INFO) << num_documents << " documents delivered with queue size "
+            << queue_size << " and " << output_threads << " output threads";
+}
+
+int main(int argc, char *argv[]) {
+  InitProgram(&argc, &argv);
+
+  // Initialize two-stage annotation pipeline.
+  TestEnvironment env;
+  task::Task task(&env);
+  task.AddAnnotator("test-first-stage");
+  task.AddAnnotator("test-second-stage");
+  Store commons;
+  DocumentNames *names = new DocumentNames(&commons);
+  Pipeline pipeline;
+  pipeline.Init(&task, &commons);
+  commons.Freeze();
+  CHECK_EQ(pipeline.annotators().size(), 2);
+
+  TestPipelineExecutor(pipeline, &commons, names, 1000, 16, 1);
+  TestPipelineExecutor(pipeline, &commons, names, 1000, 1, 4);
+  TestPipelineExecutor(pipeline, &commons, names, 0, 16, 1);
+
+  names->Release();
+  LOG(INFO) << "PASS";
+  return 0;
+}
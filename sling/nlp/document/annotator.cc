@@ -46,6 +46,56 @@ void Pipeline::Annotate(Document *document) {
   for (Annotator *a : annotators_) a->Annotate(document);
 }
 
+PipelineExecutor::PipelineExecutor(const Pipeline *pipeline, int queue_size,
+                                   int output_threads)
+    : pipeline_(pipeline),
+      queue_size_(queue_size),
+      output_threads_(output_threads) {
+  CHECK_GE(queue_size, 1);
+  CHECK_GE(output_threads, 1);
+}
+
+PipelineExecutor::~PipelineExecutor() {
+  Stop();
+}
+
+void PipelineExecutor::Start() {
+  CHECK(stages_.empty());
+  for (int i = 0; i < pipeline_->annotators().size(); ++i) {
+    ThreadPool *stage = new ThreadPool(1, queue_size_);
+    stage->StartWorkers();
+    stages_.push_back(stage);
+  }
+  output_ = new ThreadPool(output_threads_, queue_size_);
+  output_->StartWorkers();
+}
+
+void PipelineExecutor::Submit(Document *document, Callback done) {
+  Schedule(0, document, done);
+}
+
+void PipelineExecutor::Stop() {
+  // Shut down the stages in pipeline order. Deleting a stage waits until all
+  // its queued documents have been passed on to the next stage, and deleting
+  // the output pool waits until all completion callbacks have returned.
+  for (ThreadPool *stage : stages_) delete stage;
+  stages_.clear();
+  delete output_;
+  output_ = nullptr;
+}
+
+void PipelineExecutor::Schedule(int stage, Document *document,
+                                const Callback &done) {
+  if (stage == stages_.size()) {
+    output_->Schedule([document, done]() { done(document); });
+    return;
+  }
+  stages_[stage]->Schedule([this, stage, document, done]() {
+    pipeline_->annotators()[stage]->Annotate(document);
+    Schedule(stage + 1, document, done);
+  });
+}
+
 DocumentAnnotation::DocumentAnnotation() : task_(this) {}
 
 DocumentAnnotation::~DocumentAnnotation() {
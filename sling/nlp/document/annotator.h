@@ -15,6 +15,7 @@
 #ifndef SLING_NLP_DOCUMENT_ANNOTATOR_H_
 #define SLING_NLP_DOCUMENT_ANNOTATOR_H_
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -22,6 +23,7 @@
 #include "sling/base/types.h"
 #include "sling/nlp/document/document.h"
 #include "sling/task/task.h"
+#include "sling/util/threadpool.h"
 
 namespace sling {
 namespace nlp {
@@ -55,11 +57,71 @@ class Pipeline {
   // Check for no-op pipeline.
   bool empty() const { return annotators_.empty(); }
 
+  // Document annotators in pipeline order.
+  const std::vector<Annotator *> &annotators() const { return annotators_; }
+
  private:
   // Document annotators.
   std::vector<Annotator *> annotators_;
 };
 
+// Pipelined executor for a document annotation pipeline. Each annotator runs
+// as a stage on a dedicated thread, and the stages are connected by bounded
+// queues, so heavy annotators like parsers can overlap with light ones like
+// tokenizers and phrase matchers. A document is handed from stage to stage
+// together with the local store that owns it, so only one thread works on a
+// document at any time. Each annotator only runs on its own stage thread, so
+// the throughput is bounded by the slowest annotator. Annotated documents are
+// passed on to a separate pool of output threads, so the completion callback
+// does not hold up the last stage.
+class PipelineExecutor {
+ public:
+  // Callback for documents that have been annotated by all stages. This is
+  // called on one of the output threads, so it must be thread-safe if there
+  // is more than one output thread.
+  typedef std::function<void(Document *document)> Callback;
+
+  // Initialize executor for pipeline with the maximum number of queued
+  // documents for each stage and the number of threads for calling the
+  // completion callbacks.
+  PipelineExecutor(const Pipeline *pipeline, int queue_size,
+                   int output_threads = 1);
+
+  // Wait until all submitted documents have been annotated.
+  ~PipelineExecutor();
+
+  // Start stage and output threads.
+  void Start();
+
+  // Submit document for annotation. The done callback is called when the
+  // document has been annotated by all stages. This blocks while the queue
+  // for the first stage is full.
+  void Submit(Document *document, Callback done);
+
+  // Wait until the completion callbacks for all submitted documents have
+  // returned and stop the threads.
+  void Stop();
+
+ private:
+  // Schedule document for annotation by stage.
+  void Schedule(int stage, Document *document, const Callback &done);
+
+  // Pipeline with annotators for stages.
+  const Pipeline *pipeline_;
+
+  // Maximum number of queued documents per stage.
+  int queue_size_;
+
+  // Number of threads for calling completion callbacks.
+  int output_threads_;
+
+  // Single-threaded worker pool for each stage.
+  std::vector<ThreadPool *> stages_;
+
+  // Worker pool for calling completion callbacks.
+  ThreadPool *output_ = nullptr;
+};
+
 class DocumentAnnotation : public task::Environment {
  public:
   DocumentAnnotation();
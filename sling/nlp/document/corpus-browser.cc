@@ -135,9 +135,9 @@ class CorpusBrowser : public DocumentService {
     // Analyze document.
     annotators_->Annotate(&document);
 
-    // Return document in JSON format.
+    // Stream document to client in JSON format.
     Frame json = Convert(document);
-    ws->set_output(json);
+    ws->StreamOutput(json);
   }
 
  private:
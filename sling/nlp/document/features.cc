@@ -16,11 +16,41 @@
 
 #include "sling/base/types.h"
 #include "sling/nlp/document/document.h"
+#include "sling/util/fingerprint.h"
 #include "sling/util/unicode.h"
 
 namespace sling {
 namespace nlp {
 
+TokenFeatureCache::TokenFeatureCache(const Lexicon *lexicon, int size)
+    : lexicon_(lexicon) {
+  int capacity = 1;
+  while (capacity < size) capacity <<= 1;
+  entries_.resize(capacity);
+  mask_ = capacity - 1;
+}
+
+void TokenFeatureCache::Lookup(const string &word, TokenFeatures *features) {
+  uint64 fp = Fingerprint(word.data(), word.size());
+  Entry &entry = entries_[fp & mask_];
+  if (entry.fp == fp && fp != 0) {
+    *features = entry.features;
+    Increment(&hits_);
+    return;
+  }
+
+  // Look up word in lexicon and add it to the cache.
+  features->word = lexicon_->Lookup(word, &features->prefix,
+                                    &features->suffix, &features->shape);
+  entry.fp = fp;
+  entry.features = *features;
+  Increment(&misses_);
+}
+
+void TokenFeatureCache::Clear() {
+  for (Entry &entry : entries_) entry.fp = 0;
+}
+
 void DocumentFeatures::Extract(const Document &document, int begin, int end) {
   if (end == -1) end = document.num_tokens();
   int length = end - begin;
@@ -31,7 +61,11 @@ void DocumentFeatures::Extract(const Document &document, int begin, int end) {
     TokenFeatures &f = features_[i];
 
     // Look up token word in lexicon and get word features.
-    f.word = lexicon_->Lookup(word, &f.prefix, &f.suffix, &f.shape);
+    if (cache_ != nullptr) {
+      cache_->Lookup(word, &f);
+    } else {
+      f.word = lexicon_->Lookup(word, &f.prefix, &f.suffix, &f.shape);
+    }
 
     // Re-compute context-sensitive features.
     if (i == 0 || document.token(i).brk() >= SENTENCE_BREAK) {
@@ -15,6 +15,8 @@
 #ifndef SLING_NLP_DOCUMENT_FEATURES_H_
 #define SLING_NLP_DOCUMENT_FEATURES_H_
 
+#include <atomic>
+#include <string>
 #include <vector>
 
 #include "sling/base/types.h"
@@ -24,11 +26,72 @@
 namespace sling {
 namespace nlp {
 
+// Lexical features for token.
+struct TokenFeatures {
+  int word;                 // word id
+  Affix *prefix = nullptr;  // longest prefix
+  Affix *suffix = nullptr;  // longest suffix
+  WordShape shape;          // word shape features
+};
+
+// Bounded cache mapping token words to lexical features. Since real text is
+// highly repetitive, most words are found in the cache so they do not need to
+// be normalized and looked up in the lexicon. The cache is direct-mapped on
+// the fingerprint of the raw word, so a new word evicts the previous word in
+// its slot. A cache can be shared across documents, but must only be used by
+// one thread at a time. The hit and miss counters can be read from any
+// thread.
+class TokenFeatureCache {
+ public:
+  // Initialize cache for lexicon. The size is rounded up to a power of two.
+  TokenFeatureCache(const Lexicon *lexicon, int size);
+
+  // Look up features for word, either from the cache or from the lexicon.
+  void Lookup(const string &word, TokenFeatures *features);
+
+  // Remove all words from the cache.
+  void Clear();
+
+  // Cache statistics.
+  int64 hits() const { return hits_.load(std::memory_order_relaxed); }
+  int64 misses() const { return misses_.load(std::memory_order_relaxed); }
+
+ private:
+  // Cache entry with word fingerprint and features. Fingerprint zero is used
+  // for empty entries.
+  struct Entry {
+    uint64 fp = 0;
+    TokenFeatures features;
+  };
+
+  // Increment counter. Only the owning thread updates the counters, so an
+  // atomic read-modify-write is not needed.
+  static void Increment(std::atomic<int64> *counter) {
+    counter->store(counter->load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+  }
+
+  // Lexicon for looking up words not in the cache.
+  const Lexicon *lexicon_;
+
+  // Cache entries.
+  std::vector<Entry> entries_;
+
+  // Mask for mapping fingerprints to cache entries.
+  uint64 mask_;
+
+  // Number of cache hits and misses.
+  std::atomic<int64> hits_{0};
+  std::atomic<int64> misses_{0};
+};
+
 // Extract lexical features from the tokens in a document.
 class DocumentFeatures {
  public:
-  // Initialize lexical feature extractor.
-  DocumentFeatures(const Lexicon *lexicon) : lexicon_(lexicon) {}
+  // Initialize lexical feature extractor. If a cache is provided, the token
+  // features are looked up through the cache.
+  DocumentFeatures(const Lexicon *lexicon, TokenFeatureCache *cache = nullptr)
+      : lexicon_(lexicon), cache_(cache) {}
 
   // Extract features from document.
   void Extract(const Document &document, int begin = 0, int end = -1);
@@ -60,17 +123,12 @@ class DocumentFeatures {
   }
 
  private:
-  // Lexical features for token.
-  struct TokenFeatures {
-    int word;                 // word id
-    Affix *prefix = nullptr;  // longest prefix
-    Affix *suffix = nullptr;  // longest suffix
-    WordShape shape;          // word shape features
-  };
-
   // Lexicon for looking up feature values.
   const Lexicon *lexicon_;
 
+  // Optional cache for token features.
+  TokenFeatureCache *cache_;
+
   // Features for tokens.
   std::vector<TokenFeatures> features_;
 };
@@ -22,9 +22,12 @@ namespace sling {
 namespace nlp {
 
 uint64 Fingerprinter::Fingerprint(Text word, Normalization normalization) {
-  // Normalize string.
-  string normalized;
-  UTF8::Normalize(word.data(), word.size(), normalization, &normalized);
+  // Normalize string. Words that fit in the local buffer are normalized
+  // without allocating memory.
+  char buffer[256];
+  string overflow;
+  Text normalized = UTF8::Normalize(word, normalization,
+                                    buffer, sizeof(buffer), &overflow);
 
   // Ignore degenerate words.
   if (normalized.empty()) return 1;
@@ -24,7 +24,51 @@ using namespace sling::myelin;
 namespace sling {
 namespace nlp {
 
+LexicalFeatures::~LexicalFeatures() {
+  ClearCaches();
+}
+
+TokenFeatureCache *LexicalFeatures::AcquireCache() const {
+  if (cache_size_ == 0) return nullptr;
+  MutexLock lock(&mu_);
+  if (free_caches_.empty()) {
+    TokenFeatureCache *cache = new TokenFeatureCache(&lexicon_, cache_size_);
+    caches_.push_back(cache);
+    return cache;
+  }
+
+  // Reuse the most recently released cache.
+  TokenFeatureCache *cache = free_caches_.back();
+  free_caches_.pop_back();
+  return cache;
+}
+
+void LexicalFeatures::ReleaseCache(TokenFeatureCache *cache) const {
+  if (cache == nullptr) return;
+  MutexLock lock(&mu_);
+  free_caches_.push_back(cache);
+}
+
+void LexicalFeatures::GetCacheStats(int64 *hits, int64 *misses) const {
+  MutexLock lock(&mu_);
+  *hits = *misses = 0;
+  for (TokenFeatureCache *cache : caches_) {
+    *hits += cache->hits();
+    *misses += cache->misses();
+  }
+}
+
+void LexicalFeatures::ClearCaches() {
+  MutexLock lock(&mu_);
+  for (TokenFeatureCache *cache : caches_) delete cache;
+  caches_.clear();
+  free_caches_.clear();
+}
+
 void LexicalFeatures::LoadLexicon(Flow *flow) {
+  // Remove cached features for previous lexicon.
+  ClearCaches();
+
   // Load word vocabulary.
   Flow::Blob *vocabulary = flow->DataBlock("lexicon");
   CHECK(vocabulary != nullptr);
@@ -84,6 +128,9 @@ void LexicalFeatures::SaveLexicon(Flow *flow) const {
 
 void LexicalFeatures::InitializeLexicon(Vocabulary::Iterator *words,
                                         const LexiconSpec &spec) {
+  // Remove cached features for previous lexicon.
+  ClearCaches();
+
   // Build dictionary.
   std::unordered_map<string, int> dictionary;
   words->Reset();
@@ -393,8 +440,10 @@ void LexicalFeatureExtractor::Compute(const DocumentFeatures &features,
 void LexicalFeatureExtractor::Extract(const Document &document,
                                       int begin, int end, Channel *fv) {
   // Extract lexical features from document.
-  DocumentFeatures features(&lex_.lexicon_);
+  TokenFeatureCache *cache = lex_.AcquireCache();
+  DocumentFeatures features(&lex_.lexicon_, cache);
   features.Extract(document, begin, end);
+  lex_.ReleaseCache(cache);
 
   // Compute feature vectors.
   int length = end - begin;
@@ -412,8 +461,10 @@ Channel *LexicalFeatureLearner::Extract(const Document &document,
   extractors_.clear();
 
   // Extract lexical features from document.
-  DocumentFeatures features(&lex_.lexicon_);
+  TokenFeatureCache *cache = lex_.AcquireCache();
+  DocumentFeatures features(&lex_.lexicon_, cache);
   features.Extract(document, begin, end);
+  lex_.ReleaseCache(cache);
 
   // Compute feature vector for all tokens in range.
   int length = end - begin;
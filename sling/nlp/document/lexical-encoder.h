@@ -17,6 +17,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "sling/base/types.h"
 #include "sling/myelin/flow.h"
@@ -24,6 +25,7 @@
 #include "sling/myelin/rnn.h"
 #include "sling/nlp/document/features.h"
 #include "sling/nlp/document/lexicon.h"
+#include "sling/util/mutex.h"
 
 namespace sling {
 namespace nlp {
@@ -64,6 +66,7 @@ class LexicalFeatures {
   };
 
   LexicalFeatures(const string &name = "features") : name_(name) {}
+  ~LexicalFeatures();
 
   // Load lexicon from existing model.
   void LoadLexicon(myelin::Flow *flow);
@@ -89,7 +92,29 @@ class LexicalFeatures {
   // Feature vector output.
   myelin::Tensor *feature_vector() const { return feature_vector_; }
 
+  // Acquire a token feature cache for extracting features from a document, or
+  // return null if caching is disabled. The caller has exclusive use of the
+  // cache until it is returned with ReleaseCache(). Caches are reused across
+  // documents and threads, so the number of caches is bounded by the number
+  // of concurrent feature extractions. All caches are deleted together with
+  // the lexical features.
+  TokenFeatureCache *AcquireCache() const;
+
+  // Return token feature cache to the pool of free caches.
+  void ReleaseCache(TokenFeatureCache *cache) const;
+
+  // Set the number of words in each token feature cache. Zero disables the
+  // cache. This must be set before any features are extracted. By default,
+  // each cache holds 16K words, which takes up about 1 MB.
+  void set_cache_size(int size) { cache_size_ = size; }
+
+  // Get total number of hits and misses for the token feature caches.
+  void GetCacheStats(int64 *hits, int64 *misses) const;
+
  private:
+  // Remove all token feature caches. This is called when the lexicon changes.
+  void ClearCaches();
+
   // Load pre-trained word embeddings into word embedding matrix.
   int LoadWordEmbeddings(myelin::Flow::Variable *matrix,
                          const string &filename);
@@ -117,6 +142,12 @@ class LexicalFeatures {
   myelin::Tensor *d_feature_vector_;           // feature vector gradient
   myelin::Tensor *primal_;                     // reference to primal cell
 
+  // Token feature caches.
+  int cache_size_ = 1 << 14;
+  mutable Mutex mu_;
+  mutable std::vector<TokenFeatureCache *> caches_;       // all caches
+  mutable std::vector<TokenFeatureCache *> free_caches_;  // unused caches
+
   friend class LexicalFeatureExtractor;
   friend class LexicalFeatureLearner;
 };
@@ -185,6 +216,13 @@ class LexicalEncoder {
     rnn_.AddLayers(layers, spec, bidir);
   }
 
+  // Precompute the RNN input projections for whole sentences. This rewrites
+  // the inference flow and must be called before the flow is compiled.
+  void BuildProjections(myelin::Flow *flow) { rnn_.BuildProjections(flow); }
+
+  // Set worker pool for computing bidirectional RNN layers in parallel.
+  void set_pool(ThreadPool *pool) { rnn_.set_pool(pool); }
+
   // Build flow for lexical encoder. Returns the output variables from the RNN.
   myelin::RNN::Variables Build(myelin::Flow *flow,
                                const LexicalFeatures::Spec &spec,
@@ -193,12 +193,15 @@ void Lexicon::PrecomputeShapes() {
 int Lexicon::Lookup(const string &word,
                     Affix **prefix, Affix **suffix,
                     WordShape *shape) const {
-  // Normalize word.
-  string normalized;
-  UTF8::Normalize(word, normalization_, &normalized);
+  // Normalize word. Words that fit in the local buffer are normalized
+  // without allocating memory.
+  char buffer[256];
+  string overflow;
+  Text key = UTF8::Normalize(word, normalization_,
+                             buffer, sizeof(buffer), &overflow);
 
   // Look up word in vocabulary.
-  int id = vocabulary_.Lookup(normalized);
+  int id = vocabulary_.Lookup(key);
 
   // Return pre-computed information from the lexicon for known words.
   if (id != -1) {
@@ -260,12 +263,12 @@ int Lexicon::Lookup(const string &word,
 
   // Compute affixes and shape features on-the-fly for unknown words.
   if (prefixes_.max_length() > 0) {
-    *prefix = prefixes_.GetLongestAffix(normalized);
+    *prefix = prefixes_.GetLongestAffix(key);
   } else {
     *prefix = nullptr;
   }
   if (suffixes_.max_length() > 0) {
-    *suffix = suffixes_.GetLongestAffix(normalized);
+    *suffix = suffixes_.GetLongestAffix(key);
   } else {
     *suffix = nullptr;
   }
@@ -14,6 +14,13 @@
 
 #include "sling/nlp/document/text-tokenizer.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -127,6 +134,36 @@ TokenFlags CharacterFlags::get(char32 ch) const {
   }
 }
 
+// Returns the length of the run of plain ASCII characters at the start of the
+// string, i.e. characters below 128 other than '&', which can start an HTML
+// entity. The input is scanned 32 bytes at a time with AVX2 or 16 bytes at a
+// time with SSE2, if available.
+static int PlainASCIIRun(const char *s, const char *end) {
+  const char *p = s;
+#ifdef __AVX2__
+  const __m256i amp32 = _mm256_set1_epi8('&');
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    uint32 mask = _mm256_movemask_epi8(v) |
+                  _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, amp32));
+    if (mask != 0) return p - s + __builtin_ctz(mask);
+    p += 32;
+  }
+#endif
+#ifdef __SSE2__
+  const __m128i amp = _mm_set1_epi8('&');
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    uint32 mask = _mm_movemask_epi8(v) |
+                  _mm_movemask_epi8(_mm_cmpeq_epi8(v, amp));
+    if (mask != 0) return p - s + __builtin_ctz(mask);
+    p += 16;
+  }
+#endif
+  while (p < end && (*p & 0x80) == 0 && *p != '&') p++;
+  return p - s;
+}
+
 TokenizerText::TokenizerText(Text text, const CharacterFlags &char_flags) {
   // Keep reference to original text.
   source_ = text;
@@ -144,6 +181,21 @@ TokenizerText::TokenizerText(Text text, const CharacterFlags &char_flags) {
   int i = 0;
   int escapes = 0;
   while (cur < end) {
+    // Plain ASCII characters are copied directly and classified through the
+    // ASCII flag table without UTF-8 decoding.
+    int n = PlainASCIIRun(cur, end);
+    for (int k = 0; k < n; ++k) {
+      Element &e = elements_[i++];
+      uint8 c = cur[k];
+      e.ch = c;
+      e.position = cur + k - start;
+      e.flags = char_flags.ascii(c);
+      e.node = nullptr;
+      e.escapes = escapes;
+    }
+    cur += n;
+    if (cur == end) break;
+
     Element &e = elements_[i];
     e.position = cur - start;
     e.node = nullptr;
@@ -183,6 +235,14 @@ TokenizerText::TokenizerText(Text text, const CharacterFlags &char_flags) {
   e.flags = 0;
   e.node = nullptr;
   e.escapes = escapes;
+  e.run = 0;
+
+  // Compute the length of the letter and digit runs.
+  for (int k = length_ - 1; k >= 0; --k) {
+    Element &element = elements_[k];
+    bool alnum = (element.flags & (CHAR_LETTER | CHAR_DIGIT)) != 0;
+    element.run = alnum ? elements_[k + 1].run + 1 : 0;
+  }
 }
 
 void TokenizerText::GetText(int start, int end, string *result) const {
@@ -194,7 +254,7 @@ void TokenizerText::GetText(int start, int end, string *result) const {
   if (elements_[start].escapes == elements_[end].escapes) {
     int from = elements_[start].position;
     int to = elements_[end].position;
-    result->append(source_.data(), from, to - from);
+    result->append(source_.data() + from, to - from);
   } else {
     for (int i = start; i < end; ++i) {
       UTF8::Encode(elements_[i].ch, result);
@@ -964,7 +1024,7 @@ void StandardTokenization::Process(TokenizerText *t) {
       while (j < t->length()) {
         if (t->is(j, CHAR_DIGIT | CHAR_LETTER)) {
           prev_was_punct = false;
-          j++;
+          j += t->run(j);
         } else if (t->is(j, NUMBER_PUNCT)) {
           if (prev_was_punct) break;
           prev_was_punct = true;
@@ -1065,7 +1125,7 @@ void StandardTokenization::Process(TokenizerText *t) {
       while (j < t->length()) {
         if (t->is(j, CHAR_LETTER) || t->is(j, CHAR_DIGIT)) {
           prev_was_punct = false;
-          j++;
+          j += t->run(j);
         } else if (t->is(j, WORD_PUNCT)) {
           if (prev_was_punct) break;
           prev_was_punct = true;
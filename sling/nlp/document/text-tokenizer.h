@@ -94,6 +94,9 @@ class CharacterFlags {
   // Returns the flags for a character value.
   TokenFlags get(char32 ch) const;
 
+  // Returns the flags for an ASCII character.
+  TokenFlags ascii(uint8 ch) const { return low_flags_[ch]; }
+
  private:
   std::vector<TokenFlags> low_flags_;
   std::unordered_map<char32, TokenFlags> high_flags_;
@@ -142,9 +145,16 @@ class TokenizerText {
 
   // Returns character at some position in the text in lowercase.
   char32 lower(int index) const {
-    return Unicode::ToLower(at(index));
+    char32 ch = at(index);
+    if (ch < 0x80) return ch >= 'A' && ch <= 'Z' ? ch + ('a' - 'A') : ch;
+    return Unicode::ToLower(ch);
   }
 
+  // Returns the number of consecutive letters and digits starting at some
+  // position in the text. This allows token processors to skip over plain
+  // words without checking each character.
+  int run(int index) const { return elements_[index].run; }
+
   // Sets/gets the token node for an element.
   const TrieNode *node(int index) const { return elements_[index].node; }
   void set_node(int index, const TrieNode *node) {
@@ -172,6 +182,9 @@ class TokenizerText {
     // Count of escaped entities so far in the text. This is used for quickly
     // determining if a range in the text contains any escaped entities.
     int escapes;
+
+    // Number of consecutive letters and digits starting at this element.
+    int run;
   };
 
   // Source text.
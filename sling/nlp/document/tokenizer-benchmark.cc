@@ -0,0 +1,91 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark for the text tokenizer. The text of the documents in a document
+// corpus, e.g. Wikipedia, is loaded into memory and tokenized a number of
+// times. The tokenization throughput is reported in MB/s and tokens/s.
+
+#include <string>
+#include <vector>
+
+#include "sling/base/clock.h"
+#include "sling/base/flags.h"
+#include "sling/base/init.h"
+#include "sling/base/logging.h"
+#include "sling/base/types.h"
+#include "sling/frame/store.h"
+#include "sling/nlp/document/document.h"
+#include "sling/nlp/document/document-corpus.h"
+#include "sling/nlp/document/text-tokenizer.h"
+
+DEFINE_string(corpus, "local/data/e/wiki/en/documents@10.rec",
+              "Document corpus with text to tokenize");
+DEFINE_int32(maxdocs, 10000, "Maximum number of documents to load");
+DEFINE_int32(runs, 5, "Number of benchmark runs");
+DEFINE_bool(ptb, false, "Use PTB tokenization instead of LDC tokenization");
+
+using namespace sling;
+using namespace sling::nlp;
+
+int main(int argc, char *argv[]) {
+  InitProgram(&argc, &argv);
+
+  // Load document text from corpus.
+  LOG(INFO) << "Loading documents from " << FLAGS_corpus;
+  Store commons;
+  DocumentCorpus corpus(&commons, FLAGS_corpus);
+  std::vector<string> texts;
+  int64 bytes = 0;
+  while (texts.size() < FLAGS_maxdocs) {
+    Store store(&commons);
+    Document *document = corpus.Next(&store);
+    if (document == nullptr) break;
+    if (!document->text().empty()) {
+      texts.push_back(document->text());
+      bytes += document->text().size();
+    }
+    delete document;
+  }
+  LOG(INFO) << texts.size() << " documents, " << bytes << " bytes";
+
+  // Initialize tokenizer.
+  Tokenizer tokenizer;
+  if (FLAGS_ptb) {
+    tokenizer.InitPTB();
+  } else {
+    tokenizer.InitLDC();
+  }
+
+  // Tokenize the text and report the throughput for the fastest run.
+  double best = 0.0;
+  int64 tokens = 0;
+  for (int run = 0; run < FLAGS_runs; ++run) {
+    tokens = 0;
+    Clock clock;
+    clock.start();
+    for (const string &text : texts) {
+      tokenizer.Tokenize(text, [&tokens](const Tokenizer::Token &t) {
+        tokens++;
+      });
+    }
+    clock.stop();
+    double mbs = bytes / clock.secs() / 1e6;
+    LOG(INFO) << "Run " << run << ": " << mbs << " MB/s, "
+              << tokens / clock.secs() << " tokens/s";
+    if (mbs > best) best = mbs;
+  }
+  LOG(INFO) << tokens << " tokens, best " << best << " MB/s";
+
+  return 0;
+}
@@ -49,12 +49,35 @@ void MikolovFlow::BuildLayer1() {
 
   // Inputs.
   alpha = tf.Var("alpha", DT_FLOAT, {});
-  label = tf.Var("label", DT_FLOAT, {1, 1});
-  target = tf.Var("target", DT_INT32, {1, out_features});
   error = tf.Var("error", DT_FLOAT, {dims});
   l1_l0 = tf.Instance(layer0);
   auto *h = tf.Ref(l1_l0, hidden);
 
+  if (samples > 1) {
+    // Score the positive and all the negative samples in one step.
+    CHECK_EQ(out_features, 1);
+    label = tf.Var("label", DT_FLOAT, {samples, 1});
+    target = tf.Var("target", DT_INT32, {1, samples});
+
+    // Outputs.
+    auto *embed = tf.Gather(W1, target);
+    auto *output = tf.MatMul(embed, tf.Reshape(h, {dims, 1}));
+
+    // Likelihoods.
+    likelihood = tf.Name(tf.Sub(label, tf.Sigmoid(output)), "likelihood");
+    likelihood->set_out();
+    auto *eta = tf.Mul(likelihood, alpha);
+
+    // Backprop layer 1.
+    auto *delta = tf.MatMul(tf.Reshape(eta, {1, samples}), embed);
+    tf.AssignAdd(error, tf.Reshape(delta, {dims}));
+    tf.AssignAddScatter(W1, target, tf.MatMul(eta, h));
+    return;
+  }
+
+  label = tf.Var("label", DT_FLOAT, {1, 1});
+  target = tf.Var("target", DT_INT32, {1, out_features});
+
   // Output.
   bool single = out_features == 1;
   auto *embed = single ? tf.Gather(W1, target) : tf.GatherAvg(W1, target);
@@ -46,6 +46,7 @@ struct MikolovFlow : public myelin::Flow {
   int dims = 64;          // number of dimensions in embedding vectors
   int in_features = 32;   // (maximum) number of input features
   int out_features = 1;   // (maximum) number of output features
+  int samples = 1;        // output samples (positive and negatives) per step
 
   Variable *W0;           // input embedding matrix
   Variable *W1;           // output embedding matrix
@@ -54,8 +55,8 @@ struct MikolovFlow : public myelin::Flow {
   Variable *hidden;       // hidden activation
 
   Variable *alpha;        // learning rate
-  Variable *label;        // output label (1=positive, 0=negative example)
-  Variable *target;       // output target
+  Variable *label;        // output labels (1=positive, 0=negative example)
+  Variable *target;       // output targets
 
   Variable *likelihood;   // likelihood for example
   Variable *error;        // accumulated error
@@ -197,8 +197,8 @@ class FactEmbeddingsTrainer : public LearnerTask {
       }
 
       // Update parameters.
+      optimizer_->Apply(batch.gradients(), &optimizer_mu_);
       optimizer_mu_.Lock();
-      optimizer_->Apply(batch.gradients());
       loss_sum_ += epoch_loss;
       loss_count_ += batches_per_update_;
       optimizer_mu_.Unlock();
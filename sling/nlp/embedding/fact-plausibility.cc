@@ -254,8 +254,8 @@ class FactPlausibilityTrainer : public LearnerTask {
       }
 
       // Update parameters.
+      optimizer_->Apply(gradients, &optimizer_mu_);
       optimizer_mu_.Lock();
-      optimizer_->Apply(gradients);
       loss_sum_ += epoch_loss;
       loss_count_ += epoch_count;
       train_benchmark_.add(batch_benchmark);
@@ -51,25 +51,40 @@ class WordVocabularySampler {
       if (word == "<UNKNOWN>") oov_ = index;
       dictionary_[word] = index;
       entry_.emplace_back(word, count);
-      permutation_.emplace_back(index, count);
       sum += count;
     }
     threshold_ = subsampling * sum;
 
-    // Shuffle words (Fisher-Yates shuffle).
-    int n = permutation_.size();
-    Random rnd;
-    for (int i = 0; i < n - 1; ++i) {
-      int j = rnd.UniformInt(n - i);
-      std::swap(permutation_[i], permutation_[i + j]);
-    }
-
-    // Convert counts to accumulative distribution.
-    double acc = 0.0;
+    // Build alias table for sampling words in constant time (Vose's method).
+    // Each bucket is split between the word for the bucket and an alias word
+    // such that all buckets have the same total probability.
+    int n = entry_.size();
+    alias_.resize(n);
+    std::vector<double> scaled(n);
+    std::vector<int> small;
+    std::vector<int> large;
     for (int i = 0; i < n; ++i) {
-      acc += permutation_[i].probability / sum;
-      permutation_[i].probability = acc;
+      scaled[i] = entry_[i].count * n / sum;
+      if (scaled[i] < 1.0) {
+        small.push_back(i);
+      } else {
+        large.push_back(i);
+      }
+    }
+    while (!small.empty() && !large.empty()) {
+      int s = small.back();
+      small.pop_back();
+      int l = large.back();
+      alias_[s].threshold = scaled[s];
+      alias_[s].alias = l;
+      scaled[l] -= 1.0 - scaled[s];
+      if (scaled[l] < 1.0) {
+        large.pop_back();
+        small.push_back(l);
+      }
     }
+    for (int i : large) alias_[i] = Bucket(1.0, i);
+    for (int i : small) alias_[i] = Bucket(1.0, i);
   }
 
   // Look up word in dictionary. Return OOV for unknown words.
@@ -80,20 +95,11 @@ class WordVocabularySampler {
     return f != dictionary_.end() ? f->second : oov_;
   }
 
-  // Sample word according to distribution. Used for sampling negative examples.
-  int Sample(float p) const {
-    int n = permutation_.size();
-    int low = 0;
-    int high = n - 1;
-    while (low < high) {
-      int center = (low + high) / 2;
-      if (permutation_[center].probability < p) {
-        low = center + 1;
-      } else {
-        high = center;
-      }
-    }
-    return permutation_[low].index;
+  // Sample word according to distribution from a uniformly sampled bucket and
+  // a probability. Used for sampling negative examples.
+  int Sample(int bucket, float p) const {
+    const Bucket &b = alias_[bucket];
+    return p < b.threshold ? bucket : b.alias;
   }
 
   // Sub-sampling probability for word. Used for sub-sampling words in
@@ -108,7 +114,7 @@ class WordVocabularySampler {
   void Clear() {
     dictionary_.clear();
     entry_.clear();
-    permutation_.clear();
+    alias_.clear();
   }
 
   // Return the number of words in the vocabulary.
@@ -124,10 +130,11 @@ class WordVocabularySampler {
     float count;
   };
 
-  struct Element {
-    Element(int i, float p) : index(i), probability(p) {}
-    int index;
-    float probability;
+  struct Bucket {
+    Bucket() : threshold(1.0), alias(0) {}
+    Bucket(float t, int a) : threshold(t), alias(a) {}
+    float threshold;
+    int alias;
   };
 
   // Mapping from word to vocabulary index.
@@ -136,8 +143,8 @@ class WordVocabularySampler {
   // Word list.
   std::vector<Entry> entry_;
 
-  // Permutation of words for sampling.
-  std::vector<Element> permutation_;
+  // Alias table for sampling.
+  std::vector<Bucket> alias_;
 
   // Threshold for sub-sampling words
   float threshold_;
@@ -166,6 +173,7 @@ class WordEmbeddingsTrainer : public Process {
     task->Fetch("min_learning_rate", &min_learning_rate_);
     task->Fetch("embedding_dims", &embedding_dims_);
     task->Fetch("subsampling", &subsampling_);
+    task->Fetch("cache_corpus", &cache_corpus_);
 
     // Load vocabulary.
     normalization_ = ParseNormalization(task->Get("normalization", ""));
@@ -176,6 +184,7 @@ class WordEmbeddingsTrainer : public Process {
     flow_.inputs = flow_.outputs = vocabulary_size;
     flow_.dims = embedding_dims_;
     flow_.in_features = window_ * 2;
+    flow_.samples = negative_ + 1;
     flow_.Build();
 
     // Compile embedding model.
@@ -248,6 +257,7 @@ class WordEmbeddingsTrainer : public Process {
     rnd.seed(index);
     int epoch = 0;
     std::vector<int> words;
+    int vocabulary_size = vocabulary_.size();
 
     // Set up model compute instances.
     myelin::Instance l0(flow_.layer0);
@@ -257,98 +267,138 @@ class WordEmbeddingsTrainer : public Process {
     int *features = l0.Get<int>(flow_.fv);
     int *fend = features + flow_.in_features;
     int *target = l1.Get<int>(flow_.target);
-    float *label = l1.Get<float>(flow_.label);
     float *alpha = l1.Get<float>(flow_.alpha);
     *alpha = learning_rate_;
 
+    // The first sample is the positive example and the rest are negative.
+    for (int d = 0; d <= negative_; ++d) {
+      *l1.Get<float>(flow_.label, d) = d == 0 ? 1.0 : 0.0;
+    }
+
     l1.Set(flow_.l1_l0, &l0);
     l0b.Set(flow_.l0b_l0, &l0);
     l0b.Set(flow_.l0b_l1, &l1);
 
+    // Train model on sentence with word indices.
+    auto train = [&](const int *begin, const int *end) {
+      // Get all the words in the sentence with sub-sampling.
+      words.clear();
+      for (const int *w = begin; w < end; ++w) {
+        if (rnd.UniformProb() < vocabulary_.SubsamplingProbability(*w)) {
+          words.push_back(*w);
+        }
+      }
+
+      // Use each word in the sentence as a training example.
+      for (int pos = 0; pos < words.size(); ++pos) {
+        // Get features from window around word.
+        int *f = features;
+        for (int i = pos - window_; i <= pos + window_; ++i) {
+          if (i == pos) continue;
+          if (i < 0) continue;
+          if (i >= words.size()) continue;
+          *f++ = words[i];
+        }
+        if (f == features) continue;
+        if (f < fend) *f = -1;
+        num_instances_->Increment();
+
+        // Propagate input to hidden layer.
+        l0.Compute();
+
+        // Randomly sample negative examples.
+        target[0] = words[pos];
+        for (int d = 1; d <= negative_; ++d) {
+          int bucket = rnd.UniformInt(vocabulary_size);
+          target[d] = vocabulary_.Sample(bucket, rnd.UniformProb());
+        }
+
+        // Propagate hidden to output and back for the positive and negative
+        // examples. This also accumulates the errors that should be
+        // propagated back to the input layer.
+        l1.Clear(flow_.error);
+        l1.Compute();
+
+        // Propagate hidden to input.
+        l0b.Compute();
+      }
+    };
+
+    // The corpus can optionally be cached in memory as word indices with
+    // sentences terminated by -1 after the first iteration.
+    std::vector<int> corpus;
+    int64 cached_documents = 0;
+
     RecordFileOptions options;
     RecordReader input(filename, options);
     Record record;
     for (;;) {
       // Check for end of corpus.
-      if (input.Done()) {
-        epochs_completed_->Increment();
-        if (++epoch < iterations_) {
-          // Seek back to the beginning.
-          input.Rewind();
-
-          // Update learning rate.
-          float progress = static_cast<float>(epoch) / iterations_;
-          *alpha = learning_rate_ * (1.0 - progress);
-          if (*alpha < min_learning_rate_) *alpha = min_learning_rate_;
-          continue;
-        } else {
-          break;
-        }
-      }
-
-      // Read next record from input.
-      CHECK(input.Read(&record));
-      num_documents_->Increment();
-      if (epoch == 0) total_documents_->Increment();
-
-      // Create document.
-      Store store(commons_);
-      StringDecoder decoder(&store, record.value.data(), record.value.size());
-      Document document(decoder.Decode().AsFrame(), docnames_);
-      num_tokens_->Increment(document.num_tokens());
-
-      // Go over each sentence in the document.
-      for (SentenceIterator s(&document); s.more(); s.next()) {
-        // Get all the words in the sentence with sub-sampling.
-        words.clear();
-        for (int t = s.begin(); t < s.end(); ++t) {
-          // Sub-sample words.
-          const string &word = document.token(t).word();
-          int index = vocabulary_.Lookup(word, normalization_);
-          if (rnd.UniformProb() < vocabulary_.SubsamplingProbability(index)) {
-            words.push_back(index);
+      if (epoch > 0 && cache_corpus_) {
+        // Train on cached corpus.
+        num_documents_->Increment(cached_documents);
+        num_tokens_->Increment(corpus.size());
+        const int *begin = corpus.data();
+        const int *end = begin + corpus.size();
+        for (const int *p = begin; p < end; ++p) {
+          if (*p != -1) continue;
+          train(begin, p);
+          begin = p + 1;
+
+          // Check for early stopping.
+          if (max_epochs_ != -1) {
+            if (num_instances_->value() >= max_epochs_) return;
           }
         }
-
-        // Use each word in the sentence as a training example.
-        for (int pos = 0; pos < words.size(); ++pos) {
-          // Get features from window around word.
-          int *f = features;
-          for (int i = pos - window_; i <= pos + window_; ++i) {
-            if (i == pos) continue;
-            if (i < 0) continue;
-            if (i >= words.size()) continue;
-            *f++ = words[i];
+      } else if (!input.Done()) {
+        // Read next record from input.
+        CHECK(input.Read(&record));
+        num_documents_->Increment();
+        if (epoch == 0) total_documents_->Increment();
+
+        // Create document.
+        Store store(commons_);
+        StringDecoder decoder(&store, record.value.data(), record.value.size());
+        Document document(decoder.Decode().AsFrame(), docnames_);
+        num_tokens_->Increment(document.num_tokens());
+
+        // Go over each sentence in the document.
+        std::vector<int> sentence;
+        for (SentenceIterator s(&document); s.more(); s.next()) {
+          // Look up words in vocabulary.
+          sentence.clear();
+          for (int t = s.begin(); t < s.end(); ++t) {
+            const string &word = document.token(t).word();
+            sentence.push_back(vocabulary_.Lookup(word, normalization_));
           }
-          if (f == features) continue;
-          if (f < fend) *f = -1;
-          num_instances_->Increment();
-
-          // Propagate input to hidden layer.
-          l0.Compute();
-
-          // Propagate hidden to output and back. This also accumulates the
-          // errors that should be propagated back to the input layer.
-          l1.Clear(flow_.error);
-          *label = 1.0;
-          *target = words[pos];
-          l1.Compute();
-
-          // Randomly sample negative examples.
-          *label = 0.0;
-          for (int d = 0; d < negative_; ++d) {
-            *target = vocabulary_.Sample(rnd.UniformProb());
-            l1.Compute();
+          if (cache_corpus_) {
+            corpus.insert(corpus.end(), sentence.begin(), sentence.end());
+            corpus.push_back(-1);
           }
 
-          // Propagate hidden to input.
-          l0b.Compute();
+          train(sentence.data(), sentence.data() + sentence.size());
         }
+        if (cache_corpus_) cached_documents++;
+
+        // Check for early stopping.
+        if (max_epochs_ != -1) {
+          if (num_instances_->value() >= max_epochs_) break;
+        }
+        continue;
       }
 
-      // Check for early stopping.
-      if (max_epochs_ != -1) {
-        if (num_instances_->value() >= max_epochs_) break;
+      // Start next iteration.
+      epochs_completed_->Increment();
+      if (++epoch < iterations_) {
+        // Seek back to the beginning.
+        if (!cache_corpus_) input.Rewind();
+
+        // Update learning rate.
+        float progress = static_cast<float>(epoch) / iterations_;
+        *alpha = learning_rate_ * (1.0 - progress);
+        if (*alpha < min_learning_rate_) *alpha = min_learning_rate_;
+      } else {
+        break;
       }
     }
   }
@@ -363,6 +413,7 @@ class WordEmbeddingsTrainer : public Process {
   double min_learning_rate_ = 0.0001;  // minimum learning rate
   int embedding_dims_ = 256;           // size of embedding vectors
   double subsampling_ = 1e-3;          // sub-sampling rate
+  bool cache_corpus_ = false;          // cache word indices for corpus
 
   // Flow model for word embedding trainer.
   MikolovFlow flow_;
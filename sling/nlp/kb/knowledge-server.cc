@@ -22,6 +22,8 @@
 DEFINE_int32(port, 8080, "HTTP server port");
 DEFINE_string(kb, "local/data/e/wiki/kb.sling", "Knowledge base");
 DEFINE_string(names, "local/data/e/wiki/en/name-table.repo", "Name table");
+DEFINE_int32(cache, 256, "Size of item cache in megabytes");
+DEFINE_int32(workers, 8, "Number of workers for batch item requests");
 
 using namespace sling;
 using namespace sling::nlp;
@@ -38,6 +40,8 @@ int main(int argc, char *argv[]) {
   HTTPServer http(options, FLAGS_port);
 
   KnowledgeService kb;
+  kb.set_cache_capacity(static_cast<int64>(FLAGS_cache) << 20);
+  kb.set_num_workers(FLAGS_workers);
   kb.Load(&commons, FLAGS_names);
   commons.Freeze();
 
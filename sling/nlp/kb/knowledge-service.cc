@@ -15,6 +15,8 @@
 #include "sling/nlp/kb/knowledge-service.h"
 
 #include <math.h>
+#include <condition_variable>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -61,7 +63,15 @@ static string ConvertGeoCoord(double coord, bool latitude) {
   return StrCat(degrees, "°", minutes, "′", seconds, "″", sign);
 }
 
+KnowledgeService::~KnowledgeService() {
+  delete workers_;
+}
+
 void KnowledgeService::Load(Store *kb, const string &name_table) {
+  // Rendered items from any previously loaded knowledge base are stale.
+  item_cache_.Clear();
+  unit_names_.clear();
+
   // Bind names and freeze store.
   kb_ = kb;
   CHECK(names_.Bind(kb_));
@@ -115,8 +125,16 @@ void KnowledgeService::Load(Store *kb, const string &name_table) {
 void KnowledgeService::Register(HTTPServer *http) {
   http->Register("/kb/query", this, &KnowledgeService::HandleQuery);
   http->Register("/kb/item", this, &KnowledgeService::HandleGetItem);
+  http->Register("/kb/items", this, &KnowledgeService::HandleGetItems);
   http->Register("/kb/frame", this, &KnowledgeService::HandleGetFrame);
+  http->Register("/kb/cachez", this, &KnowledgeService::HandleCacheStats);
   app_.Register(http);
+
+  // Start workers for batch requests.
+  if (workers_ == nullptr && num_workers_ > 0) {
+    workers_ = new ThreadPool(num_workers_, kMaxBatchSize);
+    workers_->StartWorkers();
+  }
 }
 
 void KnowledgeService::HandleQuery(HTTPRequest *request,
@@ -166,24 +184,112 @@ void KnowledgeService::HandleQuery(HTTPRequest *request,
 
 void KnowledgeService::HandleGetItem(HTTPRequest *request,
                                      HTTPResponse *response) {
+  string key;
+  {
+    WebService ws(kb_, request, response);
+
+    // Serve item from cache if it has already been rendered in the requested
+    // output format.
+    Text itemid = ws.Get("id");
+    LOG(INFO) << "Look up item '" << itemid << "'";
+    ws.ResolveOutputFormat();
+    key = StrCat(itemid, "|", static_cast<int>(ws.output_format()));
+    if (item_cache_.Serve(key, response)) return;
+
+    // Generate response.
+    Handle item = BuildItem(itemid, ws.store());
+    if (item.IsNil()) {
+      response->SendError(404, nullptr, "Item not found");
+      return;
+    }
+
+    // Return response.
+    ws.set_output(Object(ws.store(), item));
+  }
+
+  // Add rendered item to cache.
+  item_cache_.Insert(key, response);
+}
+
+void KnowledgeService::HandleGetItems(HTTPRequest *request,
+                                      HTTPResponse *response) {
   WebService ws(kb_, request, response);
 
-  // Look up item in knowledge base.
-  Text itemid = ws.Get("id");
-  LOG(INFO) << "Look up item '" << itemid << "'";
-  Handle handle = kb_->LookupExisting(itemid);
-  if (handle.IsNil()) {
-    response->SendError(404, nullptr, "Item not found");
+  // Get item ids from request.
+  std::vector<Text> ids;
+  Text param = ws.Get("ids");
+  int start = 0;
+  while (start < param.size()) {
+    int end = param.find(',', start);
+    if (end == -1) end = param.size();
+    if (end > start) ids.push_back(param.substr(start, end - start));
+    start = end + 1;
+  }
+  if (ws.input().IsArray()) {
+    Array input = ws.input().AsArray();
+    for (int i = 0; i < input.length(); ++i) {
+      Handle id = input.get(i);
+      if (ws.store()->IsString(id)) {
+        ids.push_back(ws.store()->GetString(id)->str());
+      }
+    }
+  }
+  if (ids.empty()) {
+    response->SendError(400, nullptr, "No item ids");
     return;
   }
-
-  // Generate response.
-  Frame item(ws.store(), handle);
-  if (!item.valid()) {
-    response->SendError(404, nullptr, "Invalid item");
+  if (ids.size() > kMaxBatchSize) {
+    response->SendError(400, nullptr, "Too many item ids");
     return;
   }
+  LOG(INFO) << "Look up " << ids.size() << " items";
+
+  // Resolve items in parallel. Each item is built in a separate store and
+  // returned in binary encoding, which is shared with the item cache.
+  int n = ids.size();
+  std::vector<string> encoded(n);
+  std::vector<char> found(n);
+  if (workers_ != nullptr && n > 1) {
+    std::mutex mu;
+    std::condition_variable completed;
+    int remaining = n;
+    for (int i = 0; i < n; ++i) {
+      workers_->Schedule([&, i]() {
+        found[i] = GetEncodedItem(ids[i], &encoded[i]);
+        std::unique_lock<std::mutex> lock(mu);
+        if (--remaining == 0) completed.notify_one();
+      });
+    }
+    std::unique_lock<std::mutex> lock(mu);
+    while (remaining > 0) completed.wait(lock);
+  } else {
+    for (int i = 0; i < n; ++i) {
+      found[i] = GetEncodedItem(ids[i], &encoded[i]);
+    }
+  }
+
+  // Decode items into the response store. Unknown items are skipped.
+  Handles items(ws.store());
+  for (int i = 0; i < n; ++i) {
+    if (!found[i]) continue;
+    items.push_back(Decode(ws.store(), encoded[i]).handle());
+  }
+
+  // Return response.
   Builder b(ws.store());
+  b.Add(n_items_, Array(ws.store(), items));
+  ws.set_output(b.Create());
+}
+
+Handle KnowledgeService::BuildItem(Text id, Store *store) {
+  // Look up item in knowledge base.
+  Handle handle = kb_->LookupExisting(id);
+  if (handle.IsNil()) return Handle::nil();
+  Frame item(store, handle);
+  if (!item.valid()) return Handle::nil();
+
+  // Build item record.
+  Builder b(store);
   GetStandardProperties(item, &b);
   Handle datatype = item.GetHandle(n_target_);
   if (!datatype.IsNil()) {
@@ -194,11 +300,11 @@ void KnowledgeService::HandleGetItem(HTTPRequest *request,
   }
 
   // Fetch properties.
-  Item info(ws.store());
+  Item info(store);
   FetchProperties(item, &info);
-  b.Add(n_properties_, Array(ws.store(), info.properties));
-  b.Add(n_xrefs_, Array(ws.store(), info.xrefs));
-  b.Add(n_categories_, Array(ws.store(), info.categories));
+  b.Add(n_properties_, Array(store, info.properties));
+  b.Add(n_xrefs_, Array(store, info.xrefs));
+  b.Add(n_categories_, Array(store, info.categories));
 
   // Set item image.
   if (!info.image.IsNil()) {
@@ -207,8 +313,23 @@ void KnowledgeService::HandleGetItem(HTTPRequest *request,
     b.Add(n_thumbnail_, info.alternate_image);
   }
 
-  // Return response.
-  ws.set_output(b.Create());
+  return b.Create().handle();
+}
+
+bool KnowledgeService::GetEncodedItem(Text id, string *encoded) {
+  // Try to get encoded item from cache.
+  string key = StrCat(id, "|", static_cast<int>(WebService::ENCODED));
+  if (item_cache_.Lookup(key, encoded)) return true;
+
+  // Build item in local store and encode it.
+  Store store(kb_);
+  Handle item = BuildItem(id, &store);
+  if (item.IsNil()) return false;
+  *encoded = Encode(Object(&store, item));
+
+  // Add encoded item to cache.
+  item_cache_.Insert(key, "application/sling", *encoded);
+  return true;
 }
 
 void KnowledgeService::FetchProperties(const Frame &item, Item *info) {
@@ -423,6 +544,19 @@ string KnowledgeService::UnitName(const Frame &unit) {
   // Check for valid unit.
   if (!unit.valid()) return "";
 
+  // Check for cached unit name.
+  {
+    MutexLock lock(&unit_mu_);
+    auto f = unit_names_.find(unit.handle());
+    if (f != unit_names_.end()) return f->second;
+  }
+  string name = LookupUnitName(unit);
+  MutexLock lock(&unit_mu_);
+  unit_names_[unit.handle()] = name;
+  return name;
+}
+
+string KnowledgeService::LookupUnitName(const Frame &unit) {
   // Find best unit symbol, preferably in latin script.
   Handle best = Handle::nil();
   Handle fallback = Handle::nil();
@@ -474,8 +608,18 @@ void KnowledgeService::HandleGetFrame(HTTPRequest *request,
     return;
   }
 
-  // Return frame as response.
-  ws.set_output(Object(kb_, handle));
+  // Stream frame to client. Large frames are sent in chunks instead of being
+  // buffered in the response.
+  ws.StreamOutput(Object(kb_, handle));
+}
+
+void KnowledgeService::HandleCacheStats(HTTPRequest *request,
+                                        HTTPResponse *response) {
+  response->SetContentType("text/html");
+  response->Append("<html><head><title>cachez</title></head><body>\n");
+  response->Append("<h1>Item cache</h1>\n");
+  item_cache_.Report(response);
+  response->Append("</body></html>\n");
 }
 
 }  // namespace nlp
@@ -21,9 +21,12 @@
 #include "sling/frame/object.h"
 #include "sling/frame/store.h"
 #include "sling/http/http-server.h"
+#include "sling/http/response-cache.h"
 #include "sling/http/static-content.h"
 #include "sling/nlp/kb/calendar.h"
 #include "sling/nlp/kb/name-table.h"
+#include "sling/util/mutex.h"
+#include "sling/util/threadpool.h"
 
 namespace sling {
 namespace nlp {
@@ -46,31 +49,59 @@ class KnowledgeService {
     Handle alternate_image;
   };
 
+  ~KnowledgeService();
+
   // Load and initialize knowledge base.
   void Load(Store *kb, const string &name_table);
 
   // Register knowledge base service.
   void Register(HTTPServer *http);
 
+  // Set maximum size in bytes for cache of rendered items.
+  void set_cache_capacity(int64 capacity) {
+    item_cache_.set_capacity(capacity);
+  }
+
+  // Set number of worker threads for resolving items in batch requests.
+  void set_num_workers(int num_workers) { num_workers_ = num_workers; }
+
   // Handle KB name queries.
   void HandleQuery(HTTPRequest *request, HTTPResponse *response);
 
   // Handle KB item requests.
   void HandleGetItem(HTTPRequest *request, HTTPResponse *response);
 
+  // Handle KB batch item requests. The item ids are either given as a
+  // comma-separated list in the ids parameter or as an array of ids in the
+  // request body.
+  void HandleGetItems(HTTPRequest *request, HTTPResponse *response);
+
   // Handle KB frame requests.
   void HandleGetFrame(HTTPRequest *request, HTTPResponse *response);
 
+  // Handle item cache statistics requests.
+  void HandleCacheStats(HTTPRequest *request, HTTPResponse *response);
+
  private:
+  // Build item record in store. Returns nil if item is not found.
+  Handle BuildItem(Text id, Store *store);
+
+  // Get item record in binary encoding. The encoded item records are shared
+  // with the item cache. Returns false if item is not found.
+  bool GetEncodedItem(Text id, string *encoded);
+
   // Fetch properties.
   void FetchProperties(const Frame &item, Item *info);
 
   // Get standard properties (ref, name, and description).
   void GetStandardProperties(const Frame &item, Builder *builder) const;
 
-  // Get unit name.
+  // Get unit name. The unit names are cached.
   string UnitName(const Frame &unit);
 
+  // Find unit name in knowledge base.
+  string LookupUnitName(const Frame &unit);
+
   // Convert value to readable text.
   string AsText(Handle value);
 
@@ -96,6 +127,20 @@ class KnowledgeService {
   // Name table.
   NameTable aliases_;
 
+  // Cache of rendered item responses keyed by item id and output format.
+  ResponseCache item_cache_;
+
+  // Cache of unit names shared between requests.
+  HandleMap<string> unit_names_;
+  Mutex unit_mu_;
+
+  // Worker threads for resolving items in batch requests.
+  int num_workers_ = 8;
+  ThreadPool *workers_ = nullptr;
+
+  // Maximum number of items in batch request.
+  static const int kMaxBatchSize = 1000;
+
   // Knowledge base browser app.
   StaticContent app_{"/kb", "sling/nlp/kb/app"};
 
@@ -117,6 +162,7 @@ class KnowledgeService {
   Name n_url_{names_, "url"};
   Name n_thumbnail_{names_, "thumbnail"};
   Name n_matches_{names_, "matches"};
+  Name n_items_{names_, "items"};
   Name n_lang_{names_, "lang"};
 
   Name n_xref_type_{names_, "/w/xref"};
@@ -12,9 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "sling/base/logging.h"
 #include "sling/base/types.h"
@@ -38,11 +40,18 @@ class NameTableBuilder : public task::FrameProcessor {
     // Set name normalization.
     normalization_ = ParseNormalization(task->Get("normalization", "lcp"));
 
+    // Get parameters for completion index. The top-k entities are
+    // precomputed for all name prefixes matching at least the threshold
+    // number of names.
+    task->Fetch("completions", &completions_);
+    task->Fetch("completion_threshold", &completion_threshold_);
+
     // Statistics.
     num_aliases_ = task->GetCounter("aliases");
     num_names_ = task->GetCounter("names");
     num_entities_ = task->GetCounter("entities");
     num_instances_ = task->GetCounter("instances");
+    num_completions_ = task->GetCounter("completions");
   }
 
   void Process(Slice key, const Frame &frame) override {
@@ -151,6 +160,20 @@ class NameTableBuilder : public task::FrameProcessor {
       offset += sizeof(uint8) + namelen + sizeof(uint32) + entity_array_size;
     }
 
+    // Write completion index for prefixes matching many names.
+    if (completions_ > 0) {
+      LOG(INFO) << "Build completion index";
+      File *completion_index_block = repository.AddBlock("CompletionIndex");
+      File *completion_block = repository.AddBlock("Completions");
+      std::vector<const NameEntry *> names;
+      names.reserve(name_table_.size());
+      for (const auto &it : name_table_) names.push_back(&it);
+      uint32 completion_offset = 0;
+      BuildCompletions(names, 0, names.size(), 0,
+                       completion_index_block, completion_block,
+                       &completion_offset);
+    }
+
     // Write repository to file.
     const string &filename = task->GetOutput("repository")->resource()->name();
     LOG(INFO) << "Write name repository to " << filename;
@@ -179,6 +202,82 @@ class NameTableBuilder : public task::FrameProcessor {
     uint32 count;
   };
 
+  // Name table entry.
+  typedef std::pair<const string, std::vector<EntityName>> NameEntry;
+
+  // Build completion index for the names in the range [begin;end) which all
+  // share a prefix of the given length. The completions are written in sorted
+  // prefix order, since a prefix sorts before all longer prefixes starting
+  // with it.
+  void BuildCompletions(const std::vector<const NameEntry *> &names,
+                        int begin, int end, int prefixlen,
+                        File *index_block, File *completion_block,
+                        uint32 *offset) {
+    // Only index prefixes matching enough names. The matches for other
+    // prefixes are cheap to find by scanning the names.
+    if (end - begin < completion_threshold_) return;
+
+    if (prefixlen > 0) {
+      // Sum the entity frequencies over all names matching the prefix.
+      std::unordered_map<uint32, uint64> scores;
+      for (int i = begin; i < end; ++i) {
+        for (const EntityName &entity : names[i]->second) {
+          scores[entity.index] += entity.count;
+        }
+      }
+
+      // Select the top-k entities by frequency.
+      std::vector<std::pair<uint64, uint32>> top;
+      top.reserve(scores.size());
+      for (const auto &it : scores) top.emplace_back(it.second, it.first);
+      int k = std::min<int>(completions_, top.size());
+      std::partial_sort(top.begin(), top.begin() + k, top.end(),
+                        std::greater<std::pair<uint64, uint32>>());
+
+      // Write completion offset to index.
+      index_block->WriteOrDie(offset, sizeof(uint32));
+
+      // Write prefix and top-k entities to completion block using the same
+      // layout as for names.
+      uint8 namelen = prefixlen;
+      completion_block->WriteOrDie(&namelen, sizeof(uint8));
+      completion_block->WriteOrDie(names[begin]->first.data(), namelen);
+      uint32 entlen = k;
+      completion_block->WriteOrDie(&entlen, sizeof(uint32));
+      std::vector<uint32> entity_array;
+      for (int i = 0; i < k; ++i) {
+        uint64 count = std::min<uint64>(top[i].first, 0xFFFFFFFF);
+        entity_array.push_back(entity_table_[top[i].second].offset);
+        entity_array.push_back(count);
+      }
+      int entity_array_size = entity_array.size() * sizeof(uint32);
+      completion_block->WriteOrDie(entity_array.data(), entity_array_size);
+      *offset += sizeof(uint8) + namelen + sizeof(uint32) + entity_array_size;
+      num_completions_->Increment();
+    }
+
+    // Skip name that is equal to the prefix. This sorts before all the other
+    // names with the prefix.
+    if (names[begin]->first.size() == prefixlen) begin++;
+
+    // Split range into sub-ranges by the next character after the prefix and
+    // build completions for the longer prefixes.
+    int start = begin;
+    while (start < end) {
+      const string &name = names[start]->first;
+      int len = prefixlen + UTF8::CharLen(name.data() + prefixlen);
+      if (len > name.size()) len = name.size();
+      Text prefix(name.data(), len);
+      int stop = start + 1;
+      while (stop < end && Text(names[stop]->first).starts_with(prefix)) {
+        stop++;
+      }
+      BuildCompletions(names, start, stop, len,
+                       index_block, completion_block, offset);
+      start = stop;
+    }
+  }
+
   // Symbols.
   Name n_lang_{names_, "lang"};
   Name n_name_{names_, "name"};
@@ -191,6 +290,12 @@ class NameTableBuilder : public task::FrameProcessor {
   // Text normalization flags.
   Normalization normalization_;
 
+  // Number of entities in completion index per prefix (top-k).
+  int completions_ = 100;
+
+  // Minimum number of names matching a prefix in completion index.
+  int completion_threshold_ = 100;
+
   // Sorted name table mapping normalized strings to entities with that name.
   std::map<string, std::vector<EntityName>> name_table_;
 
@@ -205,6 +310,7 @@ class NameTableBuilder : public task::FrameProcessor {
   task::Counter *num_entities_ = nullptr;
   task::Counter *num_aliases_ = nullptr;
   task::Counter *num_instances_ = nullptr;
+  task::Counter *num_completions_ = nullptr;
 
   // Mutex for serializing access to repository.
   Mutex mu_;
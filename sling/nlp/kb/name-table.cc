@@ -29,7 +29,11 @@ void NameTable::Load(const string &filename) {
   repository_.Read(filename);
 
   // Initialize name table.
-  name_index_.Initialize(repository_);
+  name_index_.Initialize(repository_, "Index", "Names", false);
+
+  // Initialize optional completion index.
+  has_completions_ = completion_index_.Initialize(
+      repository_, "CompletionIndex", "Completions", true);
 
   // Initialize entity table.
   repository_.FetchBlock("Entities", &entity_table_);
@@ -45,21 +49,68 @@ void NameTable::Load(const string &filename) {
 void NameTable::LookupPrefix(Text prefix,
                              int limit, int boost,
                              std::vector<Text> *matches) const {
-  // Normalize prefix.
-  string normalized;
-  UTF8::Normalize(prefix.data(), prefix.size(), normalization_, &normalized);
-  Text normalized_prefix(normalized);
+  // Normalize prefix. Prefixes that fit in the local buffer are normalized
+  // without allocating memory.
+  char buffer[256];
+  string overflow;
+  Text normalized_prefix = UTF8::Normalize(prefix, normalization_,
+                                           buffer, sizeof(buffer), &overflow);
 
   // Find first name that is greater than or equal to the prefix.
-  int lo = 0;
-  int hi = name_index_.size() - 1;
-  while (lo < hi) {
-    int mid = (lo + hi) / 2;
-    const NameItem *item = name_index_.GetName(mid);
-    if (item->name() < normalized_prefix) {
-      lo = mid + 1;
-    } else {
-      hi = mid;
+  int lo = LowerBound(name_index_, normalized_prefix);
+
+  // Use completion index if the prefix has been indexed. The index only has
+  // the top-k entities for the prefix, so the names are scanned if more
+  // matches are requested.
+  if (has_completions_) {
+    int c = LowerBound(completion_index_, normalized_prefix);
+    const NameItem *completion = nullptr;
+    if (c < completion_index_.size()) {
+      completion = completion_index_.GetName(c);
+      if (completion->name() != normalized_prefix) completion = nullptr;
+    }
+    if (completion != nullptr && limit > completion->num_entities()) {
+      completion = nullptr;
+    }
+    if (completion != nullptr) {
+      // Get the top-k entities for the prefix.
+      std::vector<std::pair<uint32, const EntityItem *>> top;
+      const EntityName *entity_names = completion->entities();
+      for (int i = 0; i < completion->num_entities(); ++i) {
+        top.emplace_back(entity_names[i].count,
+                         GetEntity(entity_names[i].offset));
+      }
+
+      // Add boost for entities with a name that is an exact match.
+      if (lo < name_index_.size()) {
+        const NameItem *exact = name_index_.GetName(lo);
+        if (exact->name() == normalized_prefix) {
+          const EntityName *exact_names = exact->entities();
+          for (int i = 0; i < exact->num_entities(); ++i) {
+            const EntityItem *entity = GetEntity(exact_names[i].offset);
+            bool found = false;
+            for (auto &t : top) {
+              if (t.second == entity) {
+                t.first += boost;
+                found = true;
+                break;
+              }
+            }
+            if (!found) {
+              top.emplace_back(exact_names[i].count + boost, entity);
+            }
+          }
+        }
+      }
+
+      // Return entities sorted by decreasing frequency.
+      std::sort(top.rbegin(), top.rend());
+      matches->clear();
+      for (const auto &t : top) {
+        if (matches->size() >= limit) break;
+        matches->push_back(t.second->id());
+      }
+      return;
     }
   }
 
@@ -102,6 +153,21 @@ void NameTable::LookupPrefix(Text prefix,
   }
 }
 
+int NameTable::LowerBound(const NameIndex &index, Text key) {
+  int lo = 0;
+  int hi = index.size() - 1;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    const NameItem *item = index.GetName(mid);
+    if (item->name() < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
 }  // namespace nlp
 }  // namespace sling
 
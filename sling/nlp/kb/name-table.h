@@ -33,7 +33,10 @@ class NameTable {
   void Load(const string &filename);
 
   // Look up entities with names matching a prefix. The matches are sorted
-  // by decreasing entity frequency.
+  // by decreasing entity frequency. If the name table has a completion index
+  // entry for the prefix with at least limit entities, the precomputed top-k
+  // entities for the prefix are returned instead of scanning all the names
+  // matching the prefix.
   void LookupPrefix(Text prefix, int limit, int boost,
                     std::vector<Text> *matches) const;
 
@@ -88,8 +91,10 @@ class NameTable {
   class NameIndex : public RepositoryIndex<uint32, NameItem> {
    public:
     // Initialize name index.
-    void Initialize(const Repository &repository) {
-      Init(repository, "Index", "Names", false);
+    bool Initialize(const Repository &repository,
+                    const char *index_block, const char *data_block,
+                    bool optional) {
+      return Init(repository, index_block, data_block, optional);
     }
 
     // Return name from name index.
@@ -98,6 +103,10 @@ class NameTable {
     }
   };
 
+  // Return index of the first name in index that is greater than or equal to
+  // the key.
+  static int LowerBound(const NameIndex &index, Text key);
+
   // Get entity from entity table.
   const EntityItem *GetEntity(uint32 offset) const {
     return reinterpret_cast<const EntityItem *>(entity_table_ + offset);
@@ -109,6 +118,11 @@ class NameTable {
   // Name index.
   NameIndex name_index_;
 
+  // Completion index with the most frequent entities for name prefixes that
+  // match many names. These use the same layout as the names.
+  NameIndex completion_index_;
+  bool has_completions_ = false;
+
   // Entity table.
   const char *entity_table_ = nullptr;
 
@@ -25,6 +25,7 @@
 #include "sling/nlp/wiki/wiki.h"
 #include "sling/task/frames.h"
 #include "sling/task/task.h"
+#include "sling/util/bloom.h"
 #include "sling/util/mutex.h"
 
 namespace sling {
@@ -39,6 +40,8 @@ class PhraseTableBuilder : public task::FrameProcessor {
     language_ = commons_->Lookup("/lang/" + lang);
     task->Fetch("reliable_alias_sources", &reliable_alias_sources_);
     task->Fetch("transfer_aliases", &transfer_aliases_);
+    task->Fetch("filter_bits_per_phrase", &filter_bits_per_phrase_);
+    task->Fetch("filter_hashes", &filter_hashes_);
 
     // Set phrase normalization.
     tokenizer_.set_normalization(
@@ -160,6 +163,20 @@ class PhraseTableBuilder : public task::FrameProcessor {
     }
     repository.WriteMap("Phrase", &items, num_buckets);
 
+    // Write Bloom filter for phrase fingerprints. This allows the phrase
+    // table to reject unknown phrases without probing the phrase map.
+    if (filter_bits_per_phrase_ > 0) {
+      LOG(INFO) << "Build phrase filter";
+      size_t bits = static_cast<size_t>(num_phrases) * filter_bits_per_phrase_;
+      BloomFilter filter(std::max(bits, static_cast<size_t>(64)),
+                         filter_hashes_);
+      for (auto &it : phrase_table_) filter.insert(it.first);
+      File *filter_block = repository.AddBlock("PhraseFilter");
+      uint64 header[2] = {filter.size(), static_cast<uint64>(filter.hashes())};
+      filter_block->WriteOrDie(header, sizeof(header));
+      filter_block->WriteOrDie(filter.data(), filter.bytes());
+    }
+
     // Write repository to file.
     const string &filename = task->GetOutput("repository")->resource()->name();
     CHECK(!filename.empty());
@@ -435,6 +452,11 @@ class PhraseTableBuilder : public task::FrameProcessor {
   // Mapping of entity id to entity index in entity table.
   std::unordered_map<string, int> entity_mapping_;
 
+  // Bloom filter parameters for phrase fingerprints. The default of ten bits
+  // per phrase with four hashes gives a false-positive rate of about 1%.
+  int filter_bits_per_phrase_ = 10;
+  int filter_hashes_ = 4;
+
   // Alias transfer.
   bool transfer_aliases_ = false;
 
@@ -33,6 +33,17 @@ void PhraseTable::Load(Store *store, const string &filename) {
     normalization_.assign(norm, repository_.GetBlockSize("normalization"));
   }
 
+  // Get Bloom filter for phrase fingerprints.
+  const uint64 *filter = reinterpret_cast<const uint64 *>(
+      repository_.GetBlock("PhraseFilter"));
+  if (filter) {
+    filter_size_ = filter[0];
+    filter_hashes_ = filter[1];
+    filter_ = filter + 2;
+    CHECK_LE((filter_size_ + 63) / 64 * sizeof(uint64),
+             repository_.GetBlockSize("PhraseFilter") - 2 * sizeof(uint64));
+  }
+
   // Allocate handle array for resolved entities.
   store_ = store;
   entity_table_ = new Handles(store);
@@ -53,6 +64,7 @@ Handle PhraseTable::GetEntityHandle(int index) const {
 }
 
 const PhraseTable::Phrase *PhraseTable::Find(uint64 fp) const {
+  if (!MaybeContains(fp)) return nullptr;
   int bucket = fp % phrase_index_.num_buckets();
   const PhraseItem *phrase = phrase_index_.GetBucket(bucket);
   const PhraseItem *end = phrase_index_.GetBucket(bucket + 1);
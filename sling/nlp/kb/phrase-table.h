@@ -25,6 +25,7 @@
 #include "sling/frame/object.h"
 #include "sling/string/text.h"
 #include "sling/util/asset.h"
+#include "sling/util/bloom.h"
 
 namespace sling {
 namespace nlp {
@@ -161,6 +162,14 @@ class PhraseTable : public Asset {
   // Find matching phrase in phrase table. Return null if phrase is not found.
   const Phrase *Find(uint64 fp) const;
 
+  // Check if phrase can possibly be in the phrase table. This uses the Bloom
+  // filter in the phrase repository, if present, so unknown phrases can be
+  // rejected without probing the phrase map.
+  bool MaybeContains(uint64 fp) const {
+    if (filter_ == nullptr) return true;
+    return BloomFilter::Contains(filter_, filter_size_, filter_hashes_, fp);
+  }
+
   // Get matching handles for phrase.
   void GetMatches(const Phrase *phrase, Handles *matches) const;
 
@@ -177,6 +186,12 @@ class PhraseTable : public Asset {
   // Entity index.
   EntityIndex entity_index_;
 
+  // Bloom filter for phrase fingerprints or null if the repository has no
+  // phrase filter.
+  const uint64 *filter_ = nullptr;
+  size_t filter_size_ = 0;
+  int filter_hashes_ = 0;
+
   // Store for resolving entity ids.
   Store *store_ = nullptr;
 
@@ -37,6 +37,9 @@ class ParserFeatureModel {
   // Return output with activation for current step.
   const myelin::Tensor *activation() const { return activation_; }
 
+  // Return input with links to the activations for the previous steps.
+  const myelin::Tensor *steps() const { return steps_; }
+
  private:
   // Get parameter tensor in decoder cell.
   myelin::Tensor *GetParam(const string &name, bool optional = false);
@@ -279,8 +279,8 @@ void ParserTrainer::Worker(int index, Network *model) {
     }
 
     // Update parameters.
+    optimizer_->Apply(gradients, &update_mu_);
     update_mu_.Lock();
-    optimizer_->Apply(gradients);
     loss_sum_ += epoch_loss;
     loss_count_ += epoch_count;
     update_mu_.Unlock();
@@ -14,22 +14,121 @@
 
 #include "sling/nlp/parser/parser.h"
 
+#include <string.h>
+
 #include "sling/frame/serialization.h"
+#include "sling/myelin/builder.h"
 
 REGISTER_COMPONENT_REGISTRY("parser delegate", sling::nlp::Delegate);
 
 namespace sling {
 namespace nlp {
 
+namespace {
+
+// Decoder for parsing the sentences in a document as part of a batch.
+class DocumentDecoder {
+ public:
+  DocumentDecoder(Document *document,
+                  const LexicalEncoder &encoder,
+                  const myelin::Cell *cell,
+                  const ParserFeatureModel *model)
+      : document_(document),
+        sentence_(document),
+        model_(model),
+        encoder_(encoder),
+        decoder_(cell),
+        activations_(model->steps()) {}
+
+  ~DocumentDecoder() {
+    delete features_;
+    delete state_;
+  }
+
+  // Start parsing the next non-empty sentence in the document. Returns false
+  // when there are no more sentences.
+  bool NextSentence() {
+    while (sentence_.more()) {
+      int begin = sentence_.begin();
+      int end = sentence_.end();
+      sentence_.next();
+
+      // Run the lexical encoder for sentence.
+      encodings_ = encoder_.Compute(*document_, begin, end);
+
+      // Initialize decoder.
+      delete features_;
+      delete state_;
+      state_ = new ParserState(document_, begin, end);
+      features_ = new ParserFeatureExtractor(model_, state_);
+      activations_.clear();
+      if (!state_->done()) return true;
+    }
+    return false;
+  }
+
+  // Compute decoder feature vector for the current step. The activations are
+  // computed by the batch decoder.
+  void Compute() {
+    // Allocate space for next step.
+    activations_.push();
+
+    // Attach instance to recurrent layers.
+    decoder_.Clear();
+    features_->Attach(encodings_, &activations_, &decoder_);
+
+    // Extract features.
+    features_->Extract(&decoder_);
+
+    // Compute feature vector.
+    decoder_.Compute();
+  }
+
+  // Decoder activations for the current step.
+  float *activation() const {
+    return reinterpret_cast<float *>(activations_.at(state_->step()));
+  }
+
+  // Parser state for current sentence.
+  ParserState *state() const { return state_; }
+
+  // Decoder instance for the current step.
+  myelin::Instance *instance() { return &decoder_; }
+
+ private:
+  // Document being parsed.
+  Document *document_;
+
+  // Iterator for the sentences in the document.
+  SentenceIterator sentence_;
+
+  // Parser feature model.
+  const ParserFeatureModel *model_;
+
+  // Lexical encoder and encodings for the current sentence.
+  LexicalEncoderInstance encoder_;
+  myelin::Channel *encodings_ = nullptr;
+
+  // Parser state and feature extractor for the current sentence.
+  ParserState *state_ = nullptr;
+  ParserFeatureExtractor *features_ = nullptr;
+
+  // Decoder instance and activations for the current sentence.
+  myelin::Instance decoder_;
+  myelin::Channel activations_;
+};
+
+}  // namespace
+
 Parser::~Parser() {
   for (auto *d : delegates_) delete d;
+  delete pool_;
 }
 
 void Parser::Load(Store *store, const string &model) {
-  // Load and compile parser flow.
+  // Load parser flow.
   myelin::Flow flow;
   CHECK(flow.Load(model));
-  compiler_.Compile(&flow, &network_);
 
   // Load commons store from parser model.
   myelin::Flow::Blob *commons = flow.DataBlock("commons");
@@ -57,6 +156,21 @@ void Parser::Load(Store *store, const string &model) {
   bool rnn_bidir = encoder_spec.GetBool("bidir");
 
   encoder_.AddLayers(rnn_layers, rnn_spec, rnn_bidir);
+
+  // Compile parser flow. The encoder input projections are computed for
+  // whole sentences, and the decoder activations for batches of sentences.
+  encoder_.BuildProjections(&flow);
+  BuildBatchDecoder(&flow);
+  if (quantizer_ != nullptr) {
+    if (calibrate_) {
+      quantizer_->Prepare(&flow);
+    } else {
+      quantizer_->Quantize(&flow);
+    }
+  }
+  compiler_.Compile(&flow, &network_);
+  if (calibrate_) quantizer_->Initialize(network_);
+
   encoder_.Initialize(network_);
   encoder_.LoadLexicon(&flow);
 
@@ -88,65 +202,158 @@ void Parser::Load(Store *store, const string &model) {
   // Initialize decoder feature model.
   decoder_ = network_.GetCell("decoder");
   feature_model_.Init(decoder_, &roles_, frame_limit);
+
+  // Initialize batch decoder.
+  features_ = decoder_->GetParameter("decoder/features");
+  batch_decoder_ = network_.GetCell("decoder_batch");
+  batch_features_ = batch_decoder_->GetParameter("decoder_batch/features");
+  batch_activations_ =
+      batch_decoder_->GetParameter("decoder_batch/activations");
+}
+
+void Parser::BuildBatchDecoder(myelin::Flow *flow) {
+  // Find the feed-forward layer that computes the decoder activations from
+  // the feature vector, i.e. activation = Relu(MatMul(features, W0) + b0).
+  myelin::Flow::Function *decoder = flow->Func("decoder");
+  myelin::Flow::Variable *activation = flow->Var("decoder/activation");
+  CHECK(decoder != nullptr);
+  CHECK(activation != nullptr);
+  myelin::Flow::Operation *relu = activation->producer;
+  CHECK(relu != nullptr && relu->type == "Relu");
+  myelin::Flow::Operation *add = relu->inputs[0]->producer;
+  CHECK(add != nullptr && add->type == "Add");
+  myelin::Flow::Operation *matmul = add->inputs[0]->producer;
+  CHECK(matmul != nullptr && matmul->type == "MatMul");
+  myelin::Flow::Variable *features = matmul->inputs[0];
+  myelin::Flow::Variable *weights = matmul->inputs[1];
+  myelin::Flow::Variable *bias = add->inputs[1];
+  myelin::Flow::Variable *product = matmul->outputs[0];
+  myelin::Flow::Variable *sum = add->outputs[0];
+
+  // Remove the feed-forward layer from the decoder and output the feature
+  // vector instead. The activation variable is kept in the decoder, so it is
+  // still linked to the step and delegate inputs.
+  flow->RemoveOperation(relu);
+  flow->RemoveOperation(add);
+  flow->RemoveOperation(matmul);
+  flow->DeleteVariable(product);
+  flow->DeleteVariable(sum);
+  features->name = "decoder/features";
+  features->set_out();
+  decoder->unused.push_back(activation);
+
+  // Compute the activations for a batch of feature vectors.
+  myelin::FlowBuilder f(flow, "decoder_batch");
+  int fvsize = features->dim(1);
+  auto *input = f.Placeholder("features", myelin::DT_FLOAT,
+                              {batch_size_, fvsize});
+  auto *output = f.Relu(f.Add(f.MatMul(input, weights), bias));
+  f.Name(output, "activations")->set_out();
+}
+
+void Parser::set_batch_size(int batch_size) {
+  CHECK(decoder_ == nullptr) << "Batch size must be set before loading parser";
+  CHECK_GE(batch_size, 1);
+  batch_size_ = batch_size;
+}
+
+void Parser::set_quantizer(myelin::Quantizer *quantizer, bool calibrate) {
+  CHECK(decoder_ == nullptr) << "Quantizer must be set before loading parser";
+  quantizer_ = quantizer;
+  calibrate_ = calibrate && quantizer != nullptr;
+}
+
+void Parser::EnableParallelEncoder(int threads) {
+  CHECK(pool_ == nullptr);
+  pool_ = new ThreadPool(threads, threads);
+  pool_->StartWorkers();
+  encoder_.set_pool(pool_);
 }
 
 void Parser::Parse(Document *document) const {
+  std::vector<Document *> documents = {document};
+  Parse(documents);
+}
+
+void Parser::Parse(const std::vector<Document *> &documents) const {
   // Create delegates.
   std::vector<DelegateInstance *> delegates;
   for (auto *d : delegates_) delegates.push_back(d->CreateInstance());
 
-  // Parse each sentence of the document.
-  LexicalEncoderInstance encoder(encoder_);
-  for (SentenceIterator s(document); s.more(); s.next()) {
-    // Run the lexical encoder for sentence.
-    myelin::Channel *encodings = encoder.Compute(*document, s.begin(), s.end());
-
-    // Initialize decoder.
-    ParserState state(document, s.begin(), s.end());
-    ParserFeatureExtractor features(&feature_model_, &state);
-    myelin::Instance decoder(decoder_);
-    myelin::Channel activations(feature_model_.activation());
-
-    // Run decoder to predict transitions.
-    while (!state.done()) {
-      // Allocate space for next step.
-      activations.push();
-
-      // Attach instance to recurrent layers.
-      decoder.Clear();
-      features.Attach(encodings, &activations, &decoder);
-
-      // Extract features.
-      features.Extract(&decoder);
-
-      // Compute decoder activations.
-      decoder.Compute();
-
-      // Run the cascade.
-      ParserAction action(ParserAction::CASCADE, 0);
-      int step = state.step();
-      float *activation = reinterpret_cast<float *>(activations.at(step));
-      int d = 0;
-      for (;;) {
-        delegates[d]->Predict(activation, &action);
-        if (action.type != ParserAction::CASCADE) break;
-        CHECK_GT(action.delegate, d);
-        d = action.delegate;
+  // Run the decoder over the documents in batches. Whenever all the sentences
+  // in a document have been parsed, the next document is added to the batch.
+  myelin::Instance data(batch_decoder_);
+  size_t fvsize = features_->elements() * sizeof(float);
+  size_t actsize = batch_activations_->dim(1) * sizeof(float);
+  std::vector<DocumentDecoder *> batch;
+  int next = 0;
+  while (next < documents.size() || !batch.empty()) {
+    // Fill up batch with new documents.
+    while (batch.size() < batch_size_ && next < documents.size()) {
+      auto *decoder = new DocumentDecoder(documents[next++], encoder_,
+                                          decoder_, &feature_model_);
+      if (decoder->NextSentence()) {
+        batch.push_back(decoder);
+      } else {
+        delete decoder;
       }
+    }
 
-      // Fall back to SHIFT if predicted action is not valid.
-      if (!state.CanApply(action)) {
-        action.type = ParserAction::SHIFT;
-      }
+    // Compute the feature vectors for the current step of all sentences.
+    for (int i = 0; i < batch.size(); ++i) {
+      myelin::Instance *instance = batch[i]->instance();
+      batch[i]->Compute();
+      if (calibrate_) quantizer_->Observe(instance);
+      memcpy(data.Get<float>(batch_features_, i),
+             instance->Get<float>(features_), fvsize);
+    }
+
+    // Compute the decoder activations for all sentences in the batch.
+    data.Compute();
+    if (calibrate_) quantizer_->Observe(&data);
 
-      // Apply action to parser state.
-      state.Apply(action);
+    // Predict and apply the next action for all sentences, and remove the
+    // documents that have been completely parsed from the batch.
+    int active = 0;
+    for (int i = 0; i < batch.size(); ++i) {
+      DocumentDecoder *decoder = batch[i];
+      memcpy(decoder->activation(),
+             data.Get<float>(batch_activations_, i), actsize);
+      Predict(delegates, decoder->activation(), decoder->state());
+      if (decoder->state()->done() && !decoder->NextSentence()) {
+        delete decoder;
+      } else {
+        batch[active++] = decoder;
+      }
     }
+    batch.resize(active);
   }
 
   for (auto *d : delegates) delete d;
 }
 
+void Parser::Predict(const std::vector<DelegateInstance *> &delegates,
+                     float *activation,
+                     ParserState *state) const {
+  // Run the cascade.
+  ParserAction action(ParserAction::CASCADE, 0);
+  int d = 0;
+  for (;;) {
+    delegates[d]->Predict(activation, &action);
+    if (action.type != ParserAction::CASCADE) break;
+    CHECK_GT(action.delegate, d);
+    d = action.delegate;
+  }
+
+  // Fall back to SHIFT if predicted action is not valid.
+  if (!state->CanApply(action)) {
+    action.type = ParserAction::SHIFT;
+  }
+
+  // Apply action to parser state.
+  state->Apply(action);
+}
+
 }  // namespace nlp
 }  // namespace sling
 
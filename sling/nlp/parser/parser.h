@@ -24,11 +24,13 @@
 #include "sling/myelin/compiler.h"
 #include "sling/myelin/compute.h"
 #include "sling/myelin/flow.h"
+#include "sling/myelin/quantization.h"
 #include "sling/nlp/document/document.h"
 #include "sling/nlp/document/lexical-encoder.h"
 #include "sling/nlp/parser/parser-features.h"
 #include "sling/nlp/parser/parser-state.h"
 #include "sling/nlp/parser/roles.h"
+#include "sling/util/threadpool.h"
 
 namespace sling {
 namespace nlp {
@@ -68,13 +70,55 @@ class Parser {
   // Load and initialize parser model.
   void Load(Store *store, const string &filename);
 
-  // Parse document.
+  // Use quantizer for int8 quantization of the parser network. This must be
+  // called before Load(). In calibration mode, the matrix multiplications
+  // that can be quantized are selected when the parser is loaded, and their
+  // inputs are observed by the quantizer while parsing documents. Parsing is
+  // not thread-safe in calibration mode. Otherwise, the parser network is
+  // quantized with the calibrated quantizer when the parser is loaded.
+  void set_quantizer(myelin::Quantizer *quantizer, bool calibrate);
+
+  // Compute the left-to-right and right-to-left RNNs of bidirectional encoder
+  // layers in parallel using a pool of worker threads.
+  void EnableParallelEncoder(int threads);
+
+  // Set the number of sentences in the batch decoder. This must be called
+  // before Load(). The feed-forward layer of the decoder is moved into a
+  // separate batch decoder cell that computes the activations for up to
+  // batch_size sentences in one go using matrix-matrix kernels. All parsing
+  // goes through the batch decoder, so parsing a batch of documents gives the
+  // same result as parsing the documents one at a time. The matrix-matrix
+  // kernels can round differently from the vector-matrix kernels used for a
+  // batch size of one, but the activations for a sentence do not depend on
+  // the other sentences in the batch.
+  void set_batch_size(int batch_size);
+
+  // Parse document. The sentences in a document are parsed in order, so this
+  // only fills one row of the batch decoder.
   void Parse(Document *document) const;
 
+  // Parse batch of documents. The decoder is run in lockstep over up to
+  // batch_size documents, so the decoder activations for each step are
+  // computed for all the sentences in the batch at once.
+  void Parse(const std::vector<Document *> &documents) const;
+
   // Neural network for parser.
   const myelin::Network &network() const { return network_; }
 
+  // Lexical encoder for parser.
+  const LexicalEncoder &encoder() const { return encoder_; }
+
  private:
+  // Predict next action from decoder activations using the delegate cascade
+  // and apply it to the parser state.
+  void Predict(const std::vector<DelegateInstance *> &delegates,
+               float *activation,
+               ParserState *state) const;
+
+  // Move the feed-forward layer of the decoder into a separate batch decoder
+  // function with batch_size rows.
+  void BuildBatchDecoder(myelin::Flow *flow);
+
   // JIT compiler.
   myelin::Compiler compiler_;
 
@@ -87,6 +131,14 @@ class Parser {
   // Parser decoder.
   myelin::Cell *decoder_ = nullptr;
 
+  // Batch decoder for computing the decoder activations for a batch of
+  // sentences from the decoder feature vectors.
+  int batch_size_ = 1;
+  myelin::Cell *batch_decoder_ = nullptr;
+  myelin::Tensor *features_ = nullptr;
+  myelin::Tensor *batch_features_ = nullptr;
+  myelin::Tensor *batch_activations_ = nullptr;
+
   // Parser feature model for feature extraction in the decoder.
   ParserFeatureModel feature_model_;
 
@@ -95,6 +147,13 @@ class Parser {
 
   // Set of roles considered.
   RoleSet roles_;
+
+  // Worker pool for parallel encoder.
+  ThreadPool *pool_ = nullptr;
+
+  // Quantizer for calibrating or quantizing the parser network (optional).
+  myelin::Quantizer *quantizer_ = nullptr;
+  bool calibrate_ = false;
 };
 
 }  // namespace nlp
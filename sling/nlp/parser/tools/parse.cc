@@ -19,13 +19,21 @@
 //    The output frames are printed in textual form, whose indentation is
 //    controlled by --indent.
 // B. If --benchmark is true, then it runs the parser over the corpus
-//    specified via --corpus, and reports the processing speed.
+//    specified via --corpus, and reports the processing speed. The documents
+//    are parsed in batches of --batch documents, and the decoder activations
+//    are computed for up to --batch sentences at a time.
 // C. If --evaluate is true, then it takes gold documents via --corpus, runs
 //    the parser over them, and reports frame evaluation numbers.
 //
 // For B and C, --maxdocs can be used to limit the processing to the specified
 // number of documents.
+//
+// With --quantize, the matrix multiplications in the parser network are
+// quantized to int8. The quantization is calibrated by parsing the first
+// --calibration_docs documents in --corpus with the float parser, and the
+// quantization error for each op is reported.
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -40,6 +48,7 @@
 #include "sling/frame/serialization.h"
 #include "sling/myelin/compiler.h"
 #include "sling/myelin/profile.h"
+#include "sling/myelin/quantization.h"
 #include "sling/nlp/document/document.h"
 #include "sling/nlp/document/document-corpus.h"
 #include "sling/nlp/document/document-tokenizer.h"
@@ -58,6 +67,10 @@ DEFINE_bool(benchmark, false, "Benchmark parser");
 DEFINE_bool(lex, false, "Output documents in LEX format");
 DEFINE_bool(evaluate, false, "Evaluate parser");
 DEFINE_int32(maxdocs, -1, "Maximum number of documents to process");
+DEFINE_int32(batch, 1, "Number of documents parsed in each batch");
+DEFINE_int32(encoder_threads, 0, "Worker threads for bidirectional encoder");
+DEFINE_bool(quantize, false, "Quantize parser to int8 calibrated on --corpus");
+DEFINE_int32(calibration_docs, 100, "Number of documents for calibration");
 
 using namespace sling;
 using namespace sling::nlp;
@@ -126,13 +139,44 @@ class ParserEvaulationCorpus : public ParallelCorpus {
 int main(int argc, char *argv[]) {
   InitProgram(&argc, &argv);
 
+  // Optionally calibrate int8 quantization of the parser network by parsing
+  // documents from the corpus with the float parser.
+  myelin::Quantizer quantizer;
+  Parser parser;
+  if (FLAGS_quantize) {
+    CHECK(!FLAGS_corpus.empty());
+    LOG(INFO) << "Calibrate quantization on " << FLAGS_corpus;
+    Store calibration_commons;
+    Parser calibration;
+    calibration.set_quantizer(&quantizer, true);
+    calibration.set_batch_size(std::max(FLAGS_batch, 1));
+    calibration.Load(&calibration_commons, FLAGS_parser);
+    calibration_commons.Freeze();
+    DocumentCorpus corpus(&calibration_commons, FLAGS_corpus);
+    for (int i = 0; i < FLAGS_calibration_docs; ++i) {
+      Store store(&calibration_commons);
+      Document *document = corpus.Next(&store);
+      if (document == nullptr) break;
+      document->ClearAnnotations();
+      calibration.Parse(document);
+      delete document;
+    }
+    parser.set_quantizer(&quantizer, false);
+  }
+
   // Load parser.
   LOG(INFO) << "Load parser from " << FLAGS_parser;
   Clock clock;
   clock.start();
   Store commons;
-  Parser parser;
+  parser.set_batch_size(std::max(FLAGS_batch, 1));
   parser.Load(&commons, FLAGS_parser);
+  if (FLAGS_quantize) {
+    LOG(INFO) << "Quantization error:\n" << quantizer.Report();
+  }
+  if (FLAGS_encoder_threads > 0) {
+    parser.EnableParallelEncoder(FLAGS_encoder_threads);
+  }
   commons.Freeze();
   clock.stop();
   LOG(INFO) << clock.ms() << " ms loading parser";
@@ -202,28 +246,49 @@ int main(int argc, char *argv[]) {
     DocumentCorpus corpus(&commons, FLAGS_corpus);
     int num_documents = 0;
     int num_tokens = 0;
+    std::vector<Store *> stores;
+    std::vector<Document *> batch;
     clock.start();
     for (;;) {
-      if (FLAGS_maxdocs != -1 && num_documents >= FLAGS_maxdocs) break;
-
-      Store store(&commons);
-      Document *document = corpus.Next(&store);
-      if (document == nullptr) break;
-
-      num_documents++;
-      num_tokens += document->num_tokens();
-      if (num_documents % 100 == 0) {
-        std::cout << num_documents << " documents\r";
-        std::cout.flush();
+      // Read next batch of documents.
+      while (batch.size() < std::max(FLAGS_batch, 1)) {
+        if (FLAGS_maxdocs != -1 && num_documents >= FLAGS_maxdocs) break;
+        Store *store = new Store(&commons);
+        Document *document = corpus.Next(store);
+        if (document == nullptr) {
+          delete store;
+          break;
+        }
+        stores.push_back(store);
+        batch.push_back(document);
+
+        num_documents++;
+        num_tokens += document->num_tokens();
+        if (num_documents % 100 == 0) {
+          std::cout << num_documents << " documents\r";
+          std::cout.flush();
+        }
       }
-      parser.Parse(document);
+      if (batch.empty()) break;
 
-      delete document;
+      // Parse documents in batch.
+      parser.Parse(batch);
+
+      for (Document *document : batch) delete document;
+      for (Store *store : stores) delete store;
+      batch.clear();
+      stores.clear();
     }
     clock.stop();
     LOG(INFO) << num_documents << " documents, "
               << num_tokens << " tokens, "
               << num_tokens / clock.secs() << " tokens/sec";
+    int64 hits, misses;
+    parser.encoder().lex().GetCacheStats(&hits, &misses);
+    if (hits + misses > 0) {
+      LOG(INFO) << "Token feature cache hit rate "
+                << (100.0 * hits / (hits + misses)) << "%";
+    }
   }
 
   // Evaluate parser on gold corpus.
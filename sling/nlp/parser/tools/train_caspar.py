@@ -3,6 +3,8 @@ import sling.flags as flags
 import sling.task.workflow as workflow
 
 flags.define("--accurate", default=False,action='store_true')
+flags.define("--optimizer_shards", default=1, type=int)
+flags.define("--hogwild", default=False,action='store_true')
 
 flags.parse()
 
@@ -59,6 +61,8 @@ trainer.add_params({
   "report_interval": 1000,
   "learning_rate_cliff": 40000,
   "epochs": 50000,
+  "optimizer_shards": flags.arg.optimizer_shards,
+  "hogwild": flags.arg.hogwild,
 })
 
 trainer.attach_input("training_corpus", training_corpus)
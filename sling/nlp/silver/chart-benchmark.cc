@@ -0,0 +1,124 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark for the span chart solver. Long sentences are collected from a
+// document corpus, e.g. Wikipedia, and span charts are populated with the
+// mentions in the documents and, optionally, with the matches in a phrase
+// table. The charts are then solved and extracted a number of times, and the
+// throughput is reported in sentences/s and tokens/s.
+
+#include <string>
+#include <vector>
+
+#include "sling/base/clock.h"
+#include "sling/base/flags.h"
+#include "sling/base/init.h"
+#include "sling/base/logging.h"
+#include "sling/base/types.h"
+#include "sling/frame/store.h"
+#include "sling/nlp/document/document.h"
+#include "sling/nlp/document/document-corpus.h"
+#include "sling/nlp/kb/phrase-table.h"
+#include "sling/nlp/silver/chart.h"
+#include "sling/nlp/silver/mentions.h"
+
+DEFINE_string(corpus, "local/data/e/wiki/en/documents@10.rec",
+              "Document corpus with sentences");
+DEFINE_string(aliases, "", "Phrase table for populating charts");
+DEFINE_int32(maxdocs, 10000, "Maximum number of documents to load");
+DEFINE_int32(min_length, 40, "Minimum sentence length in tokens");
+DEFINE_int32(max_phrase_length, 10, "Maximum phrase length");
+DEFINE_int32(runs, 5, "Number of benchmark runs");
+
+using namespace sling;
+using namespace sling::nlp;
+
+// Sentence in document with the mentions in the sentence.
+struct Sentence {
+  Document *document;
+  int begin;
+  int end;
+  std::vector<Span *> mentions;
+};
+
+int main(int argc, char *argv[]) {
+  InitProgram(&argc, &argv);
+
+  // Load phrase table.
+  Store commons;
+  PhraseTable aliases;
+  if (!FLAGS_aliases.empty()) {
+    LOG(INFO) << "Loading phrase table from " << FLAGS_aliases;
+    aliases.Load(&commons, FLAGS_aliases);
+  }
+
+  // Collect long sentences from corpus.
+  LOG(INFO) << "Loading documents from " << FLAGS_corpus;
+  DocumentCorpus corpus(&commons, FLAGS_corpus);
+  Store store(&commons);
+  std::vector<Document *> documents;
+  std::vector<Sentence> sentences;
+  int64 tokens = 0;
+  while (documents.size() < FLAGS_maxdocs) {
+    Document *document = corpus.Next(&store);
+    if (document == nullptr) break;
+    documents.push_back(document);
+    for (SentenceIterator s(document, HEADING_BEGIN); s.more(); s.next()) {
+      if (s.length() < FLAGS_min_length) continue;
+      sentences.emplace_back();
+      Sentence &sentence = sentences.back();
+      sentence.document = document;
+      sentence.begin = s.begin();
+      sentence.end = s.end();
+      for (Span *span : document->spans()) {
+        if (span->begin() < s.begin() || span->end() > s.end()) continue;
+        if (span->length() == 0) continue;
+        sentence.mentions.push_back(span);
+      }
+      tokens += s.length();
+    }
+  }
+  LOG(INFO) << sentences.size() << " sentences, " << tokens << " tokens";
+
+  // Populate, solve, and extract span charts for all sentences, and report
+  // the throughput for the fastest run.
+  SpanPopulator populator;
+  double best = 0.0;
+  int64 spans = 0;
+  for (int run = 0; run < FLAGS_runs; ++run) {
+    spans = 0;
+    Clock clock;
+    clock.start();
+    for (const Sentence &s : sentences) {
+      SpanChart chart(s.document, s.begin, s.end, FLAGS_max_phrase_length);
+      if (!FLAGS_aliases.empty()) populator.Annotate(&aliases, &chart);
+      for (Span *span : s.mentions) {
+        chart.Add(span->begin(), span->end(), span->Evoked().handle());
+      }
+      chart.Solve();
+      chart.Extract([&spans](int begin, int end, const SpanChart::Item &item) {
+        spans++;
+      });
+    }
+    clock.stop();
+    double sps = sentences.size() / clock.secs();
+    LOG(INFO) << "Run " << run << ": " << sps << " sentences/s, "
+              << tokens / clock.secs() << " tokens/s";
+    if (sps > best) best = sps;
+  }
+  LOG(INFO) << spans << " spans, best " << best << " sentences/s";
+
+  for (Document *document : documents) delete document;
+  return 0;
+}
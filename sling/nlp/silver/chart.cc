@@ -14,8 +14,10 @@
 
 #include "sling/nlp/silver/chart.h"
 
-#include <vector>
+#include <algorithm>
+#include <limits>
 #include <utility>
+#include <vector>
 
 namespace sling {
 namespace nlp {
@@ -31,13 +33,33 @@ SpanChart::SpanChart(const Document *document, int begin, int end, int maxlen)
   // Phrase matches cannot be longer than the number of document tokens.
   if (size_ < maxlen_) maxlen_ = size_;
 
-  // Initialize chart.
-  items_.resize(size_ * size_);
+  // Initialize chart band with items for spans up to the maximum length.
+  band_ = std::max(maxlen_, 1);
+  items_.resize(size_ * band_);
   for (int b = 0; b < size_; ++b) {
-    for (int e = b + 1; e <= size_; ++e) {
-      item(b, e).cost = e - b;
+    for (int l = 1; l <= band_; ++l) {
+      items_[b * band_ + l - 1].cost = l;
     }
   }
+
+  // Initially, the whole chart is one segment.
+  segments_.push_back(size_);
+}
+
+SpanChart::Item &SpanChart::LongItem(int begin, int end) {
+  auto f = long_items_.find(begin * size_ + end - 1);
+  if (f != long_items_.end()) return f->second;
+  Item &item = long_items_[begin * size_ + end - 1];
+  item.cost = end - begin;
+  return item;
+}
+
+const SpanChart::Item *SpanChart::Find(int begin, int end) const {
+  int length = end - begin;
+  if (length <= band_) return &items_[begin * band_ + length - 1];
+  if (long_items_.empty()) return nullptr;
+  auto f = long_items_.find(begin * size_ + end - 1);
+  return f != long_items_.end() ? &f->second : nullptr;
 }
 
 void SpanChart::Add(int begin, int end, Handle match, int flags) {
@@ -50,70 +72,129 @@ void SpanChart::Add(int begin, int end, Handle match, int flags) {
 }
 
 void SpanChart::Solve() {
+  // Find the end of the longest matched span starting at each token. Only
+  // spans up to the maximum phrase length are considered.
+  std::vector<int> reach(size_);
+  for (int b = 0; b < size_; ++b) {
+    reach[b] = b + 1;
+    int limit = std::min(std::min(band_, maxlen_), size_ - b);
+    const Item *items = &items_[b * band_];
+    for (int l = 1; l <= limit; ++l) {
+      if (items[l - 1].matched()) reach[b] = b + l;
+    }
+  }
+  for (auto &it : long_items_) {
+    int b = it.first / size_;
+    int e = it.first % size_ + 1;
+    if (e - b <= maxlen_ && it.second.matched() && e > reach[b]) reach[b] = e;
+  }
+
   // Segment document into parts without crossing spans.
+  segments_.clear();
   int segment_begin = 0;
   while (segment_begin < size_) {
     // Find next segment.
     int segment_end = segment_begin + 1;
     for (int b = segment_begin; b < segment_end; ++b) {
-      for (int l = 1; l <= maxlen_; l++) {
-        int e = b + l;
-        if (e > size_) break;
-        Item &span = item(b, e);
-        if (span.matches != nullptr || !span.aux.IsNil()) {
-          if (e > segment_end) segment_end = e;
-        }
-      }
+      if (reach[b] > segment_end) segment_end = reach[b];
+    }
+
+    // Compute best span covering for the segment. Single-token segments are
+    // already covered by the token.
+    if (segment_end - segment_begin > 1) {
+      SolveSegment(segment_begin, segment_end);
+    }
+
+    // Move on to next segment.
+    segments_.push_back(segment_end);
+    segment_begin = segment_end;
+  }
+}
+
+void SpanChart::SolveSegment(int begin, int end) {
+  // Get the span costs for the segment. The costs and splits are indexed by
+  // span start and length relative to the segment.
+  int n = end - begin;
+  costs_.resize(n * n);
+  splits_.assign(n * n, -1);
+  float min_cost = std::numeric_limits<float>::max();
+  for (int s = 0; s < n; ++s) {
+    for (int l = 1; l <= n - s; ++l) {
+      const Item *span = Find(begin + s, begin + s + l);
+      float cost = span != nullptr ? span->cost : l;
+      costs_[s * n + l - 1] = cost;
+      if (cost < min_cost) min_cost = cost;
     }
+  }
 
-    // Compute best span covering for the segment.
-    int segment_size = segment_end - segment_begin;
-    for (int l = 2; l <= segment_size; ++l) {
-      // Find best covering for all spans of length l.
-      for (int s = segment_begin; s <= segment_end - l; ++s) {
-        // Find best split of span [s;s+l).
-        Item &span = item(s, s + l);
-        for (int n = 1; n < l; ++n) {
-          // Consider the split [s;s+n) and [s+n;s+l).
-          Item &left = item(s, s + n);
-          Item &right = item(s + n, s + l);
-          float cost = left.cost + right.cost;
-          if (cost < span.cost) {
-            span.cost = cost;
-            span.split = n;
-          }
+  // With non-negative costs, a split costs at least twice the minimum cost,
+  // so spans with a cost below this cannot be improved by splitting.
+  bool prune = min_cost >= 0.0;
+  float bound = 2 * min_cost;
+
+  // Compute best covering for all spans of length l.
+  for (int l = 2; l <= n; ++l) {
+    for (int s = 0; s <= n - l; ++s) {
+      // Find best split of span [s;s+l).
+      float &cost = costs_[s * n + l - 1];
+      if (prune && cost <= bound) continue;
+      int &split = splits_[s * n + l - 1];
+      for (int k = 1; k < l; ++k) {
+        // Consider the split [s;s+k) and [s+k;s+l).
+        float c = costs_[s * n + k - 1] + costs_[(s + k) * n + l - k - 1];
+        if (c < cost) {
+          cost = c;
+          split = k;
         }
       }
     }
+  }
 
-    if (segment_end != size_) {
-      // Mark segment split.
-      item(segment_begin, size_).split = segment_end - segment_begin;
+  // Store the improved spans in the chart.
+  for (int s = 0; s < n; ++s) {
+    for (int l = 2; l <= n - s; ++l) {
+      int split = splits_[s * n + l - 1];
+      if (split == -1) continue;
+      Item &span = item(begin + s, begin + s + l);
+      span.cost = costs_[s * n + l - 1];
+      span.split = split;
     }
-
-    // Move on to next segment.
-    segment_begin = segment_end;
   }
 }
 
 void SpanChart::Extract(const Extractor &extractor) {
   std::vector<std::pair<int, int>> queue;
-  queue.emplace_back(0, size_);
-  while (!queue.empty()) {
-    // Get next span from queue.
-    int b = queue.back().first;
-    int e = queue.back().second;
-    queue.pop_back();
-
-    Item &s = item(b, e);
-    if (!s.aux.IsNil() || s.matches != nullptr) {
-      // Output annotation.
-      extractor(begin_ + b, begin_ + e, s);
-    } else if (s.split != -1) {
-      // Queue best split.
-      queue.emplace_back(b + s.split, e);
-      queue.emplace_back(b, b + s.split);
+  int segment_begin = 0;
+  for (int segment_end : segments_) {
+    // A matched span covering the rest of the chart is output instead of the
+    // remaining segments.
+    if (segment_end != size_) {
+      const Item *rest = Find(segment_begin, size_);
+      if (rest != nullptr && rest->matched()) {
+        extractor(begin_ + segment_begin, begin_ + size_, *rest);
+        return;
+      }
     }
+
+    queue.emplace_back(segment_begin, segment_end);
+    while (!queue.empty()) {
+      // Get next span from queue.
+      int b = queue.back().first;
+      int e = queue.back().second;
+      queue.pop_back();
+
+      const Item *s = Find(b, e);
+      if (s == nullptr) continue;
+      if (s->matched()) {
+        // Output annotation.
+        extractor(begin_ + b, begin_ + e, *s);
+      } else if (s->split != -1) {
+        // Queue best split.
+        queue.emplace_back(b + s->split, e);
+        queue.emplace_back(b, b + s->split);
+      }
+    }
+    segment_begin = segment_end;
   }
 }
 
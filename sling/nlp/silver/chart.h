@@ -16,6 +16,7 @@
 #define SLING_NLP_NER_CHART_H_
 
 #include <functional>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -28,7 +29,9 @@ namespace sling {
 namespace nlp {
 
 // Span chart for sentence in document. This represents all the phrase matches
-// up to a maximum length.
+// up to a maximum length. The items for spans up to the maximum phrase length
+// are stored in a dense band, and items for longer spans are only stored when
+// they are used, so the chart size is linear in the sentence length.
 class SpanChart {
  public:
   // Chart item.
@@ -61,7 +64,9 @@ class SpanChart {
   // Add auxiliary match to chart.
   void Add(int begin, int end, Handle match, int flags = 0);
 
-  // Compute non-overlapping span covering with minimum cost.
+  // Compute non-overlapping span covering with minimum cost. The chart is
+  // divided into segments that are not crossed by any matched span, and the
+  // covering is only computed for segments with more than one token.
   void Solve();
 
   // Extract best span covering.
@@ -75,7 +80,9 @@ class SpanChart {
     DCHECK_LT(begin, size_);
     DCHECK_GT(end, begin);
     DCHECK_LE(end, size_);
-    return items_[begin * size_ + end - 1];
+    int length = end - begin;
+    if (length <= band_) return items_[begin * band_ + length - 1];
+    return LongItem(begin, end);
   }
 
   // Return item for single-token span.
@@ -108,6 +115,16 @@ class SpanChart {
   }
 
  private:
+  // Return item for span longer than the band. The item is added to the chart
+  // if it is not already there.
+  Item &LongItem(int begin, int end);
+
+  // Return item for span, or null if the span is not stored in the chart.
+  const Item *Find(int begin, int end) const;
+
+  // Compute best span covering for segment.
+  void SolveSegment(int begin, int end);
+
   // Document and token span for chart.
   const Document *document_;
   int begin_;
@@ -116,10 +133,23 @@ class SpanChart {
   // Maximum phrase length considered for matching.
   int maxlen_;
 
-  // Chart items indexed by span start and length.
+  // Chart items for spans up to the band length indexed by span start and
+  // length.
   std::vector<Item> items_;
+  int band_;
   int size_;
 
+  // Chart items for spans longer than the band length indexed by span start
+  // and end.
+  std::unordered_map<int, Item> long_items_;
+
+  // End of each segment in the chart.
+  std::vector<int> segments_;
+
+  // Span costs and splits for the segment being solved.
+  std::vector<float> costs_;
+  std::vector<int> splits_;
+
   // Tracked frame handles.
   Handles tracking_;
 };
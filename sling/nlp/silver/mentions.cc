@@ -51,11 +51,18 @@ void SpanPopulator::Annotate(const PhraseTable *aliases,
   }
 
   // Find all matching spans up to the maximum length.
+  const Document *document = chart->document();
   for (int b = begin; b < end; ++b) {
     // Span cannot start on a skipped token.
     if (skip[b - begin]) continue;
 
+    // The phrase fingerprint is extended one token at a time, so each span
+    // fingerprint is computed incrementally from the previous one.
+    uint64 fp = 1;
     for (int e = b + 1; e <= std::min(b + chart->maxlen(), end); ++e) {
+      uint64 word_fp = document->TokenFingerprint(e - 1);
+      if (word_fp != 1) fp = Fingerprinter::Mix(word_fp, fp);
+
       // Span cannot end on a skipped token. This does not apply to upper case
       // tokens.
       if (skip[e - begin - 1]) {
@@ -63,8 +70,10 @@ void SpanPopulator::Annotate(const PhraseTable *aliases,
         if (form != CASE_TITLE && form != CASE_UPPER) continue;
       }
 
+      // Skip phrases that are not in the phrase table.
+      if (!aliases->MaybeContains(fp)) continue;
+
       // Check if phrase has been black-listed.
-      uint64 fp = chart->document()->PhraseFingerprint(b, e);
       if (blacklist_.count(fp) > 0) continue;
 
       // Find matches in phrase table.
@@ -89,18 +89,53 @@ string WikiTemplate::GetValue(const Node *node) const {
   return value.text();
 }
 
+Text WikiTemplate::GetText(const Node *node, string *buffer) const {
+  if (node == nullptr) return Text();
+
+  // Check for argument with a single text node.
+  int child = node->first_child;
+  if (child != -1) {
+    const Node &n = extractor_->parser().node(child);
+    if (n.type == WikiParser::TEXT && n.next_sibling == -1) {
+      // The plain text sink skips text starting with '<'.
+      const char *begin = n.begin;
+      const char *end = n.end;
+      if (begin != end && *begin == '<') return Text();
+
+      // Trim whitespace and check that there are no line breaks or runs of
+      // spaces that would be collapsed by the plain text sink.
+      while (begin < end && (*begin == ' ' || *begin == '\n')) begin++;
+      while (end > begin && (end[-1] == ' ' || end[-1] == '\n')) end--;
+      bool plain = true;
+      for (const char *p = begin; p < end; ++p) {
+        if (*p == '\n' || (*p == ' ' && p[1] == ' ')) {
+          plain = false;
+          break;
+        }
+      }
+      if (plain) return Text(begin, end - begin);
+    }
+  }
+
+  // Extract plain text into buffer.
+  *buffer = GetValue(node);
+  return Text(*buffer);
+}
+
 int WikiTemplate::GetNumber(const Node *node) const {
   if (node == nullptr) return -1;
-  string value = GetValue(node);
+  string buffer;
+  Text value = GetText(node, &buffer);
   if (value.empty()) return 0;
   int number;
-  if (safe_strto32(value, &number)) return number;
+  if (safe_strto32(value.data(), value.size(), &number)) return number;
   return -1;
 }
 
 float WikiTemplate::GetFloat(const Node *node) const {
   if (node == nullptr) return 0.0;
-  string value = GetValue(node);
+  string buffer;
+  string value = GetText(node, &buffer).str();
   if (value.empty()) return 0.0;
   float number;
   if (safe_strtof(value, &number)) return number;
@@ -77,6 +77,11 @@ class WikiTemplate {
   string GetValue(Text name) const { return GetValue(GetArgument(name)); }
   string GetValue(int index) const { return GetValue(GetArgument(index)); }
 
+  // Return plain text value for template argument without copying when the
+  // argument is a single text span that needs no whitespace normalization.
+  // Otherwise, the value is extracted into the buffer.
+  Text GetText(const Node *node, string *buffer) const;
+
   // Return numeric value for named or positional template argument. Return
   // -1 if the argument does not exist or is not a number and return zero if
   // the argument is empty.
@@ -14,6 +14,8 @@
 
 #include "sling/nlp/wiki/wiki-extractor.h"
 
+#include <string.h>
+
 #include "sling/string/strcat.h"
 
 namespace sling {
@@ -327,21 +329,29 @@ void WikiExtractor::ResetFont() {
 
 void WikiPlainTextSink::Content(const char *begin, const char *end) {
   if (begin != end && *begin == '<') return;
-  for (const char *p = begin; p < end; ++p) {
+  const char *p = begin;
+  while (p < end) {
     if (*p == ' ' || *p == '\n') {
       space_break_ = true;
+      p++;
     } else {
       if (space_break_) {
         text_.push_back(' ');
         space_break_ = false;
       }
-      text_.push_back(*p);
+
+      // Output the run of characters up to the next space or newline.
+      const char *q = p + 1;
+      while (q < end && *q != ' ' && *q != '\n') q++;
+      text_.append(p, q - p);
+      p = q;
     }
   }
 }
 
 void WikiTextSink::Content(const char *begin, const char *end) {
-  for (const char *p = begin; p < end; ++p) {
+  const char *p = begin;
+  while (p < end) {
     if (*p == '\n') {
       if (!text_.empty()) line_breaks_++;
       word_break_ = false;
@@ -352,7 +362,11 @@ void WikiTextSink::Content(const char *begin, const char *end) {
         case 5: text_.append("</em></b>"); break;
       }
       font_ = 0;
-    } else if (*p != ' ' || line_breaks_ == 0) {
+      p++;
+    } else if (*p == ' ' && line_breaks_ > 0) {
+      // Skip spaces at the beginning of a line.
+      p++;
+    } else {
       if (line_breaks_ > 1) {
         text_.append("\n<p>");
         line_breaks_ = 0;
@@ -368,7 +382,14 @@ void WikiTextSink::Content(const char *begin, const char *end) {
         text_.append("\xe2\x80\x8b");  // zero-width space
         word_break_ = false;
       }
-      text_.push_back(*p);
+
+      // Output the run of characters up to the next newline. There are no
+      // pending breaks after the first character, so the rest of the line
+      // can be copied verbatim.
+      const char *q = static_cast<const char *>(memchr(p, '\n', end - p));
+      if (q == nullptr) q = end;
+      text_.append(p, q - p);
+      p = q;
     }
   }
 }
@@ -0,0 +1,99 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark for the wiki text parser and extractor. The wiki text of the
+// pages in a Wikipedia article dump, i.e. the output of the Wikipedia
+// importer, is loaded into memory and parsed and extracted a number of times.
+// The throughput is reported in pages/s and MB/s.
+
+#include <string>
+#include <vector>
+
+#include "sling/base/clock.h"
+#include "sling/base/flags.h"
+#include "sling/base/init.h"
+#include "sling/base/logging.h"
+#include "sling/base/types.h"
+#include "sling/file/recordio.h"
+#include "sling/frame/object.h"
+#include "sling/frame/serialization.h"
+#include "sling/frame/store.h"
+#include "sling/nlp/wiki/wiki-extractor.h"
+#include "sling/nlp/wiki/wiki-parser.h"
+#include "sling/stream/memory.h"
+
+DEFINE_string(input, "local/data/e/wiki/en/articles@10.rec",
+              "Wikipedia article records with wiki text");
+DEFINE_int32(maxpages, 10000, "Maximum number of pages to load");
+DEFINE_int32(runs, 5, "Number of benchmark runs");
+DEFINE_bool(reuse, true, "Reuse parser across pages");
+DEFINE_bool(extract, true, "Extract text from AST");
+
+using namespace sling;
+using namespace sling::nlp;
+
+int main(int argc, char *argv[]) {
+  InitProgram(&argc, &argv);
+
+  // Load wiki text for pages.
+  LOG(INFO) << "Loading pages from " << FLAGS_input;
+  RecordDatabase db(FLAGS_input, RecordFileOptions());
+  std::vector<string> pages;
+  int64 bytes = 0;
+  while (pages.size() < FLAGS_maxpages && !db.Done()) {
+    Record record;
+    CHECK(db.Next(&record));
+    Store store;
+    ArrayInputStream stream(record.value.data(), record.value.size());
+    InputParser parser(&store, &stream);
+    Frame frame = parser.Read().AsFrame();
+    CHECK(frame.valid());
+    string text = frame.GetString("/wp/page/text");
+    if (text.empty()) continue;
+    bytes += text.size();
+    pages.emplace_back(std::move(text));
+  }
+  LOG(INFO) << pages.size() << " pages, " << bytes << " bytes";
+
+  // Parse pages and extract text, and report the throughput for the fastest
+  // run.
+  double best = 0.0;
+  int64 nodes = 0;
+  WikiParser reused;
+  for (int run = 0; run < FLAGS_runs; ++run) {
+    nodes = 0;
+    Clock clock;
+    clock.start();
+    for (const string &wikitext : pages) {
+      WikiParser fresh;
+      WikiParser &parser = FLAGS_reuse ? reused : fresh;
+      parser.Reset(wikitext.c_str());
+      parser.Parse();
+      nodes += parser.nodes().size();
+      if (FLAGS_extract) {
+        WikiExtractor extractor(parser);
+        WikiTextSink sink;
+        extractor.Extract(&sink);
+      }
+    }
+    clock.stop();
+    double pps = pages.size() / clock.secs();
+    LOG(INFO) << "Run " << run << ": " << pps << " pages/s, "
+              << bytes / clock.secs() / 1e6 << " MB/s";
+    if (pps > best) best = pps;
+  }
+  LOG(INFO) << nodes << " AST nodes, best " << best << " pages/s";
+
+  return 0;
+}
@@ -191,8 +191,14 @@ static const TemplatePrefixMap template_prefix = {
 }  // namespace
 
 WikiParser::WikiParser(const char *wikitext) {
+  Reset(wikitext);
+}
+
+void WikiParser::Reset(const char *wikitext) {
   ptr_ = wikitext;
   txt_ = ptr_;
+  nodes_.clear();
+  stack_.clear();
 }
 
 void WikiParser::Parse() {
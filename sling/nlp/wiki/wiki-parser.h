@@ -102,6 +102,15 @@ class WikiParser {
   // Initialize parser with wiki text.
   WikiParser(const char *wikitext);
 
+  // Initialize parser without wiki text. Use Reset() to set the text before
+  // parsing.
+  WikiParser() {}
+
+  // Reset parser for parsing new wiki text. The storage for the AST nodes is
+  // kept, so a parser that is reused for parsing many pages does not need to
+  // allocate node storage for each page. The wiki text must outlive the AST.
+  void Reset(const char *wikitext);
+
   // Parse wiki text.
   void Parse();
 
@@ -28,6 +28,7 @@
 #include "sling/task/frames.h"
 #include "sling/task/process.h"
 #include "sling/task/task.h"
+#include "sling/util/threadpool.h"
 #include "sling/web/xml-parser.h"
 
 namespace sling {
@@ -63,9 +64,21 @@ class WikipediaXMLParser : public XMLParser {
     num_redirects_ = task->GetCounter("wikipedia_redirects");
     num_fragment_redirects_ = task->GetCounter("fragment_redirects");
     input_bytes_ = task->GetCounter("wikipedia_input_bytes");
+
+    // Start worker threads for building and sending page frames. The bounded
+    // worker queue blocks the parser when the workers fall behind.
+    int threads = task->Get("worker_threads", 0);
+    if (threads > 0) {
+      int queue_size = task->Get("worker_queue", threads * 4);
+      pool_ = new ThreadPool(threads, queue_size);
+      pool_->StartWorkers();
+    }
   }
 
   ~WikipediaXMLParser() {
+    // Wait for workers to output the remaining pages.
+    delete pool_;
+
     if (articles_channel_) articles_channel_->Close();
     if (redirects_channel_) redirects_channel_->Close();
   }
@@ -147,89 +160,114 @@ class WikipediaXMLParser : public XMLParser {
   // Process Wikipedia page.
   void ProcessPage() {
     // Get article fields.
-    const string &title = fields_[TITLE];
-    const string &text = fields_[TEXT];
-    int ns = -1;
+    Page *page = new Page();
+    page->title.swap(fields_[TITLE]);
+    page->text.swap(fields_[TEXT]);
+    page->redirect.swap(redirect_);
     if (!fields_[NS].empty()) {
-      CHECK(safe_strto32(fields_[NS], &ns));
+      CHECK(safe_strto32(fields_[NS], &page->ns));
     }
-    int pageid = -1;
     if (!fields_[ID].empty()) {
-      CHECK(safe_strto32(fields_[ID], &pageid));
+      CHECK(safe_strto32(fields_[ID], &page->pageid));
     }
-    string id = Wiki::Id(lang_, title);
 
-    if (redirect_.empty()) {
+    if (page->redirect.empty()) {
       // Only keep articles in main and category namespaces.
-      task::Counter *&ctr = num_namespace_pages_[ns];
+      task::Counter *&ctr = num_namespace_pages_[page->ns];
       if (ctr == nullptr) {
-        ctr = task_->GetCounter(StringPrintf("namespace_pages[%d]", ns));
+        ctr = task_->GetCounter(StringPrintf("namespace_pages[%d]", page->ns));
       }
       ctr->Increment();
-      if (ns != WIKIPEDIA_NAMESPACE_MAIN &&
-          ns != WIKIPEDIA_NAMESPACE_CATEGORY) {
+      if (page->ns != WIKIPEDIA_NAMESPACE_MAIN &&
+          page->ns != WIKIPEDIA_NAMESPACE_CATEGORY) {
+        delete page;
         return;
       }
+    } else if (page->text.find('#', 1) != string::npos) {
+      // Ignore redirects with fragments.
+      VLOG(9) << "Ignore redirect from " << page->title << ": " << page->text;
+      num_fragment_redirects_->Increment();
+      delete page;
+      page = nullptr;
+    }
+
+    // Build and output page frame, either in a worker thread or inline.
+    if (page != nullptr) {
+      if (pool_ != nullptr) {
+        pool_->Schedule([this, page]() {
+          OutputPage(*page);
+          delete page;
+        });
+      } else {
+        OutputPage(*page);
+        delete page;
+      }
+    }
 
+    // Update input statistics.
+    uint64 bytes = input()->stream()->ByteCount();
+    input_bytes_->Increment(bytes - position_);
+    position_ = bytes;
+  }
+
+ private:
+  // Fields for Wikipedia page.
+  struct Page {
+    string title;
+    string text;
+    string redirect;
+    int ns = -1;
+    int pageid = -1;
+  };
+
+  // Build frame for article or redirect and output it on the channel for the
+  // page type. This is thread-safe.
+  void OutputPage(const Page &page) {
+    string id = Wiki::Id(lang_, page.title);
+    Store store(&commons_);
+    Builder builder(&store);
+    if (page.redirect.empty()) {
       // Build article frame.
-      Store store(&commons_);
-      Builder builder(&store);
       builder.AddId(id);
       builder.AddIsA(n_page_);
-      if (ns == WIKIPEDIA_NAMESPACE_CATEGORY) builder.AddIsA(n_category_);
-      builder.Add(n_page_pageid_, pageid);
-      builder.Add(n_page_title_, title);
+      if (page.ns == WIKIPEDIA_NAMESPACE_CATEGORY) builder.AddIsA(n_category_);
+      builder.Add(n_page_pageid_, page.pageid);
+      builder.Add(n_page_title_, page.title);
       builder.AddLink(n_lang_, "/lang/" + lang_);
-      if (!text.empty()) {
-        builder.Add(n_page_text_, text);
+      if (!page.text.empty()) {
+        builder.Add(n_page_text_, page.text);
       }
 
       // Output frame.
       Frame frame = builder.Create();
-      if (ns == WIKIPEDIA_NAMESPACE_MAIN) {
+      if (page.ns == WIKIPEDIA_NAMESPACE_MAIN) {
         if (articles_channel_) {
           articles_channel_->Send(task::CreateMessage(frame));
         }
         num_articles_->Increment();
-      } else if (ns == WIKIPEDIA_NAMESPACE_CATEGORY) {
+      } else if (page.ns == WIKIPEDIA_NAMESPACE_CATEGORY) {
         if (categories_channel_) {
           categories_channel_->Send(task::CreateMessage(frame));
         }
         num_categories_->Increment();
       }
     } else {
-      // Ignore redirects with fragments.
-      if (fields_[TEXT].find('#', 1) != string::npos) {
-        VLOG(9) << "Ignore redirect from " << title << ": " << fields_[TEXT];
-        num_fragment_redirects_->Increment();
-      } else {
-        // Build redirect frame.
-        Store store(&commons_);
-        Builder builder(&store);
-        builder.AddId(id);
-        builder.AddIsA(n_redirect_);
-        builder.Add(n_redirect_pageid_, pageid);
-        builder.Add(n_redirect_title_, title);
-        if (!redirect_.empty()) {
-          builder.AddLink(n_redirect_link_, Wiki::Id(lang_, redirect_));
-        }
-
-        // Output frame on redirect channel.
-        if (redirects_channel_) {
-          Frame frame = builder.Create();
-          redirects_channel_->Send(task::CreateMessage(frame));
-        }
-        num_redirects_->Increment();
+      // Build redirect frame.
+      builder.AddId(id);
+      builder.AddIsA(n_redirect_);
+      builder.Add(n_redirect_pageid_, page.pageid);
+      builder.Add(n_redirect_title_, page.title);
+      builder.AddLink(n_redirect_link_, Wiki::Id(lang_, page.redirect));
+
+      // Output frame on redirect channel.
+      if (redirects_channel_) {
+        Frame frame = builder.Create();
+        redirects_channel_->Send(task::CreateMessage(frame));
       }
+      num_redirects_->Increment();
     }
-
-    // Update input statistics.
-    uint64 bytes = input()->stream()->ByteCount();
-    input_bytes_->Increment(bytes - position_);
-    position_ = bytes;
   }
 
- private:
   // Wikimedia XML fields.
   enum Field {
     NONE, MEDIAWIKI, PAGE, REVISION,
@@ -270,6 +308,9 @@ class WikipediaXMLParser : public XMLParser {
   task::Counter *input_bytes_;
   uint64 position_ = 0;
 
+  // Worker threads for outputting pages.
+  ThreadPool *pool_ = nullptr;
+
   // SLING store.
   Store commons_;
   Names names_;
@@ -298,7 +339,8 @@ class WikipediaImporter : public task::Process {
 
     // Open input file.
     int buffer_size = task->Get("buffer_size", 256 * 1024);
-    FileInput file(input->resource()->name(), buffer_size);
+    int threads = task->Get("decompression_threads", 0);
+    FileInput file(input->resource()->name(), buffer_size, threads);
 
     // Parse XML parser.
     WikipediaXMLParser parser(task);
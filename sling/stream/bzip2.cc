@@ -15,6 +15,7 @@
 #include "sling/stream/bzip2.h"
 
 #include <string.h>
+#include <string>
 
 #include "sling/base/logging.h"
 #include "third_party/bz2lib/bzlib.h"
@@ -28,6 +29,78 @@ void bz_internal_error(int errcode) {
 
 namespace sling {
 
+// Magic numbers for BZIP2 block header and end-of-stream marker.
+static const uint64 kBlockMagic = 0x314159265359ULL;
+static const uint64 kStreamEndMagic = 0x177245385090ULL;
+static const uint64 kMagicMask = 0xFFFFFFFFFFFFULL;
+
+// Maximum number of blocks merged when recovering from false block magic
+// numbers in the compressed data.
+static const int kMaxMerges = 16;
+
+// Return the byte starting at a bit position in a bit string. Bits beyond the
+// end of the string are zero.
+static inline uint8 GetByte(const string &src, int64 pos) {
+  int64 i = pos >> 3;
+  int shift = pos & 7;
+  uint8 b = static_cast<uint8>(src[i]) << shift;
+  if (shift != 0 && i + 1 < src.size()) {
+    b |= static_cast<uint8>(src[i + 1]) >> (8 - shift);
+  }
+  return b;
+}
+
+// Bit writer for building BZIP2 bit streams.
+class BitWriter {
+ public:
+  explicit BitWriter(string *out) : out_(out) {}
+
+  // Output the n (at most 32) lower bits of value.
+  void PutBits(uint32 value, int n) {
+    buffer_ = (buffer_ << n) | (value & ((1ULL << n) - 1));
+    count_ += n;
+    while (count_ >= 8) {
+      count_ -= 8;
+      out_->push_back(static_cast<char>(buffer_ >> count_));
+    }
+  }
+
+  // Output the 48-bit magic number.
+  void PutMagic(uint64 magic) {
+    PutBits(magic >> 24, 24);
+    PutBits(magic, 24);
+  }
+
+  // Append bits from bit string starting at bit position.
+  void Append(const string &src, int64 pos, int64 nbits) {
+    int64 end = pos + nbits;
+    if (count_ == 0 && (pos & 7) == 0) {
+      // Copy whole bytes if both source and destination are byte-aligned.
+      out_->append(src, pos >> 3, nbits >> 3);
+      pos += nbits & ~7LL;
+    } else {
+      while (pos + 8 <= end) {
+        PutBits(GetByte(src, pos), 8);
+        pos += 8;
+      }
+    }
+    if (pos < end) {
+      int n = end - pos;
+      PutBits(GetByte(src, pos) >> (8 - n), n);
+    }
+  }
+
+  // Pad output to byte boundary.
+  void Flush() {
+    if (count_ > 0) PutBits(0, 8 - count_);
+  }
+
+ private:
+  string *out_;
+  uint64 buffer_ = 0;
+  int count_ = 0;
+};
+
 BZip2Compressor::BZip2Compressor(OutputStream *sink,
                                  int block_size,
                                  int compression_level) {
@@ -145,5 +218,235 @@ int64 BZip2Decompressor::ByteCount() const {
   return total_bytes_ - backup_;
 }
 
+ParallelBZip2Decompressor::ParallelBZip2Decompressor(InputStream *source,
+                                                     int threads)
+    : source_(source), max_blocks_(threads * 2) {
+  pool_ = new ThreadPool(threads, threads * 2);
+  pool_->StartWorkers();
+}
+
+ParallelBZip2Decompressor::~ParallelBZip2Decompressor() {
+  // Wait for workers to complete before deleting the blocks.
+  delete pool_;
+  for (Block *block : blocks_) delete block;
+}
+
+bool ParallelBZip2Decompressor::Next(const void **data, int *size) {
+  // Check if there is any backed up data.
+  if (backup_ > 0) {
+    *data = output_.data() + output_.size() - backup_;
+    *size = backup_;
+    backup_ = 0;
+    return true;
+  }
+
+  for (;;) {
+    // Keep the workers busy with reading ahead.
+    while (blocks_.size() < max_blocks_ && Read()) {}
+    if (blocks_.empty()) return false;
+
+    // Wait for the next block in the input.
+    Block *block = blocks_.front();
+    Wait(block);
+    if (!block->ok) Recover();
+    blocks_.pop_front();
+    output_.swap(block->output);
+    delete block;
+
+    // Return uncompressed block.
+    if (!output_.empty()) {
+      *data = output_.data();
+      *size = output_.size();
+      total_bytes_ += output_.size();
+      return true;
+    }
+  }
+}
+
+void ParallelBZip2Decompressor::BackUp(int count) {
+  backup_ += count;
+  CHECK_LE(backup_, output_.size());
+}
+
+bool ParallelBZip2Decompressor::Skip(int count) {
+  while (count > 0) {
+    const void *chunk;
+    int bytes;
+    if (!Next(&chunk, &bytes)) return false;
+    if (count >= bytes) {
+      count -= bytes;
+    } else {
+      BackUp(bytes - count);
+      count = 0;
+    }
+  }
+  return true;
+}
+
+int64 ParallelBZip2Decompressor::ByteCount() const {
+  return total_bytes_ - backup_;
+}
+
+bool ParallelBZip2Decompressor::Read() {
+  if (eof_) return false;
+
+  // Read next chunk from source.
+  const void *chunk;
+  int bytes;
+  if (!source_->Next(&chunk, &bytes)) {
+    // Add the remaining input as the final segment.
+    eof_ = true;
+    int64 end = pending_.size() * 8;
+    if (end > start_) AddBlock(start_, end);
+    pending_.clear();
+    return true;
+  }
+  pending_.append(static_cast<const char *>(chunk), bytes);
+
+  // Split input at the block and end-of-stream magic numbers. The magic
+  // numbers are not byte-aligned, so all eight bit offsets are checked for
+  // each new input byte.
+  int64 size = pending_.size();
+  const uint8 *input = reinterpret_cast<const uint8 *>(pending_.data());
+  uint64 window = window_;
+  for (int64 i = scan_; i < size; ++i) {
+    window = (window << 8) | input[i];
+    for (int k = 7; k >= 0; --k) {
+      uint64 magic = (window >> k) & kMagicMask;
+      if (magic != kBlockMagic && magic != kStreamEndMagic) continue;
+      int64 pos = (i + 1) * 8 - k - 48;
+      if (pos <= start_) continue;
+      AddBlock(start_, pos);
+      start_ = pos;
+    }
+  }
+  window_ = window;
+  scan_ = size;
+
+  // Remove input that has been added to blocks.
+  int64 consumed = start_ >> 3;
+  if (consumed > 0) {
+    pending_.erase(0, consumed);
+    start_ -= consumed * 8;
+    scan_ -= consumed;
+  }
+  return true;
+}
+
+void ParallelBZip2Decompressor::AddBlock(int64 start, int64 end) {
+  // Extract the bits for the segment.
+  Block *block = new Block();
+  BitWriter writer(&block->bits);
+  writer.Append(pending_, start, end - start);
+  writer.Flush();
+  block->nbits = end - start;
+  blocks_.push_back(block);
+
+  // Only segments starting with a block header contain compressed data.
+  uint64 magic = 0;
+  if (block->nbits >= 48) {
+    for (int i = 0; i < 6; ++i) {
+      magic = (magic << 8) | GetByte(block->bits, i * 8);
+    }
+  }
+  if (magic != kBlockMagic) {
+    block->skip = true;
+    block->done = true;
+    block->ok = true;
+    return;
+  }
+
+  // Decompress block in worker thread.
+  pool_->Schedule([this, block]() {
+    string output;
+    bool ok = Decompress(block->bits, block->nbits, &output);
+    MutexLock lock(&mu_);
+    block->output.swap(output);
+    block->ok = ok;
+    block->done = true;
+    completed_.notify_all();
+  });
+}
+
+void ParallelBZip2Decompressor::Wait(Block *block) {
+  std::unique_lock<std::mutex> lock(mu_);
+  while (!block->done) completed_.wait(lock);
+}
+
+void ParallelBZip2Decompressor::Recover() {
+  // A false magic number splits a block into fragments that cannot be
+  // decompressed separately, so merge the block with the following segments
+  // until it can be decompressed.
+  Block *block = blocks_.front();
+  for (int merges = 0; !block->ok; ++merges) {
+    CHECK_LT(merges, kMaxMerges) << "Corrupt BZIP2 input";
+    while (blocks_.size() < 2 && Read()) {}
+    CHECK_GE(blocks_.size(), 2) << "Corrupt BZIP2 input";
+    Block *next = blocks_[1];
+    Wait(next);
+
+    string bits;
+    BitWriter writer(&bits);
+    writer.Append(block->bits, 0, block->nbits);
+    writer.Append(next->bits, 0, next->nbits);
+    writer.Flush();
+    block->bits.swap(bits);
+    block->nbits += next->nbits;
+    blocks_.erase(blocks_.begin() + 1);
+    delete next;
+
+    block->ok = Decompress(block->bits, block->nbits, &block->output);
+  }
+}
+
+bool ParallelBZip2Decompressor::Decompress(const string &bits, int64 nbits,
+                                           string *output) {
+  // A block consists of the magic number, the block CRC, and the compressed
+  // data.
+  output->clear();
+  if (nbits < 80) return false;
+
+  // Build a stand-alone stream with the block. The combined CRC for a stream
+  // with a single block is the same as the block CRC.
+  string input;
+  input.reserve(bits.size() + 16);
+  BitWriter writer(&input);
+  writer.PutBits('B', 8);
+  writer.PutBits('Z', 8);
+  writer.PutBits('h', 8);
+  writer.PutBits('9', 8);
+  writer.Append(bits, 0, nbits);
+  writer.PutMagic(kStreamEndMagic);
+  for (int i = 0; i < 4; ++i) writer.PutBits(GetByte(bits, 48 + i * 8), 8);
+  writer.Flush();
+
+  // Decompress stream.
+  bz_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  CHECK(BZ2_bzDecompressInit(&stream, 0, 0) == BZ_OK);
+  stream.next_in = const_cast<char *>(input.data());
+  stream.avail_in = input.size();
+  int64 used = 0;
+  bool ok = false;
+  for (;;) {
+    if (used == output->size()) {
+      output->resize(output->empty() ? bits.size() * 4 : output->size() * 2);
+    }
+    stream.next_out = &(*output)[used];
+    stream.avail_out = output->size() - used;
+    int rc = BZ2_bzDecompress(&stream);
+    used = output->size() - stream.avail_out;
+    if (rc == BZ_STREAM_END) {
+      ok = true;
+      break;
+    }
+    if (rc != BZ_OK) break;
+    if (stream.avail_in == 0 && stream.avail_out > 0) break;
+  }
+  CHECK(BZ2_bzDecompressEnd(&stream) == BZ_OK);
+  output->resize(ok ? used : 0);
+  return ok;
+}
+
 }  // namespace sling
 
@@ -15,8 +15,14 @@
 #ifndef SLING_STREAM_BZIP2_H_
 #define SLING_STREAM_BZIP2_H_
 
+#include <condition_variable>
+#include <deque>
+#include <string>
+
 #include "sling/base/types.h"
 #include "sling/stream/stream.h"
+#include "sling/util/mutex.h"
+#include "sling/util/threadpool.h"
 #include "third_party/bz2lib/bzlib.h"
 
 namespace sling {
@@ -78,6 +84,96 @@ class BZip2Decompressor : public InputStream {
   int backup_;
 };
 
+// Parallel BZIP2 stream decompression. The blocks in a BZIP2 stream are
+// compressed independently and start with a 48-bit magic number at an
+// arbitrary bit offset. The compressed input is split at the block boundaries
+// and each block is decompressed by a pool of worker threads as a stand-alone
+// single-block stream. The uncompressed blocks are returned in order, and the
+// number of blocks in flight is bounded to limit memory usage. Multi-stream
+// files, like the ones produced by pbzip2 and lbzip2, are also supported.
+class ParallelBZip2Decompressor : public InputStream {
+ public:
+  // Initialize decompressor with a number of worker threads.
+  ParallelBZip2Decompressor(InputStream *source, int threads);
+  ~ParallelBZip2Decompressor() override;
+
+  // Implementation of InputStream interface.
+  bool Next(const void **data, int *size) override;
+  void BackUp(int count) override;
+  bool Skip(int count) override;
+  int64 ByteCount() const override;
+
+ private:
+  // Segment of the compressed input between two magic numbers. The bits of
+  // the segment are aligned to the start of the bit string.
+  struct Block {
+    string bits;            // compressed bits for block
+    int64 nbits = 0;        // number of compressed bits
+    bool skip = false;      // stream header or end-of-stream segment
+    bool done = false;      // decompression completed
+    bool ok = false;        // block was successfully decompressed
+    string output;          // uncompressed block
+  };
+
+  // Read next chunk from source and split it into blocks. Returns false when
+  // there is no more input.
+  bool Read();
+
+  // Add segment of pending input for decompression.
+  void AddBlock(int64 start, int64 end);
+
+  // Wait until block has been decompressed.
+  void Wait(Block *block);
+
+  // Merge block with the following block(s) and decompress it again. This
+  // handles block magic numbers that occur by chance in the compressed data.
+  void Recover();
+
+  // Decompress block as a stand-alone single-block stream. Returns false if
+  // the block could not be decompressed.
+  static bool Decompress(const string &bits, int64 nbits, string *output);
+
+  // Source for compressed input.
+  InputStream *source_;
+
+  // Worker threads for decompressing blocks.
+  ThreadPool *pool_;
+
+  // Maximum number of blocks in flight.
+  int max_blocks_;
+
+  // Compressed input that has not been added to a block yet.
+  string pending_;
+
+  // Bit position of the start of the current segment in the pending input.
+  int64 start_ = 0;
+
+  // Byte position of the next byte to scan in the pending input.
+  int64 scan_ = 0;
+
+  // Bits shifted in from the scanned input.
+  uint64 window_ = 0;
+
+  // End of input reached.
+  bool eof_ = false;
+
+  // Blocks in input order.
+  std::deque<Block *> blocks_;
+
+  // Current uncompressed block.
+  string output_;
+
+  // Number of bytes uncompressed.
+  uint64 total_bytes_ = 0;
+
+  // Number of bytes to back up.
+  int backup_ = 0;
+
+  // Mutex and signal for completed blocks.
+  Mutex mu_;
+  std::condition_variable completed_;
+};
+
 }  // namespace sling
 
 #endif  // SLING_STREAM_BZIP2_H_
@@ -53,7 +53,8 @@ int64 InputPipeline::ByteCount() const {
   return last_->ByteCount();
 }
 
-InputStream *FileInput::Open(const string &filename, int block_size) {
+InputStream *FileInput::Open(const string &filename, int block_size,
+                             int threads) {
   // Open input file.
   InputStream *stream = new FileInputStream(filename, block_size);
 
@@ -67,7 +68,11 @@ InputStream *FileInput::Open(const string &filename, int block_size) {
       decompressor = new GZipDecompressor(stream, block_size);
     } else if (ext == ".bz2") {
       // Add BZIP2 decompressor.
-      decompressor =  new BZip2Decompressor(stream, block_size);
+      if (threads > 1) {
+        decompressor = new ParallelBZip2Decompressor(stream, threads);
+      } else {
+        decompressor = new BZip2Decompressor(stream, block_size);
+      }
     }
 
     // Create input pipeline for compressed files.
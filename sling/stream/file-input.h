@@ -51,17 +51,20 @@ class InputPipeline : public InputStream {
 };
 
 // File input class that supports decompression of the input stream based on
-// the file extension.
+// the file extension. BZIP2 input is decompressed in parallel if the number
+// of decompression threads is more than one.
 class FileInput : public Input {
  public:
   // Open file.
-  explicit FileInput(const string &filename, int block_size = 1 << 20)
-      : Input(Open(filename, block_size)) {}
+  explicit FileInput(const string &filename, int block_size = 1 << 20,
+                     int threads = 0)
+      : Input(Open(filename, block_size, threads)) {}
 
   ~FileInput() { delete stream(); }
 
   // Open input file and add decompression for compressed input files.
-  static InputStream *Open(const string &filename, int block_size = 1 << 20);
+  static InputStream *Open(const string &filename, int block_size = 1 << 20,
+                           int threads = 0);
 
  private:
   DISALLOW_IMPLICIT_CONSTRUCTORS(FileInput);
@@ -14,11 +14,19 @@
 
 #include "sling/task/documents.h"
 
+#include "sling/base/logging.h"
+#include "sling/frame/store.h"
+
 namespace sling {
 namespace task {
 
 REGISTER_TASK_PROCESSOR("document-processor", DocumentProcessor);
 
+DocumentProcessor::~DocumentProcessor() {
+  delete executor_;
+  if (docnames_) docnames_->Release();
+}
+
 void DocumentProcessor::InitCommons(Task *task) {
   // Initialize document annotation pipeline.
   pipeline_.Init(task, commons_);
@@ -35,6 +43,52 @@ void DocumentProcessor::Start(Task *task) {
   num_documents_ = task->GetCounter("documents");
   num_tokens_ = task->GetCounter("tokens");
   num_spans_ = task->GetCounter("spans");
+
+  // Run each annotator in the pipeline on a separate thread if requested.
+  if (!pipeline_.empty() && task->Get("pipelined_annotators", false)) {
+    int queue_size = task->Get("annotator_queue", 16);
+    int output_threads = task->Get("annotator_output_threads", 1);
+    executor_ = new nlp::PipelineExecutor(&pipeline_, queue_size,
+                                          output_threads);
+    executor_->Start();
+  }
+}
+
+void DocumentProcessor::Receive(Channel *channel, Message *message) {
+  if (executor_ == nullptr) {
+    FrameProcessor::Receive(channel, message);
+    return;
+  }
+
+  // Decode document into a local store which is handed over to the annotation
+  // stages together with the document.
+  Store *store = new Store(commons_);
+  nlp::Document *document = DecodeDocument(store, message);
+
+  // Process document when it has been annotated by all the stages.
+  executor_->Submit(document, [this, store, message](nlp::Document *document) {
+    document->Update();
+    Process(message->key(), *document);
+
+    // Update statistics.
+    num_documents_->Increment();
+    num_tokens_->Increment(document->num_tokens());
+    num_spans_->Increment(document->num_spans());
+    delete document;
+    UpdateStoreStatistics(store);
+
+    delete store;
+    delete message;
+  });
+}
+
+void DocumentProcessor::Done(Task *task) {
+  // Wait until all documents in the annotation pipeline have been processed.
+  delete executor_;
+  executor_ = nullptr;
+
+  // Flush output.
+  FrameProcessor::Done(task);
 }
 
 void DocumentProcessor::Process(Slice key, const Frame &frame) {
@@ -60,6 +114,13 @@ void DocumentProcessor::Process(Slice key, const nlp::Document &document) {
   Output(key, document);
 }
 
+nlp::Document *DocumentProcessor::DecodeDocument(Store *store,
+                                                 Message *message) {
+  Frame frame = DecodeMessage(store, message);
+  CHECK(frame.valid());
+  return new nlp::Document(frame, docnames_);
+}
+
 void DocumentProcessor::Output(Text key, const nlp::Document &document) {
   FrameProcessor::Output(key, document.top());
 }
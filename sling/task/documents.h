@@ -23,10 +23,22 @@ namespace sling {
 namespace task {
 
 // Task processor for receiving and sending documents.
+//
+// If the "pipelined_annotators" task parameter is set, the document annotators
+// run as a pipeline with one thread per annotator (see PipelineExecutor), and
+// Process() is called on a separate pool of "annotator_output_threads" threads
+// (default 1). Each annotator stage is single-threaded, so the throughput is
+// bounded by the slowest annotator, and a single output thread serializes
+// Process() calls. This pays off when several annotators of similar cost can
+// overlap. When one annotator dominates, running more task workers with the
+// serial path is usually faster. "annotator_queue" sets the number of queued
+// documents per stage (default 16).
 class DocumentProcessor : public FrameProcessor {
  public:
-  ~DocumentProcessor() { if (docnames_) docnames_->Release(); }
+  ~DocumentProcessor();
 
+  void Receive(Channel *channel, Message *message) override;
+  void Done(Task *task) override;
   void Process(Slice key, const Frame &frame) override;
 
   // Initialize commons store with document symbols.
@@ -48,12 +60,18 @@ class DocumentProcessor : public FrameProcessor {
   const nlp::DocumentNames *docnames() const { return docnames_; }
 
  private:
+  // Decode document from message into store.
+  nlp::Document *DecodeDocument(Store *store, Message *message);
+
   // Document symbol names.
   const nlp::DocumentNames *docnames_ = nullptr;
 
   // Document annotator pipeline for preprocessing incoming documents.
   nlp::Pipeline pipeline_;
 
+  // Executor for running the annotators in separate threads (optional).
+  nlp::PipelineExecutor *executor_ = nullptr;
+
   // Statistics.
   Counter *num_documents_;
   Counter *num_tokens_;
@@ -80,13 +80,7 @@ void FrameProcessor::Receive(Channel *channel, Message *message) {
   Process(message->key(), frame);
 
   // Update statistics.
-  MemoryUsage usage;
-  store.GetMemoryUsage(&usage, true);
-  frame_memory_->Increment(usage.memory_used());
-  frame_handles_->Increment(usage.used_handles());
-  frame_symbols_->Increment(usage.num_symbols());
-  frame_gcs_->Increment(usage.num_gcs);
-  frame_gctime_->Increment(usage.gc_time);
+  UpdateStoreStatistics(&store);
 
   // Delete input message.
   delete message;
@@ -121,6 +115,16 @@ void FrameProcessor::OutputShallow(const Frame &value) {
   output_->Send(CreateMessage(value, true));
 }
 
+void FrameProcessor::UpdateStoreStatistics(Store *store) {
+  MemoryUsage usage;
+  store->GetMemoryUsage(&usage, true);
+  frame_memory_->Increment(usage.memory_used());
+  frame_handles_->Increment(usage.used_handles());
+  frame_symbols_->Increment(usage.num_symbols());
+  frame_gcs_->Increment(usage.num_gcs);
+  frame_gctime_->Increment(usage.gc_time);
+}
+
 void FrameProcessor::InitCommons(Task *task) {}
 void FrameProcessor::Startup(Task *task) {}
 void FrameProcessor::Process(Slice key, const Frame &frame) {}
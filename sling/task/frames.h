@@ -58,6 +58,9 @@ class FrameProcessor : public Processor {
   Channel *output() const { return output_; }
 
  protected:
+  // Update frame store statistics with memory usage for local store.
+  void UpdateStoreStatistics(Store *store);
+
   // Commons store for messages.
   Store *commons_ = nullptr;
 
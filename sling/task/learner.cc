@@ -97,7 +97,8 @@ bool LearnerTask::EpochCompleted() {
   return done_;
 }
 
-Optimizer *GetOptimizer(Task *task) {
+// Create optimizer of the configured type.
+static Optimizer *NewOptimizer(Task *task) {
   const string &type = task->Get("optimizer", "sgd");
   float lr = task->Get("learning_rate", 0.01);
   float decay = task->Get("learning_rate_decay", 1.0);
@@ -131,5 +132,13 @@ Optimizer *GetOptimizer(Task *task) {
   }
 }
 
+Optimizer *GetOptimizer(Task *task) {
+  Optimizer *optimizer = NewOptimizer(task);
+  optimizer->set_num_shards(task->Get("optimizer_shards", 1));
+  optimizer->set_hogwild(task->Get("hogwild", false));
+  optimizer->set_lazy(task->Get("lazy_updates", false));
+  return optimizer;
+}
+
 }  // namespace task
 }  // namespace sling
@@ -44,7 +44,8 @@ class TextMapReader : public Process {
 
     // Open input file.
     int buffer_size = task->Get("buffer_size", 1 << 16);
-    FileInput file(input->resource()->name(), buffer_size);
+    int threads = task->Get("decompression_threads", 0);
+    FileInput file(input->resource()->name(), buffer_size, threads);
 
     // Statistics counters.
     Counter *invalid_map_lines = task->GetCounter("invalid_map_lines");
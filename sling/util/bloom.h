@@ -45,38 +45,69 @@ class BloomFilter {
   };
 
   // Initialize Bloom filter.
-  BloomFilter(size_t size, int hashes) : bits_(size), hashes_(hashes) {}
+  BloomFilter(size_t size, int hashes)
+      : bits_((size + 63) / 64), size_(size), hashes_(hashes) {}
 
   // Insert element in set.
   void insert(uint64 fp) {
-    Mixer mixer(fp, bits_.size());
-    for (int n = 0; n < bits_.size(); ++n) bits_[mixer()] = true;
+    Mixer mixer(fp, size_);
+    for (int n = 0; n < hashes_; ++n) set(bits_.data(), mixer());
   }
 
   // Add element to set and check if element was possibly already in the set.
   bool add(uint64 fp) {
-    Mixer mixer(fp, bits_.size());
+    Mixer mixer(fp, size_);
     bool member = true;
     for (int n = 0; n < hashes_; ++n) {
       uint64 h = mixer();
-      member &= bits_[h];
-      bits_[h] = true;
+      member &= test(bits_.data(), h);
+      set(bits_.data(), h);
     }
     return member;
   }
 
   // Check if element is possibly in the set.
-  bool contains(uint64 fp) {
-    Mixer mixer(fp, bits_.size());
-    for (int n = 0; n < hashes_; ++n) {
-      if (!bits_[mixer()]) return false;
+  bool contains(uint64 fp) const {
+    return Contains(bits_.data(), size_, hashes_, fp);
+  }
+
+  // Check if element is possibly in the set for a Bloom filter stored in an
+  // external bit vector, e.g. a memory-mapped repository block.
+  static bool Contains(const uint64 *bits, size_t size, int hashes,
+                       uint64 fp) {
+    Mixer mixer(fp, size);
+    for (int n = 0; n < hashes; ++n) {
+      if (!test(bits, mixer())) return false;
     }
     return true;
   }
 
+  // Bit vector for Bloom filter stored as 64-bit words.
+  const uint64 *data() const { return bits_.data(); }
+
+  // Size of bit vector in bytes.
+  size_t bytes() const { return bits_.size() * sizeof(uint64); }
+
+  // Number of bits in filter.
+  size_t size() const { return size_; }
+
+  // Number of hash functions in filter.
+  int hashes() const { return hashes_; }
+
  private:
+  // Bit operations on bit vector.
+  static bool test(const uint64 *bits, uint64 h) {
+    return (bits[h >> 6] >> (h & 63)) & 1;
+  }
+  static void set(uint64 *bits, uint64 h) {
+    bits[h >> 6] |= 1ULL << (h & 63);
+  }
+
   // Bit vector for Bloom filter.
-  std::vector<bool> bits_;
+  std::vector<uint64> bits_;
+
+  // Number of bits in filter.
+  size_t size_;
 
   // Number of hash functions in filter.
   int hashes_;
@@ -85,4 +116,3 @@ class BloomFilter {
 }  // namespace sling
 
 #endif  // SLING_UTIL_BLOOM_H_
-
@@ -14,7 +14,12 @@
 
 #include "sling/util/unicode.h"
 
+#include <string.h>
+#include <algorithm>
 #include <string>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "sling/base/logging.h"
 #include "sling/base/types.h"
@@ -434,28 +439,144 @@ void UTF8::Lowercase(const char *s, int len, string *result) {
   }
 }
 
-void UTF8::Normalize(const char *s, int len, int flags, string *normalized) {
-  // Clear output string.
-  normalized->clear();
+// Normalize ASCII characters one at a time until the first non-ASCII
+// character. Returns the number of input bytes consumed.
+static int NormalizeASCIIBytes(const char *s, int len, int flags, char **out) {
+  for (int i = 0; i < len; ++i) {
+    uint8 c = s[i];
+    if (c & 0x80) return i;
+    int ch = Unicode::Normalize(c, flags);
+    if (ch > 0) *(*out)++ = ch;
+  }
+  return len;
+}
+
+// Normalize the leading ASCII part of a string. All characters below 128 are
+// normalized to at most one byte, so the output buffer must have room for len
+// bytes. Blocks of up to 16 letters and digits are normalized in parallel
+// with SSE2 instructions, since these are never removed and only change for
+// case and digit normalization. Blocks with other characters are normalized
+// one character at a time. Returns the number of input bytes consumed and the
+// number of output bytes in outlen.
+static int NormalizeASCII(const char *s, int len, int flags,
+                          char *out, int *outlen) {
+  char *o = out;
+  int pos = 0;
+#ifdef __SSE2__
+  // Signed byte comparisons also reject all bytes of multi-byte characters.
+  const __m128i upper_lo = _mm_set1_epi8('A' - 1);
+  const __m128i upper_hi = _mm_set1_epi8('Z' + 1);
+  const __m128i lower_lo = _mm_set1_epi8('a' - 1);
+  const __m128i lower_hi = _mm_set1_epi8('z' + 1);
+  const __m128i digit_lo = _mm_set1_epi8('0' - 1);
+  const __m128i digit_hi = _mm_set1_epi8('9' + 1);
+  const __m128i case_bit = _mm_set1_epi8(0x20);
+  const __m128i nine = _mm_set1_epi8('9');
+  char block[16];
+  while (pos < len) {
+    // Load next block. A partial block at the end is copied to a zero-padded
+    // buffer to avoid reading past the end of the input.
+    int n = std::min(len - pos, 16);
+    __m128i v;
+    if (n == 16) {
+      v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + pos));
+    } else {
+      memset(block, 0, sizeof(block));
+      memcpy(block, s + pos, n);
+      v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+    }
 
+    // Classify characters in block.
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, upper_lo),
+                                  _mm_cmplt_epi8(v, upper_hi));
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, lower_lo),
+                                  _mm_cmplt_epi8(v, lower_hi));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, digit_lo),
+                                  _mm_cmplt_epi8(v, digit_hi));
+    __m128i alnum = _mm_or_si128(_mm_or_si128(upper, lower), digit);
+    int valid = (1 << n) - 1;
+    if ((_mm_movemask_epi8(alnum) & valid) != valid) {
+      // Normalize block one character at a time.
+      int done = NormalizeASCIIBytes(s + pos, n, flags, &o);
+      pos += done;
+      if (done < n) break;
+      continue;
+    }
+
+    // Normalize letters and digits.
+    if (flags & NORMALIZE_CASE) {
+      v = _mm_add_epi8(v, _mm_and_si128(upper, case_bit));
+    }
+    if (flags & NORMALIZE_DIGITS) {
+      v = _mm_or_si128(_mm_andnot_si128(digit, v), _mm_and_si128(digit, nine));
+    }
+
+    // Store normalized block.
+    if (n == 16) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(o), v);
+    } else {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(block), v);
+      memcpy(o, block, n);
+    }
+    o += n;
+    pos += n;
+  }
+#else
+  pos = NormalizeASCIIBytes(s, len, flags, &o);
+#endif
+  *outlen = o - out;
+  return pos;
+}
+
+void UTF8::Normalize(const char *s, int len, int flags, string *normalized) {
   // Try fast conversion where all characters are below 128. All characters
   // below 128 are normalized to one byte codes.
+  normalized->resize(len);
+  int outlen;
+  int pos = NormalizeASCII(s, len, flags, &(*normalized)[0], &outlen);
+  normalized->resize(outlen);
+
+  // Handle any remaining part of the string which can contain multi-byte
+  // characters.
   const char *end = s + len;
+  s += pos;
   while (s < end) {
-    uint8 c = *reinterpret_cast<const uint8 *>(s);
-    if (c & 0x80) break;
-    int ch = Unicode::Normalize(c, flags);
-    if (ch > 0) normalized->push_back(ch);
-    s++;
+    int ch = Unicode::Normalize(Decode(s), flags);
+    if (ch > 0) Encode(ch, normalized);
+    s = Next(s);
   }
+}
+
+int UTF8::Normalize(const char *s, int len, int flags,
+                    char *buffer, int size) {
+  // Normalize the ASCII part of the string directly into the buffer.
+  int outlen;
+  int pos = NormalizeASCII(s, std::min(len, size), flags, buffer, &outlen);
 
   // Handle any remaining part of the string which can contain multi-byte
   // characters.
+  const char *end = s + len;
+  s += pos;
   while (s < end) {
     int ch = Unicode::Normalize(Decode(s), flags);
-    if (ch > 0) Encode(ch, normalized);
+    if (ch > 0) {
+      char code[MAXLEN];
+      int n = Encode(ch, code);
+      if (outlen + n > size) return -1;
+      memcpy(buffer + outlen, code, n);
+      outlen += n;
+    }
     s = Next(s);
   }
+  return outlen;
+}
+
+Text UTF8::Normalize(Text str, int flags,
+                     char *buffer, int size, string *overflow) {
+  int len = Normalize(str.data(), str.size(), flags, buffer, size);
+  if (len >= 0) return Text(buffer, len);
+  Normalize(str.data(), str.size(), flags, overflow);
+  return Text(*overflow);
 }
 
 void UTF8::ToTitleCase(const string &str, string *titlecased) {
@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "sling/base/types.h"
+#include "sling/string/text.h"
 
 namespace sling {
 
@@ -304,6 +305,18 @@ class UTF8 {
     return result;
   }
 
+  // Normalize UTF8 encoded string into a caller-provided buffer without
+  // allocating memory. Returns the length of the normalized string or -1 if
+  // it does not fit in the buffer.
+  static int Normalize(const char *s, int len, int flags,
+                       char *buffer, int size);
+
+  // Normalize UTF8 encoded string into a caller-provided buffer, falling back
+  // to the overflow string if the result does not fit. Returns the normalized
+  // string, which points into either the buffer or the overflow string.
+  static Text Normalize(Text str, int flags,
+                        char *buffer, int size, string *overflow);
+
   // Convert string to title case, i.e. make the first letter uppercase.
   static void ToTitleCase(const string &str, string *titlecased);
 
@@ -1630,6 +1630,34 @@ class Assembler : public CodeGenerator {
     vinstr(0x25, dst, ymm0, isrc, k66, k0F38, kWIG);
   }
 
+  void vpmovzxwd(XMMRegister dst, XMMRegister src) {
+    vinstr(0x33, dst, xmm0, src, k66, k0F38, kWIG);
+  }
+  void vpmovzxwd(XMMRegister dst, const Operand &src) {
+    vinstr(0x33, dst, xmm0, src, k66, k0F38, kWIG);
+  }
+  void vpmovzxwd(YMMRegister dst, XMMRegister src) {
+    YMMRegister isrc = {src.code()};
+    vinstr(0x33, dst, ymm0, isrc, k66, k0F38, kWIG);
+  }
+  void vpmovzxwd(YMMRegister dst, const Operand &src) {
+    vinstr(0x33, dst, ymm0, src, k66, k0F38, kWIG);
+  }
+
+  void vcvtph2ps(XMMRegister dst, XMMRegister src) {
+    vinstr(0x13, dst, xmm0, src, k66, k0F38, kW0);
+  }
+  void vcvtph2ps(XMMRegister dst, const Operand &src) {
+    vinstr(0x13, dst, xmm0, src, k66, k0F38, kW0);
+  }
+  void vcvtph2ps(YMMRegister dst, XMMRegister src) {
+    YMMRegister isrc = {src.code()};
+    vinstr(0x13, dst, ymm0, isrc, k66, k0F38, kW0);
+  }
+  void vcvtph2ps(YMMRegister dst, const Operand &src) {
+    vinstr(0x13, dst, ymm0, src, k66, k0F38, kW0);
+  }
+
   void vcmpss(XMMRegister dst, XMMRegister src1, XMMRegister src2, int8_t cmp) {
     vss(0xC2, dst, src1, src2);
     emit(cmp);
@@ -2011,6 +2039,13 @@ class Assembler : public CodeGenerator {
     emit(imm8);
   }
 
+  void vpermd(YMMRegister dst, YMMRegister idx, YMMRegister src) {
+    vinstr(0x36, dst, idx, src, k66, k0F38, kW0);
+  }
+  void vpermd(YMMRegister dst, YMMRegister idx, const Operand &src) {
+    vinstr(0x36, dst, idx, src, k66, k0F38, kW0);
+  }
+
   void vbroadcastss(XMMRegister dst, XMMRegister src) {
     vinstr(0x18, dst, xmm0, src, k66, k0F38, kW0);
   }